@@ -49,8 +49,9 @@ private:
   static const float mIR[512];
 
   WDL_ImpulseBuffer mImpulse;
-//  WDL_ConvolutionEngine_Div mEngine; // < low latency version
-  WDL_ConvolutionEngine mEngine;
+//  WDL_ConvolutionEngine mEngine; // < uniformly partitioned version, latency = half the FFT size
+//  WDL_ConvolutionEngine_Div mEngine; // < low latency version, everything on the audio thread
+  WDL_ConvolutionEngine_Thread mEngine; // < low latency version, impulse beyond the first 8192 samples is convolved on a worker thread
   
   static constexpr int mBlockLength = 64;
 
@@ -62,7 +62,7 @@ public:
   
   void Reset(double sampleRate, int blockSize)
   {
-    mMidiQueue.Resize(blockSize);
+    mMidiQueue.Resize(IMidiQueue::SizeForBlock(blockSize));
 //    mMidiQueue.Resize(IMidiMsg::QueueSize(blockSize, sampleRate));
   }
   
@@ -72,7 +72,7 @@ public:
     {
       while (!mMidiQueue.Empty())
       {
-        IMidiMsg& msg = mMidiQueue.Peek();
+        const IMidiMsg msg = mMidiQueue.Peek();
         if (msg.mOffset > s) break;
         
         if(msg.StatusMsg() == IMidiMsg::kNoteOn && msg.Velocity())
@@ -69,12 +69,9 @@ public:
    *  This must be called on the main thread - typically in MyPlugin::OnIdle() */
   void TransmitData(IEditorDelegate& dlg)
   {
-    while(mQueue.ElementsAvailable())
-    {
-      ISenderData<MAXNC, T> d;
-      mQueue.Pop(d);
-      dlg.SendControlMsgFromDelegate(d.ctrlTag, kUpdateMessage, sizeof(ISenderData<MAXNC, T>), (void*) &d);
-    }
+    mQueue.Drain([&dlg](const ISenderData<MAXNC, T>& d) {
+      dlg.SendControlMsgFromDelegate(d.ctrlTag, kUpdateMessage, sizeof(ISenderData<MAXNC, T>), (const void*) &d);
+    });
   }
 
 private:
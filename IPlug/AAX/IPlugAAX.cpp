@@ -379,7 +379,7 @@ void IPlugAAX::RenderAudio(AAX_SIPlugRenderInfo* pRenderInfo, const TParamValPai
       {        
         while (!mMidiOutputQueue.Empty())
         {
-          IMidiMsg& msg = mMidiOutputQueue.Peek();
+          const IMidiMsg msg = mMidiOutputQueue.Peek();
           
           AAX_CMidiPacket packet;
           
@@ -114,12 +114,12 @@ void IPlugAPP::SendSysexMsgFromUI(const ISysEx& msg)
   SendSysEx(msg);
 }
 
-void IPlugAPP::AppProcess(double** inputs, double** outputs, int nFrames)
+void IPlugAPP::AppProcess(sample** inputs, sample** outputs, int nFrames)
 {
   SetChannelConnections(ERoute::kInput, 0, MaxNChannels(ERoute::kInput), !IsInstrument()); //TODO: go elsewhere - enable inputs
   SetChannelConnections(ERoute::kOutput, 0, MaxNChannels(ERoute::kOutput), true); //TODO: go elsewhere
-  AttachBuffers(ERoute::kInput, 0, NChannelsConnected(ERoute::kInput), inputs, GetBlockSize());
-  AttachBuffers(ERoute::kOutput, 0, NChannelsConnected(ERoute::kOutput), outputs, GetBlockSize());
+  AttachBuffers(ERoute::kInput, 0, NChannelsConnected(ERoute::kInput), inputs, nFrames);
+  AttachBuffers(ERoute::kOutput, 0, NChannelsConnected(ERoute::kOutput), outputs, nFrames);
   
   if(mMidiMsgsFromCallback.ElementsAvailable())
   {
@@ -157,6 +157,6 @@ void IPlugAPP::AppProcess(double** inputs, double** outputs, int nFrames)
   //Do not handle Sysex messages here - SendSysexMsgFromUI overridden
 
   ENTER_PARAMS_MUTEX
-  ProcessBuffers(0.0, GetBlockSize());
+  ProcessBuffers((sample) 0, nFrames);
   LEAVE_PARAMS_MUTEX
 }
@@ -53,7 +53,7 @@ public:
   bool SendSysEx(const ISysEx& msg) override;
   
   //IPlugAPP
-  void AppProcess(double** inputs, double** outputs, int nFrames);
+  void AppProcess(sample** inputs, sample** outputs, int nFrames);
 
 private:
   IPlugAPPHost* mAppHost = nullptr;
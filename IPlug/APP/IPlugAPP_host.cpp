@@ -14,6 +14,20 @@
 #include <sys/stat.h>
 #endif
 
+#ifdef OS_LINUX
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
 #include "IPlugLogger.h"
 
 using namespace iplug;
@@ -90,6 +104,13 @@ bool IPlugAPPHost::InitState()
   mINIPath.SetFormatted(MAX_PATH_LEN, "%s\\%s\\", strPath, BUNDLE_NAME);
 #elif defined OS_MAC
   mINIPath.SetFormatted(MAX_PATH_LEN, "%s/Library/Application Support/%s/", getenv("HOME"), BUNDLE_NAME);
+#elif defined OS_LINUX
+  const char* pConfigHome = getenv("XDG_CONFIG_HOME");
+
+  if (pConfigHome && pConfigHome[0])
+    mINIPath.SetFormatted(MAX_PATH_LEN, "%s/%s/", pConfigHome, BUNDLE_NAME);
+  else
+    mINIPath.SetFormatted(MAX_PATH_LEN, "%s/.config/%s/", getenv("HOME"), BUNDLE_NAME);
 #else
   #error NOT IMPLEMENTED
 #endif
@@ -119,6 +140,9 @@ bool IPlugAPPHost::InitState()
       //mState.mAudioInIsMono = GetPrivateProfileInt("audio", "monoinput", 0, mINIPath.Get());
 
       mState.mBufferSize = GetPrivateProfileInt("audio", "buffer", 512, mINIPath.Get());
+      mState.mLowLatency = GetPrivateProfileInt("audio", "lowlatency", 0, mINIPath.Get());
+      mState.mRTPriority = GetPrivateProfileInt("audio", "rtpriority", 0, mINIPath.Get());
+      mState.mLockMemory = GetPrivateProfileInt("audio", "lockmemory", 0, mINIPath.Get());
       mState.mAudioSR = GetPrivateProfileInt("audio", "sr", 44100, mINIPath.Get());
 
       //midi
@@ -139,14 +163,14 @@ bool IPlugAPPHost::InitState()
     CreateDirectory(mINIPath.Get(), NULL);
     mINIPath.Append("settings.ini");
     UpdateINI(); // will write file if doesn't exist
-#elif defined OS_MAC
+#elif defined OS_MAC || defined OS_LINUX
     mode_t process_mask = umask(0);
     int result_code = mkdir(mINIPath.Get(), S_IRWXU | S_IRWXG | S_IRWXO);
     umask(process_mask);
 
     if(!result_code)
     {
-      mINIPath.Append("\\settings.ini");
+      mINIPath.Append("settings.ini");
       UpdateINI(); // will write file if doesn't exist
     }
     else
@@ -187,6 +211,15 @@ void IPlugAPPHost::UpdateINI()
   str.SetFormatted(32, "%i", mState.mBufferSize);
   WritePrivateProfileString("audio", "buffer", str.Get(), ini);
 
+  sprintf(buf, "%u", mState.mLowLatency);
+  WritePrivateProfileString("audio", "lowlatency", buf, ini);
+
+  sprintf(buf, "%u", mState.mRTPriority);
+  WritePrivateProfileString("audio", "rtpriority", buf, ini);
+
+  sprintf(buf, "%u", mState.mLockMemory);
+  WritePrivateProfileString("audio", "lockmemory", buf, ini);
+
   str.SetFormatted(32, "%i", mState.mAudioSR);
   WritePrivateProfileString("audio", "sr", str.Get(), ini);
 
@@ -343,6 +376,9 @@ bool IPlugAPPHost::AudioSettingsInStateAreEqual(AppState& os, AppState& ns)
   if (strcmp(os.mAudioOutDev.Get(), ns.mAudioOutDev.Get())) return false;
   if (os.mAudioSR != ns.mAudioSR) return false;
   if (os.mBufferSize != ns.mBufferSize) return false;
+  if (os.mLowLatency != ns.mLowLatency) return false;
+  if (os.mRTPriority != ns.mRTPriority) return false;
+  if (os.mLockMemory != ns.mLockMemory) return false;
   if (os.mAudioInChanL != ns.mAudioInChanL) return false;
   if (os.mAudioInChanR != ns.mAudioInChanR) return false;
   if (os.mAudioOutChanL != ns.mAudioOutChanL) return false;
@@ -381,6 +417,11 @@ bool IPlugAPPHost::TryToChangeAudioDriverType()
     mDAC = std::make_unique<RtAudio>(RtAudio::MACOSX_CORE);
   //else
   //mDAC = std::make_unique<RtAudio>(RtAudio::UNIX_JACK);
+#elif defined OS_LINUX
+  if(mState.mAudioDriverType == kDeviceJack)
+    mDAC = std::make_unique<RtAudio>(RtAudio::UNIX_JACK);
+  else
+    mDAC = std::make_unique<RtAudio>(RtAudio::LINUX_ALSA);
 #else
   #error NOT IMPLEMENTED
 #endif
@@ -401,7 +442,7 @@ bool IPlugAPPHost::TryToChangeAudio()
     inputID = GetAudioDeviceIdx(mState.mAudioOutDev.Get());
   else
     inputID = GetAudioDeviceIdx(mState.mAudioInDev.Get());
-#elif defined OS_MAC
+#elif defined OS_MAC || defined OS_LINUX
   inputID = GetAudioDeviceIdx(mState.mAudioInDev.Get());
 #else
   #error NOT IMPLEMENTED
@@ -480,7 +521,7 @@ bool IPlugAPPHost::SelectMIDIDevice(ERoute direction, const char* pPortName)
       {
         return true;
       }
-  #if defined OS_WIN
+  #if defined OS_WIN || defined OS_LINUX
       else
       {
         mMidiIn->openPort(port-1);
@@ -520,7 +561,7 @@ bool IPlugAPPHost::SelectMIDIDevice(ERoute direction, const char* pPortName)
       
       if (port == 0)
         return true;
-#if defined OS_WIN
+#if defined OS_WIN || defined OS_LINUX
       else
       {
         mMidiOut->openPort(port-1);
@@ -571,6 +612,8 @@ void IPlugAPPHost::CloseAudio()
     
     mDAC->closeStream();
   }
+
+  StopXrunLog();
 }
 
 bool IPlugAPPHost::InitAudio(uint32_t inId, uint32_t outId, uint32_t sr, uint32_t iovs)
@@ -595,21 +638,37 @@ bool IPlugAPPHost::InitAudio(uint32_t inId, uint32_t outId, uint32_t sr, uint32_
   options.flags = RTAUDIO_NONINTERLEAVED;
   // options.streamName = BUNDLE_NAME; // JACK stream name, not used on other streams
 
-  mBufIndex = 0;
+  // RtAudio requests real-time scheduling when it creates the callback thread (SCHED_RR for ALSA and PulseAudio) and the callback then
+  // switches to SCHED_FIFO on Linux. JACK calls back on its own thread, which the JACK server has already made real-time.
+  const int rtPriority = (int) std::min(mState.mRTPriority, 99u);
+
+  if (rtPriority > 0)
+  {
+    options.flags |= RTAUDIO_SCHEDULE_REALTIME;
+    options.priority = rtPriority;
+  }
+
+  mAudioThreadPriority = (mDAC->getCurrentApi() == RtAudio::UNIX_JACK) ? 0 : rtPriority;
+  mAudioThreadPrepared = false;
+  mAudioThreadSchedResult = -1;
+
   mSamplesElapsed = 0;
   mSampleRate = (double) sr;
   mVecWait = 0;
   mAudioEnding = false;
   mAudioDone = false;
-  
-  mIPlug->SetBlockSize(APP_SIGNAL_VECTOR_SIZE);
-  mIPlug->SetSampleRate(mSampleRate);
-  mIPlug->OnReset();
 
   try
   {
-    mDAC->openStream(&oParams, iParams.nChannels > 0 ? &iParams : nullptr, RTAUDIO_FLOAT64, sr, &mBufferSize, &AudioCallback, this, &options /*, &ErrorCallback */);
+    mDAC->openStream(&oParams, iParams.nChannels > 0 ? &iParams : nullptr, APP_RTAUDIO_FORMAT, sr, &mBufferSize, &AudioCallback, this, &options /*, &ErrorCallback */);
     
+    // In low latency mode the plug-in processes the whole device buffer at once, so the vector size can only be set once the stream is open
+    mVectorSize = mState.mLowLatency ? std::max(mBufferSize, 1u) : APP_SIGNAL_VECTOR_SIZE;
+
+    mIPlug->SetBlockSize(mVectorSize);
+    mIPlug->SetSampleRate(mSampleRate);
+    mIPlug->OnReset();
+
     for (int i = 0; i < iParams.nChannels; i++)
     {
       mInputBufPtrs.Add(nullptr); //will be set in callback
@@ -620,6 +679,12 @@ bool IPlugAPPHost::InitAudio(uint32_t inId, uint32_t outId, uint32_t sr, uint32_
       mOutputBufPtrs.Add(nullptr); //will be set in callback
     }
     
+    // The plug-in and the host have allocated and cleared their buffers by now, and the audio thread exists, so locking memory here
+    // faults all of them in before the stream starts
+    if (mState.mLockMemory)
+      LockMemory();
+
+    StartXrunLog();
     mDAC->startStream();
 
     mActiveState = mState;
@@ -633,6 +698,130 @@ bool IPlugAPPHost::InitAudio(uint32_t inId, uint32_t outId, uint32_t sr, uint32_
   return true;
 }
 
+void IPlugAPPHost::LockMemory()
+{
+#ifdef OS_LINUX
+  if (mMemoryLocked)
+    return;
+
+  // Only lock what is mapped so far: MCL_CURRENT faults it all in. MCL_FUTURE isn't used since every later allocation (sample imports,
+  // memory mapped files) would then count against RLIMIT_MEMLOCK too, and fail with ENOMEM once the limit is reached.
+  // If locking fails the app carries on with nothing locked.
+  if (mlockall(MCL_CURRENT) == 0)
+  {
+    mMemoryLocked = true;
+    fprintf(stderr, "Locked memory into RAM\n");
+  }
+  else
+  {
+    const int lockError = errno;
+    rlimit limit {};
+
+    if ((getrlimit(RLIMIT_MEMLOCK, &limit) == 0) && (limit.rlim_cur != RLIM_INFINITY))
+      fprintf(stderr, "Couldn't lock memory into RAM: %s (the memlock limit is %llu KB, see /etc/security/limits.conf)\n",
+              strerror(lockError), (unsigned long long) (limit.rlim_cur / 1024));
+    else
+      fprintf(stderr, "Couldn't lock memory into RAM: %s\n", strerror(lockError));
+  }
+#endif
+}
+
+// Called by the audio callback the first time it runs, on the audio thread
+void IPlugAPPHost::PrepareAudioThread()
+{
+#ifdef OS_LINUX
+  if (mAudioThreadPriority > 0)
+  {
+    sched_param param {};
+    param.sched_priority = std::clamp(mAudioThreadPriority, sched_get_priority_min(SCHED_FIFO), sched_get_priority_max(SCHED_FIFO));
+    mAudioThreadSchedResult = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+  }
+
+  if (mMemoryLocked)
+  {
+    // Touch the stack the plug-in is likely to use, so the pages are faulted in (and locked) now rather than part way through a block
+    volatile char stack[64 * 1024];
+
+    for (size_t i = 0; i < sizeof(stack); i += 4096)
+      stack[i] = 0;
+  }
+#endif
+}
+
+void IPlugAPPHost::StartXrunLog()
+{
+  StopXrunLog();
+
+  mXrunLogRunning = true;
+  mXrunLogThread = std::thread([this]() {
+    bool reportedScheduling = false;
+
+    while (mXrunLogRunning)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(250));
+
+      const int schedResult = mAudioThreadSchedResult;
+
+      if (!reportedScheduling && (schedResult != -1))
+      {
+        if (schedResult == 0)
+          fprintf(stderr, "Audio thread running with SCHED_FIFO priority %i\n", mAudioThreadPriority);
+        else
+          fprintf(stderr, "Couldn't set SCHED_FIFO priority %i for the audio thread: %s (check the rtprio limit in /etc/security/limits.conf)\n",
+                  mAudioThreadPriority, strerror(schedResult));
+
+        reportedScheduling = true;
+      }
+
+      LogXruns();
+    }
+
+    LogXruns();
+  });
+}
+
+void IPlugAPPHost::StopXrunLog()
+{
+  if (mXrunLogThread.joinable())
+  {
+    mXrunLogRunning = false;
+    mXrunLogThread.join();
+  }
+}
+
+// Writes the xruns sent by the audio callback to stderr, with the wall clock time they were reported so they can be matched up with other logs
+void IPlugAPPHost::LogXruns()
+{
+  mXrunQueue.Drain([this](const XrunEvent& xrun) {
+    const std::time_t time = std::chrono::system_clock::to_time_t(xrun.mTime);
+    const int milliseconds = (int) (std::chrono::duration_cast<std::chrono::milliseconds>(xrun.mTime.time_since_epoch()).count() % 1000);
+    std::tm localTime {};
+#ifdef OS_WIN
+    localtime_s(&localTime, &time);
+#else
+    localtime_r(&time, &localTime);
+#endif
+    char timeStr[32];
+    strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", &localTime);
+
+    const bool inputOverflow = (xrun.mStatus & RTAUDIO_INPUT_OVERFLOW) != 0;
+    const bool outputUnderflow = (xrun.mStatus & RTAUDIO_OUTPUT_UNDERFLOW) != 0;
+    mNumXruns++;
+
+    fprintf(stderr, "%s.%03i xrun: %s%s%s at stream time %.3f s (%u total)\n", timeStr, milliseconds,
+            inputOverflow ? "input overflow" : "", (inputOverflow && outputUnderflow) ? ", " : "", outputUnderflow ? "output underflow" : "",
+            xrun.mStreamTime, mNumXruns);
+  });
+
+  const uint32_t numDropped = mNumXrunsDropped.exchange(0);
+
+  if (numDropped > 0)
+  {
+    mNumXruns += numDropped;
+    fprintf(stderr, "%u more xruns weren't logged, there were too many at once (%u total)\n", numDropped, mNumXruns);
+  }
+}
+
 bool IPlugAPPHost::InitMidi()
 {
   try
@@ -663,22 +852,71 @@ bool IPlugAPPHost::InitMidi()
   return true;
 }
 
-void ApplyFades(double *pBuffer, int nChans, int nFrames, bool down)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+  #define APP_GAIN_SSE2 1
+  #include <emmintrin.h>
+#else
+  #define APP_GAIN_SSE2 0
+#endif
+
+// Multiplies a buffer by a linear gain ramp, starting at startGain and changing by gainStep each frame. A gainStep of 0 applies a fixed gain
+static inline void ApplyGainRamp(float* pBuffer, int nFrames, double startGain, double gainStep)
+{
+  int i = 0;
+
+#if APP_GAIN_SSE2
+  const __m128 step4 = _mm_set1_ps((float) (gainStep * 4.));
+  __m128 gain = _mm_setr_ps((float) startGain, (float) (startGain + gainStep), (float) (startGain + gainStep * 2.), (float) (startGain + gainStep * 3.));
+
+  for (; i + 4 <= nFrames; i += 4)
+  {
+    _mm_storeu_ps(pBuffer + i, _mm_mul_ps(_mm_loadu_ps(pBuffer + i), gain));
+    gain = _mm_add_ps(gain, step4);
+  }
+#endif
+
+  for (; i < nFrames; i++)
+    pBuffer[i] *= (float) (startGain + gainStep * (double) i);
+}
+
+static inline void ApplyGainRamp(double* pBuffer, int nFrames, double startGain, double gainStep)
 {
+  int i = 0;
+
+#if APP_GAIN_SSE2
+  const __m128d step2 = _mm_set1_pd(gainStep * 2.);
+  __m128d gain = _mm_setr_pd(startGain, startGain + gainStep);
+
+  for (; i + 2 <= nFrames; i += 2)
+  {
+    _mm_storeu_pd(pBuffer + i, _mm_mul_pd(_mm_loadu_pd(pBuffer + i), gain));
+    gain = _mm_add_pd(gain, step2);
+  }
+#endif
+
+  for (; i < nFrames; i++)
+    pBuffer[i] *= startGain + gainStep * (double) i;
+}
+
+// Applies the output gain (APP_MULT) and fades in or out, in a single pass over each channel
+void ApplyGainAndFades(sample *pBuffer, int nChans, int nFrames, double gain, bool fade, bool down)
+{
+  double startGain = gain;
+  double gainStep = 0.;
+
+  if (fade)
+  {
+    startGain = down ? gain * (double) (nFrames - 1) / (double) nFrames : 0.;
+    gainStep = (down ? -gain : gain) / (double) nFrames;
+  }
+  else if (gain == 1.)
+  {
+    return;
+  }
+
   for (int i = 0; i < nChans; i++)
   {
-    double *pIO = pBuffer + (i * nFrames);
-    
-    if (down)
-    {
-      for (int j = 0; j < nFrames; j++)
-        pIO[j] *= ((double) (nFrames - (j + 1)) / (double) nFrames);
-    }
-    else
-    {
-      for (int j = 0; j < nFrames; j++)
-        pIO[j] *= ((double) j / (double) nFrames);
-    }
+    ApplyGainRamp(pBuffer + (i * nFrames), nFrames, startGain, gainStep);
   }
 }
 
@@ -687,58 +925,61 @@ int IPlugAPPHost::AudioCallback(void* pOutputBuffer, void* pInputBuffer, uint32_
 {
   IPlugAPPHost* _this = (IPlugAPPHost*) pUserData;
 
+  if (!_this->mAudioThreadPrepared)
+  {
+    _this->PrepareAudioThread();
+    _this->mAudioThreadPrepared = true;
+  }
+
+  // Xruns are logged by another thread, since the callback mustn't block on I/O. system_clock::now() doesn't block
+  if (status)
+  {
+    if (!_this->mXrunQueue.Push(XrunEvent { std::chrono::system_clock::now(), streamTime, status }))
+      _this->mNumXrunsDropped.fetch_add(1, std::memory_order_relaxed);
+  }
+
   int nins = _this->GetPlug()->MaxNChannels(ERoute::kInput);
   int nouts = _this->GetPlug()->MaxNChannels(ERoute::kOutput);
   
-  double* pInputBufferD = static_cast<double*>(pInputBuffer);
-  double* pOutputBufferD = static_cast<double*>(pOutputBuffer);
+  sample* pInputBufferD = static_cast<sample*>(pInputBuffer);
+  sample* pOutputBufferD = static_cast<sample*>(pOutputBuffer);
 
   bool startWait = _this->mVecWait >= APP_N_VECTOR_WAIT; // wait APP_N_VECTOR_WAIT * iovs before processing audio, to avoid clicks
   bool doFade = _this->mVecWait == APP_N_VECTOR_WAIT || _this->mAudioEnding;
   
   if (startWait && !_this->mAudioDone)
   {
-    if (doFade)
-      ApplyFades(pInputBufferD, nins, nFrames, _this->mAudioEnding);
+    if (doFade && pInputBufferD)
+      ApplyGainAndFades(pInputBufferD, nins, nFrames, 1., true, _this->mAudioEnding);
     
-    for (int i = 0; i < nFrames; i++)
+    // The plug-in processes straight from and to the device buffers, in chunks of up to mVectorSize frames
+    for (uint32_t offset = 0; offset < nFrames; offset += _this->mVectorSize)
     {
-      _this->mBufIndex %= APP_SIGNAL_VECTOR_SIZE;
+      const uint32_t nChunkFrames = std::min(nFrames - offset, _this->mVectorSize);
 
-      if (_this->mBufIndex == 0)
+      for (int c = 0; c < nins; c++)
       {
-        for (int c = 0; c < nins; c++)
-        {
-          _this->mInputBufPtrs.Set(c, (pInputBufferD + (c * nFrames)) + i);
-        }
-        
-        for (int c = 0; c < nouts; c++)
-        {
-          _this->mOutputBufPtrs.Set(c, (pOutputBufferD + (c * nFrames)) + i);
-        }
-        
-        _this->mIPlug->AppProcess(_this->mInputBufPtrs.GetList(), _this->mOutputBufPtrs.GetList(), APP_SIGNAL_VECTOR_SIZE);
-
-        _this->mSamplesElapsed += APP_SIGNAL_VECTOR_SIZE;
+        _this->mInputBufPtrs.Set(c, (pInputBufferD + (c * nFrames)) + offset);
       }
       
       for (int c = 0; c < nouts; c++)
       {
-        pOutputBufferD[c * nFrames + i] *= APP_MULT;
+        _this->mOutputBufPtrs.Set(c, (pOutputBufferD + (c * nFrames)) + offset);
       }
+      
+      _this->mIPlug->AppProcess(_this->mInputBufPtrs.GetList(), _this->mOutputBufPtrs.GetList(), (int) nChunkFrames);
 
-      _this->mBufIndex++;
+      _this->mSamplesElapsed += nChunkFrames;
     }
     
-    if (doFade)
-      ApplyFades(pOutputBufferD, nouts, nFrames, _this->mAudioEnding);
+    ApplyGainAndFades(pOutputBufferD, nouts, nFrames, APP_MULT, doFade, _this->mAudioEnding);
     
     if (_this->mAudioEnding)
       _this->mAudioDone = true;
   }
   else
   {
-    memset(pOutputBufferD, 0, nFrames * nouts * sizeof(double));
+    memset(pOutputBufferD, 0, nFrames * nouts * sizeof(sample));
   }
   
   _this->mVecWait = std::min(_this->mVecWait + 1, uint32_t(APP_N_VECTOR_WAIT + 1));
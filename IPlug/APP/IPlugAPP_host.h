@@ -25,6 +25,18 @@
  macOS: /Users/USERNAME/Library/Application\ Support/BUNDLE_NAME/settings.ini
  OR
  /Users/USERNAME/Library/Containers/BUNDLE_ID/Data/Library/Application Support/BUNDLE_NAME/settings.ini
+ Linux: $XDG_CONFIG_HOME/BUNDLE_NAME/settings.ini, or /home/USERNAME/.config/BUNDLE_NAME/settings.ini if XDG_CONFIG_HOME isn't set
+ 
+ The [audio] section has two settings for running on busy machines, which have no UI:
+ 
+ rtpriority: 0 to use the default scheduling for the audio thread, or 1-99 to request real-time scheduling at that priority (SCHED_FIFO on Linux)
+ lockmemory: 1 to lock the memory the app has mapped once the plug-in is initialized (Linux only), so the audio thread never waits on a page fault.
+             Memory mapped later (e.g. samples loaded afterwards) is not locked, so it doesn't count against the memlock limit.
+ 
+ Audio dropouts reported by the driver (xruns) are logged to stderr with a timestamp.
+ 
+ The Linux code in the host (settings path, ALSA/JACK and device selection, scheduling and memory locking) is untested: the Linux app
+ doesn't build yet, since IPlugTimer has no Linux implementation and the dialog and main haven't been ported.
  
  */
 
@@ -33,6 +45,9 @@
 #include <vector>
 #include <limits>
 #include <memory>
+#include <atomic>
+#include <chrono>
+#include <thread>
 
 #include "wdltypes.h"
 #include "wdlstring.h"
@@ -41,6 +56,7 @@
 #include "IPlugConstants.h"
 
 #include "IPlugAPP.h"
+#include "IPlugQueue.h"
 
 #include "config.h"
 
@@ -57,6 +73,8 @@
   #define DEFAULT_OUTPUT_DEV "Built-in Output"
 #elif defined(OS_LINUX)
   #include "IPlugSWELL.h"
+  #define DEFAULT_INPUT_DEV "default"
+  #define DEFAULT_OUTPUT_DEV "default"
 #endif
 
 #include "RtAudio.h"
@@ -64,6 +82,13 @@
 
 #define OFF_TEXT "off"
 
+// The audio stream uses the plug-in's sample type, so the device buffers can be passed to the plug-in without conversion
+#ifdef SAMPLE_TYPE_FLOAT
+  #define APP_RTAUDIO_FORMAT RTAUDIO_FLOAT32
+#else
+  #define APP_RTAUDIO_FORMAT RTAUDIO_FLOAT64
+#endif
+
 extern HWND gHWND;
 extern HINSTANCE gHINSTANCE;
 
@@ -92,6 +117,9 @@ public:
     uint32_t mAudioDriverType;
     uint32_t mAudioSR;
     uint32_t mBufferSize;
+    uint32_t mLowLatency; // If non-zero the plug-in processes the whole device buffer at once, rather than APP_SIGNAL_VECTOR_SIZE frames at a time
+    uint32_t mRTPriority; // 0 for the default audio thread scheduling, otherwise the real-time priority (1-99) to request for the audio thread
+    uint32_t mLockMemory; // If non-zero the app's memory is locked into RAM once the plug-in is initialized (Linux only)
     uint32_t mMidiInChan;
     uint32_t mMidiOutChan;
     
@@ -107,6 +135,9 @@ public:
     , mMidiOutDev(OFF_TEXT)
     , mAudioDriverType(0) // DirectSound / CoreAudio by default
     , mBufferSize(512)
+    , mLowLatency(0)
+    , mRTPriority(0)
+    , mLockMemory(0)
     , mAudioSR(44100)
     , mMidiInChan(0)
     , mMidiOutChan(0)
@@ -125,6 +156,9 @@ public:
     , mMidiOutDev(obj.mMidiOutDev.Get())
     , mAudioDriverType(obj.mAudioDriverType)
     , mBufferSize(obj.mBufferSize)
+    , mLowLatency(obj.mLowLatency)
+    , mRTPriority(obj.mRTPriority)
+    , mLockMemory(obj.mLockMemory)
     , mAudioSR(obj.mAudioSR)
     , mMidiInChan(obj.mMidiInChan)
     , mMidiOutChan(obj.mMidiOutChan)
@@ -139,6 +173,9 @@ public:
     bool operator==(const AppState& rhs) const {
       return (rhs.mAudioDriverType == mAudioDriverType &&
               rhs.mBufferSize == mBufferSize &&
+              rhs.mLowLatency == mLowLatency &&
+              rhs.mRTPriority == mRTPriority &&
+              rhs.mLockMemory == mLockMemory &&
               rhs.mAudioSR == mAudioSR &&
               rhs.mMidiInChan == mMidiInChan &&
               rhs.mMidiOutChan == mMidiOutChan &&
@@ -200,6 +237,11 @@ public:
   bool InitMidi();
   void CloseAudio();
   bool InitAudio(uint32_t inId, uint32_t outId, uint32_t sr, uint32_t iovs);
+  void LockMemory();
+  void PrepareAudioThread();
+  void StartXrunLog();
+  void StopXrunLog();
+  void LogXruns();
   bool AudioSettingsInStateAreEqual(AppState& os, AppState& ns);
   bool MIDISettingsInStateAreEqual(AppState& os, AppState& ns);
 
@@ -234,10 +276,31 @@ private:
   uint32_t mSamplesElapsed = 0;
   uint32_t mVecWait = 0;
   uint32_t mBufferSize = 512;
-  uint32_t mBufIndex = 0; // index for signal vector, loops from 0 to mSigVS
+  uint32_t mVectorSize = APP_SIGNAL_VECTOR_SIZE; // the maximum number of frames the plug-in processes at once
   bool mExiting = false;
   bool mAudioEnding = false;
   bool mAudioDone = false;
+  /** Set by the audio callback once it has set up the audio thread (scheduling, stack), so that is only done once per stream */
+  bool mAudioThreadPrepared = false;
+  /** The SCHED_FIFO priority the audio callback should give its thread, or 0 to leave it alone. Always 0 for JACK, which runs its own real-time threads */
+  int mAudioThreadPriority = 0;
+  /** The result of changing the audio thread's scheduling: -1 if not done yet, otherwise 0 or the error number. Reported by the xrun log */
+  std::atomic<int> mAudioThreadSchedResult {-1};
+  bool mMemoryLocked = false;
+
+  /** An xrun reported to the audio callback, sent to the logging thread so the callback doesn't block on I/O */
+  struct XrunEvent
+  {
+    std::chrono::system_clock::time_point mTime;
+    double mStreamTime;
+    RtAudioStreamStatus mStatus;
+  };
+
+  IPlugQueue<XrunEvent> mXrunQueue {64};
+  std::thread mXrunLogThread;
+  std::atomic<bool> mXrunLogRunning {false};
+  uint32_t mNumXruns = 0; // total xruns logged, only used by the logging thread
+  std::atomic<uint32_t> mNumXrunsDropped {0}; // xruns which didn't fit in the queue, counted by the audio thread and reported by the logging thread
 
   /** The index of the operating systems default input device, -1 if not detected */
   int32_t mDefaultInputDev = -1;
@@ -252,8 +315,8 @@ private:
   std::vector<std::string> mMidiInputDevNames;
   std::vector<std::string> mMidiOutputDevNames;
   
-  WDL_PtrList<double> mInputBufPtrs;
-  WDL_PtrList<double> mOutputBufPtrs;
+  WDL_PtrList<sample> mInputBufPtrs;
+  WDL_PtrList<sample> mOutputBufPtrs;
 
   friend class IPlugAPP;
 };
@@ -0,0 +1,147 @@
+/*
+SSE2Downsampler2x.h
+
+Downsamples the input signal by a factor 2, using SSE2. Both allpass chains
+are processed in parallel, for a pair of channels at once: see
+SSE2StageProc.h. Samples are interleaved, each frame holds NBR_CHN samples.
+
+Template parameters:
+  - NC: number of coefficients, > 0
+  - T: sample type, float or double
+
+  --- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*/
+
+#pragma once
+
+#include "SSE2StageProc.h"
+
+#if HIIR_SSE2
+
+namespace hiir
+{
+
+template <int NC, typename T>
+class Downsampler2xSSE2
+{
+public:
+  enum { NBR_COEFS = NC };
+  enum { NBR_CHN = StageProcSSE2 <T>::NBR_CHN };
+
+  Downsampler2xSSE2 ();
+
+  /*
+  Name: set_coefs
+  Description:
+  Sets filter coefficients. Generate them with the PolyphaseIir2Designer
+  class.
+  Call this function before doing any processing.
+  Input parameters:
+  - coef_arr: Array of coefficients. There should be as many coefficients as
+  mentioned in the class template parameter.
+  */
+  void set_coefs (const double coef_arr []);
+
+  /*
+  Name: process_block
+  Description:
+  Downsamples (x2) a block of samples.
+  Input and output blocks may overlap, see assert() for details.
+  Input parameters:
+  - in_ptr: Input array, containing nbr_spl * 2 frames of NBR_CHN samples.
+  - nbr_spl: Number of frames to output, > 0
+  Output parameters:
+  - out_ptr: Array for the output frames, capacity: nbr_spl frames.
+  */
+  void process_block (T out_ptr [], const T in_ptr [], long nbr_spl);
+
+  /*
+  Name: clear_buffers
+  Description:
+  Clears filter memory, as if it processed silence since an infinite amount
+  of time.
+  */
+  void clear_buffers ();
+
+private:
+  typedef typename StageProcSSE2 <T>::Vec Vec;
+
+  enum { NBR_VEC = (NC + 1) / 2 };
+
+  Vec _coef [NBR_VEC];
+  Vec _x [NBR_VEC];
+  Vec _y [NBR_VEC];
+
+private:
+  bool operator == (const Downsampler2xSSE2 &other);
+  bool operator != (const Downsampler2xSSE2 &other);
+
+};  // class Downsampler2xSSE2
+
+
+template <int NC, typename T>
+Downsampler2xSSE2 <NC, T>::Downsampler2xSSE2 ()
+{
+  for (int i = 0; i < NBR_VEC; ++i)
+  {
+    _coef [i] = StageProcSSE2 <T>::zero ();
+  }
+  clear_buffers ();
+}
+
+template <int NC, typename T>
+void  Downsampler2xSSE2 <NC, T>::set_coefs (const double coef_arr[])
+{
+  assert (coef_arr != 0);
+
+  for (int i = 0; i < NBR_VEC; ++i)
+  {
+    const T coef_0 = static_cast <T> (coef_arr [i * 2]);
+    const T coef_1 = (i * 2 + 1 < NBR_COEFS) ? static_cast <T> (coef_arr [i * 2 + 1]) : T (0);
+    _coef [i] = StageProcSSE2 <T>::set_coefs (coef_0, coef_1);
+  }
+}
+
+template <int NC, typename T>
+void Downsampler2xSSE2 <NC, T>::process_block (T out_ptr[], const T in_ptr[], long nbr_spl)
+{
+  assert (in_ptr != 0);
+  assert (out_ptr != 0);
+  assert (out_ptr <= in_ptr || out_ptr >= in_ptr + nbr_spl * 2 * NBR_CHN);
+  assert (nbr_spl > 0);
+
+  long pos = 0;
+  do
+  {
+    const Vec spl = process_sample_pos_sse2 <NBR_COEFS, T> (
+      StageProcSSE2 <T>::load_down (&in_ptr [pos * 2 * NBR_CHN]),
+      _coef,
+      _x,
+      _y
+    );
+    StageProcSSE2 <T>::store_down (&out_ptr [pos * NBR_CHN], spl);
+    ++pos;
+  }
+  while (pos < nbr_spl);
+}
+
+template <int NC, typename T>
+void Downsampler2xSSE2 <NC, T>::clear_buffers ()
+{
+  for (int i = 0; i < NBR_VEC; ++i)
+  {
+    _x [i] = StageProcSSE2 <T>::zero ();
+    _y [i] = StageProcSSE2 <T>::zero ();
+  }
+}
+
+} // namespace hiir
+
+#endif // HIIR_SSE2
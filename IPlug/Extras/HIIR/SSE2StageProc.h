@@ -0,0 +1,176 @@
+/*
+        SSE2StageProc.h
+
+Processes the two allpass chains of the polyphase filter in parallel, using
+SSE2, for a pair of channels at once. The chains share a register: the lower
+half holds the first chain (even coefficients) and the upper half the second
+chain (odd coefficients). Floats fit both channels in one register, doubles
+use a register per channel.
+
+Samples are interleaved: each frame holds NBR_CHN samples, one per channel.
+
+The operations are the same, in the same order, as in StageProcFPU, so the
+results are identical to the FPU version.
+
+Template parameters:
+  - T: sample type, float or double
+
+  --- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*/
+
+#pragma once
+
+#if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && (_M_IX86_FP >= 2))
+  #define HIIR_SSE2 1
+#else
+  #define HIIR_SSE2 0
+#endif
+
+#if HIIR_SSE2
+
+#include <emmintrin.h>
+
+namespace hiir
+{
+
+template <typename T>
+class StageProcSSE2;
+
+template <>
+class StageProcSSE2 <double>
+{
+public:
+  // One register per channel, each holding both chains: the two channels
+  // are independent, so their latencies overlap
+  struct Vec
+  {
+    __m128d _0;
+    __m128d _1;
+  };
+
+  // Number of channels processed at once
+  enum { NBR_CHN = 2 };
+
+  static inline Vec zero () { return { _mm_setzero_pd (), _mm_setzero_pd () }; }
+  static inline Vec set_coefs (double coef_0, double coef_1) { const __m128d c = _mm_setr_pd (coef_0, coef_1); return { c, c }; }
+
+  static inline Vec add (Vec a, Vec b) { return { _mm_add_pd (a._0, b._0), _mm_add_pd (a._1, b._1) }; }
+  static inline Vec sub (Vec a, Vec b) { return { _mm_sub_pd (a._0, b._0), _mm_sub_pd (a._1, b._1) }; }
+  static inline Vec mul (Vec a, Vec b) { return { _mm_mul_pd (a._0, b._0), _mm_mul_pd (a._1, b._1) }; }
+
+  // Takes the first chain from a and the second chain from b
+  static inline Vec merge_chains (Vec a, Vec b) { return { _mm_move_sd (b._0, a._0), _mm_move_sd (b._1, a._1) }; }
+
+  // One input frame fed to both chains
+  static inline Vec load_up (const double in_ptr [])
+  {
+    return { _mm_load1_pd (&in_ptr [0]), _mm_load1_pd (&in_ptr [1]) };
+  }
+
+  // The first chain gives the even output frame, the second the odd frame
+  static inline void store_up (double out_ptr [], Vec v)
+  {
+    _mm_storeu_pd (&out_ptr [0], _mm_unpacklo_pd (v._0, v._1));
+    _mm_storeu_pd (&out_ptr [2], _mm_unpackhi_pd (v._0, v._1));
+  }
+
+  // Two input frames: the odd frame goes to the first chain, the even frame
+  // to the second, as in Downsampler2xFPU
+  static inline Vec load_down (const double in_ptr [])
+  {
+    const __m128d even = _mm_loadu_pd (&in_ptr [0]);
+    const __m128d odd = _mm_loadu_pd (&in_ptr [2]);
+    return { _mm_unpacklo_pd (odd, even), _mm_unpackhi_pd (odd, even) };
+  }
+
+  // The output frame is the average of both chains
+  static inline void store_down (double out_ptr [], Vec v)
+  {
+    const __m128d sum = _mm_add_pd (_mm_unpacklo_pd (v._0, v._1), _mm_unpackhi_pd (v._0, v._1));
+    _mm_storeu_pd (out_ptr, _mm_mul_pd (_mm_set1_pd (0.5f), sum));
+  }
+};
+
+template <>
+class StageProcSSE2 <float>
+{
+public:
+  // One register for both channels: the lower half holds the first chain
+  // for each channel, the upper half the second chain
+  typedef __m128 Vec;
+
+  enum { NBR_CHN = 2 };
+
+  static inline Vec zero () { return _mm_setzero_ps (); }
+  static inline Vec set_coefs (float coef_0, float coef_1) { return _mm_setr_ps (coef_0, coef_0, coef_1, coef_1); }
+
+  static inline Vec add (Vec a, Vec b) { return _mm_add_ps (a, b); }
+  static inline Vec sub (Vec a, Vec b) { return _mm_sub_ps (a, b); }
+  static inline Vec mul (Vec a, Vec b) { return _mm_mul_ps (a, b); }
+
+  static inline Vec merge_chains (Vec a, Vec b) { return _mm_shuffle_ps (a, b, _MM_SHUFFLE (3, 2, 1, 0)); }
+
+  static inline Vec load_up (const float in_ptr [])
+  {
+    const __m128 frame = _mm_castpd_ps (_mm_load_sd (reinterpret_cast <const double *> (in_ptr)));
+    return _mm_movelh_ps (frame, frame);
+  }
+
+  static inline void store_up (float out_ptr [], Vec v) { _mm_storeu_ps (out_ptr, v); }
+
+  static inline Vec load_down (const float in_ptr [])
+  {
+    const __m128 frames = _mm_loadu_ps (in_ptr);
+    return _mm_shuffle_ps (frames, frames, _MM_SHUFFLE (1, 0, 3, 2));
+  }
+
+  static inline void store_down (float out_ptr [], Vec v)
+  {
+    const __m128 sum = _mm_add_ps (v, _mm_shuffle_ps (v, v, _MM_SHUFFLE (1, 0, 3, 2)));
+    _mm_store_sd (reinterpret_cast <double *> (out_ptr), _mm_castps_pd (_mm_mul_ps (_mm_set1_ps (0.5f), sum)));
+  }
+};
+
+/*
+Name: process_sample_pos_sse2
+Description:
+  Runs one sample of both allpass chains. coef, x and y hold one vector per
+  pair of coefficients, (NC + 1) / 2 in total. When NC is odd the last
+  vector only has a coefficient in its lower half and the upper half of the
+  result is taken from the previous stage, as in StageProcFPU <1, T>.
+*/
+template <int NC, typename T>
+inline typename StageProcSSE2 <T>::Vec process_sample_pos_sse2 (typename StageProcSSE2 <T>::Vec spl, const typename StageProcSSE2 <T>::Vec coef [], typename StageProcSSE2 <T>::Vec x [], typename StageProcSSE2 <T>::Vec y [])
+{
+  typedef StageProcSSE2 <T> Proc;
+
+  for (int i = 0; i < NC / 2; ++i)
+  {
+    const typename Proc::Vec temp = Proc::add (Proc::mul (Proc::sub (spl, y [i]), coef [i]), x [i]);
+    x [i] = spl;
+    y [i] = temp;
+    spl = temp;
+  }
+
+  if (NC & 1)
+  {
+    const int last = NC / 2;
+    const typename Proc::Vec temp = Proc::add (Proc::mul (Proc::sub (spl, y [last]), coef [last]), x [last]);
+    x [last] = spl;
+    y [last] = temp;
+    spl = Proc::merge_chains (temp, spl);
+  }
+
+  return spl;
+}
+
+} // namespace hiir
+
+#endif // HIIR_SSE2
@@ -12,11 +12,14 @@
 
 #define OVERSAMPLING_FACTORS_VA_LIST "None", "2x", "4x", "8x", "16x"
 
+#include <algorithm>
 #include <functional>
 #include <cmath>
 
 #include "HIIR/FPUUpsampler2x.h"
 #include "HIIR/FPUDownsampler2x.h"
+#include "HIIR/SSE2Upsampler2x.h"
+#include "HIIR/SSE2Downsampler2x.h"
 
 #include "heapbuf.h"
 #include "ptrlist.h"
@@ -37,23 +40,35 @@ enum EFactor
   kNumFactors
 };
 
+/** Over samples a signal by 2x, 4x, 8x or 16x with cascaded half-band polyphase IIR filters (HIIR), processes it at the higher rate and
+ * down samples it again.
+ *
+ * Where SSE2 is available the filters process a pair of channels at a time, with both of their allpass chains in parallel. The SIMD filters
+ * give exactly the same results as the FPU ones, and can be switched off at runtime with SetUseSIMD().
+ *
+ * All buffers are allocated by Reset(), sized for the largest rate, so changing the over sampling factor or the block size passed to
+ * ProcessBlock() never allocates. Blocks larger than the block size passed to Reset() are processed in several chunks. */
 template<typename T = double>
 class OverSampler
 {
 public:
   using BlockProcessFunc = std::function<void(T**, T**, int)>;
-  
+
+  /** The highest over sampling rate */
+  static constexpr int kMaxRate = 16;
+
+#if HIIR_SSE2
+  /** The number of channels each SIMD filter processes at once, interleaved */
+  static constexpr int kSIMDChans = Upsampler2xSSE2<2, T>::NBR_CHN;
+#else
+  static constexpr int kSIMDChans = 1;
+#endif
+
   OverSampler(EFactor factor = kNone, bool blockProcessing = true, int nInChannels = 1, int nOutChannels = 1)
   : mBlockProcessing(blockProcessing)
   , mNInChannels(nInChannels)
   , mNOutChannels(nOutChannels)
   {
-    
-    static constexpr double coeffs2x[12] = { 0.036681502163648017, 0.13654762463195794, 0.27463175937945444, 0.42313861743656711, 0.56109869787919531, 0.67754004997416184, 0.76974183386322703, 0.83988962484963892, 0.89226081800387902, 0.9315419599631839, 0.96209454837808417, 0.98781637073289585 };
-    static constexpr double coeffs4x[4] = {0.041893991997656171, 0.16890348243995201, 0.39056077292116603, 0.74389574826847926 };
-    static constexpr double coeffs8x[3] = {0.055748680811302048, 0.24305119574153072, 0.64669913119268196 };
-    static constexpr double coeffs16x[2] = {0.10717745346023573, 0.53091435354504557 };
-
     for (auto c = 0; c < mNInChannels; c++)
     {
       mUpsampler2x.Add(new Upsampler2xFPU<12, T>());
@@ -61,13 +76,15 @@ public:
       mUpsampler8x.Add(new Upsampler2xFPU<3, T>());
       mUpsampler16x.Add(new Upsampler2xFPU<2, T>());
       
-      mUpsampler2x.Get(c)->set_coefs(coeffs2x);
-      mUpsampler4x.Get(c)->set_coefs(coeffs4x);
-      mUpsampler8x.Get(c)->set_coefs(coeffs8x);
-      mUpsampler16x.Get(c)->set_coefs(coeffs16x);
+      mUpsampler2x.Get(c)->set_coefs(kCoeffs2x);
+      mUpsampler4x.Get(c)->set_coefs(kCoeffs4x);
+      mUpsampler8x.Get(c)->set_coefs(kCoeffs8x);
+      mUpsampler16x.Get(c)->set_coefs(kCoeffs16x);
       
       // ptr location doesn't matter at this stage
-      mNextInputPtrs.Add(mUp2x.Get());
+      mNextInputPtrs.Add(nullptr);
+      mChunkInputPtrs.Add(nullptr);
+      mUpBufferPtrs.Add(nullptr);
     }
     
     for (auto c = 0; c < mNOutChannels; c++)
@@ -77,18 +94,50 @@ public:
       mDownsampler8x.Add(new Downsampler2xFPU<3, T>());
       mDownsampler16x.Add(new Downsampler2xFPU<2, T>());
       
-      mDownsampler2x.Get(c)->set_coefs(coeffs2x);
-      mDownsampler4x.Get(c)->set_coefs(coeffs4x);
-      mDownsampler8x.Get(c)->set_coefs(coeffs8x);
-      mDownsampler16x.Get(c)->set_coefs(coeffs16x);
+      mDownsampler2x.Get(c)->set_coefs(kCoeffs2x);
+      mDownsampler4x.Get(c)->set_coefs(kCoeffs4x);
+      mDownsampler8x.Get(c)->set_coefs(kCoeffs8x);
+      mDownsampler16x.Get(c)->set_coefs(kCoeffs16x);
       
       // ptr location doesn't matter at this stage
-      mNextOutputPtrs.Add(mDown2x.Get());
+      mNextOutputPtrs.Add(nullptr);
+      mChunkOutputPtrs.Add(nullptr);
+      mDownBufferPtrs.Add(nullptr);
+    }
+
+#if HIIR_SSE2
+    for (auto c = 0; c < mNInChannels; c += kSIMDChans)
+    {
+      mUpsampler2xSIMD.Add(new Upsampler2xSSE2<12, T>());
+      mUpsampler4xSIMD.Add(new Upsampler2xSSE2<4, T>());
+      mUpsampler8xSIMD.Add(new Upsampler2xSSE2<3, T>());
+      mUpsampler16xSIMD.Add(new Upsampler2xSSE2<2, T>());
+
+      const int g = c / kSIMDChans;
+      mUpsampler2xSIMD.Get(g)->set_coefs(kCoeffs2x);
+      mUpsampler4xSIMD.Get(g)->set_coefs(kCoeffs4x);
+      mUpsampler8xSIMD.Get(g)->set_coefs(kCoeffs8x);
+      mUpsampler16xSIMD.Get(g)->set_coefs(kCoeffs16x);
+    }
+
+    for (auto c = 0; c < mNOutChannels; c += kSIMDChans)
+    {
+      mDownsampler2xSIMD.Add(new Downsampler2xSSE2<12, T>());
+      mDownsampler4xSIMD.Add(new Downsampler2xSSE2<4, T>());
+      mDownsampler8xSIMD.Add(new Downsampler2xSSE2<3, T>());
+      mDownsampler16xSIMD.Add(new Downsampler2xSSE2<2, T>());
+
+      const int g = c / kSIMDChans;
+      mDownsampler2xSIMD.Get(g)->set_coefs(kCoeffs2x);
+      mDownsampler4xSIMD.Get(g)->set_coefs(kCoeffs4x);
+      mDownsampler8xSIMD.Get(g)->set_coefs(kCoeffs8x);
+      mDownsampler16xSIMD.Get(g)->set_coefs(kCoeffs16x);
     }
-        
+#endif
+
     SetOverSampling(factor);
     
-    Reset();
+    Reset(mBlockSize);
   }
   
   ~OverSampler()
@@ -101,44 +150,36 @@ public:
     mDownsampler8x.Empty(true);
     mUpsampler16x.Empty(true);
     mDownsampler16x.Empty(true);
+
+#if HIIR_SSE2
+    mUpsampler2xSIMD.Empty(true);
+    mDownsampler2xSIMD.Empty(true);
+    mUpsampler4xSIMD.Empty(true);
+    mDownsampler4xSIMD.Empty(true);
+    mUpsampler8xSIMD.Empty(true);
+    mDownsampler8xSIMD.Empty(true);
+    mUpsampler16xSIMD.Empty(true);
+    mDownsampler16xSIMD.Empty(true);
+#endif
   }
 
   OverSampler(const OverSampler&) = delete;
   OverSampler& operator=(const OverSampler&) = delete;
     
+  /** Clears the filters and, if the block size changed, reallocates the buffers
+   * @param blockSize The largest number of frames ProcessBlock() will process in one go. Larger blocks are split up */
   void Reset(int blockSize = DEFAULT_BLOCK_SIZE)
   {
-    int numBufSamples = 1;
-    
-    if(mBlockProcessing)
-      numBufSamples = blockSize;
-    else
-    {
-      numBufSamples = 1;
-      blockSize = 1;
-    }
-    
-    numBufSamples *= mNInChannels;
-    
-    mUp2x.Resize(2 * numBufSamples);
-    mUp4x.Resize(4 * numBufSamples);
-    mUp8x.Resize(8 * numBufSamples);
-    mUp16x.Resize(16 * numBufSamples);
-    
-    mDown2x.Resize(2 * numBufSamples);
-    mDown4x.Resize(4 * numBufSamples);
-    mDown8x.Resize(8 * numBufSamples);
-    mDown16x.Resize(16 * numBufSamples);
-    
-    mUp16BufferPtrs.Empty();
-    mUp8BufferPtrs.Empty();
-    mUp4BufferPtrs.Empty();
-    mUp2BufferPtrs.Empty();
+    mBlockSize = mBlockProcessing ? std::max(blockSize, 1) : 1;
+
+    // Every buffer is sized for the highest rate, so changing the rate doesn't need to reallocate
+    const int maxChunkSize = kMaxRate * mBlockSize;
     
-    mDown16BufferPtrs.Empty();
-    mDown8BufferPtrs.Empty();
-    mDown4BufferPtrs.Empty();
-    mDown2BufferPtrs.Empty();
+    mUpBuffer.Resize(maxChunkSize * mNInChannels);
+    mDownBuffer.Resize(maxChunkSize * mNOutChannels);
+    mScratch[0].Resize(maxChunkSize * kSIMDChans);
+    mScratch[1].Resize(maxChunkSize * kSIMDChans);
+    mInterleaved.Resize(maxChunkSize * kSIMDChans);
     
     for (auto c = 0; c < mNInChannels; c++)
     {
@@ -146,11 +187,8 @@ public:
       mUpsampler4x.Get(c)->clear_buffers();
       mUpsampler8x.Get(c)->clear_buffers();
       mUpsampler16x.Get(c)->clear_buffers();
-      
-      mUp2BufferPtrs.Add(mUp2x.Get() + c * 2 * blockSize);
-      mUp4BufferPtrs.Add(mUp4x.Get() + (c * 4 * blockSize));
-      mUp8BufferPtrs.Add(mUp8x.Get() + (c * 8 * blockSize));
-      mUp16BufferPtrs.Add(mUp16x.Get() + (c * 16 * blockSize));
+
+      mUpBufferPtrs.Set(c, mUpBuffer.Get() + (c * maxChunkSize));
     }
     
     for (auto c = 0; c < mNOutChannels; c++)
@@ -159,12 +197,27 @@ public:
       mDownsampler4x.Get(c)->clear_buffers();
       mDownsampler8x.Get(c)->clear_buffers();
       mDownsampler16x.Get(c)->clear_buffers();
-      
-      mDown2BufferPtrs.Add(mDown2x.Get() + c * 2 * blockSize);
-      mDown4BufferPtrs.Add(mDown4x.Get() + (c * 4 * blockSize));
-      mDown8BufferPtrs.Add(mDown8x.Get() + (c * 8 * blockSize));
-      mDown16BufferPtrs.Add(mDown16x.Get() + (c * 16 * blockSize));
+
+      mDownBufferPtrs.Set(c, mDownBuffer.Get() + (c * maxChunkSize));
+    }
+
+#if HIIR_SSE2
+    for (auto g = 0; g < mUpsampler2xSIMD.GetSize(); g++)
+    {
+      mUpsampler2xSIMD.Get(g)->clear_buffers();
+      mUpsampler4xSIMD.Get(g)->clear_buffers();
+      mUpsampler8xSIMD.Get(g)->clear_buffers();
+      mUpsampler16xSIMD.Get(g)->clear_buffers();
+    }
+
+    for (auto g = 0; g < mDownsampler2xSIMD.GetSize(); g++)
+    {
+      mDownsampler2xSIMD.Get(g)->clear_buffers();
+      mDownsampler4xSIMD.Get(g)->clear_buffers();
+      mDownsampler8xSIMD.Get(g)->clear_buffers();
+      mDownsampler16xSIMD.Get(g)->clear_buffers();
     }
+#endif
   }
 
   /** Over sample an input block with a per-block function (up sample input -> process with function -> down sample)
@@ -179,72 +232,36 @@ public:
     assert(nInChans <= mNInChannels);
     assert(nOutChans <= mNOutChannels);
     
-    if(mRate != mPrevRate)
+    if (mRate == 1)
     {
-      switch (mRate) {
-        case 2:
-          mInPtrLoopSrc = &mUp2BufferPtrs;
-          mOutPtrLoopSrc = &mDown2BufferPtrs;
-          break;
-        case 4:
-          mInPtrLoopSrc = &mUp4BufferPtrs;
-          mOutPtrLoopSrc = &mDown4BufferPtrs;
-          break;
-        case 8:
-          mInPtrLoopSrc = &mUp8BufferPtrs;
-          mOutPtrLoopSrc = &mDown8BufferPtrs;
-          break;
-        case 16:
-          mInPtrLoopSrc = &mUp16BufferPtrs;
-          mOutPtrLoopSrc = &mDown16BufferPtrs;
-          break;
-        default:
-          break;
-      }
-      
-      mPrevRate = mRate;
-    }
-
-    for(auto c = 0; c < nInChans; c++) {
-      if (mRate >= 2) {
-        mUpsampler2x.Get(c)->process_block(mUp2BufferPtrs.Get(c), inputs[c], nFrames);
-      }
-      if (mRate >= 4) {
-        mUpsampler4x.Get(c)->process_block(mUp4BufferPtrs.Get(c), mUp2BufferPtrs.Get(c), nFrames * 2);
-      }
-      if (mRate >= 8) {
-        mUpsampler8x.Get(c)->process_block(mUp8BufferPtrs.Get(c), mUp4BufferPtrs.Get(c), nFrames * 4);
-      }
-      if (mRate == 16) {
-        mUpsampler16x.Get(c)->process_block(mUp16BufferPtrs.Get(c), mUp8BufferPtrs.Get(c), nFrames * 8);
-      }
-    }
-    
-    if (mRate == 1) {
       func(inputs, outputs, nFrames);
-    } else {
-      for (auto i = 0; i < mRate; i++) {
-        for(auto c = 0; c < nInChans; c++) {
-          mNextInputPtrs.Set(c, mInPtrLoopSrc->Get(c) + (i * nFrames));
-          mNextOutputPtrs.Set(c, mOutPtrLoopSrc->Get(c) + (i * nFrames));
-        }
-        func(mNextInputPtrs.GetList(), mNextOutputPtrs.GetList(), nFrames);
-      }
+      return;
     }
-    
-    for(auto c = 0; c < nOutChans; c++) {
-      if (mRate == 16) {
-        mDownsampler16x.Get(c)->process_block(mDown8BufferPtrs.Get(c), mDown16BufferPtrs.Get(c), nFrames * 8);
-      }
-      if (mRate >= 8) {
-        mDownsampler8x.Get(c)->process_block(mDown4BufferPtrs.Get(c), mDown8BufferPtrs.Get(c), nFrames * 4);
-      }
-      if (mRate >= 4) {
-        mDownsampler4x.Get(c)->process_block(mDown2BufferPtrs.Get(c), mDown4BufferPtrs.Get(c), nFrames * 2);
-      }
-      if (mRate >= 2) {
-        mDownsampler2x.Get(c)->process_block(outputs[c], mDown2BufferPtrs.Get(c), nFrames);
+
+    for (auto offset = 0; offset < nFrames; offset += mBlockSize)
+    {
+      const int nChunkFrames = std::min(nFrames - offset, mBlockSize);
+
+      for (auto c = 0; c < nInChans; c++)
+        mChunkInputPtrs.Set(c, inputs[c] + offset);
+
+      for (auto c = 0; c < nOutChans; c++)
+        mChunkOutputPtrs.Set(c, outputs[c] + offset);
+
+      Upsample(mChunkInputPtrs.GetList(), nInChans, nChunkFrames);
+
+      for (auto i = 0; i < mRate; i++)
+      {
+        for (auto c = 0; c < nInChans; c++)
+          mNextInputPtrs.Set(c, mUpBufferPtrs.Get(c) + (i * nChunkFrames));
+
+        for (auto c = 0; c < nOutChans; c++)
+          mNextOutputPtrs.Set(c, mDownBufferPtrs.Get(c) + (i * nChunkFrames));
+
+        func(mNextInputPtrs.GetList(), mNextOutputPtrs.GetList(), nChunkFrames);
       }
+
+      Downsample(mChunkOutputPtrs.GetList(), nOutChans, nChunkFrames);
     }
   }
   
@@ -254,66 +271,23 @@ public:
    * @return The audio sample output */
   T Process(T input, std::function<T(T)> func)
   {
-    T output;
-
-    if(mRate == 16)
-    {
-      mUpsampler2x.Get(0)->process_sample(mUp2x.Get()[0], mUp2x.Get()[1], input);
-      mUpsampler4x.Get(0)->process_block(mUp4x.Get(), mUp2x.Get(), 2);
-      mUpsampler8x.Get(0)->process_block(mUp8x.Get(), mUp4x.Get(), 4);
-      mUpsampler16x.Get(0)->process_block(mUp16x.Get(), mUp8x.Get(), 8);
+    if (mRate == 1)
+      return func(input);
 
-      for (auto i = 0; i < 16; i++)
-      {
-        mDown16x.Get()[i] = func(mUp16x.Get()[i]);
-      }
-
-      mDownsampler16x.Get(0)->process_block(mDown8x.Get(), mDown16x.Get(), 8);
-      mDownsampler8x.Get(0)->process_block(mDown4x.Get(), mDown8x.Get(), 4);
-      mDownsampler4x.Get(0)->process_block(mDown2x.Get(), mDown4x.Get(), 2);
-      output = mDownsampler2x.Get(0)->process_sample(mDown2x.Get());
-    }
-    else if (mRate == 8)
-    {
-      mUpsampler2x.Get(0)->process_sample(mUp2x.Get()[0], mUp2x.Get()[1], input);
-      mUpsampler4x.Get(0)->process_block(mUp4x.Get(), mUp2x.Get(), 2);
-      mUpsampler8x.Get(0)->process_block(mUp8x.Get(), mUp4x.Get(), 4);
-
-      for (auto i = 0; i < 8; i++)
-      {
-        mDown8x.Get()[i] = func(mUp8x.Get()[i]);
-      }
-
-      mDownsampler8x.Get(0)->process_block(mDown4x.Get(), mDown8x.Get(), 4);
-      mDownsampler4x.Get(0)->process_block(mDown2x.Get(), mDown4x.Get(), 2);
-      output = mDownsampler2x.Get(0)->process_sample(mDown2x.Get());
-    }
-    else if (mRate == 4)
-    {
-      mUpsampler2x.Get(0)->process_sample(mUp2x.Get()[0], mUp2x.Get()[1], input);
-      mUpsampler4x.Get(0)->process_block(mUp4x.Get(), mUp2x.Get(), 2);
+    const T* pInput = &input;
+    Upsample(&pInput, 1, 1);
 
-      for (auto i = 0; i < 4; i++)
-      {
-        mDown4x.Get()[i] = func(mUp4x.Get()[i]);
-      }
-
-      mDownsampler4x.Get(0)->process_block(mDown2x.Get(), mDown4x.Get(), 2);
-      output = mDownsampler2x.Get(0)->process_sample(mDown2x.Get());
-    }
-    else if (mRate == 2)
-    {
-      mUpsampler2x.Get(0)->process_sample(mUp2x.Get()[0], mUp2x.Get()[1], input);
+    const T* pUp = mUpBufferPtrs.Get(0);
+    T* pDown = mDownBufferPtrs.Get(0);
 
-      mDown2x.Get()[0] = func(mUp2x.Get()[0]);
-      mDown2x.Get()[1] = func(mUp2x.Get()[1]);
-      output = mDownsampler2x.Get(0)->process_sample(mDown2x.Get());
-    }
-    else
+    for (auto i = 0; i < mRate; i++)
     {
-      output = func(input);
+      pDown[i] = func(pUp[i]);
     }
 
+    T output;
+    T* pOutput = &output;
+    Downsample(&pOutput, 1, 1);
     return output;
   }
 
@@ -322,82 +296,19 @@ public:
    * @return The audio sample output */
   T ProcessGen(std::function<T()> genFunc)
   {
-    auto ProcessDown16x = [&](T input)
-    {
-      mDown16x.Get()[mWritePos] = (T) input;
-
-      mWritePos++;
-      mWritePos &= 15;
+    if (mRate == 1)
+      return genFunc();
 
-      if(mWritePos == 0)
-      {
-        mDownsampler16x.Get(0)->process_block(mDown8x.Get(), mDown16x.Get(), 8);
-        mDownsampler8x.Get(0)->process_block(mDown4x.Get(), mDown8x.Get(), 4);
-        mDownsampler4x.Get(0)->process_block(mDown2x.Get(), mDown4x.Get(), 2);
-        mDownSamplerOutput = mDownsampler2x.Get(0)->process_sample(mDown2x.Get());
-      }
-    };
-
-    auto ProcessDown8x = [&](T input)
-    {
-      mDown8x.Get()[mWritePos] = (T) input;
-
-      mWritePos++;
-      mWritePos &= 7;
-
-      if(mWritePos == 0)
-      {
-        mDownsampler8x.Get(0)->process_block(mDown4x.Get(), mDown8x.Get(), 4);
-        mDownsampler4x.Get(0)->process_block(mDown2x.Get(), mDown4x.Get(), 2);
-        mDownSamplerOutput = mDownsampler2x.Get(0)->process_sample(mDown2x.Get());
-      }
-    };
-
-    auto ProcessDown4x = [&](T input)
-    {
-      mDown4x.Get()[mWritePos] = (T) input;
-
-      mWritePos++;
-      mWritePos &= 3;
-
-      if(mWritePos == 0)
-      {
-        mDownsampler4x.Get(0)->process_block(mDown2x.Get(), mDown4x.Get(), 2);
-        mDownSamplerOutput = mDownsampler2x.Get(0)->process_sample(mDown2x.Get());
-      }
-    };
-
-    auto ProcessDown2x = [&](T input)
-    {
-      mDown2x.Get()[mWritePos] = (T) input;
-
-      mWritePos = !mWritePos;
-
-      if(mWritePos == 0)
-      {
-        mDownSamplerOutput = mDownsampler2x.Get(0)->process_sample(mDown2x.Get());
-      }
-    };
+    T* pDown = mDownBufferPtrs.Get(0);
 
-    T output;
-
-    for (int j = 0; j < mRate; j++)
+    for (auto i = 0; i < mRate; i++)
     {
-      output = genFunc();
-
-      switch(mRate)
-      {
-        case 2: ProcessDown2x(output); break;
-        case 4: ProcessDown4x(output); break;
-        case 8: ProcessDown8x(output); break;
-        case 16: ProcessDown16x(output); break;
-        default: break;
-      }
+      pDown[i] = genFunc();
     }
 
-    if(mRate > 1)
-      output = mDownSamplerOutput;
-
+    T output;
+    T* pOutput = &output;
+    Downsample(&pOutput, 1, 1);
     return output;
   }
 
@@ -406,11 +317,29 @@ public:
     if(factor != mFactor)
     {
       mFactor = factor;
-      mRate = std::pow(2, (int) factor);
+      mRate = 1 << (int) factor;
       
-      Reset();
+      Reset(mBlockSize);
+    }
+  }
+
+  /** Choose between the SIMD and FPU filters. The filters are cleared if this changes which are used. Has no effect without SSE2
+   * @param useSIMD \c true to use the SIMD filters where they are available */
+  void SetUseSIMD(bool useSIMD)
+  {
+    useSIMD = useSIMD && HIIR_SSE2;
+
+    if (useSIMD != mUseSIMD)
+    {
+      mUseSIMD = useSIMD;
+      Reset(mBlockSize);
     }
   }
+
+  bool GetUseSIMD() const
+  {
+    return mUseSIMD;
+  }
   
   static EFactor RateToFactor(int rate)
   {
@@ -431,43 +360,142 @@ public:
   }
 
 private:
+  /** Up sample nFrames of each input channel into the up sampling buffers, at the current rate */
+  void Upsample(const T* const* inputs, int nChans, int nFrames)
+  {
+#if HIIR_SSE2
+    if (mUseSIMD)
+    {
+      for (auto c = 0; c < nChans; c += kSIMDChans)
+      {
+        const int g = c / kSIMDChans;
+        const int nGroupChans = std::min(nChans - c, kSIMDChans);
+
+        // The first stage mustn't read from mScratch[0], which it writes to when there are several stages
+        Interleave(mScratch[1].Get(), inputs + c, nGroupChans, nFrames);
+        UpsampleStages(*mUpsampler2xSIMD.Get(g), *mUpsampler4xSIMD.Get(g), *mUpsampler8xSIMD.Get(g), *mUpsampler16xSIMD.Get(g),
+                       mInterleaved.Get(), mScratch[1].Get(), nFrames);
+        Deinterleave(mUpBufferPtrs.GetList() + c, mInterleaved.Get(), nGroupChans, nFrames * mRate);
+      }
+
+      return;
+    }
+#endif
+
+    for (auto c = 0; c < nChans; c++)
+    {
+      UpsampleStages(*mUpsampler2x.Get(c), *mUpsampler4x.Get(c), *mUpsampler8x.Get(c), *mUpsampler16x.Get(c),
+                     mUpBufferPtrs.Get(c), inputs[c], nFrames);
+    }
+  }
+
+  /** Down sample the current rate's worth of frames in the down sampling buffers into nFrames of each output channel */
+  void Downsample(T* const* outputs, int nChans, int nFrames)
+  {
+#if HIIR_SSE2
+    if (mUseSIMD)
+    {
+      for (auto c = 0; c < nChans; c += kSIMDChans)
+      {
+        const int g = c / kSIMDChans;
+        const int nGroupChans = std::min(nChans - c, kSIMDChans);
+
+        Interleave(mInterleaved.Get(), mDownBufferPtrs.GetList() + c, nGroupChans, nFrames * mRate);
+        DownsampleStages(*mDownsampler2xSIMD.Get(g), *mDownsampler4xSIMD.Get(g), *mDownsampler8xSIMD.Get(g), *mDownsampler16xSIMD.Get(g),
+                         mInterleaved.Get(), mInterleaved.Get(), nFrames);
+        Deinterleave(outputs + c, mInterleaved.Get(), nGroupChans, nFrames);
+      }
+
+      return;
+    }
+#endif
+
+    for (auto c = 0; c < nChans; c++)
+    {
+      DownsampleStages(*mDownsampler2x.Get(c), *mDownsampler4x.Get(c), *mDownsampler8x.Get(c), *mDownsampler16x.Get(c),
+                       outputs[c], mDownBufferPtrs.Get(c), nFrames);
+    }
+  }
+
+  /** Run the up sampling stages for the current rate, from nFrames in pSrc to mRate * nFrames in pDst.
+   * The stages in between write to the scratch buffers in turn, so pSrc must not be mScratch[0] */
+  template <class Up2x, class Up4x, class Up8x, class Up16x>
+  void UpsampleStages(Up2x& up2x, Up4x& up4x, Up8x& up8x, Up16x& up16x, T* pDst, const T* pSrc, int nFrames)
+  {
+    T* pStageDst[4] = { mScratch[0].Get(), mScratch[1].Get(), mScratch[0].Get(), mScratch[1].Get() };
+    pStageDst[mFactor - 1] = pDst;
+
+    up2x.process_block(pStageDst[0], pSrc, nFrames);
+    if (mRate >= 4) up4x.process_block(pStageDst[1], pStageDst[0], nFrames * 2);
+    if (mRate >= 8) up8x.process_block(pStageDst[2], pStageDst[1], nFrames * 4);
+    if (mRate == 16) up16x.process_block(pStageDst[3], pStageDst[2], nFrames * 8);
+  }
+
+  /** Run the down sampling stages for the current rate, from mRate * nFrames in pSrc to nFrames in pDst.
+   * The stages in between write to the scratch buffers in turn. pDst may be the same as pSrc */
+  template <class Down2x, class Down4x, class Down8x, class Down16x>
+  void DownsampleStages(Down2x& down2x, Down4x& down4x, Down8x& down8x, Down16x& down16x, T* pDst, const T* pSrc, int nFrames)
+  {
+    T* pStageDst[4] = { mScratch[0].Get(), mScratch[1].Get(), mScratch[0].Get(), mScratch[1].Get() };
+    pStageDst[mFactor - 1] = pDst;
+    int stage = 0;
+
+    if (mRate == 16) { down16x.process_block(pStageDst[stage], pSrc, nFrames * 8); pSrc = pStageDst[stage++]; }
+    if (mRate >= 8) { down8x.process_block(pStageDst[stage], pSrc, nFrames * 4); pSrc = pStageDst[stage++]; }
+    if (mRate >= 4) { down4x.process_block(pStageDst[stage], pSrc, nFrames * 2); pSrc = pStageDst[stage++]; }
+    down2x.process_block(pStageDst[stage], pSrc, nFrames);
+  }
+
+  /** Interleave up to kSIMDChans channels into frames of kSIMDChans samples, zeroing any unused channels */
+  static void Interleave(T* pDst, const T* const* srcs, int nChans, int nFrames)
+  {
+    for (auto s = 0; s < nFrames; s++)
+    {
+      for (auto c = 0; c < kSIMDChans; c++)
+        pDst[(s * kSIMDChans) + c] = (c < nChans) ? srcs[c][s] : T(0);
+    }
+  }
+
+  static void Deinterleave(T* const* dsts, const T* pSrc, int nChans, int nFrames)
+  {
+    for (auto s = 0; s < nFrames; s++)
+    {
+      for (auto c = 0; c < nChans; c++)
+        dsts[c][s] = pSrc[(s * kSIMDChans) + c];
+    }
+  }
+
+  static constexpr double kCoeffs2x[12] = { 0.036681502163648017, 0.13654762463195794, 0.27463175937945444, 0.42313861743656711, 0.56109869787919531, 0.67754004997416184, 0.76974183386322703, 0.83988962484963892, 0.89226081800387902, 0.9315419599631839, 0.96209454837808417, 0.98781637073289585 };
+  static constexpr double kCoeffs4x[4] = {0.041893991997656171, 0.16890348243995201, 0.39056077292116603, 0.74389574826847926 };
+  static constexpr double kCoeffs8x[3] = {0.055748680811302048, 0.24305119574153072, 0.64669913119268196 };
+  static constexpr double kCoeffs16x[2] = {0.10717745346023573, 0.53091435354504557 };
+
   EFactor mFactor = kNone;
-  int mPrevRate = 0;
   int mRate = 1;
-  int mWritePos = 0;
-  T mDownSamplerOutput = 0.;
+  int mBlockSize = DEFAULT_BLOCK_SIZE;
+  bool mUseSIMD = HIIR_SSE2;
   bool mBlockProcessing; // false
   int mNInChannels; // 1
   int mNOutChannels;
   
-  // the actual data
-  WDL_TypedBuf<T> mUp16x;
-  WDL_TypedBuf<T> mUp8x;
-  WDL_TypedBuf<T> mUp4x;
-  WDL_TypedBuf<T> mUp2x;
-
-  WDL_TypedBuf<T> mDown16x;
-  WDL_TypedBuf<T> mDown8x;
-  WDL_TypedBuf<T> mDown4x;
-  WDL_TypedBuf<T> mDown2x;
+  // the actual data: each channel's signal at the over sampled rate, sized for kMaxRate
+  WDL_TypedBuf<T> mUpBuffer;
+  WDL_TypedBuf<T> mDownBuffer;
+
+  // the stages in between the first and last ping-pong between the scratch buffers. Interleaved holds the SIMD filters' input or output
+  WDL_TypedBuf<T> mScratch[2];
+  WDL_TypedBuf<T> mInterleaved;
   
   //Ptrs into buffer data
-  WDL_PtrList<T> mUp16BufferPtrs;
-  WDL_PtrList<T> mUp8BufferPtrs;
-  WDL_PtrList<T> mUp4BufferPtrs;
-  WDL_PtrList<T> mUp2BufferPtrs;
-  
-  WDL_PtrList<T> mDown16BufferPtrs;
-  WDL_PtrList<T> mDown8BufferPtrs;
-  WDL_PtrList<T> mDown4BufferPtrs;
-  WDL_PtrList<T> mDown2BufferPtrs;
+  WDL_PtrList<T> mUpBufferPtrs;
+  WDL_PtrList<T> mDownBufferPtrs;
 
   WDL_PtrList<T> mNextInputPtrs;
   WDL_PtrList<T> mNextOutputPtrs;
 
-  //Ptrs to the buffer data ptrs, changed depending on rate (block processing only)
-  WDL_PtrList<T>* mInPtrLoopSrc = nullptr;
-  WDL_PtrList<T>* mOutPtrLoopSrc = nullptr;
+  //Ptrs into the host's buffers, for the chunk of the block being processed
+  WDL_PtrList<const T> mChunkInputPtrs;
+  WDL_PtrList<T> mChunkOutputPtrs;
   
   //Ptrs to oversamplers for each channel
   WDL_PtrList<Upsampler2xFPU<12, T>> mUpsampler2x; // for 1x to 2x SR
@@ -479,6 +507,19 @@ private:
   WDL_PtrList<Downsampler2xFPU<4, T>> mDownsampler4x;  // decimator for 4x to 2x SR
   WDL_PtrList<Downsampler2xFPU<3, T>> mDownsampler8x;  // decimator for 8x to 4x SR
   WDL_PtrList<Downsampler2xFPU<2, T>> mDownsampler16x; // decimator for 16x to 8x SR
+
+#if HIIR_SSE2
+  //Ptrs to SIMD oversamplers for each group of kSIMDChans channels
+  WDL_PtrList<Upsampler2xSSE2<12, T>> mUpsampler2xSIMD;
+  WDL_PtrList<Upsampler2xSSE2<4, T>> mUpsampler4xSIMD;
+  WDL_PtrList<Upsampler2xSSE2<3, T>> mUpsampler8xSIMD;
+  WDL_PtrList<Upsampler2xSSE2<2, T>> mUpsampler16xSIMD;
+
+  WDL_PtrList<Downsampler2xSSE2<12, T>> mDownsampler2xSIMD;
+  WDL_PtrList<Downsampler2xSSE2<4, T>> mDownsampler4xSIMD;
+  WDL_PtrList<Downsampler2xSSE2<3, T>> mDownsampler8xSIMD;
+  WDL_PtrList<Downsampler2xSSE2<2, T>> mDownsampler16xSIMD;
+#endif
 };
 
 END_IPLUG_NAMESPACE
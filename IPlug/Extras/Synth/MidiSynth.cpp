@@ -474,7 +474,7 @@ void MidiSynth::SetSampleRateAndBlockSize(double sampleRate, int blockSize)
   Reset();
 
   mSampleRate = sampleRate;
-  mMidiQueue.Resize(blockSize);
+  mMidiQueue.Resize(IMidiQueue::SizeForBlock(blockSize));
   mVoiceAllocator.SetSampleRateAndBlockSize(sampleRate, blockSize);
 
   for(int v = 0; v < NVoices(); v++)
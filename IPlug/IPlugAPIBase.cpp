@@ -143,49 +143,34 @@ void IPlugAPIBase::OnTimer(Timer& t)
   {
 // VST3 ********************************************************************************
 #if defined VST3P_API || defined VST3_API
-    while (mMidiMsgsFromProcessor.ElementsAvailable())
-    {
-      IMidiMsg msg;
-      mMidiMsgsFromProcessor.Pop(msg);
+    mMidiMsgsFromProcessor.Drain([this](const IMidiMsg& msg) {
 #ifdef VST3P_API // distributed
       TransmitMidiMsgFromProcessor(msg);
 #else
       SendMidiMsgFromDelegate(msg);
 #endif
-    }
+    });
 
-    while (mSysExDataFromProcessor.ElementsAvailable())
-    {
-      SysExData msg;
-      mSysExDataFromProcessor.Pop(msg);
+    mSysExDataFromProcessor.Drain([this](const SysExData& msg) {
 #ifdef VST3P_API // distributed
       TransmitSysExDataFromProcessor(msg);
 #else
       SendSysexMsgFromDelegate({msg.mOffset, msg.mData, msg.mSize});
 #endif
-    }
+    });
 // !VST3 ******************************************************************************
 #else
-    while(mParamChangeFromProcessor.ElementsAvailable())
-    {
-      ParamTuple p;
-      mParamChangeFromProcessor.Pop(p);
+    mParamChangeFromProcessor.Drain([this](const ParamTuple& p) {
       SendParameterValueFromDelegate(p.idx, p.value, false);
-    }
+    });
     
-    while (mMidiMsgsFromProcessor.ElementsAvailable())
-    {
-      IMidiMsg msg;
-      mMidiMsgsFromProcessor.Pop(msg);
+    mMidiMsgsFromProcessor.Drain([this](const IMidiMsg& msg) {
       SendMidiMsgFromDelegate(msg);
-    }
+    });
     
-    while (mSysExDataFromProcessor.ElementsAvailable())
-    {
-      SysExData msg;
-      mSysExDataFromProcessor.Pop(msg);
+    mSysExDataFromProcessor.Drain([this](const SysExData& msg) {
       SendSysexMsgFromDelegate({msg.mOffset, msg.mData, msg.mSize});
-    }
+    });
 #endif
   }
   
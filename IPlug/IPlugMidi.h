@@ -622,12 +622,15 @@ IMidiQueue is a fast, lean & mean MIDI queue for IPlug instruments or
 effects. Here are a few code snippets showing how to implement IMidiQueue in
 an IPlug project:
 
+Altered from the original: the queue is now a fixed capacity ring buffer that
+never allocates on the audio thread, messages that don't fit are dropped
+according to an overflow policy (by default never a note off), and Flush() no
+longer rewrites the offsets of the queued messages.
 
-MyPlug.h:
 
-#include "WDL/IPlug/IMidiQueue.h"
+MyPlug.h:
 
-class MyPlug: public IPlug
+class MyPlug: public Plugin
 {
 protected:
   IMidiQueue mMidiQueue;
@@ -638,21 +641,22 @@ MyPlug.cpp:
 
 void MyPlug::OnReset()
 {
-  mMidiQueue.Resize(GetBlockSize());
+  // Not on the audio thread: this is the only place memory is allocated
+  mMidiQueue.Resize(IMidiQueue::SizeForBlock(GetBlockSize()));
 }
 
-void MyPlug::ProcessMidiMsg(IMidiMsg* pMsg)
+void MyPlug::ProcessMidiMsg(const IMidiMsg& msg)
 {
-  mMidiQueue.Add(pMsg);
+  mMidiQueue.Add(msg);
 }
 
-void MyPlug::ProcessBlock(double** inputs, double** outputs, int nFrames)
+void MyPlug::ProcessBlock(sample** inputs, sample** outputs, int nFrames)
 {
   for (int offset = 0; offset < nFrames; ++offset)
   {
     while (!mMidiQueue.Empty())
     {
-      IMidiMsg* pMsg = mMidiQueue.Peek();
+      const IMidiMsg msg = mMidiQueue.Peek();
       if (msg.mOffset > offset) break;
 
       // To-do: Handle the MIDI message
@@ -672,15 +676,36 @@ void MyPlug::ProcessBlock(double** inputs, double** outputs, int nFrames)
   #define DEFAULT_BLOCK_SIZE 512
 #endif
 
-/** A class to help with queuing timestamped MIDI messages
+/** A class to help with queuing timestamped MIDI messages.
+  * The queue has a fixed capacity, set when it is constructed or resized, and adding, removing and flushing messages never allocates memory,
+  * so it is safe to use on the audio thread. Messages are kept sorted by offset: adding them in order (the common case) takes constant time.
   * @ingroup IPlugUtilities */
 class IMidiQueue
 {
 public:
-  IMidiQueue(int size = DEFAULT_BLOCK_SIZE)
-  : mBuf(NULL), mSize(0), mGrow(Granulize(size)), mFront(0), mBack(0)
+  /** What to do with a message added to a full queue */
+  enum class EOverflowPolicy
+  {
+    kDropNewest,    // Drop the message being added
+    kDropOldest,    // Drop the message at the front of the queue to make room
+    kKeepNoteOffs   // Drop the message being added, unless it releases notes: then drop the oldest message which doesn't to make room
+  };
+
+  /** The smallest size for a queue: enough for a block's worth of dense controller data plus notes */
+  static constexpr int kMinSize = 4096;
+
+  /** Get a size for a queue which holds the MIDI for blocks of up to the given number of frames
+   * @param blockSize The largest number of frames in a block
+   * @return Room for a few messages per frame, and at least kMinSize */
+  static int SizeForBlock(int blockSize) { return std::max(kMinSize, blockSize * 4); }
+
+  /** Create a queue, allocating its memory up front
+   * @param size The number of messages the queue can hold: rounded up to a power of 2
+   * @param overflowPolicy What to do with messages added when the queue is full */
+  IMidiQueue(int size = kMinSize, EOverflowPolicy overflowPolicy = EOverflowPolicy::kKeepNoteOffs)
+  : mBuf(NULL), mSize(0), mFront(0), mCount(0), mTime(0), mNumDropped(0), mOverflowPolicy(overflowPolicy)
   {
-    Expand();
+    Resize(size);
   }
   
   ~IMidiQueue()
@@ -688,119 +713,181 @@ public:
     free(mBuf);
   }
 
-  // Adds a MIDI message at the back of the queue. If the queue is full,
-  // it will automatically expand itself.
-  void Add(const IMidiMsg& msg)
+  IMidiQueue(const IMidiQueue&) = delete;
+  IMidiQueue& operator=(const IMidiQueue&) = delete;
+
+  // Adds a MIDI message to the queue, in order of it's offset (messages with
+  // the same offset stay in the order they were added). If the queue is full
+  // then a message is dropped according to the overflow policy: returns false
+  // if it was the message being added.
+  bool Add(const IMidiMsg& msg)
   {
-    if (mBack >= mSize)
+    if (mCount >= mSize)
     {
-      if (mFront > 0)
-        Compact();
-      else if (!Expand()) return;
+      ++mNumDropped;
+
+      if (mSize == 0)
+        return false;
+
+      switch (mOverflowPolicy)
+      {
+        case EOverflowPolicy::kDropNewest:
+          return false;
+
+        case EOverflowPolicy::kDropOldest:
+          Remove();
+          break;
+
+        case EOverflowPolicy::kKeepNoteOffs:
+          // Only releases are worth making room for, since dropping them leaves notes stuck
+          if (!IsRelease(msg) || !RemoveOldestNonRelease())
+            return false;
+
+          break;
+      }
     }
 
+    int i = mCount;
+
 #ifndef DONT_SORT_IMIDIQUEUE
-    // Insert the MIDI message at the right offset.
-    if (mBack > mFront && msg.mOffset < mBuf[mBack - 1].mOffset)
+    // Move any later messages up to make room: there are none when messages arrive in order
+    while (i > 0 && msg.mOffset < RelativeOffset(At(i - 1)))
     {
-      int i = mBack - 2;
-      while (i >= mFront && msg.mOffset < mBuf[i].mOffset) --i;
-      i++;
-      memmove(&mBuf[i + 1], &mBuf[i], (mBack - i) * sizeof(IMidiMsg));
-      mBuf[i] = msg;
+      At(i) = At(i - 1);
+      --i;
     }
-    else
 #endif
-      mBuf[mBack] = msg;
-    ++mBack;
+
+    IMidiMsg& queuedMsg = At(i);
+    queuedMsg = msg;
+    queuedMsg.mOffset = (int) ((unsigned) msg.mOffset + mTime);
+    ++mCount;
+    return true;
   }
 
-  // Removes a MIDI message from the front of the queue (but does *not*
-  // free up its space until Compact() is called).
-  inline void Remove() { ++mFront; }
+  // Removes the MIDI message at the front of the queue.
+  inline void Remove()
+  {
+    mFront = (mFront + 1) & (mSize - 1);
+
+    if (--mCount == 0)
+      mFront = 0;
+  }
 
   // Returns true if the queue is empty.
-  inline bool Empty() const { return mFront == mBack; }
+  inline bool Empty() const { return mCount == 0; }
 
   // Returns the number of MIDI messages in the queue.
-  inline int ToDo() const { return mBack - mFront; }
+  inline int ToDo() const { return mCount; }
 
-  // Returns the number of MIDI messages for which memory has already been
-  // allocated.
+  // Returns the number of MIDI messages the queue can hold.
   inline int GetSize() const { return mSize; }
 
-  // Returns the "next" MIDI message (all the way in the front of the
-  // queue), but does *not* remove it from the queue.
-  inline IMidiMsg& Peek() const { return mBuf[mFront]; }
+  // Returns how many MIDI messages have been dropped because the queue was
+  // full, since the queue was created or cleared.
+  inline int NumDropped() const { return mNumDropped; }
 
-  // Moves back MIDI messages all the way to the front of the queue, thus
-  // freeing up space at the back, and updates the sample offset of the
-  // remaining MIDI messages by substracting nFrames.
-  inline void Flush(int nFrames)
+  // Returns a copy of the "next" MIDI message (all the way in the front of
+  // the queue), but does *not* remove it from the queue. The offset is
+  // relative to the start of the current block.
+  inline IMidiMsg Peek() const
   {
-    // Move everything all the way to the front.
-    if (mFront > 0) Compact();
+    IMidiMsg msg = mBuf[mFront];
+    msg.mOffset = RelativeOffset(msg);
+    return msg;
+  }
 
-    // Update the sample offset.
-    for (int i = 0; i < mBack; ++i) mBuf[i].mOffset -= nFrames;
+  // Moves on to the next block by subtracting nFrames from the offsets of
+  // the remaining MIDI messages. The queued messages themselves are not
+  // touched: their offsets are kept relative to a running frame count.
+  inline void Flush(int nFrames)
+  {
+    mTime = Empty() ? 0 : mTime + (unsigned) nFrames;
   }
 
   // Clears the queue.
-  inline void Clear() { mFront = mBack = 0; }
+  inline void Clear() { mFront = mCount = 0; mTime = 0; mNumDropped = 0; }
 
-  // Resizes (grows or shrinks) the queue, returns the new size.
+  void SetOverflowPolicy(EOverflowPolicy overflowPolicy) { mOverflowPolicy = overflowPolicy; }
+  EOverflowPolicy GetOverflowPolicy() const { return mOverflowPolicy; }
+
+  // Resizes (grows or shrinks) the queue, returns the new size. This
+  // allocates memory, so must not be called on the audio thread.
   int Resize(int size)
   {
-    if (mFront > 0) Compact();
-    mGrow = size = Granulize(size);
     // Don't shrink below the number of currently queued MIDI messages.
-    if (size < mBack) size = Granulize(mBack);
+    size = RoundUpToPowerOf2(std::max(size, mCount));
     if (size == mSize) return mSize;
 
-    void* buf = realloc(mBuf, size * sizeof(IMidiMsg));
+    IMidiMsg* buf = (IMidiMsg*) malloc(size * sizeof(IMidiMsg));
     if (!buf) return mSize;
 
-    mBuf = (IMidiMsg*)buf;
+    for (int i = 0; i < mCount; ++i)
+      buf[i] = At(i);
+
+    free(mBuf);
+    mBuf = buf;
     mSize = size;
+    mFront = 0;
     return size;
   }
 
 protected:
-  // Automatically expands the queue.
-  bool Expand()
+  // Returns the i'th queued message, counting from the front of the queue.
+  inline IMidiMsg& At(int i) const { return mBuf[(mFront + i) & (mSize - 1)]; }
+
+  // Returns true if the message releases notes: a note off (or a note on with
+  // zero velocity), the sustain pedal going up, or all notes off.
+  static bool IsRelease(const IMidiMsg& msg)
   {
-    if (!mGrow) return false;
-    int size = (mSize / mGrow + 1) * mGrow;
+    switch (msg.StatusMsg())
+    {
+      case IMidiMsg::kNoteOff:
+        return true;
+      case IMidiMsg::kNoteOn:
+        return msg.Velocity() == 0;
+      case IMidiMsg::kControlChange:
+        return (msg.mData1 == IMidiMsg::kSustainOnOff && msg.mData2 < 64) || msg.mData1 == IMidiMsg::kAllNotesOff;
+      default:
+        return false;
+    }
+  }
 
-    void* buf = realloc(mBuf, size * sizeof(IMidiMsg));
-    if (!buf) return false;
+  // Removes the oldest queued message which doesn't release notes, keeping the
+  // others in order. Returns false if every queued message releases notes.
+  bool RemoveOldestNonRelease()
+  {
+    int i = 0;
+    while (i < mCount && IsRelease(At(i))) ++i;
+    if (i >= mCount) return false;
 
-    mBuf = (IMidiMsg*)buf;
-    mSize = size;
+    for (; i > 0; --i)
+      At(i) = At(i - 1);
+
+    Remove();
     return true;
   }
 
-  // Moves everything all the way to the front.
-  inline void Compact()
-  {
-    mBack -= mFront;
-    if (mBack > 0) memmove(&mBuf[0], &mBuf[mFront], mBack * sizeof(IMidiMsg));
-    mFront = 0;
-  }
+  // Returns the offset of a queued message relative to the start of the
+  // current block. Note: the running frame count is allowed to wrap around.
+  inline int RelativeOffset(const IMidiMsg& queuedMsg) const { return (int) ((unsigned) queuedMsg.mOffset - mTime); }
 
-  // Rounds the MIDI queue size up to the next 4 kB memory page size.
-  inline int Granulize(int size) const
+  // Rounds the MIDI queue size up to the next power of 2, so that indexes
+  // can wrap around with a mask.
+  static inline int RoundUpToPowerOf2(int size)
   {
-    int bytes = size * sizeof(IMidiMsg);
-    int rest = bytes % 4096;
-    if (rest) size = (bytes - rest + 4096) / sizeof(IMidiMsg);
-    return size;
+    int powerOf2 = 1;
+    while (powerOf2 < size) powerOf2 <<= 1;
+    return powerOf2;
   }
 
   IMidiMsg* mBuf;
 
-  int mSize, mGrow;
-  int mFront, mBack;
+  int mSize;
+  int mFront, mCount;
+  unsigned mTime;
+  int mNumDropped;
+  EOverflowPolicy mOverflowPolicy;
 };
 
 END_IPLUG_NAMESPACE
@@ -236,6 +236,7 @@ void IParam::Init(const IParam& p, const char* searchStr, const char* replaceStr
   }
   
   InitDouble(str.Get(), p.mDefault, p.mMin, p.mMax, p.mStep, p.mLabel, p.mFlags, group.Get(), *p.mShape, p.mUnit, p.mDisplayFunction);
+  mRampFunction = p.mRampFunction;
   
   for (auto i=0; i<p.NDisplayTexts(); i++)
   {
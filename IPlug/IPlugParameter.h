@@ -55,11 +55,23 @@ public:
     kFlagSignDisplay      = 0x8,
     /** Indicates that the parameter may influence the state of other parameters */
     kFlagMeta             = 0x10,
+    /** Indicates that host automation of the parameter should be applied at the exact sample it occurs, rather than at the start of the block.
+     * Where the API supports it (currently VST3), the block is split into sub-blocks at each automation point and ProcessBlock() is called for each of them,
+     * unless the parameter has a RampFunc, in which case the automation is handed to that instead.
+     * Note that MIDI messages are all passed to ProcessMidiMsg() before the first sub-block, with offsets relative to the start of the whole host block:
+     * a plug-in which queues them should advance the queue by the length of each sub-block it processes, as IMidiQueue::Flush() does.
+     * IPlugProcessor::GetSubBlockFramesRemaining() tells when the last sub-block of a host block is being processed. */
+    kFlagSampleAccurate   = 0x20,
   };
   
   /** DisplayFunc allows custom parameter display functions, defined by a lambda matching this signature */
   using DisplayFunc = std::function<void(double, WDL_String&)>;
 
+  /** RampFunc allows a plug-in to smooth sample accurate automation itself, defined by a lambda matching this signature.
+   * It is called on the audio thread before ProcessBlock(), once for each linear segment of the automation in the block, in order: the normalized value goes from
+   * startValue at startFrame to endValue at endFrame. The parameter is then set to the final value and OnParamChange() is called, without splitting the block. */
+  using RampFunc = std::function<void(int startFrame, double startValue, int endFrame, double endValue)>;
+
 #pragma mark - Shape
 
   /** Base struct for parameter shaping */
@@ -332,6 +344,14 @@ public:
    * @param func A function conforming to DisplayFunc */
   void SetDisplayFunc(DisplayFunc func) { mDisplayFunction = func; }
 
+  /** Set a function to receive the sample accurate automation of this parameter, instead of the block being split at each automation point.
+   * This also sets kFlagSampleAccurate.
+   * @param func A function conforming to RampFunc */
+  void SetRampFunc(RampFunc func) { mRampFunction = func; mFlags |= kFlagSampleAccurate; }
+
+  /** @return The function set to receive the sample accurate automation of this parameter, if any */
+  const RampFunc& GetRampFunc() const { return mRampFunction; }
+
   /** Gets a readable value of the parameter
    * @return double Current value of the parameter */
   double Value() const { return mValue.load(); }
@@ -480,6 +500,9 @@ public:
 
   /** @return \c true If the parameter is flagged as a "meta" parameter, e.g. one that could modify other parameters */
   bool GetMeta() const { return mFlags & kFlagMeta; }
+
+  /** @return \c true If host automation of the parameter should be applied at the exact sample it occurs */
+  bool GetSampleAccurate() const { return mFlags & kFlagSampleAccurate; }
  
   /** Get a JSON description of the parameter. 
    * @param json WDL_String to fill with the JSON
@@ -512,6 +535,7 @@ private:
   
   std::unique_ptr<Shape> mShape;
   DisplayFunc mDisplayFunction = nullptr;
+  RampFunc mRampFunction = nullptr;
 
   WDL_TypedBuf<DisplayText> mDisplayTexts;
 } WDL_FIXALIGN;
@@ -35,6 +35,8 @@ IPlugProcessor::IPlugProcessor(const Config& config, EAPI plugAPI)
 
   mScratchData[ERoute::kInput].Resize(totalNInChans);
   mScratchData[ERoute::kOutput].Resize(totalNOutChans);
+  mSubBlockData[ERoute::kInput].Resize(totalNInChans);
+  mSubBlockData[ERoute::kOutput].Resize(totalNOutChans);
 
   sample** ppInData = mScratchData[ERoute::kInput].Get();
 
@@ -507,14 +509,33 @@ void IPlugProcessor::PassThroughBuffers(PLUG_SAMPLE_SRC type, int nFrames)
   }
 }
 
-void IPlugProcessor::ProcessBuffers(PLUG_SAMPLE_DST type, int nFrames)
+void IPlugProcessor::ProcessBuffers(PLUG_SAMPLE_DST type, int nFrames, int startFrame)
 {
-  ProcessBlock(mScratchData[ERoute::kInput].Get(), mScratchData[ERoute::kOutput].Get(), nFrames);
+  if (startFrame == 0)
+  {
+    ProcessBlock(mScratchData[ERoute::kInput].Get(), mScratchData[ERoute::kOutput].Get(), nFrames);
+    return;
+  }
+
+  // A sub-block of the attached buffers, e.g. between two sample accurate parameter changes
+  for (auto dir : { ERoute::kInput, ERoute::kOutput })
+  {
+    const int n = mScratchData[dir].GetSize();
+    sample** ppData = mScratchData[dir].Get();
+    sample** ppSubBlockData = mSubBlockData[dir].Get();
+
+    for (auto i = 0; i < n; ++i)
+    {
+      ppSubBlockData[i] = ppData[i] + startFrame;
+    }
+  }
+
+  ProcessBlock(mSubBlockData[ERoute::kInput].Get(), mSubBlockData[ERoute::kOutput].Get(), nFrames);
 }
 
-void IPlugProcessor::ProcessBuffers(PLUG_SAMPLE_SRC type, int nFrames)
+void IPlugProcessor::ProcessBuffers(PLUG_SAMPLE_SRC type, int nFrames, int startFrame)
 {
-  ProcessBuffers((PLUG_SAMPLE_DST) 0, nFrames);
+  ProcessBuffers((PLUG_SAMPLE_DST) 0, nFrames, startFrame);
   int i, n = MaxNChannels(ERoute::kOutput);
   IChannelData<>** ppOutChannel = mChannelData[ERoute::kOutput].GetList();
 
@@ -524,7 +545,7 @@ void IPlugProcessor::ProcessBuffers(PLUG_SAMPLE_SRC type, int nFrames)
 
     if (pOutChannel->mConnected)
     {
-      CastCopy(pOutChannel->mIncomingData, *(pOutChannel->mData), nFrames);
+      CastCopy(pOutChannel->mIncomingData + startFrame, *(pOutChannel->mData) + startFrame, nFrames);
     }
   }
 }
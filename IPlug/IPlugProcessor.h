@@ -115,6 +115,11 @@ public:
   /** @return \c true if the plugin is currently rendering off-line */
   bool GetRenderingOffline() const { return mRenderingOffline; };
 
+  /** @return The number of frames of the host's block still to be processed after the current call to ProcessBlock(). This is only ever non-zero when
+   * the block is split into sub-blocks for sample accurate automation (see IParam::kFlagSampleAccurate), so a plug-in which needs to do something once per
+   * host block can do it when this is 0 */
+  int GetSubBlockFramesRemaining() const { return mSubBlockFramesRemaining; }
+
 #pragma mark -
   /** @return The number of samples elapsed since start of project timeline. */
   double GetSamplePos() const { return mTimeInfo.mSamplePos; }
@@ -257,8 +262,8 @@ protected:
   void AttachBuffers(ERoute direction, int idx, int n, PLUG_SAMPLE_SRC** ppData, int nFrames);
   void PassThroughBuffers(PLUG_SAMPLE_SRC type, int nFrames);
   void PassThroughBuffers(PLUG_SAMPLE_DST type, int nFrames);
-  void ProcessBuffers(PLUG_SAMPLE_SRC type, int nFrames);
-  void ProcessBuffers(PLUG_SAMPLE_DST type, int nFrames);
+  void ProcessBuffers(PLUG_SAMPLE_SRC type, int nFrames, int startFrame = 0);
+  void ProcessBuffers(PLUG_SAMPLE_DST type, int nFrames, int startFrame = 0);
   void ProcessBuffersAccumulating(int nFrames); // only for VST2 deprecated method single precision
   void ZeroScratchBuffers();
   void SetSampleRate(double sampleRate) { mSampleRate = sampleRate; }
@@ -266,6 +271,7 @@ protected:
   void SetBypassed(bool bypassed) { mBypassed = bypassed; }
   void SetTimeInfo(const ITimeInfo& timeInfo) { mTimeInfo = timeInfo; }
   void SetRenderingOffline(bool renderingOffline) { mRenderingOffline = renderingOffline; }
+  void SetSubBlockFramesRemaining(int nFrames) { mSubBlockFramesRemaining = nFrames; }
   const WDL_String& GetChannelLabel(ERoute direction, int idx) { return mChannelData[direction].Get(idx)->mLabel; }
 
 private:
@@ -289,10 +295,14 @@ private:
   bool mBypassed = false;
   /** \c true if the plug-in is rendering off-line*/
   bool mRenderingOffline = false;
+  /** Frames of the host's block following the sub-block being processed, if the block is split up */
+  int mSubBlockFramesRemaining = 0;
   /** A list of IOConfig structures populated by ParseChannelIOStr in the IPlugProcessor constructor */
   WDL_PtrList<IOConfig> mIOConfigs;
   /* Manages pointers to the actual data for each channel */
   WDL_TypedBuf<sample*> mScratchData[2];
+  /* Pointers into the channel data for a sub-block starting part way through the attached buffers */
+  WDL_TypedBuf<sample*> mSubBlockData[2];
   /* A list of IChannelData structures corresponding to every input/output channel */
   WDL_PtrList<IChannelData<>> mChannelData[2];
 protected: // these members are protected because they need to be access by the API classes, and don't want a setter/getter
@@ -15,8 +15,10 @@
  * @copydoc IPlugQueue
  */
 
+#include <algorithm>
 #include <atomic>
 #include <cstddef>
+#include <limits>
 
 #include "heapbuf.h"
 
@@ -24,13 +26,21 @@ BEGIN_IPLUG_NAMESPACE
 
 /** A lock-free SPSC queue used to transfer data between threads
  * based on MLQueue.h by Randy Jones
- * based on https://kjellkod.wordpress.com/2012/11/28/c-debt-paid-in-full-wait-free-lock-free-queue/ */
+ * based on https://kjellkod.wordpress.com/2012/11/28/c-debt-paid-in-full-wait-free-lock-free-queue/
+ *
+ * The read and write indices live on separate cache lines, so the producer and consumer threads don't invalidate each other's cache on
+ * every element. Each side also keeps a cached copy of the other side's index, and only reloads it (with an acquire) when the cached
+ * copy says the queue is full or empty. Batches of elements can be moved with PushN(), PopN() and Drain(), which publish the whole batch
+ * with a single release. */
 template<typename T>
 class IPlugQueue final
 {
 public:
+  /** The size of a cache line: the indices are padded to this to avoid false sharing */
+  static constexpr size_t kCacheLineSize = 64;
+
   /** IPlugQueue constructor 
-   * @param size \todo */
+   * @param size The maximum number of elements the queue can hold */
   IPlugQueue(int size)
   {
     Resize(size);
@@ -41,51 +51,118 @@ public:
   IPlugQueue(const IPlugQueue&) = delete;
   IPlugQueue& operator=(const IPlugQueue&) = delete;
     
-  /** \todo 
-   * @param size \todo */
+  /** Resize the queue. This allocates memory and is not thread safe: it must not be called while either thread is using the queue
+   * @param size The maximum number of elements the queue can hold */
   void Resize(int size)
   {
     mData.Resize(size + 1);
   }
 
-  /** \todo 
-   * @param item \todo
-   * @return true \todo
-   * @return false \todo */
+  /** Push a single element onto the queue. Only call this from the producer thread
+   * @param item The element to push
+   * @return true if the element was pushed
+   * @return false if the queue was full */
   bool Push(const T& item)
   {
     const auto currentWriteIndex = mWriteIndex.load(std::memory_order_relaxed);
     const auto nextWriteIndex = Increment(currentWriteIndex);
-    if(nextWriteIndex != mReadIndex.load(std::memory_order_acquire))
+    if(nextWriteIndex == mCachedReadIndex)
     {
-      mData.Get()[currentWriteIndex] = item;
-      mWriteIndex.store(nextWriteIndex, std::memory_order_release);
-      return true;
+      mCachedReadIndex = mReadIndex.load(std::memory_order_acquire);
+      if(nextWriteIndex == mCachedReadIndex)
+        return false; // the queue is full
     }
-    return false;
+    mData.Get()[currentWriteIndex] = item;
+    mWriteIndex.store(nextWriteIndex, std::memory_order_release);
+    return true;
   }
 
-  /** \todo 
-   * @param item \todo
-   * @return true \todo
-   * @return false \todo */
+  /** Push as many of the given elements as will fit onto the queue, publishing them to the consumer all at once. Only call this from the producer thread
+   * @param pItems The elements to push
+   * @param numItems The number of elements to push
+   * @return int The number of elements pushed, which is less than numItems if the queue filled up */
+  int PushN(const T* pItems, int numItems)
+  {
+    const auto currentWriteIndex = mWriteIndex.load(std::memory_order_relaxed);
+    size_t space = FreeSpace(currentWriteIndex, mCachedReadIndex);
+    if(space < (size_t) numItems)
+    {
+      mCachedReadIndex = mReadIndex.load(std::memory_order_acquire);
+      space = FreeSpace(currentWriteIndex, mCachedReadIndex);
+    }
+    const size_t numToPush = std::min(space, (size_t) std::max(numItems, 0));
+    if(numToPush == 0)
+      return 0;
+
+    // Copy in up to two runs: up to the end of the buffer, then from the start
+    T* pData = mData.Get();
+    const size_t size = mData.GetSize();
+    const size_t numBeforeWrap = std::min(numToPush, size - currentWriteIndex);
+    std::copy(pItems, pItems + numBeforeWrap, pData + currentWriteIndex);
+    std::copy(pItems + numBeforeWrap, pItems + numToPush, pData);
+    mWriteIndex.store((currentWriteIndex + numToPush) % size, std::memory_order_release);
+    return (int) numToPush;
+  }
+
+  /** Pop a single element off the queue. Only call this from the consumer thread
+   * @param item Receives the element popped
+   * @return true if an element was popped
+   * @return false if the queue was empty */
   bool Pop(T& item)
   {
     const auto currentReadIndex = mReadIndex.load(std::memory_order_relaxed);
-    if(currentReadIndex == mWriteIndex.load(std::memory_order_acquire))
+    if(currentReadIndex == mCachedWriteIndex)
     {
-      return false; // empty the queue
+      mCachedWriteIndex = mWriteIndex.load(std::memory_order_acquire);
+      if(currentReadIndex == mCachedWriteIndex)
+        return false; // empty the queue
     }
     item = mData.Get()[currentReadIndex];
     mReadIndex.store(Increment(currentReadIndex), std::memory_order_release);
     return true;
   }
 
-  /** \todo 
-   * @return size_t \todo */
+  /** Pop up to the given number of elements off the queue, freeing their space for the producer all at once. Only call this from the consumer thread
+   * @param pItems Receives the elements popped
+   * @param maxItems The maximum number of elements to pop
+   * @return int The number of elements popped, which is 0 if the queue was empty */
+  int PopN(T* pItems, int maxItems)
+  {
+    size_t numPopped = 0;
+    Drain([&](const T& item) { pItems[numPopped++] = item; }, maxItems);
+    return (int) numPopped;
+  }
+
+  /** Call a function for each element available in the queue (up to a maximum) and then pop them all at once.
+   * The elements are passed by reference, straight out of the queue's buffer, so large elements are not copied. Only call this from the consumer thread
+   * @param func The function to call with each element, which takes a `const T&`
+   * @param maxItems The maximum number of elements to pop: by default, all of the elements that were in the queue when this was called
+   * @return int The number of elements popped */
+  template <typename F>
+  int Drain(F&& func, int maxItems = std::numeric_limits<int>::max())
+  {
+    const auto currentReadIndex = mReadIndex.load(std::memory_order_relaxed);
+    mCachedWriteIndex = mWriteIndex.load(std::memory_order_acquire);
+    const size_t numToPop = std::min(UsedSpace(mCachedWriteIndex, currentReadIndex), (size_t) std::max(maxItems, 0));
+    if(numToPop == 0)
+      return 0;
+
+    const T* pData = mData.Get();
+    size_t readIndex = currentReadIndex;
+    for(size_t i = 0; i < numToPop; i++)
+    {
+      func(pData[readIndex]);
+      readIndex = Increment(readIndex);
+    }
+    mReadIndex.store(readIndex, std::memory_order_release);
+    return (int) numToPop;
+  }
+
+  /** Get the number of elements in the queue. Only exact when called from the consumer thread
+   * @return size_t The number of elements available to pop */
   size_t ElementsAvailable() const
   {
-    return (mWriteIndex.load(std::memory_order_acquire) - mReadIndex.load(std::memory_order_relaxed))%mData.GetSize();
+    return UsedSpace(mWriteIndex.load(std::memory_order_acquire), mReadIndex.load(std::memory_order_relaxed));
   }
 
   /** \todo
@@ -95,7 +172,7 @@ public:
   const T& Peek()
   {
     const auto currentReadIndex = mReadIndex.load(std::memory_order_relaxed);
-    return mData[currentReadIndex];
+    return mData.Get()[currentReadIndex];
   }
 
   /** \todo 
@@ -121,12 +198,26 @@ private:
    * @return size_t \todo */
   size_t Increment(size_t idx) const
   {
-    return (idx + 1) % (mData.GetSize());
+    return (idx + 1 == (size_t) mData.GetSize()) ? 0 : idx + 1;
+  }
+
+  /** The number of elements between the given read and write indices */
+  size_t UsedSpace(size_t writeIndex, size_t readIndex) const
+  {
+    return (writeIndex >= readIndex) ? writeIndex - readIndex : writeIndex + mData.GetSize() - readIndex;
+  }
+
+  /** The number of elements that can be pushed, given the read and write indices. One slot is always left empty to tell a full queue from an empty one */
+  size_t FreeSpace(size_t writeIndex, size_t readIndex) const
+  {
+    return mData.GetSize() - 1 - UsedSpace(writeIndex, readIndex);
   }
 
   WDL_TypedBuf<T> mData;
-  std::atomic<size_t> mWriteIndex{0};
-  std::atomic<size_t> mReadIndex{0};
+  alignas(kCacheLineSize) std::atomic<size_t> mWriteIndex{0};
+  size_t mCachedReadIndex = 0; // The producer's copy of mReadIndex, on the producer's cache line
+  alignas(kCacheLineSize) std::atomic<size_t> mReadIndex{0};
+  size_t mCachedWriteIndex = 0; // The consumer's copy of mWriteIndex, on the consumer's cache line
 };
 
 END_IPLUG_NAMESPACE
@@ -14,6 +14,9 @@
 #include "public.sdk/source/vst/vsteventshelper.h"
 #include "IPlugVST3_ProcessorBase.h"
 
+#include <algorithm>
+#include <climits>
+
 using namespace iplug;
 using namespace Steinberg;
 using namespace Vst;
@@ -65,6 +68,9 @@ IPlugVST3ProcessorBase::IPlugVST3ProcessorBase(Config c, IPlugAPIBase& plug)
   
   // Make sure the process context is predictably initialised in case it is used before process is called
   memset(&mProcessContext, 0, sizeof(ProcessContext));
+
+  // Sample accurate parameter changes are collected on the audio thread, so make room for them up front
+  mParamChanges.reserve(kMaxSampleAccurateParamChanges);
 }
 
 void IPlugVST3ProcessorBase::ProcessMidiIn(IEventList* pEventList, IPlugQueue<IMidiMsg>& editorQueue, IPlugQueue<IMidiMsg>& processorQueue)
@@ -129,7 +135,7 @@ void IPlugVST3ProcessorBase::ProcessMidiOut(IPlugQueue<SysExData>& sysExQueue, S
     
     while (!mMidiOutputQueue.Empty())
     {
-      IMidiMsg& msg = mMidiOutputQueue.Peek();
+      msg = mMidiOutputQueue.Peek();
 
       if (msg.StatusMsg() == IMidiMsg::kNoteOn)
       {
@@ -226,7 +232,7 @@ bool IPlugVST3ProcessorBase::SetupProcessing(const ProcessSetup& setup, ProcessS
   
   SetSampleRate(setup.sampleRate);
   IPlugProcessor::SetBlockSize(setup.maxSamplesPerBlock); // TODO: should IPlugVST3Processor call SetBlockSize in construct unlike other APIs?
-  mMidiOutputQueue.Resize(setup.maxSamplesPerBlock);
+  mMidiOutputQueue.Resize(IMidiQueue::SizeForBlock(setup.maxSamplesPerBlock));
   OnReset();
     
   return true;
@@ -242,10 +248,13 @@ bool IPlugVST3ProcessorBase::SetProcessing(bool state)
 
 bool IPlugVST3ProcessorBase::CanProcessSampleSize(int32 symbolicSampleSize)
 {
+  // Plugins built to process in float only offer 32-bit processing, so the host's buffers can be used without conversion
   switch (symbolicSampleSize)
   {
-    case kSample32:   // fall through
+    case kSample32:   return true;
+#ifdef SAMPLE_TYPE_DOUBLE
     case kSample64:   return true;
+#endif
     default:          return false;
   }
 }
@@ -276,6 +285,8 @@ void IPlugVST3ProcessorBase::PrepareProcessContext(ProcessData& data, ProcessSet
 void IPlugVST3ProcessorBase::ProcessParameterChanges(ProcessData& data, IPlugQueue<IMidiMsg>& fromProcessor)
 {
   IParameterChanges* paramChanges = data.inputParameterChanges;
+  mParamChanges.clear();
+  mNextParamChangeIdx = 0;
   
   if (paramChanges)
   {
@@ -309,16 +320,45 @@ void IPlugVST3ProcessorBase::ProcessParameterChanges(ProcessData& data, IPlugQue
             {
               if (idx >= 0 && idx < mPlug.NParams())
               {
-#ifdef PARAMS_MUTEX
-                mPlug.mParams_mutex.Enter();
-#endif
-                mPlug.GetParam(idx)->SetNormalized(value);
-              
-                // In VST3 non distributed the same parameter value is also set via IPlugVST3Controller::setParamNormalized(ParamID tag, ParamValue value)
-                mPlug.OnParamChange(idx, kHost, offsetSamples);
-#ifdef PARAMS_MUTEX
-                mPlug.mParams_mutex.Leave();
-#endif
+                const IParam* pParam = mPlug.GetParam(idx);
+
+                if (pParam->GetRampFunc())
+                {
+                  // The plug-in smooths the automation itself: hand it every segment, starting from the current value
+                  int32 startOffset = 0;
+                  double startValue = pParam->GetNormalized();
+
+                  for (int32 pointIdx = 0; pointIdx < numPoints; pointIdx++)
+                  {
+                    int32 pointOffset;
+                    double pointValue;
+
+                    if (paramQueue->getPoint(pointIdx, pointOffset, pointValue) == kResultTrue)
+                    {
+                      pParam->GetRampFunc()(startOffset, startValue, pointOffset, pointValue);
+                      startOffset = pointOffset;
+                      startValue = pointValue;
+                    }
+                  }
+
+                  SetParamFromHost(idx, value, offsetSamples);
+                }
+                else if (pParam->GetSampleAccurate())
+                {
+                  // Apply every point at the sample it occurs, splitting the block there
+                  for (int32 pointIdx = 0; pointIdx < numPoints; pointIdx++)
+                  {
+                    int32 pointOffset;
+                    double pointValue;
+
+                    if (paramQueue->getPoint(pointIdx, pointOffset, pointValue) == kResultTrue)
+                      AddSampleAccurateParamChange(idx, pointValue, pointOffset);
+                  }
+                }
+                else
+                {
+                  SetParamFromHost(idx, value, offsetSamples);
+                }
               }
               else if (idx >= kMIDICCParamStartIdx)
               {
@@ -326,17 +366,29 @@ void IPlugVST3ProcessorBase::ProcessParameterChanges(ProcessData& data, IPlugQue
                 int channel = index / kCountCtrlNumber;
                 int ctrlr = index % kCountCtrlNumber;
 
-                IMidiMsg msg;
+                // MIDI messages carry their own offsets, so every point is sent: only the last one goes to the editor
+                for (int32 pointIdx = 0; pointIdx < numPoints; pointIdx++)
+                {
+                  int32 pointOffset;
+                  double pointValue;
 
-                if (ctrlr == kAfterTouch)
-                  msg.MakeChannelATMsg((int) (value * 127.), offsetSamples, channel);
-                else if (ctrlr == kPitchBend)
-                  msg.MakePitchWheelMsg((value * 2.)-1., channel, offsetSamples);
-                else
-                  msg.MakeControlChangeMsg((IMidiMsg::EControlChangeMsg) ctrlr, value, channel, offsetSamples);
+                  if (paramQueue->getPoint(pointIdx, pointOffset, pointValue) != kResultTrue)
+                    continue;
+
+                  IMidiMsg msg;
 
-                fromProcessor.Push(msg);
-                ProcessMidiMsg(msg);
+                  if (ctrlr == kAfterTouch)
+                    msg.MakeChannelATMsg((int) (pointValue * 127.), pointOffset, channel);
+                  else if (ctrlr == kPitchBend)
+                    msg.MakePitchWheelMsg((pointValue * 2.)-1., channel, pointOffset);
+                  else
+                    msg.MakeControlChangeMsg((IMidiMsg::EControlChangeMsg) ctrlr, pointValue, channel, pointOffset);
+
+                  if (pointIdx == numPoints - 1)
+                    fromProcessor.Push(msg);
+
+                  ProcessMidiMsg(msg);
+                }
               }
             }
               break;
@@ -345,6 +397,99 @@ void IPlugVST3ProcessorBase::ProcessParameterChanges(ProcessData& data, IPlugQue
       }
     }
   }
+
+  SortSampleAccurateParamChanges();
+}
+
+void IPlugVST3ProcessorBase::SetParamFromHost(int idx, double value, int sampleOffset)
+{
+#ifdef PARAMS_MUTEX
+  mPlug.mParams_mutex.Enter();
+#endif
+  mPlug.GetParam(idx)->SetNormalized(value);
+
+  // In VST3 non distributed the same parameter value is also set via IPlugVST3Controller::setParamNormalized(ParamID tag, ParamValue value)
+  mPlug.OnParamChange(idx, kHost, sampleOffset);
+#ifdef PARAMS_MUTEX
+  mPlug.mParams_mutex.Leave();
+#endif
+}
+
+void IPlugVST3ProcessorBase::AddSampleAccurateParamChange(int idx, double value, int sampleOffset)
+{
+  // If there is no room left then apply the change straight away rather than allocate on the audio thread
+  if (mParamChanges.size() >= kMaxSampleAccurateParamChanges)
+  {
+    SetParamFromHost(idx, value, sampleOffset);
+    return;
+  }
+
+  // The list is sorted once all the changes for the block are in, see SortSampleAccurateParamChanges()
+  mParamChanges.push_back({ std::max(sampleOffset, 0), (int) mParamChanges.size(), idx, value });
+}
+
+void IPlugVST3ProcessorBase::SortSampleAccurateParamChanges()
+{
+  // Sort by offset: changes at the same offset stay in the order the host gave them.
+  // std::sort() is used with the arrival order as a tie break, rather than std::stable_sort(), since it never allocates.
+  std::sort(mParamChanges.begin(), mParamChanges.end(), [](const ParamChange& a, const ParamChange& b) {
+    return (a.mOffset != b.mOffset) ? (a.mOffset < b.mOffset) : (a.mOrder < b.mOrder);
+  });
+}
+
+void IPlugVST3ProcessorBase::ApplySampleAccurateParamChanges(int endFrame)
+{
+  while ((mNextParamChangeIdx < mParamChanges.size()) && (mParamChanges[mNextParamChangeIdx].mOffset < endFrame))
+  {
+    const ParamChange& change = mParamChanges[mNextParamChangeIdx++];
+    SetParamFromHost(change.mParamIdx, change.mValue, change.mOffset);
+  }
+}
+
+template <typename T>
+void IPlugVST3ProcessorBase::ProcessSubBlocks(T sampleType, int nFrames)
+{
+  // Render up to each sample accurate parameter change, then apply it and carry on: with no changes this is a single call to ProcessBuffers()
+  const ITimeInfo blockTimeInfo = mTimeInfo;
+  int startFrame = 0;
+  ApplySampleAccurateParamChanges(1);
+
+  while (startFrame < nFrames)
+  {
+    int endFrame = nFrames;
+
+    if (mNextParamChangeIdx < mParamChanges.size())
+      endFrame = std::min(std::max(mParamChanges[mNextParamChangeIdx].mOffset, startFrame + 1), nFrames);
+
+    // Each sub-block sees the transport position at it's own start, rather than the start of the whole block
+    if (startFrame > 0)
+      SetSubBlockTimeInfo(blockTimeInfo, startFrame);
+
+    SetSubBlockFramesRemaining(nFrames - endFrame);
+    ProcessBuffers(sampleType, endFrame - startFrame, startFrame);
+    startFrame = endFrame;
+    ApplySampleAccurateParamChanges(startFrame + 1);
+  }
+
+  SetSubBlockFramesRemaining(0);
+
+  // Changes past the end of the block (which the host shouldn't send) still take effect
+  ApplySampleAccurateParamChanges(INT_MAX);
+  SetTimeInfo(blockTimeInfo);
+}
+
+void IPlugVST3ProcessorBase::SetSubBlockTimeInfo(const ITimeInfo& blockTimeInfo, int startFrame)
+{
+  // Only positions the host gave are advanced: the bar position and loop points don't move within a block
+  ITimeInfo timeInfo = blockTimeInfo;
+
+  if (timeInfo.mSamplePos >= 0.0)
+    timeInfo.mSamplePos += startFrame;
+
+  if ((mProcessContext.state & ProcessContext::kProjectTimeMusicValid) && (timeInfo.mTempo > 0.0) && (GetSampleRate() > 0.0))
+    timeInfo.mPPQPos += startFrame * timeInfo.mTempo / (60.0 * GetSampleRate());
+
+  SetTimeInfo(timeInfo);
 }
 
 void IPlugVST3ProcessorBase::ProcessAudio(ProcessData& data, ProcessSetup& setup, const BusList& ins, const BusList& outs)
@@ -411,14 +556,18 @@ void IPlugVST3ProcessorBase::ProcessAudio(ProcessData& data, ProcessSetup& setup
       mPlug.mParams_mutex.Enter();
 #endif
       if (sampleSize == kSample32)
-        ProcessBuffers(0.f, data.numSamples); // single precision
+        ProcessSubBlocks(0.f, data.numSamples); // single precision
       else
-        ProcessBuffers(0.0, data.numSamples); // double precision
+        ProcessSubBlocks(0.0, data.numSamples); // double precision
 #ifdef PARAMS_MUTEX
       mPlug.mParams_mutex.Leave();
 #endif
     }
   }
+
+  // When bypassed (or with no audio to process) any sample accurate changes left are applied at once, so none are lost
+  ApplySampleAccurateParamChanges(INT_MAX);
+  mParamChanges.clear();
 }
 
 void IPlugVST3ProcessorBase::Process(ProcessData& data, ProcessSetup& setup, const BusList& ins, const BusList& outs, IPlugQueue<IMidiMsg>& fromEditor, IPlugQueue<IMidiMsg>& fromProcessor, IPlugQueue<SysExData>& sysExFromEditor, SysExData& sysExBuf)
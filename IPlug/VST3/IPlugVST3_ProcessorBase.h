@@ -186,11 +186,32 @@ public:
   bool SendMidiMsg(const IMidiMsg& msg) override;
 
 private:
+  /** A point of host automation for a parameter with IParam::kFlagSampleAccurate, to be applied part way through the block */
+  struct ParamChange
+  {
+    int mOffset;
+    int mOrder; // The order the host gave the change in, which breaks ties between changes at the same offset
+    int mParamIdx;
+    double mValue;
+  };
+
+  /** How many sample accurate parameter changes can be held for a single block: any more are applied at the start of the block */
+  static constexpr size_t kMaxSampleAccurateParamChanges = 4096;
+
+  void SetParamFromHost(int idx, double value, int sampleOffset);
+  void AddSampleAccurateParamChange(int idx, double value, int sampleOffset);
+  void SortSampleAccurateParamChanges();
+  void ApplySampleAccurateParamChanges(int endFrame);
+  template <typename T> void ProcessSubBlocks(T sampleType, int nFrames);
+  void SetSubBlockTimeInfo(const ITimeInfo& blockTimeInfo, int startFrame);
+
   int mMaxNChansForMainInputBus = 0;
   IPlugAPIBase& mPlug;
   Steinberg::Vst::ProcessContext mProcessContext;
   IMidiQueue mMidiOutputQueue;
   bool mSidechainActive = false;
+  std::vector<ParamChange> mParamChanges; // Sample accurate parameter changes for the current block, sorted by offset
+  size_t mNextParamChangeIdx = 0; // The next entry in mParamChanges to be applied
 };
 
 END_IPLUG_NAMESPACE
@@ -3,9 +3,26 @@
 #include "IControls.h"
 #include "IPlug_include_in_plug_src.h"
 #include "SpuReverbPresets.h"
+#include "../../PluginsCommon/SampleConvert.h"
+
+#include <type_traits>
 
 static constexpr int        kNumPresets = 10;           // How many reverb presets there are
 static constexpr uint32_t   kSpuRamSize = 512 * 1024;   // SPU RAM size: this is the size that the PS1 had
+static constexpr int        kSpuBlockSize = 256;        // Maximum number of frames to process with the SPU at a time
+static constexpr uint32_t   kReverbClearBytesPerFrame = 512;    // How many bytes of reverb memory to clear per frame while the reverb is silenced
+static constexpr uint32_t   kReverbFadeFrames = 128;            // How many frames to fade the reverb out over before a work area clear, and back in after
+static constexpr uint32_t   kReverbFadeStepFrames = 16;         // The reverb volume is changed in steps of this many frames while fading
+
+// How many SPU steps to do for each output sample.
+// Now with hackish approximation of SPU2's internal 192kHz reverb clock (when main output is 48kHz): we mainly care about the firstmost
+// sample generated, the 2nd step should start to generate reverb and the 4th step will also contain the latest reverb sample to be interpolated.
+// TODO: Reimplement and default to SPU1's behavior as togglable or something
+#if SPU2_REVERB_RATE
+    static constexpr uint32_t kSpuStepsPerFrame = 4;
+#else
+    static constexpr uint32_t kSpuStepsPerFrame = 1;
+#endif
 
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Initializes the reverb plugin
@@ -15,7 +32,12 @@ PsxReverb::PsxReverb(const InstanceInfo& info) noexcept
 #if IPLUG_DSP
     , mSpu()
     , mSpuMutex()
-    , mSpuInputSample()
+    , mReverbClearPos(0)
+    , mReverbClearEnd(0)
+    , mReverbFadeLevel(kReverbFadeFrames)
+    , mbReverbRegsPending(false)
+    , mTelemetry()
+    , mTelemetrySender()
 #endif
 {
     DefinePluginParams();
@@ -35,85 +57,121 @@ PsxReverb::PsxReverb(const InstanceInfo& info) noexcept
 //------------------------------------------------------------------------------------------------------------------------------------------
 PsxReverb::~PsxReverb() noexcept {
     Spu::destroyCore(mSpu);
-    mSpuInputSample = {};
 }
 
 #if IPLUG_DSP
 
-#if !SIMPLE_SPU_FLOAT_SPU
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Convert a sample in double format to 16-bit
+// Convert blocks of samples in the host format (float or double, depending on 'SAMPLE_TYPE_FLOAT') to stereo frames in the sample format
+// used by the SPU, and back again. If there is no right channel to output to then only the left channel is output.
 //------------------------------------------------------------------------------------------------------------------------------------------
-static int16_t sampleDoubleToInt16(const double origSample) noexcept {
-  const double origClamped = std::clamp(origSample, -1.0, 1.0);
-  return (origClamped < 0) ? (int16_t)(-origClamped * double(INT16_MIN)) : (int16_t)(origClamped * double(INT16_MAX));
+template <class SampleT, class HostSampleT>
+static void samplesHostToSpu(
+    const HostSampleT* const pInL,
+    const HostSampleT* const pInR,
+    Spu::StereoSample<SampleT>* const pOutput,
+    const uint32_t numFrames
+) noexcept {
+    static_assert(sizeof(Spu::StereoSample<SampleT>) == sizeof(SampleT::value) * 2);
+    constexpr bool bHostFloat = std::is_same_v<HostSampleT, float>;
+
+    if constexpr (SampleT::IS_FLOAT) {
+        if constexpr (bHostFloat) {
+            SampleConvert::stereoInterleaveFloat(pInL, pInR, (float*) pOutput, numFrames);
+        } else {
+            SampleConvert::stereoDoubleToFloat(pInL, pInR, (float*) pOutput, numFrames);
+        }
+    } else {
+        if constexpr (bHostFloat) {
+            SampleConvert::stereoFloatToInt16(pInL, pInR, (int16_t*) pOutput, numFrames);
+        } else {
+            SampleConvert::stereoDoubleToInt16(pInL, pInR, (int16_t*) pOutput, numFrames);
+        }
+    }
 }
 
-//------------------------------------------------------------------------------------------------------------------------------------------
-// Convert a sample in 16-bit format to a floating point sample
-//------------------------------------------------------------------------------------------------------------------------------------------
-static double sampleInt16ToDouble(const int16_t origSample) noexcept {
-  return (origSample < 0) ? -double(origSample) / double(INT16_MIN) : double(origSample) / double(INT16_MAX);
+template <class SampleT, class HostSampleT>
+static void samplesSpuToHost(
+    const Spu::StereoSample<SampleT>* const pInput,
+    HostSampleT* const pOutL,
+    HostSampleT* const pOutR,
+    const uint32_t numFrames
+) noexcept {
+    static_assert(sizeof(Spu::StereoSample<SampleT>) == sizeof(SampleT::value) * 2);
+    constexpr bool bHostFloat = std::is_same_v<HostSampleT, float>;
+
+    if constexpr (SampleT::IS_FLOAT) {
+        if constexpr (bHostFloat) {
+            SampleConvert::stereoDeinterleaveFloat((const float*) pInput, pOutL, pOutR, numFrames);
+        } else {
+            SampleConvert::stereoFloatToDouble((const float*) pInput, pOutL, pOutR, numFrames);
+        }
+    } else {
+        if constexpr (bHostFloat) {
+            SampleConvert::stereoInt16ToFloat((const int16_t*) pInput, pOutL, pOutR, numFrames);
+        } else {
+            SampleConvert::stereoInt16ToDouble((const int16_t*) pInput, pOutL, pOutR, numFrames);
+        }
+    }
 }
-#endif
 
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Does the work of the reverb effect plugin
 //------------------------------------------------------------------------------------------------------------------------------------------
 void PsxReverb::ProcessBlock(sample** pInputs, sample** pOutputs, int numFrames) noexcept {
+    // Time the whole block, including any wait for the SPU lock
+    const DspTelemetry::Clock::time_point blockStartTime = mTelemetry.beginBlock();
     std::lock_guard<std::recursive_mutex> lockSpu(mSpuMutex);
+    const uint32_t startSpuCycleCount = mSpu.cycleCount;
 
-    // Process the requested number of samples
+    // Process the requested number of samples in blocks, running just the reverb part of the SPU
     const int numChannels = NOutChansConnected();
-    
-    for (int frameIdx = 0; frameIdx < numFrames; frameIdx++) {
-        // Setup the SPU input sample
+    SpuStereoSample spuInput[kSpuBlockSize];
+    SpuStereoSample spuOutput[kSpuBlockSize];
+
+    for (int blockStartIdx = 0; blockStartIdx < numFrames; blockStartIdx += kSpuBlockSize) {
+        const int blockSize = std::min(numFrames - blockStartIdx, kSpuBlockSize);
+
+        // Setup the SPU input samples: mono input is fed to both SPU channels
         if (numChannels >= 2) {
-            #if SIMPLE_SPU_FLOAT_SPU
-                mSpuInputSample.left = (float) pInputs[0][frameIdx];
-                mSpuInputSample.right = (float) pInputs[1][frameIdx];
-            #else
-                mSpuInputSample.left = sampleDoubleToInt16(pInputs[0][frameIdx]);
-                mSpuInputSample.right = sampleDoubleToInt16(pInputs[1][frameIdx]);
-            #endif
+            samplesHostToSpu(pInputs[0] + blockStartIdx, pInputs[1] + blockStartIdx, spuInput, (uint32_t) blockSize);
         } else if (numChannels == 1) {
-            #if SIMPLE_SPU_FLOAT_SPU
-                mSpuInputSample.left = (float) pInputs[0][frameIdx];
-                mSpuInputSample.right = (float) pInputs[0][frameIdx];
-            #else
-                mSpuInputSample.left = sampleDoubleToInt16(pInputs[0][frameIdx]);
-                mSpuInputSample.right = sampleDoubleToInt16(pInputs[0][frameIdx]);
-          #endif
+            samplesHostToSpu(pInputs[0] + blockStartIdx, pInputs[0] + blockStartIdx, spuInput, (uint32_t) blockSize);
         } else {
-            mSpuInputSample = {};
+            std::fill_n(spuInput, blockSize, SpuStereoSample{});
         }
 
-        // Run the SPU and grab the output sample and save
-        // Now with hackish approximation of SPU2's internal 192kHz reverb clock (when main output is 48kHz)
-        // TODO: Reimplement and default to SPU1's behavior as togglable or something
-        const Spu::StereoSample soundOut = Spu::stepCore(mSpu); // We mainly care about the firstmost sample generated.
-#if SPU2_REVERB_RATE
-        Spu::stepCore(mSpu); // 2nd step, should start to generate reverb
-        Spu::stepCore(mSpu); // 3rd step
-        Spu::stepCore(mSpu); // 4th step, will also contain the latest reverb sample to be interpolated
-#endif
+        // Run the SPU reverb and save the output.
+        // If the reverb work area is being cleared, or the reverb is fading out before or back in after a clear, then that is done too.
+        if (IsClearingReverbWorkArea() || mbReverbRegsPending || (mReverbFadeLevel < kReverbFadeFrames)) {
+            ProcessReverbBlockWithClear(spuInput, spuOutput, (uint32_t) blockSize);
+        } else {
+            Spu::processReverbBlock(mSpu, spuInput, spuOutput, (uint32_t) blockSize, kSpuStepsPerFrame);
+        }
 
+        // Output the SPU samples: only the left channel is used for mono output
         if (numChannels >= 2) {
-            #if SIMPLE_SPU_FLOAT_SPU
-                pOutputs[0][frameIdx] = soundOut.left;
-                pOutputs[1][frameIdx] = soundOut.right;
-            #else
-                pOutputs[0][frameIdx] = sampleInt16ToDouble(soundOut.left);
-                pOutputs[1][frameIdx] = sampleInt16ToDouble(soundOut.right);
-            #endif
+            samplesSpuToHost(spuOutput, pOutputs[0] + blockStartIdx, pOutputs[1] + blockStartIdx, (uint32_t) blockSize);
         } else if (numChannels == 1) {
-            #if SIMPLE_SPU_FLOAT_SPU
-                pOutputs[0][frameIdx] = soundOut.left;
-            #else
-                pOutputs[0][frameIdx] = sampleInt16ToDouble(soundOut.left);
-            #endif
+            samplesSpuToHost(spuOutput, pOutputs[0] + blockStartIdx, (sample*) nullptr, (uint32_t) blockSize);
         }
     }
+
+    // Send the telemetry for the block to the UI, once a window of telemetry has been gathered
+    DspTelemetry::BlockCounters telemetryCounters = {};
+    telemetryCounters.numReverbTicks = DspTelemetry::countReverbTicks(startSpuCycleCount, mSpu.cycleCount);
+    DspTelemetryControl::SenderData telemetry(kCtrlTagTelemetry, 1, 0);
+
+    if (mTelemetry.endBlock(blockStartTime, (uint32_t) numFrames, GetSampleRate(), telemetryCounters, telemetry.vals[0])) {
+        mTelemetrySender.PushData(telemetry);
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Called periodically to do GUI updates
+//------------------------------------------------------------------------------------------------------------------------------------------
+void PsxReverb::OnIdle() noexcept {
+    mTelemetrySender.TransmitData(*this);
 }
 
 #endif  // #if IPLUG_DSP
@@ -316,6 +374,19 @@ void PsxReverb::DoEditorSetup() noexcept {
         addHSlider(kAddrRDiff1, "DSR R-Addr 1",   595, 420, 130, 40);   addTInput(kAddrRDiff1,  730, 440, 45, 20);
         addHSlider(kAddrLDiff2, "DSR L-Addr 2",   595, 460, 130, 40);   addTInput(kAddrLDiff2,  730, 480, 45, 20);
         addHSlider(kAddrRDiff2, "DSR R-Addr 2",   595, 500, 130, 40);   addTInput(kAddrRDiff2,  730, 520, 45, 20);
+
+        pGraphics->AttachControl(
+            new DspTelemetryControl(
+                IRECT(10, 550, 790, 584),
+                DspTelemetryControl::Labels{ nullptr, "Reverb ticks", nullptr },
+                [this]() noexcept {
+                    #if IPLUG_DSP
+                        mTelemetry.requestReset();
+                    #endif
+                }
+            ),
+            kCtrlTagTelemetry
+        );
     };
 }
 
@@ -323,15 +394,6 @@ void PsxReverb::DoEditorSetup() noexcept {
 
 #if IPLUG_DSP
 
-//------------------------------------------------------------------------------------------------------------------------------------------
-// Called by the SPU emulation to retrieve an input sample.
-// Returns a sample that was passed as input to the reverb effect.
-//------------------------------------------------------------------------------------------------------------------------------------------
-Spu::StereoSample PsxReverb::SpuWantsASampleCallback(void* pUserData) noexcept {
-    PsxReverb& reverbPlugin = *(PsxReverb*) pUserData;
-    return reverbPlugin.mSpuInputSample;
-}
-
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Setup DSP related stuff
 //------------------------------------------------------------------------------------------------------------------------------------------
@@ -358,9 +420,9 @@ void PsxReverb::DoDspSetup() noexcept {
     mSpu.processedReverb = {};
     mSpu.reverbRegs = {};
 
-    // This is how we will feed samples into the SPU which were fed to the this plugin
-    mSpu.pExtInputCallback = SpuWantsASampleCallback;
-    mSpu.pExtInputUserData = this;
+    // Note: no external input callback is needed, samples fed to this plugin are given directly to the SPU's reverb processing
+    mSpu.pExtInputCallback = nullptr;
+    mSpu.pExtInputUserData = nullptr;
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
@@ -368,11 +430,14 @@ void PsxReverb::DoDspSetup() noexcept {
 //------------------------------------------------------------------------------------------------------------------------------------------
 void PsxReverb::InformHostOfParamChange([[maybe_unused]] int idx, [[maybe_unused]] double normalizedValue) noexcept {
     std::lock_guard<std::recursive_mutex> lockSpu(mSpuMutex);
-    UpdateSpuRegistersFromParams();
 
-    // If changing the work area base address then clear it
+    // If changing the work area base address then the new registers only take effect once the old reverb has faded out, just before the
+    // new work area is cleared. Other changes apply immediately, unless they are waiting on such a clear already.
     if (idx == kWABaseAddr) {
+        mbReverbRegsPending = true;
         ClearReverbWorkArea();
+    } else if (!mbReverbRegsPending) {
+        UpdateSpuRegistersFromParams();
     }
 }
 
@@ -382,9 +447,9 @@ void PsxReverb::InformHostOfParamChange([[maybe_unused]] int idx, [[maybe_unused
 void PsxReverb::OnRestoreState() noexcept {
     Plugin::OnRestoreState();
 
-    // Note when switching patches stop the current reverb effect...
+    // Note when switching patches stop the current reverb effect: the new registers are applied once it has faded out
     std::lock_guard<std::recursive_mutex> lockSpu(mSpuMutex);
-    UpdateSpuRegistersFromParams();
+    mbReverbRegsPending = true;
     ClearReverbWorkArea();
 }
 
@@ -434,18 +499,94 @@ void PsxReverb::UpdateSpuRegistersFromParams() noexcept {
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Clears the work area for the current reverb effect, effectively silencing the current reverb
+// Starts clearing the work area for the current reverb effect, effectively silencing the current reverb.
+// The clear is done a bit at a time by 'ProcessBlock' so that the audio thread is never stalled by clearing a large amount of memory at once:
+// the reverb is faded out first, stays silent until the clear is done and is then faded back in. If a clear is already in progress then
+// it is restarted.
 //------------------------------------------------------------------------------------------------------------------------------------------
 void PsxReverb::ClearReverbWorkArea() noexcept {
-    #if SIMPLE_SPU_FLOAT_SPU
+    if constexpr (SpuSample::IS_FLOAT) {
         // Float mode is given it's own reverb memory so we just clear that
-        std::memset(mSpu.pReverbRam, 0, mSpu.numReverbRamSamples * sizeof(float));
-    #else
+        mReverbClearPos = 0;
+        mReverbClearEnd = mSpu.numReverbRamSamples * sizeof(float);
+    } else {
         // Properly clear out ONLY the reverb work area of SPU RAM
-        uint32_t reverbBaseAddr = mSpu.reverbBaseAddr8 * 8;
-        uint32_t reverbClearSize = kSpuRamSize - reverbBaseAddr;
-        memset(mSpu.pRam + reverbBaseAddr, 0, reverbClearSize);
-    #endif
+        mReverbClearPos = std::min<uint32_t>(mSpu.reverbBaseAddr8 * 8, kSpuRamSize);
+        mReverbClearEnd = kSpuRamSize;
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Tells if the reverb work area is still being cleared
+//------------------------------------------------------------------------------------------------------------------------------------------
+bool PsxReverb::IsClearingReverbWorkArea() const noexcept {
+    return (mReverbClearPos < mReverbClearEnd);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Clears up to the given number of bytes of the reverb work area, if a clear is in progress.
+// When the clear finishes any reverb output computed from the old work area contents is also discarded.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void PsxReverb::StepReverbWorkAreaClear(const uint32_t maxClearSize) noexcept {
+    if (!IsClearingReverbWorkArea())
+        return;
+
+    std::byte* const pReverbMem = (SpuSample::IS_FLOAT) ? (std::byte*) mSpu.pReverbRam : mSpu.pRam;
+    const uint32_t clearSize = std::min(mReverbClearEnd - mReverbClearPos, maxClearSize);
+    std::memset(pReverbMem + mReverbClearPos, 0, clearSize);
+    mReverbClearPos += clearSize;
+
+    if (!IsClearingReverbWorkArea()) {
+        mSpu.processedReverb = {};
+        std::fill(std::begin(mSpu.reverbUpsampleBuffer), std::end(mSpu.reverbUpsampleBuffer), SpuStereoSample{});
+    }
+}
+
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Runs the SPU reverb for a block of frames while a work area clear is in progress or the reverb is fading back in after one.
+// The reverb volume is ramped down before the clear starts so the old reverb tail doesn't cut off abruptly, then any pending register
+// changes are applied and the reverb is kept silent and not allowed to write to the work area while it's cleared, and finally the volume
+// is ramped back up again.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void PsxReverb::ProcessReverbBlockWithClear(
+    const SpuStereoSample* const pInput,
+    SpuStereoSample* const pOutput,
+    const uint32_t numFrames
+) noexcept {
+    Spu::Volume reverbVol = mSpu.reverbVol;
+    const bool bReverbWriteEnable = mSpu.bReverbWriteEnable;
+
+    for (uint32_t frameIdx = 0; frameIdx < numFrames; frameIdx += kReverbFadeStepFrames) {
+        const uint32_t stepSize = std::min(numFrames - frameIdx, kReverbFadeStepFrames);
+
+        // Once faded out apply any new registers, and restart the clear in case the work area moved
+        if (mbReverbRegsPending && (mReverbFadeLevel == 0)) {
+            UpdateSpuRegistersFromParams();
+            reverbVol = mSpu.reverbVol;
+            mbReverbRegsPending = false;
+            ClearReverbWorkArea();
+        }
+
+        const bool bClearing = (IsClearingReverbWorkArea() && (mReverbFadeLevel == 0));
+
+        mSpu.reverbVol.left = (int16_t)((int32_t) reverbVol.left * (int32_t) mReverbFadeLevel / (int32_t) kReverbFadeFrames);
+        mSpu.reverbVol.right = (int16_t)((int32_t) reverbVol.right * (int32_t) mReverbFadeLevel / (int32_t) kReverbFadeFrames);
+        mSpu.bReverbWriteEnable = (bReverbWriteEnable && (!bClearing));
+        Spu::processReverbBlock(mSpu, pInput + frameIdx, pOutput + frameIdx, stepSize, kSpuStepsPerFrame);
+
+        // Fade out until silent, then clear, then fade back in
+        if (bClearing) {
+            StepReverbWorkAreaClear(stepSize * kReverbClearBytesPerFrame);
+        } else if (IsClearingReverbWorkArea() || mbReverbRegsPending) {
+            mReverbFadeLevel -= std::min(mReverbFadeLevel, stepSize);
+        } else {
+            mReverbFadeLevel = std::min(mReverbFadeLevel + stepSize, kReverbFadeFrames);
+        }
+    }
+
+    mSpu.reverbVol = reverbVol;
+    mSpu.bReverbWriteEnable = bReverbWriteEnable;
 }
 
 #endif  // #if IPLUG_DSP
@@ -2,6 +2,7 @@
 
 #include "IPlug_include_in_plug_hdr.h"
 
+#include "../../PluginsCommon/DspTelemetryControl.h"
 #include "../../PluginsCommon/Spu.h"
 #include <mutex>
 
@@ -55,6 +56,14 @@ enum EParams : uint32_t {
     kNumParams
 };
 
+//------------------------------------------------------------------------------------------------------------------------------------------
+// UI control identifiers
+//------------------------------------------------------------------------------------------------------------------------------------------
+enum EControlTags : uint32_t {
+    kCtrlTagTelemetry = 0,
+    kNumCtrlTags
+};
+
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Logic for the PlayStation 1 reverb plugin
 //------------------------------------------------------------------------------------------------------------------------------------------
@@ -65,13 +74,24 @@ public:
 
     #if IPLUG_DSP
         void ProcessBlock(sample** pInputs, sample** pOutputs, int numFrames) noexcept override;
+        void OnIdle() noexcept override;
     #endif
 
 private:
     #if IPLUG_DSP
-        Spu::Core               mSpu;
-        std::recursive_mutex    mSpuMutex;
-        Spu::StereoSample       mSpuInputSample;
+        // The type of SPU used by the reverb: authentic 16-bit integer samples, just like the original hardware
+        typedef Spu::Int16Sample                SpuSample;
+        typedef Spu::StereoSample<SpuSample>    SpuStereoSample;
+        typedef Spu::Core<SpuSample>            SpuCore;
+
+        SpuCore                        mSpu;
+        std::recursive_mutex           mSpuMutex;
+        uint32_t                       mReverbClearPos;     // Next byte of reverb memory to clear, if a work area clear is in progress
+        uint32_t                       mReverbClearEnd;     // End of the reverb memory being cleared: no clear is in progress if it's the same as the position
+        uint32_t                       mReverbFadeLevel;    // How far faded in the reverb is around a work area clear, in frames: fully faded in at 'kReverbFadeFrames'
+        bool                           mbReverbRegsPending; // If set then the parameters are applied to the SPU registers once the reverb has faded out for a clear
+        DspTelemetry                   mTelemetry;          // Measures the cost of processing each block: audio thread only, apart from resets
+        DspTelemetryControl::Sender    mTelemetrySender;    // Sends the telemetry statistics to the UI
     #endif
 
     void DefinePluginParams() noexcept;
@@ -82,11 +102,13 @@ private:
     #endif
 
     #if IPLUG_DSP
-        static Spu::StereoSample SpuWantsASampleCallback(void* pUserData) noexcept;
         void DoDspSetup() noexcept;
         virtual void InformHostOfParamChange(int idx, double normalizedValue) noexcept override;
         virtual void OnRestoreState() noexcept override;
         void UpdateSpuRegistersFromParams() noexcept;
         void ClearReverbWorkArea() noexcept;
+        bool IsClearingReverbWorkArea() const noexcept;
+        void StepReverbWorkAreaClear(const uint32_t maxClearSize) noexcept;
+        void ProcessReverbBlockWithClear(const SpuStereoSample* const pInput, SpuStereoSample* const pOutput, const uint32_t numFrames) noexcept;
     #endif
 };
@@ -1,149 +1,43 @@
 #include "PsxSampler.h"
 
+#include "../PluginsCommon/BlobCache.h"
 #include "../PluginsCommon/FileUtils.h"
+#include "../PluginsCommon/Finally.h"
 #include "../PluginsCommon/JsonUtils.h"
+#include "../PluginsCommon/PcmFileUtils.h"
+#include "../PluginsCommon/SampleConvert.h"
 #include "../PluginsCommon/VagUtils.h"
 #include "IPlug_include_in_plug_src.h"
 
+#define WDL_DENORMAL_WANTS_SCOPED_FTZ
+#include "denormal.h"
+
+#include <algorithm>
 #include <cstdio>
 #include <cassert>
+#include <functional>
+#include <type_traits>
 #include <rapidjson/filewritestream.h>
 #include <rapidjson/prettywriter.h>
 
 using namespace AudioTools;
 
 static constexpr uint32_t   kSpuRamSize         = 512 * 1024;   // SPU RAM size: this is the size that the PS1 had
+static constexpr int        kSpuBlockSize       = 256;          // Maximum number of frames of SPU output to convert at a time
 static constexpr int        kNumPresets         = 1;            // Not doing any actual presets for this instrument
-static constexpr int32_t    PITCH_BEND_CENTER   = 0x2000u;      // Pitch bend center value
-static constexpr int32_t    PITCH_BEND_MAX      = 0x3FFFu;      // Maximum pitch bend value
-
-//------------------------------------------------------------------------------------------------------------------------------------------
-// --- COPIED FROM PSYDOOM ---
-// 
-// This table defines the sample rates for an entire octave of notes (12 semitones) in 1/16 semitone steps.
-// The first note in the octave plays at 44,100 Hz (0x1000) and the last note (the start of the next octave) at 88,200 Hz (0x2000).
-// The sample rates are in the scale/format used by the PlayStation SPU.
-// This table is used by 'LIBSPU__spu_note2pitch' to figure out the sample rate for a note to be played.
-// The sample rates are scaled appropriately depending on the octave of the note to play.
-//------------------------------------------------------------------------------------------------------------------------------------------
-static const uint16_t OCTAVE_SAMPLE_RATES[] = {
-    0x1000, 0x100E, 0x101D, 0x102C, 0x103B, 0x104A, 0x1059, 0x1068,     // C
-    0x1078, 0x1087, 0x1096, 0x10A5, 0x10B5, 0x10C4, 0x10D4, 0x10E3,
-    0x10F3, 0x1103, 0x1113, 0x1122, 0x1132, 0x1142, 0x1152, 0x1162,     // C#
-    0x1172, 0x1182, 0x1193, 0x11A3, 0x11B3, 0x11C4, 0x11D4, 0x11E5,
-    0x11F5, 0x1206, 0x1216, 0x1227, 0x1238, 0x1249, 0x125A, 0x126B,     // D
-    0x127C, 0x128D, 0x129E, 0x12AF, 0x12C1, 0x12D2, 0x12E3, 0x12F5,
-    0x1306, 0x1318, 0x132A, 0x133C, 0x134D, 0x135F, 0x1371, 0x1383,     // D#
-    0x1395, 0x13A7, 0x13BA, 0x13CC, 0x13DE, 0x13F1, 0x1403, 0x1416,
-    0x1428, 0x143B, 0x144E, 0x1460, 0x1473, 0x1486, 0x1499, 0x14AC,     // E
-    0x14BF, 0x14D3, 0x14E6, 0x14F9, 0x150D, 0x1520, 0x1534, 0x1547,
-    0x155B, 0x156F, 0x1583, 0x1597, 0x15AB, 0x15BF, 0x15D3, 0x15E7,     // F
-    0x15FB, 0x1610, 0x1624, 0x1638, 0x164D, 0x1662, 0x1676, 0x168B,
-    0x16A0, 0x16B5, 0x16CA, 0x16DF, 0x16F4, 0x170A, 0x171F, 0x1734,     // F#
-    0x174A, 0x175F, 0x1775, 0x178B, 0x17A1, 0x17B6, 0x17CC, 0x17E2,
-    0x17F9, 0x180F, 0x1825, 0x183B, 0x1852, 0x1868, 0x187F, 0x1896,     // G
-    0x18AC, 0x18C3, 0x18DA, 0x18F1, 0x1908, 0x191F, 0x1937, 0x194E,
-    0x1965, 0x197D, 0x1995, 0x19AC, 0x19C4, 0x19DC, 0x19F4, 0x1A0C,     // G#
-    0x1A24, 0x1A3C, 0x1A55, 0x1A6D, 0x1A85, 0x1A9E, 0x1AB7, 0x1ACF,
-    0x1AE8, 0x1B01, 0x1B1A, 0x1B33, 0x1B4C, 0x1B66, 0x1B7F, 0x1B98,     // A
-    0x1BB2, 0x1BCC, 0x1BE5, 0x1BFF, 0x1C19, 0x1C33, 0x1C4D, 0x1C67,
-    0x1C82, 0x1C9C, 0x1CB7, 0x1CD1, 0x1CEC, 0x1D07, 0x1D22, 0x1D3D,     // A#
-    0x1D58, 0x1D73, 0x1D8E, 0x1DA9, 0x1DC5, 0x1DE0, 0x1DFC, 0x1E18,
-    0x1E34, 0x1E50, 0x1E6C, 0x1E88, 0x1EA4, 0x1EC1, 0x1EDD, 0x1EFA,     // B
-    0x1F16, 0x1F33, 0x1F50, 0x1F6D, 0x1F8A, 0x1FA7, 0x1FC5, 0x1FE2,
-    0x2000,                                                             // C, Next octave
-};
-
-//------------------------------------------------------------------------------------------------------------------------------------------
-// --- COPIED FROM PSYDOOM ---
-// 
-// Internal LIBSPU function which converts a musical note to a frequency that can be set on a voice.
-// The returned integer frequency is such that 4,096 units = 44,100 Hz.
-//
-// Params:
-//  baseNote:       Note at which the frequency is considered 44,100 Hz.
-//                  For example '60' would be C5 (12 semitones per octave, 1st note of 5th octave).
-//  baseNoteFrac:   Fractional offset to 'baseNote' in 1/128 units.
-//  note:           The note to get the frequency for.
-//  noteFrac:       Fractional offset to 'note' in 1/128 units.
-//------------------------------------------------------------------------------------------------------------------------------------------
-uint16_t LIBSPU__spu_note2pitch(
-    const int32_t centerNote,
-    const uint16_t centerNoteFrac,
-    const int32_t offsetNote,
-    const uint16_t offsetNoteFrac
-) noexcept {
-    // Get the fractional component of the note (which may be a semitone or more).
-    // Once we have that drop 3 bits of precision to convert from 1/128 to 1/16 semitone steps, and wrap to a fraction.
-    const int32_t noteFracUnwrapped = offsetNoteFrac + centerNoteFrac;
-    const int32_t noteFrac = (noteFracUnwrapped >> 3) & 0xF;
-
-    // Compute the note to sound relative to the center/root note which plays at 44,100 Hz.
-    // Note: also need to account for fractional note parts that are >= 1 semitone.
-    const int32_t note = offsetNote - centerNote + noteFracUnwrapped / 128;
-
-    // Compute what octave is being sounded, relative to the center/root note and the index of the note in that octave.
-    const int32_t octave = (note < 0) ? (note - 11) / 12 : note / 12;
-    const int32_t octaveStartNote = octave * 12;
-    const int32_t noteInOctave = note - octaveStartNote;
-    assert((noteInOctave >= 0) && (noteInOctave <= 11));
-
-    // Using the octave relative note, and the fractional note component (1/16 semitone steps) compute the sample rate table lookup index
-    const uint32_t lutIndex = (noteInOctave << 4) | noteFrac;
-    assert((lutIndex >= 0) && (lutIndex < 12 * 16));
-    const uint16_t baseSampleRate = OCTAVE_SAMPLE_RATES[lutIndex];
-
-    // Scale the sample rate depending on how many octaves up or down we are from the one that starts at 44,100 Hz
-    if (octave > 0) {
-        return baseSampleRate << +octave;
-    } else if (octave < 0) {
-        return baseSampleRate >> -octave;
-    } else {
-        return baseSampleRate;
-    }
-}
-
-//------------------------------------------------------------------------------------------------------------------------------------------
-// Figures out the sample rate of a given note (specified in semitones) using a reference base note (in semitones).
-// Returns the sample rate in PlayStation SPU sample rate format, such that '4096' = 44100 Hz.
-// Uses the reimplementation of PsyQ SDK 'LIBSPU__spu_note2pitch' to perform the calculation, which would have been used by PSX games.
-// This method is less precise than 'GetNoteSampleRate' but sounds more accurate as to how samples are sounded in PlayStation games.
-//------------------------------------------------------------------------------------------------------------------------------------------
-static uint16_t GetNoteSpuSampleRate(const float baseNote, const float note) noexcept {
-    int32_t baseNoteInt = (int32_t) baseNote;
-    int32_t noteInt = (int32_t) note;
-    const uint16_t baseNoteFrac = (int32_t)(baseNote * 128.0f) & 0x7F;
-    const uint16_t noteFrac = (int32_t)(note * 128.0f) & 0x7F;
-
-    if (baseNote < 0) {
-        baseNoteInt--;
-    }
-
-    if (note < 0) {
-        noteInt--;
-    }
+static constexpr int        kMidiQueueSize      = 4096;         // How many MIDI messages can be queued: the queue never grows on the audio thread
 
-    return LIBSPU__spu_note2pitch(baseNoteInt, baseNoteFrac, noteInt, noteFrac);
-}
+// Saved state: the sample data following the parameters starts with this tag and a format version, followed by the uncompressed size,
+// the content hash, the compressed size and then the zlib compressed ADPCM data. Older versions of the plugin saved the raw ADPCM data
+// with no header instead. The tag can't be mistaken for the start of an ADPCM block since its second byte ('S') has unused flag bits set.
+static constexpr char       kStateSampleTag[4]  = { 'P', 'S', 'X', 'C' };
+static constexpr uint32_t   kStateSampleVersion = 1;
 
-//------------------------------------------------------------------------------------------------------------------------------------------
-// Figures out the sample rate of a given note (specified in semitones) using a reference base note (in semitones) and the sample
-// rate that the base note sounds at. This is similar to 'GetNoteSpuSampleRate' but more precise and not relying on lookup tables.
-//
-// For a good explantion of the conversion from note to frequency, see:
-//  https://www.translatorscafe.com/unit-converter/en-US/calculator/note-frequency/
-//------------------------------------------------------------------------------------------------------------------------------------------
-static float GetNoteSampleRate(const float baseNote, const float baseNoteSampleRate, const float note) noexcept {
-    const float noteOffset = note - baseNote;
-    const float sampleRate = baseNoteSampleRate * std::powf(2.0f, noteOffset / 12.0f);
-    return sampleRate;
-}
-
-static double GetNoteSampleRate(const double baseNote, const double baseNoteSampleRate, const double note) noexcept {
-    const double noteOffset = note - baseNote;
-    const double sampleRate = baseNoteSampleRate * std::pow(2.0, noteOffset / 12.0);
-    return sampleRate;
-}
+// Saved state: if a sound bank is loaded then this tag follows the sample data (if any), along with a format version, the bank program
+// in use for each of the 16 MIDI channels and the path to the bank file. The bank itself is not saved since it is reloaded from disk.
+// Version 1 of the format saved a single program, which was used by all MIDI channels.
+static constexpr char       kStateBankTag[4]    = { 'P', 'S', 'X', 'B' };
+static constexpr uint32_t   kStateBankVersion   = 2;
 
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Initializes the sampler instrument plugin
@@ -152,10 +46,32 @@ PsxSampler::PsxSampler(const InstanceInfo& info) noexcept
     : Plugin(info, MakeConfig(kNumParams, kNumPresets))
     , mSpu()
     , mSpuMutex()
-    , mCurMidiPitchBend(PITCH_BEND_CENTER)
-    , mVoiceInfos{}
+    , mEngine(mSpu)
+    , mDirtyParams(0)
+    , mSeqPlayer(mEngine)
+    , mSeqFramesToUpdate(0)
+    , mSeqIdx(0)
     , mMeterSender()
-    , mMidiQueue()
+    , mTelemetry()
+    , mTelemetryBlockStartTime()
+    , mTelemetryCounters()
+    , mTelemetryBlockFrames(0)
+    , mTelemetrySender()
+    , mMidiQueue(kMidiQueueSize)
+    , mImportThread()
+    , mImportResultMutex()
+    , mImportResult()
+    , mbHaveImportResult(false)
+    , mImportProgress(0)
+    , mbImportRefining(false)
+    , mbImportDone(false)
+    , mbCancelImport(false)
+    , mpPendingSpuRam(nullptr)
+    , mbPendingKeepVoices(false)
+    , mpRetiredSpuRam(nullptr)
+    , mpSavedSampleBlob()
+    , mpButton_LoadSample(nullptr)
+    , mpLabel_Song(nullptr)
     , mpCaption_SampleRate(nullptr)
     , mpCaption_BaseNote(nullptr)
     , mpKnob_Volume(nullptr)
@@ -187,13 +103,23 @@ PsxSampler::PsxSampler(const InstanceInfo& info) noexcept
 // Shuts down the sampler plugin
 //------------------------------------------------------------------------------------------------------------------------------------------
 PsxSampler::~PsxSampler() noexcept {
+    // Stop any sample import in progress and free any SPU RAM images that were not yet handed over
+    CancelSampleImport();
+    delete[] mImportResult.pSpuRam;
+    delete[] mpPendingSpuRam.exchange(nullptr);
+    delete[] mpRetiredSpuRam.exchange(nullptr);
+    mImportResult = {};
+    mbHaveImportResult = false;
+
+    // Note: unload any song and sound bank before the SPU core goes away, since stopping playback keys off voices
+    std::unique_ptr<SeqPlayer::Song> pOldSong;
+    std::unique_ptr<SamplerEngine::SampleBank> pOldBank;
+    mSeqPlayer.swapSong(pOldSong);
+    mEngine.swapSampleBank(pOldBank);
     Spu::destroyCore(mSpu);
-    mCurMidiPitchBend = {};
-
-    for (VoiceInfo& voiceInfo : mVoiceInfos) {
-        voiceInfo = {};
-    }
 
+    mpButton_LoadSample = nullptr;
+    mpLabel_Song = nullptr;
     mpCaption_SampleRate = nullptr;
     mpCaption_BaseNote = nullptr;
     mpKnob_Volume = nullptr;
@@ -217,48 +143,103 @@ PsxSampler::~PsxSampler() noexcept {
     mpSwitch_ReleaseIsExp = nullptr;
 }
 
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Convert a block of float SPU stereo frames to the host format (float or double, depending on 'SAMPLE_TYPE_FLOAT').
+// If there is no right channel to output to then only the left channel is output.
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <class HostSampleT>
+static void SamplesSpuToHost(const float* const pInLR, HostSampleT* const pOutL, HostSampleT* const pOutR, const uint32_t numFrames) noexcept {
+    if constexpr (std::is_same_v<HostSampleT, float>) {
+        SampleConvert::stereoDeinterleaveFloat(pInLR, pOutL, pOutR, numFrames);
+    } else {
+        SampleConvert::stereoFloatToDouble(pInLR, pOutL, pOutR, numFrames);
+    }
+}
+
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Does the main sound processing work of the sampler instrument
 //------------------------------------------------------------------------------------------------------------------------------------------
 void PsxSampler::ProcessBlock(sample** pInputs, sample** pOutputs, int numFrames) noexcept {
+    // Time the whole host block, including any wait for the SPU lock.
+    // Note: the host block may be split into several calls for sample accurate automation, the timing covers all of them.
+    if (mTelemetryBlockFrames == 0) {
+        mTelemetryBlockStartTime = mTelemetry.beginBlock();
+        mTelemetryCounters = {};
+        mTelemetryCounters.midiQueueDepth = (uint32_t) mMidiQueue.ToDo();
+    }
+
+    mTelemetryBlockFrames += (uint32_t) numFrames;
+
     // Process the requested number of samples on the SPU
     const int numChannels = NOutChansConnected();
 
     {
         std::lock_guard<std::recursive_mutex> lockSpu(mSpuMutex);
+        const uint32_t startSpuCycleCount = mSpu.cycleCount;
+
+        // Flush denormals to zero while running the float SPU: decaying reverb tails would otherwise make it very slow on x86
+        WDL_denormal_ftz_scope ftzScope;
+
+        // Pick up any newly imported sample and any parameter changes
+        SwapInPendingSpuRam();
+
+        // Note: the engine is given a snapshot of all the settings at most once per block, no matter how many parameters changed
+        if ((mDirtyParams.exchange(0) & kEngineParamsMask) != 0) {
+            UpdateEngineSettings();
+        }
 
-        for (int frameIdx = 0; frameIdx < numFrames; frameIdx++) {
-            // Process any incoming MIDI messages
-            ProcessMidiQueue();
+        // Run the SPU in blocks, converting each block of output to the host format in one go
+        SpuStereoSample spuOutput[kSpuBlockSize];
+        static_assert(sizeof(SpuStereoSample) == sizeof(float) * 2);
 
-            // Run the SPU and grab the output sample and save
-            const Spu::StereoSample soundOut = Spu::stepCore(mSpu);
+        for (int blockStartIdx = 0; blockStartIdx < numFrames; blockStartIdx += kSpuBlockSize) {
+            const int blockSize = std::min(numFrames - blockStartIdx, kSpuBlockSize);
+
+            for (int i = 0; i < blockSize; i++) {
+                // Process any incoming MIDI messages and any sequence events which are due
+                ProcessMidiQueue(blockStartIdx + i);
+
+                if (mSeqFramesToUpdate == 0) {
+                    mSeqFramesToUpdate = mSeqPlayer.update(kSpuBlockSize);
+                }
+
+                mSeqFramesToUpdate--;
+
+                // Run the SPU and grab the output sample
+                spuOutput[i] = Spu::stepCore(mSpu);
+            }
 
             if (numChannels >= 2) {
-                pOutputs[0][frameIdx] = soundOut.left;
-                pOutputs[1][frameIdx] = soundOut.right;
+                SamplesSpuToHost((const float*) spuOutput, pOutputs[0] + blockStartIdx, pOutputs[1] + blockStartIdx, (uint32_t) blockSize);
             } else if (numChannels == 1) {
-                pOutputs[0][frameIdx] = soundOut.left;
+                SamplesSpuToHost((const float*) spuOutput, pOutputs[0] + blockStartIdx, (sample*) nullptr, (uint32_t) blockSize);
             }
         }
-    }
 
-    // Voice management: update the number of samples certain voices are active for and reset the parameters for other voices.
-    // Could to this for each sample processed, but that is probably overkill...
-    for (uint32_t i = 0; i < kMaxVoices; ++i) {
-        VoiceInfo& voiceInfo = mVoiceInfos[i];
-        
-        if (mSpu.pVoices[i].envPhase != Spu::EnvPhase::Off) {
-            voiceInfo.numSamplesActive += (uint32_t) numFrames;
-        } else {
-            voiceInfo.midiNote = 0xFFFFu;
-            voiceInfo.midiVelocity = 0xFFFFu;
-            voiceInfo.numSamplesActive = 0;
-        }
+        // All messages due in this block have been processed: any left over are due in later blocks
+        mMidiQueue.Flush(numFrames);
+
+        // Voice management: update the number of samples certain voices are active for and reset the parameters for other voices.
+        // Could to this for each sample processed, but that is probably overkill...
+        mEngine.advanceVoices((uint32_t) numFrames);
+
+        mTelemetryCounters.numActiveVoices = mEngine.getNumActiveVoices();
+        mTelemetryCounters.numVoiceSteals = mEngine.getNumVoiceSteals();
+        mTelemetryCounters.numReverbTicks += DspTelemetry::countReverbTicks(startSpuCycleCount, mSpu.cycleCount);
     }
 
-    // Send the output to the meter
+    // Send the output to the meter and, at the end of the host block, the telemetry for it to the UI once a window of telemetry has been gathered
     mMeterSender.ProcessBlock(pOutputs, numFrames, kCtrlTagMeter);
+
+    if (GetSubBlockFramesRemaining() == 0) {
+        DspTelemetryControl::SenderData telemetry(kCtrlTagTelemetry, 1, 0);
+
+        if (mTelemetry.endBlock(mTelemetryBlockStartTime, mTelemetryBlockFrames, GetSampleRate(), mTelemetryCounters, telemetry.vals[0])) {
+            mTelemetrySender.PushData(telemetry);
+        }
+
+        mTelemetryBlockFrames = 0;
+    }
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
@@ -266,6 +247,16 @@ void PsxSampler::ProcessBlock(sample** pInputs, sample** pOutputs, int numFrames
 //------------------------------------------------------------------------------------------------------------------------------------------
 void PsxSampler::OnIdle() noexcept {
     mMeterSender.TransmitData(*this);
+    mTelemetrySender.TransmitData(*this);
+    UpdateSampleImport();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Called when the GUI is closed: forget about controls which are about to be destroyed
+//------------------------------------------------------------------------------------------------------------------------------------------
+void PsxSampler::OnUIClose() noexcept {
+    mpButton_LoadSample = nullptr;
+    mpLabel_Song = nullptr;
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
@@ -280,36 +271,219 @@ bool PsxSampler::SerializeState(IByteChunk& chunk) const noexcept {
     const uint32_t numAdpcmBlocks = (uint32_t) GetParam(kParamLengthInBlocks)->Value();
     const uint32_t numAdpcmBytes = numAdpcmBlocks * Spu::ADPCM_BLOCK_SIZE;
 
-    if (numAdpcmBytes > 0) {
+    if ((numAdpcmBytes > 0) && (!SerializeSampleData(chunk, numAdpcmBytes)))
+        return false;
+
+    // Serialize the sound bank in use, if any
+    return SerializeSampleBank(chunk);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Write the compressed ADPCM data for the sample to the saved state
+//------------------------------------------------------------------------------------------------------------------------------------------
+bool PsxSampler::SerializeSampleData(IByteChunk& chunk, const uint32_t numAdpcmBytes) const noexcept {
+    // Grab a copy of the sample to save and then release the SPU lock quickly, since compressing can take a while.
+    // Note: if a newly imported sample has not been picked up by the audio thread yet then save that instead, since the params are for it.
+    // The audio thread can't swap it in while we hold the lock.
+    std::vector<std::byte> adpcmData;
+
+    try {
+        adpcmData.resize(numAdpcmBytes);
+    } catch (...) {
+        return false;
+    }
+
+    {
         std::lock_guard<std::recursive_mutex> lockSpu(mSpuMutex);
-        return (chunk.PutBytes(mSpu.pRam, (int) numAdpcmBytes) >= numAdpcmBytes);
+        const std::byte* const pPendingSpuRam = mpPendingSpuRam.load();
+        const std::byte* const pSpuRam = (pPendingSpuRam) ? pPendingSpuRam : mSpu.pRam;
+        std::memcpy(adpcmData.data(), pSpuRam, numAdpcmBytes);
     }
-    
-    return true;
+
+    // Compress the sample, or reuse the compressed data from the last save (or from other instances) if the sample is unchanged
+    const uint64_t contentHash = BlobCache::hashData(adpcmData.data(), numAdpcmBytes);
+    BlobCache::CompressedBlobPtr pBlob = BlobCache::getCompressedBlob(adpcmData.data(), numAdpcmBytes, contentHash);
+
+    if (!pBlob)
+        return false;
+
+    // Write the sample header and the compressed data
+    const uint32_t compressedSize = (uint32_t) pBlob->bytes.size();
+    chunk.PutBytes(kStateSampleTag, sizeof(kStateSampleTag));
+    chunk.Put(&kStateSampleVersion);
+    chunk.Put(&numAdpcmBytes);
+    chunk.Put(&contentHash);
+    chunk.Put(&compressedSize);
+    const bool bSavedOk = (chunk.PutBytes(pBlob->bytes.data(), (int) compressedSize) > 0);
+
+    // Hold onto the compressed data so it stays in the cache for the next save
+    {
+        std::lock_guard<std::recursive_mutex> lockSpu(mSpuMutex);
+        std::swap(mpSavedSampleBlob, pBlob);
+    }
+
+    return bSavedOk;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Write the path and current programs of the loaded sound bank to the saved state, if there is a bank loaded
+//------------------------------------------------------------------------------------------------------------------------------------------
+bool PsxSampler::SerializeSampleBank(IByteChunk& chunk) const noexcept {
+    std::lock_guard<std::recursive_mutex> lockSpu(mSpuMutex);
+    const SamplerEngine::SampleBank* const pBank = mEngine.getSampleBank();
+
+    if (!pBank)
+        return true;
+
+    chunk.PutBytes(kStateBankTag, sizeof(kStateBankTag));
+    chunk.Put(&kStateBankVersion);
+    chunk.PutBytes(pBank->channelPrograms, sizeof(pBank->channelPrograms));
+    return (chunk.PutStr(pBank->filePath.c_str()) > 0);
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Deserialize the VST state
 //------------------------------------------------------------------------------------------------------------------------------------------
 int PsxSampler::UnserializeState(const IByteChunk& chunk, int startPos) noexcept {
-    // Make sure all Spu voices are killed and lock the SPU
-    std::lock_guard<std::recursive_mutex> lockSpu(mSpuMutex);
-    KillAllSpuVoices();
+    // Note: the old sound bank (if any) is unloaded first since the sample data overwrites SPU RAM, and is freed outside of the SPU lock
+    std::unique_ptr<SamplerEngine::SampleBank> pOldBank;
 
-    // De-serialize normal parameters
-    startPos = UnserializeParams(chunk, startPos);
+    {
+        // Make sure all Spu voices are killed and lock the SPU
+        std::lock_guard<std::recursive_mutex> lockSpu(mSpuMutex);
+        SwapInPendingSpuRam();
+        mEngine.killAllVoices();
+        mEngine.swapSampleBank(pOldBank);
 
-    // De-serialize the ADPCM data for the previously loaded sound
-    const uint32_t numAdpcmBlocks = (uint32_t) GetParam(kParamLengthInBlocks)->Value();
-    const uint32_t numAdpcmBytes = numAdpcmBlocks * Spu::ADPCM_BLOCK_SIZE;
+        // De-serialize normal parameters
+        startPos = UnserializeParams(chunk, startPos);
 
-    if (numAdpcmBytes > 0) {
-        startPos = chunk.GetBytes(mSpu.pRam, (int) numAdpcmBytes, startPos);
+        // De-serialize the ADPCM data for the previously loaded sound
+        const uint32_t numAdpcmBlocks = (uint32_t) GetParam(kParamLengthInBlocks)->Value();
+        const uint32_t numAdpcmBytes = numAdpcmBlocks * Spu::ADPCM_BLOCK_SIZE;
+
+        if ((numAdpcmBytes > 0) && (startPos >= 0)) {
+            startPos = UnserializeSampleData(chunk, startPos, numAdpcmBytes);
+
+            // Don't leave a partially read sample around if reading failed
+            if (startPos < 0) {
+                std::memset(mSpu.pRam, 0, std::min(numAdpcmBytes, kSpuRamSize));
+            }
+        }
+    }
+
+    // De-serialize the sound bank that was in use, if any.
+    // This is done without the SPU lock held since the bank is read from disk, which would otherwise stall the audio thread.
+    if (startPos >= 0) {
+        startPos = UnserializeSampleBank(chunk, startPos);
     }
 
     return startPos;
 }
 
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Read the ADPCM data for the sample from the saved state into SPU RAM and return the position after it, or -1 on failure.
+// Handles both the current compressed format and the raw ADPCM data saved by older versions of the plugin.
+// Expects the SPU lock to be held.
+//------------------------------------------------------------------------------------------------------------------------------------------
+int PsxSampler::UnserializeSampleData(const IByteChunk& chunk, const int startPos, const uint32_t numAdpcmBytes) noexcept {
+    if (numAdpcmBytes > kSpuRamSize)
+        return -1;
+
+    // Older versions of the plugin saved the raw ADPCM data with no header
+    char tag[sizeof(kStateSampleTag)] = {};
+    const bool bHasHeader = (
+        (chunk.GetBytes(tag, (int) sizeof(tag), startPos) >= 0) &&
+        (std::memcmp(tag, kStateSampleTag, sizeof(tag)) == 0)
+    );
+
+    if (!bHasHeader) {
+        mpSavedSampleBlob.reset();
+        return chunk.GetBytes(mSpu.pRam, (int) numAdpcmBytes, startPos);
+    }
+
+    // Read the header and sanity check it
+    uint32_t version = 0;
+    uint32_t uncompressedSize = 0;
+    uint64_t contentHash = 0;
+    uint32_t compressedSize = 0;
+
+    int pos = startPos + (int) sizeof(tag);
+    pos = chunk.Get(&version, pos);
+    pos = chunk.Get(&uncompressedSize, pos);
+    pos = chunk.Get(&contentHash, pos);
+    pos = chunk.Get(&compressedSize, pos);
+
+    if ((pos < 0) || (version > kStateSampleVersion) || (uncompressedSize != numAdpcmBytes))
+        return -1;
+
+    if (compressedSize > (uint32_t)(chunk.Size() - pos))
+        return -1;
+
+    // Decompress straight into SPU RAM and verify the result
+    const std::byte* const pCompressedData = (const std::byte*) chunk.GetData() + pos;
+
+    if (!BlobCache::decompressBlob(pCompressedData, compressedSize, mSpu.pRam, numAdpcmBytes))
+        return -1;
+
+    if (BlobCache::hashData(mSpu.pRam, numAdpcmBytes) != contentHash)
+        return -1;
+
+    // Keep the compressed data around so saving again (or saving another instance with the same sample) doesn't need to recompress
+    mpSavedSampleBlob = BlobCache::addCompressedBlob(pCompressedData, compressedSize, numAdpcmBytes, contentHash);
+    return pos + (int) compressedSize;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Reload the sound bank referenced by the saved state, or unload the current bank if the state has none.
+// Returns the position after the bank info or -1 if it is malformed. A bank that can't be reloaded from disk is NOT treated as an error,
+// so that the rest of the state is still restored. Expects the SPU lock NOT to be held, since the bank is read from disk.
+//------------------------------------------------------------------------------------------------------------------------------------------
+int PsxSampler::UnserializeSampleBank(const IByteChunk& chunk, const int startPos) noexcept {
+    // States saved without a bank (or by older versions of the plugin) have no bank info
+    char tag[sizeof(kStateBankTag)] = {};
+    const bool bHasBank = (
+        (chunk.GetBytes(tag, (int) sizeof(tag), startPos) >= 0) &&
+        (std::memcmp(tag, kStateBankTag, sizeof(tag)) == 0)
+    );
+
+    if (!bHasBank) {
+        UnloadSampleBank();
+        return startPos;
+    }
+
+    uint32_t version = 0;
+    uint8_t channelPrograms[SamplerEngine::kNumMidiChannels] = {};
+    WDL_String filePath;
+
+    int pos = startPos + (int) sizeof(tag);
+    pos = chunk.Get(&version, pos);
+
+    if ((pos < 0) || (version > kStateBankVersion))
+        return -1;
+
+    // Older states have a single program for all MIDI channels
+    if (version >= 2) {
+        pos = chunk.GetBytes(channelPrograms, (int) sizeof(channelPrograms), pos);
+    } else {
+        pos = chunk.Get(&channelPrograms[0], pos);
+        std::fill(std::begin(channelPrograms), std::end(channelPrograms), channelPrograms[0]);
+    }
+
+    pos = chunk.GetStr(filePath, pos);
+
+    if (pos < 0)
+        return -1;
+
+    std::string errorMsg;
+
+    if (!LoadSampleBank(filePath.Get(), channelPrograms, errorMsg)) {
+        UnloadSampleBank();
+    }
+
+    return pos;
+}
+
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Handle a MIDI message: adds it to the queue to be processed later
 //------------------------------------------------------------------------------------------------------------------------------------------
@@ -321,17 +495,17 @@ void PsxSampler::ProcessMidiMsg(const IMidiMsg& msg) noexcept {
 // Defines the parameters used by the plugin
 //------------------------------------------------------------------------------------------------------------------------------------------
 void PsxSampler::DefinePluginParams() noexcept {
-    // Parameters
+    // Parameters: automation of the volume, pan and pitch bend settings lands on the exact sample it happens, where the host supports it (VST3)
     GetParam(kParamSampleRate)->InitInt("sampleRate", 11025, 1, INT32_MAX, "", IParam::EFlags::kFlagMeta);          // Influences 'baseNote'
     GetParam(kParamBaseNote)->InitDouble("baseNote", 84, 0.00001, 10000.0, 0.125, "", IParam::EFlags::kFlagMeta);   // Influences 'sampleRate'
     GetParam(kParamLengthInSamples)->InitInt("lengthInSamples", 0, 0, INT32_MAX);
     GetParam(kParamLengthInBlocks)->InitInt("lengthInBlocks", 0, 0, INT32_MAX);
     GetParam(kParamLoopStartSample)->InitInt("loopStartSample", 0, 0, INT32_MAX);
     GetParam(kParamLoopEndSample)->InitInt("loopEndSample", 0, 0, INT32_MAX);
-    GetParam(kParamVolume)->InitInt("volume", 127, 0, 127);
-    GetParam(kParamPan)->InitInt("pan", 64, 0, 127);
-    GetParam(kParamPitchstepUp)->InitInt("pitchstepUp", 1, 0, 48);
-    GetParam(kParamPitchstepDown)->InitInt("pitchstepDown", 1, 0, 48);
+    GetParam(kParamVolume)->InitInt("volume", 127, 0, 127, "", IParam::EFlags::kFlagSampleAccurate);
+    GetParam(kParamPan)->InitInt("pan", 64, 0, 127, "", IParam::EFlags::kFlagSampleAccurate);
+    GetParam(kParamPitchstepUp)->InitInt("pitchstepUp", 1, 0, 48, "", IParam::EFlags::kFlagSampleAccurate);
+    GetParam(kParamPitchstepDown)->InitInt("pitchstepDown", 1, 0, 48, "", IParam::EFlags::kFlagSampleAccurate);
     GetParam(kParamAttackStep)->InitInt("attackStep", 3, 0, 3);
     GetParam(kParamAttackShift)->InitInt("attackShift", 0, 0, 31);
     GetParam(kParamAttackIsExp)->InitInt("attackIsExp", 0, 0, 1);
@@ -345,8 +519,8 @@ void PsxSampler::DefinePluginParams() noexcept {
     GetParam(kParamReleaseIsExp)->InitInt("releaseIsExp", 0, 0, 1);
     GetParam(kParamNoteMin)->InitInt("noteMin", 0, 0, 127);
     GetParam(kParamNoteMax)->InitInt("noteMax", 127, 0, 127);
-    GetParam(kParamPitchBendUpOffset)->InitDouble("pitchBendUpOffset", 0, 0, 48.0, 0.25);
-    GetParam(kParamPitchBendDownOffset)->InitDouble("pitchBendDownOffset", 0, 0, 48.0, 0.25);
+    GetParam(kParamPitchBendUpOffset)->InitDouble("pitchBendUpOffset", 0, 0, 48.0, 0.25, "", IParam::EFlags::kFlagSampleAccurate);
+    GetParam(kParamPitchBendDownOffset)->InitDouble("pitchBendDownOffset", 0, 0, 48.0, 0.25, "", IParam::EFlags::kFlagSampleAccurate);
 
     // Labels for switches
     GetParam(kParamAttackIsExp)->SetDisplayText(0.0, "No");
@@ -397,12 +571,15 @@ void PsxSampler::DoEditorSetup() noexcept {
         const IRECT bndParamsLoadSavePanel = bndPadded.GetFromTop(80).GetReducedFromLeft(720).GetFromLeft(100);
         const IRECT bndTrackPanel = bndPadded.GetReducedFromTop(90).GetFromTop(100).GetFromLeft(820);
         const IRECT bndEnvelopePanel = bndPadded.GetReducedFromTop(200).GetFromTop(230).GetFromLeft(860);
+        const IRECT bndSequencePanel = bndPadded.GetReducedFromTop(440).GetFromTop(60).GetFromLeft(860);
+        const IRECT bndTelemetry = bndPadded.GetReducedFromTop(510).GetFromTop(36).GetFromLeft(860);
 
         pGraphics->AttachControl(new IVGroupControl(bndSamplePanel, "Sample"));
         pGraphics->AttachControl(new IVGroupControl(bndSampleInfoPanel, "Sample Info"));
         pGraphics->AttachControl(new IVGroupControl(bndParamsLoadSavePanel, "Params"));
         pGraphics->AttachControl(new IVGroupControl(bndTrackPanel, "Track"));
         pGraphics->AttachControl(new IVGroupControl(bndEnvelopePanel, "Envelope"));
+        pGraphics->AttachControl(new IVGroupControl(bndSequencePanel, "Sequence"));
 
         // Make a read only edit box
         const auto makeReadOnlyEditBox = [=](const IRECT bounds, const int paramIdx) noexcept {
@@ -445,17 +622,18 @@ void PsxSampler::DoEditorSetup() noexcept {
                 )
             );
 
-            pGraphics->AttachControl(
-                new IVButtonControl(
-                    bndColLoadSave.GetFromBottom(30.0f),
-                    [=](IControl* const pControl) noexcept {
-                        SplashClickActionFunc(pControl);
-                        DoLoadVagFilePrompt(*pGraphics);
-                    },
-                    "Load"
-                )
+            mpButton_LoadSample = new IVButtonControl(
+                bndColLoadSave.GetFromBottom(30.0f),
+                [=](IControl* const pControl) noexcept {
+                    SplashClickActionFunc(pControl);
+                    DoLoadVagFilePrompt(*pGraphics);
+                },
+                "Load"
             );
 
+            pGraphics->AttachControl(mpButton_LoadSample);
+            mpButton_LoadSample->SetDisabled(IsSampleImportInProgress());
+
             pGraphics->AttachControl(new IVLabelControl(bndColRateNoteLabels.GetFromTop(30.0f), "Sample Rate", labelStyle));
             pGraphics->AttachControl(new IVLabelControl(bndColRateNoteLabels.GetFromBottom(30.0f), "Base Note", labelStyle));
             mpCaption_SampleRate = new ICaptionControl(bndColRateNoteValues.GetFromTop(20.0f), kParamSampleRate, editBoxTextStyle, editBoxBgColor, false);
@@ -561,6 +739,50 @@ void PsxSampler::DoEditorSetup() noexcept {
             pGraphics->AttachControl(mpSwitch_ReleaseIsExp);
         }
 
+        // Sequence panel
+        {
+            const IRECT bndPanelPadded = bndSequencePanel.GetReducedFromTop(22.0f).GetFromTop(30.0f).GetReducedFromLeft(10.0f);
+            const IRECT bndColLoad = bndPanelPadded.GetFromLeft(100.0f);
+            const IRECT bndColPlay = bndPanelPadded.GetReducedFromLeft(110.0f).GetFromLeft(100.0f);
+            const IRECT bndColStop = bndPanelPadded.GetReducedFromLeft(220.0f).GetFromLeft(100.0f);
+            const IRECT bndColPrev = bndPanelPadded.GetReducedFromLeft(330.0f).GetFromLeft(40.0f);
+            const IRECT bndColNext = bndPanelPadded.GetReducedFromLeft(380.0f).GetFromLeft(40.0f);
+            const IRECT bndColSong = bndPanelPadded.GetReducedFromLeft(430.0f);
+
+            const auto createAndAttachButton = [=](const IRECT bounds, const char* const label, const std::function<void()> action) noexcept {
+                pGraphics->AttachControl(
+                    new IVButtonControl(
+                        bounds,
+                        [=](IControl* const pControl) noexcept {
+                            SplashClickActionFunc(pControl);
+                            action();
+                        },
+                        label
+                    )
+                );
+            };
+
+            createAndAttachButton(bndColLoad, "Load", [=]() noexcept { DoLoadSongFilePrompt(*pGraphics); });
+            createAndAttachButton(bndColPlay, "Play", [=]() noexcept { PlaySong(); });
+            createAndAttachButton(bndColStop, "Stop", [=]() noexcept { StopSong(); });
+            createAndAttachButton(bndColPrev, "<", [=]() noexcept { SelectSongSequence(-1); });
+            createAndAttachButton(bndColNext, ">", [=]() noexcept { SelectSongSequence(+1); });
+
+            mpLabel_Song = new IVLabelControl(bndColSong, "", labelStyle);
+            pGraphics->AttachControl(mpLabel_Song);
+            UpdateSongLabel();
+        }
+
+        // DSP load and voice telemetry
+        pGraphics->AttachControl(
+            new DspTelemetryControl(
+                bndTelemetry,
+                DspTelemetryControl::Labels{ "Voices", "Reverb ticks", "MIDI queue peak" },
+                [this]() noexcept { mTelemetry.requestReset(); }
+            ),
+            kCtrlTagTelemetry
+        );
+
         // Add the test keyboard and pitch bend wheel
         const IRECT bndKeyboardPanel = bndPadded.GetFromBottom(200);
         const IRECT bndKeyboard = bndKeyboardPanel.GetReducedFromLeft(60.0f);
@@ -591,7 +813,7 @@ void PsxSampler::DoEditorSetup() noexcept {
 void PsxSampler::DoDspSetup() noexcept {
     // Create the PlayStation SPU core.
     // Note: only allocate a tiny amount of samples for reverb since the sampler doesn't do reverb.
-    Spu::initCore(mSpu, kSpuRamSize, kMaxVoices, 1024);
+    Spu::initCore(mSpu, kSpuRamSize, SamplerEngine::kMaxVoices, 1024);
 
     // Set default volume levels
     mSpu.masterVol.left = 0x3FFF;
@@ -614,37 +836,30 @@ void PsxSampler::DoDspSetup() noexcept {
     mSpu.processedReverb = {};
     mSpu.reverbRegs = {};
 
-    // Default initialize all the SPU voice infos
-    for (VoiceInfo& voiceInfo : mVoiceInfos) {
-        voiceInfo.midiNote = 0xFFFFu;
-        voiceInfo.midiVelocity = 0xFFFFu;
-        voiceInfo.numSamplesActive = 0;
-    }
-
-    // Update SPU voices from the current instrument settings and terminate the current empty sample in SPU RAM
-    UpdateSpuVoicesFromParams();
+    // Reset the sampler engine, update SPU voices from the current instrument settings and terminate the current empty sample in SPU RAM
+    mEngine.setSettings(GetCurrentEngineSettings());
+    mEngine.reset();
     AddSampleTerminator();
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Called when a parameter changes
+// Called when a parameter changes from the UI: keeps linked parameters in sync.
+// The engine itself picks up the change via the dirty parameter bits at the start of the next block (see 'OnParamChange').
 //------------------------------------------------------------------------------------------------------------------------------------------
 void PsxSampler::InformHostOfParamChange(int idx, [[maybe_unused]] double normalizedValue) noexcept {
     // These two parameters are linked
-    std::lock_guard<std::recursive_mutex> lockSpu(mSpuMutex);
-
     if (idx == kParamSampleRate) {
         SetBaseNoteFromSampleRate();
         GetUI()->SetAllControlsDirty();
     } else if (idx == kParamBaseNote) {
         SetSampleRateFromBaseNote();
         GetUI()->SetAllControlsDirty();
-    } else if ((idx == kParamNoteMin) || (idx == kParamNoteMax)) {
-        DoNoteOffForOutOfRangeNotes();
+    } else {
+        return;
     }
 
-    // Update the SPU voices etc.
-    UpdateSpuVoicesFromParams();
+    // Make sure the engine sees the linked value, even if it already consumed the dirty bit for the parameter which changed
+    mDirtyParams.fetch_or((1u << kParamSampleRate) | (1u << kParamBaseNote));
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
@@ -656,353 +871,571 @@ void PsxSampler::OnRestoreState() noexcept {
 
     // Update the SPU from the changes and make sure the current sample is terminated
     std::lock_guard<std::recursive_mutex> lockSpu(mSpuMutex);
-    UpdateSpuVoicesFromParams();
+    SwapInPendingSpuRam();
+    UpdateEngineSettings();
     AddSampleTerminator();
 }
 
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Called when a parameter changes, possibly on the audio thread: the sampler engine picks up the new settings at the start of the next block
+//------------------------------------------------------------------------------------------------------------------------------------------
+void PsxSampler::OnParamChange(int paramIdx) noexcept {
+    if ((paramIdx >= 0) && (paramIdx < (int) kNumParams)) {
+        mDirtyParams.fetch_or(1u << paramIdx);
+    }
+}
+
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Add a terminator for the currently loaded sample consisting of two silent ADPCM blocks which will loop indefinitely.
 // Used to guarantee a sound will stop playing after it reaches the end, since SPU voices technically never stop.
 // The SPU emulation however will kill them to save on CPU time...
 //------------------------------------------------------------------------------------------------------------------------------------------
 void PsxSampler::AddSampleTerminator() noexcept {
-    // Figure out which ADPCM sample block to write the terminators
-    constexpr uint32_t kMaxSampleBlocks = kSpuRamSize / Spu::ADPCM_BLOCK_SIZE;
-    static_assert(kMaxSampleBlocks >= 2);
-    const uint32_t numSampleBlocks = (uint32_t) GetParam(kParamLengthInBlocks)->Value();
-    const uint32_t termAdpcmBlocksStartIdx = std::min(numSampleBlocks, kMaxSampleBlocks - 2);
-    std::byte* const pTermAdpcmBlocks = mSpu.pRam + (size_t) Spu::ADPCM_BLOCK_SIZE * termAdpcmBlocksStartIdx;
-
-    // Zero the bytes for the two ADPCM sample blocks firstly
-    std::memset(pTermAdpcmBlocks, 0, Spu::ADPCM_BLOCK_SIZE * 2);
-
-    // The 2nd byte of each ADPCM block is the flags byte, and is where we indicate loop start/end.
-    // Make the first block be the loop start, and the second block be loop end:
-    pTermAdpcmBlocks[1]   = (std::byte) Spu::ADPCM_FLAG_LOOP_START;
-    pTermAdpcmBlocks[17]  = (std::byte) Spu::ADPCM_FLAG_LOOP_END;
+    SamplerEngine::writeSampleTerminator(mSpu.pRam, kSpuRamSize, (uint32_t) GetParam(kParamLengthInBlocks)->Value());
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Process the MIDI queue - advances time by a single sample
+// Process the messages in the MIDI queue which are due at or before the given frame in the current block
 //------------------------------------------------------------------------------------------------------------------------------------------
-void PsxSampler::ProcessMidiQueue() noexcept {
-    // Continue processing the queue
+void PsxSampler::ProcessMidiQueue(const int frameIdx) noexcept {
     while (!mMidiQueue.Empty()) {
-        // Is there a delay until the next message?
-        // If so then decrement the time until it and finish up.
-        {
-            IMidiMsg& msg = mMidiQueue.Peek();
+        const IMidiMsg msg = mMidiQueue.Peek();
 
-            if (msg.mOffset > 0) {
-                msg.mOffset--;
-                break;
-            }
-        }
+        if (msg.mOffset > frameIdx)
+            break;
 
-        // Remove the message from the queue then process
-        const IMidiMsg msg = mMidiQueue.Peek();
         mMidiQueue.Remove();
-        ProcessQueuedMidiMsg(msg);
+        mEngine.processMidiMsg(msg.mStatus, msg.mData1, msg.mData2);
     }
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Process the given MIDI message that was queued
+// Update the sampler engine from the current instrument parameters.
+// Note: assumes the SPU lock is held.
 //------------------------------------------------------------------------------------------------------------------------------------------
-void PsxSampler::ProcessQueuedMidiMsg(const IMidiMsg& msg) noexcept {
-    // What type of message is it?
-    const IMidiMsg::EStatusMsg statusMsgType = msg.StatusMsg();
+void PsxSampler::UpdateEngineSettings() noexcept {
+    mEngine.setSettings(GetCurrentEngineSettings());
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Get the sampler engine settings for the current instrument parameters
+//------------------------------------------------------------------------------------------------------------------------------------------
+SamplerEngine::Settings PsxSampler::GetCurrentEngineSettings() const noexcept {
+    SamplerEngine::Settings settings = {};
+    settings.baseNote = (float) GetParam(kParamBaseNote)->Value();
+    settings.volume = (uint32_t) GetParam(kParamVolume)->Value();
+    settings.pan = (uint32_t) GetParam(kParamPan)->Value();
+    settings.pitchstepUp = (float) GetParam(kParamPitchstepUp)->Value();
+    settings.pitchstepDown = (float) GetParam(kParamPitchstepDown)->Value();
+    settings.pitchBendUpOffset = (float) GetParam(kParamPitchBendUpOffset)->Value();
+    settings.pitchBendDownOffset = (float) GetParam(kParamPitchBendDownOffset)->Value();
+    settings.noteMin = (uint32_t) GetParam(kParamNoteMin)->Value();
+    settings.noteMax = (uint32_t) GetParam(kParamNoteMax)->Value();
+    settings.bReverb = false;
+
+    Spu::AdsrEnvelope& adsrEnv = settings.adsrEnv;
+    adsrEnv.sustainLevel = (uint32_t) GetParam(kParamSustainLevel)->Value();
+    adsrEnv.decayShift = (uint32_t) GetParam(kParamDecayShift)->Value();
+    adsrEnv.attackStep = (uint32_t) GetParam(kParamAttackStep)->Value();
+    adsrEnv.attackShift = (uint32_t) GetParam(kParamAttackShift)->Value();
+    adsrEnv.bAttackExp = (uint32_t) GetParam(kParamAttackIsExp)->Value();
+    adsrEnv.releaseShift = (uint32_t) GetParam(kParamReleaseShift)->Value();
+    adsrEnv.bReleaseExp = (uint32_t) GetParam(kParamReleaseIsExp)->Value();
+    adsrEnv.sustainStep = (uint32_t) GetParam(kParamSustainStep)->Value();
+    adsrEnv.sustainShift = (uint32_t) GetParam(kParamSustainShift)->Value();
+    adsrEnv.bSustainDec = (uint32_t) GetParam(kParamSustainDec)->Value();
+    adsrEnv.bSustainExp = (uint32_t) GetParam(kParamSustainIsExp)->Value();
+
+    return settings;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Prompt the user to load a sample from a .vag, .wav or .aiff file and start importing it in the background if a choice is made.
+// PCM sounds (.wav and .aiff) are resampled to the current sample rate setting and encoded to PlayStation ADPCM.
+// Only one import can be in progress at a time.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void PsxSampler::DoLoadVagFilePrompt(IGraphics& graphics) noexcept {
+    if (IsSampleImportInProgress())
+        return;
+
+    // Prompt for the file to open and abort if none is chosen
+    WDL_String filePath;
+    WDL_String fileDir;
+    graphics.PromptForFile(filePath, fileDir, EFileAction::Open, "vag wav aif aiff vab vh");
     
-    switch (statusMsgType) {
-        case IMidiMsg::kNoteOn:
-            ProcessMidiNoteOn(msg.mData1 & uint8_t(0x7Fu), msg.mData2 & uint8_t(0x7Fu));
-            break;
+    if (filePath.GetLength() <= 0)
+        return;
 
-        case IMidiMsg::kNoteOff:
-            ProcessMidiNoteOff(msg.mData1 & uint8_t(0x7Fu));
-            break;
+    // Sound banks only need to be indexed and copied into an SPU RAM image, which is quick, so load those straight away
+    const std::string fileExt = FileUtils::getLowerCaseFileExt(filePath.Get());
 
-        case IMidiMsg::kPitchWheel: {
-            const uint16_t hiBits = (uint16_t) msg.mData2 & 0x7Fu;
-            const uint16_t loBits = (uint16_t) msg.mData1 & 0x7Fu;
-            ProcessMidiPitchBend((hiBits << 7) | loBits);
-        }   break;
+    if ((fileExt == ".vab") || (fileExt == ".vh")) {
+        std::string errorMsg;
 
-        case IMidiMsg::kControlChange: {
-            if (msg.mData1 == IMidiMsg::EControlChangeMsg::kAllNotesOff) {
-                ProcessMidiAllNotesOff();
-            }
-        }   break;
-        
-        default:
-            break;
+        const uint8_t channelPrograms[SamplerEngine::kNumMidiChannels] = {};
+
+        if (!LoadSampleBank(filePath.Get(), channelPrograms, errorMsg)) {
+            graphics.ShowMessageBox(errorMsg.c_str(), "Error!", EMsgBoxType::kMB_OK);
+        }
+
+        graphics.SetAllControlsDirty();
+        return;
+    }
+
+    // Kick off the import on a background thread so neither the UI or the audio thread is blocked
+    mImportProgress = 0;
+    mbImportRefining = false;
+    mbImportDone = false;
+    mbCancelImport = false;
+
+    const std::string filePathStr = filePath.Get();
+    const uint32_t pcmSampleRate = (uint32_t) GetParam(kParamSampleRate)->Value();
+    mImportThread = std::thread([this, filePathStr, pcmSampleRate]() noexcept { RunSampleImport(filePathStr, pcmSampleRate); });
+
+    if (mpButton_LoadSample) {
+        mpButton_LoadSample->SetDisabled(true);
     }
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Handle a MIDI note on message
+// Tells if a sample is still being imported or handed over to the audio thread
 //------------------------------------------------------------------------------------------------------------------------------------------
-void PsxSampler::ProcessMidiNoteOn(const uint8_t note, const uint8_t velocity) noexcept {
-    // Release any playing instances of this note that are not already being released
-    ProcessMidiNoteOff(note);
+bool PsxSampler::IsSampleImportInProgress() const noexcept {
+    return (mImportThread.joinable() || mpPendingSpuRam.load() || mpRetiredSpuRam.load());
+}
 
-    // Only allow the note to be played if it's within the acceptable range
-    const uint32_t minNote = (uint32_t) GetParam(kParamNoteMin)->Value();
-    const uint32_t maxNote = (uint32_t) GetParam(kParamNoteMax)->Value();
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Runs on the import thread: imports the given sound file, determining whether it is a PCM sound or .vag from the file contents.
+// Doesn't touch the SPU or any plugin parameters; results are handed over to the UI thread as they become available.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void PsxSampler::RunSampleImport(const std::string& filePath, const uint32_t pcmSampleRate) noexcept {
+    auto signalDone = finally([this]() noexcept {
+        mbImportDone = true;
+    });
 
-    if ((note < minNote) || (note > maxNote))
-        return;
+    MappedFile file;
 
-    // Try to find a free SPU voice firstly to service this request
-    uint32_t spuVoiceIdx = UINT32_MAX;
+    if (!file.open(filePath.c_str())) {
+        SampleImport result = {};
+        result.errorMsg = "Unable to open the chosen file!\nDoes the file path exist and is it accessible?";
+        PublishSampleImport(result);
+        return;
+    }
 
-    for (uint32_t i = 0; i < kMaxVoices; ++i) {
-        if (mSpu.pVoices[i].envPhase == Spu::EnvPhase::Off) {
-            spuVoiceIdx = i;
-            break;
-        }
+    if (PcmFileUtils::isWavFile(file.data(), file.size()) || PcmFileUtils::isAiffFile(file.data(), file.size())) {
+        ImportPcmSample(file.data(), file.size(), pcmSampleRate);
+    } else {
+        ImportVagSample(file.data(), file.size());
     }
+}
 
-    // If that fails try to find the oldest playing voice to use
-    if (spuVoiceIdx == UINT32_MAX) {
-        spuVoiceIdx = 0;
-        uint32_t oldestSamplesActive = mVoiceInfos[0].numSamplesActive;
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Runs on the import thread: imports a .vag file held in memory.
+// The sound data is copied straight from the file into the new SPU RAM image.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void PsxSampler::ImportVagSample(const std::byte* const pFileData, const size_t fileSize) noexcept {
+    SampleImport result = {};
+    VagUtils::VagFileView vag = {};
+    std::string parseErrorMsg;
 
-        for (uint32_t i = 1; i < kMaxVoices; ++i) {
-            if (mVoiceInfos[i].numSamplesActive > oldestSamplesActive) {
-                oldestSamplesActive = mVoiceInfos[i].numSamplesActive;
-                spuVoiceIdx = i;
-            }
-        }
+    if (!VagUtils::parseVagFile(pFileData, fileSize, vag, parseErrorMsg)) {
+        result.errorMsg = "Unable to read the PlayStation 1 format VAG file.\nFile may be corrupt or invalid!";
+        PublishSampleImport(result);
+        return;
     }
 
-    // Save the info for this voice
-    VoiceInfo& voiceInfo = mVoiceInfos[spuVoiceIdx];
-    voiceInfo.midiNote = note;
-    voiceInfo.midiVelocity = velocity;
-    voiceInfo.numSamplesActive = 0;
+    // Scan the ADPCM block flags to figure out where the loop points are in the VAG file
+    VagUtils::findPsxAdpcmLoopPoints(vag.pAdpcmData, vag.adpcmDataSizeInFile, result.loopStartSample, result.loopEndSample);
+
+    // Clamp the length of the VAG file to be within the RAM size of the SPU.
+    // Any implicit ADPCM data which is not present in the file is all zeros.
+    const uint32_t numAdpcmBlocks = std::min(vag.adpcmDataSize, kSpuRamSize) / Spu::ADPCM_BLOCK_SIZE;
+    const uint32_t numAdpcmBytesInFile = std::min(vag.adpcmDataSizeInFile, numAdpcmBlocks * Spu::ADPCM_BLOCK_SIZE);
 
-    // Make sure the voice parameters are up to date and sound the voice
-    UpdateSpuVoiceFromParams(spuVoiceIdx);
-    Spu::keyOn(mSpu.pVoices[spuVoiceIdx]);
+    result.pSpuRam = MakeSampleSpuRamImage(vag.pAdpcmData, numAdpcmBytesInFile, numAdpcmBlocks);
+    result.sampleRate = vag.sampleRate;
+    result.lengthInSamples = (vag.adpcmDataSize / Spu::ADPCM_BLOCK_SIZE) * Spu::ADPCM_BLOCK_NUM_SAMPLES;
+    result.lengthInBlocks = numAdpcmBlocks;
+    mImportProgress = 100;
+    PublishSampleImport(result);
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Handle a MIDI note off message
+// Runs on the import thread: imports a .wav or .aiff file held in memory.
+// The sound is resampled to the given sample rate, then quickly encoded at draft quality so it can be played almost immediately.
+// After that it is re-encoded at full quality, which replaces the draft encoding once done.
 //------------------------------------------------------------------------------------------------------------------------------------------
-void PsxSampler::ProcessMidiNoteOff(const uint8_t note) noexcept {
-    // Find voices playing this note which are not already being released and release them
-    for (uint32_t i = 0; i < kMaxVoices; ++i) {
-        if (mVoiceInfos[i].midiNote == note) {
-            Spu::Voice& voice = mSpu.pVoices[i];
+void PsxSampler::ImportPcmSample(const std::byte* const pFileData, const size_t fileSize, const uint32_t sampleRate) noexcept {
+    SampleImport result = {};
+    PcmFileUtils::PcmSound sound = {};
+    std::string readErrorMsg;
 
-            if ((voice.envPhase != Spu::EnvPhase::Release) && (voice.envPhase != Spu::EnvPhase::Off)) {
-                Spu::keyOff(voice);
-            }
-        }
+    // The sound length is clamped so it fits in SPU RAM along with the sample terminator.
+    // Only the part of the file which ends up in SPU RAM is decoded and resampled, so very long files don't exhaust memory.
+    constexpr uint32_t kMaxSamples = (kSpuRamSize / Spu::ADPCM_BLOCK_SIZE - 2) * Spu::ADPCM_BLOCK_NUM_SAMPLES;
+
+    if (!PcmFileUtils::readPcmSoundFile(pFileData, fileSize, sound, readErrorMsg, kMaxSamples, (double) sampleRate)) {
+        result.errorMsg = "Unable to read the sound file.\nOnly uncompressed .wav and .aiff files are supported.";
+        PublishSampleImport(result);
+        return;
+    }
+
+    if (mbCancelImport)
+        return;
+
+    // Resample and convert to 16-bit
+    std::vector<int16_t> samples;
+
+    if ((!PcmFileUtils::resamplePcmSound(sound, (double) sampleRate, kMaxSamples)) || (!PcmFileUtils::convertPcmSoundToInt16(sound, samples))) {
+        result.errorMsg = "Unable to import the sound file.\nOut of memory!";
+        PublishSampleImport(result);
+        return;
+    }
+
+    const uint32_t numSamples = (uint32_t) samples.size();
+    mImportProgress = 10;
+
+    result.sampleRate = sampleRate;
+    result.lengthInSamples = numSamples;
+    result.loopStartSample = std::min(sound.loopStartSampleIdx, numSamples);
+    result.loopEndSample = std::min(sound.loopEndSampleIdx, numSamples);
+
+    // Report encoding progress for the current stage and abort if the import has been cancelled
+    const auto onEncodeProgress = [](void* const pUserData, const uint32_t numBlocksDone, const uint32_t numBlocksTotal) noexcept -> bool {
+        PsxSampler& sampler = *(PsxSampler*) pUserData;
+        const uint32_t stageStartProgress = (sampler.mbImportRefining) ? 0 : 10;
+        sampler.mImportProgress = stageStartProgress + (100 - stageStartProgress) * numBlocksDone / std::max(numBlocksTotal, 1u);
+        return (!sampler.mbCancelImport);
+    };
+
+    // Do the draft and then full quality encodings
+    const VagUtils::EncodeQuality encodeQualities[2] = { VagUtils::EncodeQuality::Draft, VagUtils::EncodeQuality::Full };
+    std::vector<std::byte> adpcmData;
+
+    for (const VagUtils::EncodeQuality quality : encodeQualities) {
+        const bool bEncodedOk = VagUtils::encodePcmSoundToPsxAdpcm(
+            samples.data(),
+            numSamples,
+            result.loopStartSample,
+            result.loopEndSample,
+            adpcmData,
+            quality,
+            onEncodeProgress,
+            this
+        );
+
+        if (!bEncodedOk)
+            return;
+
+        const uint32_t numAdpcmBlocks = (uint32_t) adpcmData.size() / Spu::ADPCM_BLOCK_SIZE;
+        result.pSpuRam = MakeSampleSpuRamImage(adpcmData.data(), (uint32_t) adpcmData.size(), numAdpcmBlocks);
+        result.lengthInBlocks = numAdpcmBlocks;
+        PublishSampleImport(result);
+
+        // The next encoding refines this one
+        result.bIsRefinement = true;
+        mImportProgress = 0;
+        mbImportRefining = true;
     }
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Handle a MIDI pitch bend message
+// Runs on the import thread: makes the given import result available to the UI thread, replacing any previous result not yet picked up.
+// Takes ownership of the result's SPU RAM image.
 //------------------------------------------------------------------------------------------------------------------------------------------
-void PsxSampler::ProcessMidiPitchBend(const uint16_t pitchBend) noexcept {
-    mCurMidiPitchBend = pitchBend;
-    UpdateSpuVoicesFromParams();
+void PsxSampler::PublishSampleImport(SampleImport& result) noexcept {
+    std::lock_guard<std::mutex> lockResult(mImportResultMutex);
+
+    // If a draft result is being replaced before it was ever used then the replacement is no longer a refinement of what is loaded
+    if (mbHaveImportResult) {
+        delete[] mImportResult.pSpuRam;
+        result.bIsRefinement = (result.bIsRefinement && mImportResult.bIsRefinement);
+    }
+
+    mImportResult = result;
+    mbHaveImportResult = true;
+    result.pSpuRam = nullptr;
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Process an 'all notes off' MIDI message
+// Makes a new SPU RAM image containing the given ADPCM sample data followed by the sample terminator.
+// The sample is the specified number of ADPCM blocks long: any blocks not covered by the given data are zeroed.
 //------------------------------------------------------------------------------------------------------------------------------------------
-void PsxSampler::ProcessMidiAllNotesOff() noexcept {
-    KeyOffAllSpuVoices();
+std::byte* PsxSampler::MakeSampleSpuRamImage(
+    const std::byte* const pAdpcmData,
+    const uint32_t numAdpcmBytes,
+    const uint32_t numAdpcmBlocks
+) noexcept {
+    assert(numAdpcmBytes <= numAdpcmBlocks * Spu::ADPCM_BLOCK_SIZE);
+    assert(numAdpcmBytes <= kSpuRamSize);
+
+    std::byte* const pSpuRam = new std::byte[kSpuRamSize];
+    std::memcpy(pSpuRam, pAdpcmData, numAdpcmBytes);
+    std::memset(pSpuRam + numAdpcmBytes, 0, kSpuRamSize - numAdpcmBytes);
+    SamplerEngine::writeSampleTerminator(pSpuRam, kSpuRamSize, numAdpcmBlocks);
+    return pSpuRam;
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Update all of the SPU voices from the current parameters.
-// Note: assumes the SPU lock is held.
+// Called on the UI thread to advance any sample import in progress.
+// Shows progress, applies the params for a finished import and hands it's SPU RAM image over to the audio thread.
 //------------------------------------------------------------------------------------------------------------------------------------------
-void PsxSampler::UpdateSpuVoicesFromParams() noexcept {
-    // These parameters affect the pitch and volume of all voices
-    const float baseNote = (float) GetParam(kParamBaseNote)->Value();
-    const uint32_t volume = (uint32_t) GetParam(kParamVolume)->Value();
-    const uint32_t pan = (uint32_t) GetParam(kParamPan)->Value();
-
-    // Get the current pitch bend to apply to all voices (in semitones) and the ADSR envelope to use for all voices
-    Spu::AdsrEnvelope adsrEnv = GetCurrentSpuAdsrEnv();
-    const float pitchBendInNotes = GetCurrentPitchBendInNotes();
-
-    // Update all the voices: note that the base note is the note at which the sample rate is 44,100 Hz (4096.0 in SPU units) so the calculation is based on that
-    const uint32_t numVoices = mSpu.numVoices;
-    Spu::Voice* const pVoices = mSpu.pVoices;
-
-    for (uint32_t voiceIdx = 0; voiceIdx < numVoices; ++voiceIdx) {
-        const VoiceInfo& voiceInfo = mVoiceInfos[voiceIdx];
-        Spu::Voice& voice = pVoices[voiceIdx];
-
-        voice.sampleRate = GetNoteSpuSampleRate(baseNote, (float) voiceInfo.midiNote + pitchBendInNotes);
-        voice.bDisabled = false;
-        voice.bDoReverb = false;
-        voice.env = adsrEnv;
-        voice.volume = CalcSpuVoiceVolume(volume, pan, voiceInfo.midiVelocity);
+void PsxSampler::UpdateSampleImport() noexcept {
+    // Free the old SPU RAM image once the audio thread has swapped in a new one
+    delete[] mpRetiredSpuRam.exchange(nullptr);
+
+    // Pick up the latest import result if the audio thread is done with the previous one
+    SampleImport result = {};
+    bool bHaveResult = false;
+
+    if ((!mpPendingSpuRam.load()) && (!mpRetiredSpuRam.load())) {
+        std::lock_guard<std::mutex> lockResult(mImportResultMutex);
+        result = mImportResult;
+        bHaveResult = mbHaveImportResult;
+        mImportResult = {};
+        mbHaveImportResult = false;
     }
-}
 
-//------------------------------------------------------------------------------------------------------------------------------------------
-// Update a single SPU voice (only) from current parameters.
-// Note: assumes the SPU lock is held.
-//------------------------------------------------------------------------------------------------------------------------------------------
-void PsxSampler::UpdateSpuVoiceFromParams(const uint32_t voiceIdx) noexcept {
-    assert(voiceIdx < kMaxVoices);
+    if (bHaveResult) {
+        if (!result.pSpuRam) {
+            // The import failed: report why
+            if (GetUI() && (!result.errorMsg.empty())) {
+                GetUI()->ShowMessageBox(result.errorMsg.c_str(), "Error!", EMsgBoxType::kMB_OK);
+            }
+        } else {
+            // Update sample related parameters, unless this is just a better encoding of the sound already loaded
+            if (!result.bIsRefinement) {
+                UnloadSampleBank();
+                GetParam(kParamSampleRate)->Set((double) result.sampleRate);
+                SetBaseNoteFromSampleRate();
+                GetParam(kParamLengthInSamples)->Set((double) result.lengthInSamples);
+                GetParam(kParamLengthInBlocks)->Set((double) result.lengthInBlocks);
+                GetParam(kParamLoopStartSample)->Set((double) result.loopStartSample);
+                GetParam(kParamLoopEndSample)->Set((double) result.loopEndSample);
+                mDirtyParams = kEngineParamsMask;
+
+                if (GetUI()) {
+                    GetUI()->SetAllControlsDirty();
+                }
+            }
 
-    // This will affect the pitch and volume of the voice
-    const float baseNote = (float) GetParam(kParamBaseNote)->Value();
-    const uint32_t volume = (uint32_t) GetParam(kParamVolume)->Value();
-    const uint32_t pan = (uint32_t) GetParam(kParamPan)->Value();
+            // Hand the new SPU RAM image over to the audio thread.
+            // A refined encoding has exactly the same layout, so voices can keep playing through the swap.
+            mbPendingKeepVoices = result.bIsRefinement;
+            mpPendingSpuRam = result.pSpuRam;
+        }
+    }
 
-    // Get the envelope to use and the current pitch bend
-    Spu::AdsrEnvelope adsrEnv = GetCurrentSpuAdsrEnv();
-    const float pitchBendInNotes = GetCurrentPitchBendInNotes();
+    // Once the import thread is done and everything it produced has been picked up then it can be cleaned up
+    bool bHaveMoreResults = false;
 
-    // Update the voice: note that the base note is the note at which the sample rate is 44,100 Hz (4096.0 in SPU units) so the calculation is based on that
-    const VoiceInfo& voiceInfo = mVoiceInfos[voiceIdx];
-    Spu::Voice& voice = mSpu.pVoices[voiceIdx];
+    {
+        std::lock_guard<std::mutex> lockResult(mImportResultMutex);
+        bHaveMoreResults = mbHaveImportResult;
+    }
 
-    voice.sampleRate = GetNoteSpuSampleRate(baseNote, (float) voiceInfo.midiNote + pitchBendInNotes);
-    voice.bDisabled = false;
-    voice.bDoReverb = false;
-    voice.env = adsrEnv;
-    voice.volume = CalcSpuVoiceVolume(volume, pan, voiceInfo.midiVelocity);
+    if (mImportThread.joinable() && mbImportDone && (!bHaveMoreResults)) {
+        mImportThread.join();
+    }
+
+    // Show progress on the load button while importing and re-enable it once done
+    if (mpButton_LoadSample) {
+        if (mImportThread.joinable()) {
+            char progressStr[32];
+            std::snprintf(progressStr, sizeof(progressStr), (mbImportRefining) ? "HQ %u%%" : "%u%%", mImportProgress.load());
+            mpButton_LoadSample->SetLabelStr(progressStr);
+        } else if (mpButton_LoadSample->IsDisabled() && (!IsSampleImportInProgress())) {
+            mpButton_LoadSample->SetLabelStr("Load");
+            mpButton_LoadSample->SetDisabled(false);
+        }
+    }
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Compute the left/right volume for an SPU voice given the instrument volume (0-127) and pan (0-127, 64 = center) and the velocity
-// that the note was sounded with, from 0-127.
+// Stops any sample import in progress and waits for the import thread to finish up
 //------------------------------------------------------------------------------------------------------------------------------------------
-Spu::Volume PsxSampler::CalcSpuVoiceVolume(const uint32_t volume, const uint32_t pan, const uint32_t velocity) noexcept {
-    const float volumeF = std::min((float) volume / 127.0f, 1.0f);
-    const float velocityF = std::min((float) velocity / 127.0f, 1.0f);
-    const float scaleF = volumeF * velocityF;
-    const float panF = (pan < 64) ? ((float) pan - 64.0f) / 64.0f : std::min(((float) pan - 64.0f) / 63.0f, 1.0f);
-    const float volumeLF = ((1.0f - panF) / 2.0f) * scaleF;
-    const float volumeRF = ((1.0f + panF) / 2.0f) * scaleF;
-
-    return Spu::Volume{
-        (int16_t) std::round(volumeLF * (float) 0x7FFF),
-        (int16_t) std::round(volumeRF * (float) 0x7FFF)
-    };
+void PsxSampler::CancelSampleImport() noexcept {
+    if (mImportThread.joinable()) {
+        mbCancelImport = true;
+        mImportThread.join();
+    }
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Get the current SPU ADSR envelope to use, based on the instrument parameters
-//------------------------------------------------------------------------------------------------------------------------------------------
-Spu::AdsrEnvelope PsxSampler::GetCurrentSpuAdsrEnv() const noexcept {
-    const uint32_t attackStep = (uint32_t) GetParam(kParamAttackStep)->Value();
-    const uint32_t attackShift = (uint32_t) GetParam(kParamAttackShift)->Value();
-    const uint32_t attackIsExp = (uint32_t) GetParam(kParamAttackIsExp)->Value();
-    const uint32_t decayShift = (uint32_t) GetParam(kParamDecayShift)->Value();
-    const uint32_t sustainLevel = (uint32_t) GetParam(kParamSustainLevel)->Value();
-    const uint32_t sustainStep = (uint32_t) GetParam(kParamSustainStep)->Value();
-    const uint32_t sustainShift = (uint32_t) GetParam(kParamSustainShift)->Value();
-    const uint32_t sustainDec = (uint32_t) GetParam(kParamSustainDec)->Value();
-    const uint32_t sustainIsExp = (uint32_t) GetParam(kParamSustainIsExp)->Value();
-    const uint32_t releaseShift = (uint32_t) GetParam(kParamReleaseShift)->Value();
-    const uint32_t releaseIsExp = (uint32_t) GetParam(kParamReleaseIsExp)->Value();
-
-    Spu::AdsrEnvelope adsrEnv = {};
-    adsrEnv.sustainLevel = sustainLevel;
-    adsrEnv.decayShift = decayShift;
-    adsrEnv.attackStep = attackStep;
-    adsrEnv.attackShift = attackShift;
-    adsrEnv.bAttackExp = attackIsExp;
-    adsrEnv.releaseShift = releaseShift;
-    adsrEnv.bReleaseExp = releaseIsExp;
-    adsrEnv.sustainStep = sustainStep;
-    adsrEnv.sustainShift = sustainShift;
-    adsrEnv.bSustainDec = sustainDec;
-    adsrEnv.bSustainExp = sustainIsExp;
-
-    return adsrEnv;
+// Swaps in a newly imported SPU RAM image, if there is one waiting.
+// The SPU lock must be held when calling this; the old image is freed later on the UI thread.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void PsxSampler::SwapInPendingSpuRam() noexcept {
+    std::byte* const pNewSpuRam = mpPendingSpuRam.exchange(nullptr);
+
+    if (pNewSpuRam) {
+        if (!mbPendingKeepVoices) {
+            mEngine.killAllVoices();
+        }
+
+        mpRetiredSpuRam = mSpu.pRam;
+        mSpu.pRam = pNewSpuRam;
+    }
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Return how many semitones of pitch bend are currently being applied based on the current MIDI pitch bend value and the pitchbend range
+// Load a VAB sound bank from a .vab file or a .vh file (with the .vb file alongside it) and make it replace the instrument's sample.
+// The bank is opened and all of it's samples are uploaded to a new SPU RAM image without the SPU lock held, so reading the bank from disk
+// never stalls the audio thread; only swapping in the bank and the image is done under the lock.
+// Each MIDI channel plays the given program; if a program is not used by the bank then the first program that is used is selected.
+// Must be called without the SPU lock held.
 //------------------------------------------------------------------------------------------------------------------------------------------
-float PsxSampler::GetCurrentPitchBendInNotes() const noexcept {
-    // Get the range of the pitch bend in semitones
-    const float pitchstepUp = (float) GetParam(kParamPitchstepUp)->Value();
-    const float pitchstepDown = (float) GetParam(kParamPitchstepDown)->Value();
+bool PsxSampler::LoadSampleBank(
+    const std::string& filePath,
+    const uint8_t (&channelPrograms)[SamplerEngine::kNumMidiChannels],
+    std::string& errorMsgOut
+) noexcept {
+    std::unique_ptr<SamplerEngine::SampleBank> pBank = SamplerEngine::openSampleBank(filePath, channelPrograms[0], errorMsgOut);
 
-    // Get the clamped MIDI pitch bend
-    const uint32_t midiPitchBend = std::min<uint32_t>(mCurMidiPitchBend, PITCH_BEND_MAX);
+    if (!pBank)
+        return false;
 
-    // Get the normalized pitch bend in a -1.0 to +1.0 range:
-    const float pitchBendNormalized = (midiPitchBend < PITCH_BEND_CENTER) ?
-        ((float) mCurMidiPitchBend - (float) PITCH_BEND_CENTER) / (float)(PITCH_BEND_CENTER) :
-        ((float) mCurMidiPitchBend - (float) PITCH_BEND_CENTER) / (float)(PITCH_BEND_CENTER - 1);
+    for (uint8_t channel = 0; channel < SamplerEngine::kNumMidiChannels; ++channel) {
+        pBank->channelPrograms[channel] = SamplerEngine::getUsedBankProgram(pBank->vab, channelPrograms[channel]);
+    }
 
-    // Figure out the semitone pitch bend and return
-    float pitchBendOffset = 0.0f;
+    std::byte* pSpuRam = new std::byte[kSpuRamSize];
+    SamplerEngine::uploadSampleBank(*pBank, pSpuRam, kSpuRamSize);
 
-    if (midiPitchBend < PITCH_BEND_CENTER) {
-        pitchBendOffset -= (float) GetParam(kParamPitchBendDownOffset)->Value();
-    } else if (midiPitchBend > PITCH_BEND_CENTER) {
-        pitchBendOffset += (float) GetParam(kParamPitchBendUpOffset)->Value();
+    // Swap in the new bank and it's SPU RAM image, clearing out the instrument's own sample: SPU RAM now belongs to the bank.
+    // The old bank (if any) and the old SPU RAM image are freed outside of the SPU lock.
+    {
+        std::lock_guard<std::recursive_mutex> lockSpu(mSpuMutex);
+        GetParam(kParamLengthInSamples)->Set(0.0);
+        GetParam(kParamLengthInBlocks)->Set(0.0);
+        GetParam(kParamLoopStartSample)->Set(0.0);
+        GetParam(kParamLoopEndSample)->Set(0.0);
+        mEngine.swapSampleBank(pBank);
+        std::swap(mSpu.pRam, pSpuRam);
+        mpSavedSampleBlob.reset();
     }
 
-    const float scaledPitchBend = (pitchBendNormalized < 0) ? pitchBendNormalized * pitchstepDown : pitchBendNormalized * pitchstepUp;
-    const float totalPitchBend = scaledPitchBend + pitchBendOffset;
-    return totalPitchBend;
+    delete[] pSpuRam;
+    return true;
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Prompt the user to load a sample in .vag file and load it if a choice is made
+// Unload the current sound bank, if there is one
 //------------------------------------------------------------------------------------------------------------------------------------------
-void PsxSampler::DoLoadVagFilePrompt(IGraphics& graphics) noexcept {
-    // Prompt for the file to open and abort if none is chosen
+void PsxSampler::UnloadSampleBank() noexcept {
+    std::unique_ptr<SamplerEngine::SampleBank> pOldBank;
+
+    {
+        std::lock_guard<std::recursive_mutex> lockSpu(mSpuMutex);
+        mEngine.swapSampleBank(pOldBank);
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Prompt the user for a .seq or .sep music sequence file to load and load it if a choice is made
+//------------------------------------------------------------------------------------------------------------------------------------------
+void PsxSampler::DoLoadSongFilePrompt(IGraphics& graphics) noexcept {
     WDL_String filePath;
     WDL_String fileDir;
-    graphics.PromptForFile(filePath, fileDir, EFileAction::Open, "vag");
-    
+    graphics.PromptForFile(filePath, fileDir, EFileAction::Open, "seq sep");
+
     if (filePath.GetLength() <= 0)
         return;
 
-    // Read the VAG file
-    std::vector<std::byte> adpcmData;
-    uint32_t sampleRate = {};
-    std::string loadErrorMsg;
+    std::string errorMsg;
 
-    if (!VagUtils::readVagFile(filePath.Get(), adpcmData, sampleRate, loadErrorMsg)) {
-        graphics.ShowMessageBox("Unable to read the PlayStation 1 format VAG file.\nFile may be corrupt or invalid!", "Error!", EMsgBoxType::kMB_OK);
-        return;
+    if (!LoadSong(filePath.Get(), errorMsg)) {
+        graphics.ShowMessageBox(errorMsg.c_str(), "Error!", EMsgBoxType::kMB_OK);
+    }
+
+    UpdateSongLabel();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Load a .seq or .sep music sequence file, ready to be played through the sampler.
+// The sequences are normally played with the sound bank they were made for, which must be loaded separately.
+// Stops any sequence that is currently playing.
+//------------------------------------------------------------------------------------------------------------------------------------------
+bool PsxSampler::LoadSong(const std::string& filePath, std::string& errorMsgOut) noexcept {
+    std::unique_ptr<SeqPlayer::Song> pSong = SeqPlayer::openSong(filePath, errorMsgOut);
+
+    if (!pSong)
+        return false;
+
+    // Swap in the new song: the old song (if any) is freed outside of the SPU lock
+    {
+        std::lock_guard<std::recursive_mutex> lockSpu(mSpuMutex);
+        mSeqPlayer.swapSong(pSong);
+        mSeqFramesToUpdate = 0;
     }
 
-    // Decode to figure out where the loop points are in the VAG file
-    std::vector<int16_t> pcmSamples;
-    uint32_t loopStartSample = {};
-    uint32_t loopEndSample = {};
-    VagUtils::decodePsxAdpcmSamples(adpcmData.data(), (uint32_t) adpcmData.size(), pcmSamples, loopStartSample, loopEndSample);
+    mSeqIdx = 0;
+    return true;
+}
 
-    // Clamp the length of the VAG file to be within the RAM size of the SPU
-    const uint32_t numAdpcmBlocks = std::min((uint32_t) adpcmData.size(), kSpuRamSize) / Spu::ADPCM_BLOCK_SIZE;
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Start playing the selected sequence in the loaded song from the beginning, looping it until stopped
+//------------------------------------------------------------------------------------------------------------------------------------------
+void PsxSampler::PlaySong() noexcept {
+    std::lock_guard<std::recursive_mutex> lockSpu(mSpuMutex);
+    mSeqPlayer.play(mSeqIdx, 0);
+    mSeqFramesToUpdate = 0;
+}
 
-    // Update sample related parameters and lock the SPU at this point
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Stop playing the loaded song, if playing
+//------------------------------------------------------------------------------------------------------------------------------------------
+void PsxSampler::StopSong() noexcept {
     std::lock_guard<std::recursive_mutex> lockSpu(mSpuMutex);
+    mSeqPlayer.stop();
+    mSeqFramesToUpdate = 0;
+}
 
-    GetParam(kParamSampleRate)->Set((double) sampleRate);
-    SetBaseNoteFromSampleRate();
-    GetParam(kParamLengthInSamples)->Set((double) pcmSamples.size());
-    GetParam(kParamLengthInBlocks)->Set((double) numAdpcmBlocks);
-    GetParam(kParamLoopStartSample)->Set((double) loopStartSample);
-    GetParam(kParamLoopEndSample)->Set((double) loopEndSample);
-    GetUI()->SetAllControlsDirty();
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Select the previous or next sequence in the loaded song (for .sep files), wrapping around at either end.
+// If the song is playing then the newly selected sequence starts playing straight away.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void PsxSampler::SelectSongSequence(const int32_t seqIdxOffset) noexcept {
+    {
+        std::lock_guard<std::recursive_mutex> lockSpu(mSpuMutex);
+        const SeqPlayer::Song* const pSong = mSeqPlayer.getSong();
 
-    // Transfer the sound data to the SPU and terminate the sample
-    std::memcpy(mSpu.pRam, adpcmData.data(), (size_t) numAdpcmBlocks * Spu::ADPCM_BLOCK_SIZE);
-    AddSampleTerminator();
+        if (!pSong)
+            return;
 
-    // Kill all currently playing SPU voices
-    KillAllSpuVoices();
+        const int32_t numSequences = (int32_t) pSong->seqFile.sequences.size();
+        mSeqIdx = (uint32_t)((((int32_t) mSeqIdx + seqIdxOffset) % numSequences + numSequences) % numSequences);
+
+        if (mSeqPlayer.isPlaying()) {
+            PlaySong();
+        }
+    }
+
+    UpdateSongLabel();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Update the label showing the loaded song and which of it's sequences is selected
+//------------------------------------------------------------------------------------------------------------------------------------------
+void PsxSampler::UpdateSongLabel() noexcept {
+    if (!mpLabel_Song)
+        return;
+
+    std::lock_guard<std::recursive_mutex> lockSpu(mSpuMutex);
+    const SeqPlayer::Song* const pSong = mSeqPlayer.getSong();
+
+    if (!pSong) {
+        mpLabel_Song->SetStr("No .seq or .sep file loaded");
+        return;
+    }
+
+    const size_t fileNameStart = pSong->filePath.find_last_of("/\\");
+    const std::string fileName = (fileNameStart != std::string::npos) ? pSong->filePath.substr(fileNameStart + 1) : pSong->filePath;
+    const uint32_t numSequences = (uint32_t) pSong->seqFile.sequences.size();
+
+    char labelStr[256];
+    std::snprintf(labelStr, sizeof(labelStr), "%s (sequence %u of %u)", fileName.c_str(), mSeqIdx + 1, numSequences);
+    mpLabel_Song->SetStr(labelStr);
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
@@ -1024,6 +1457,7 @@ void PsxSampler::DoSaveVagFilePrompt(IGraphics& graphics) noexcept {
 
     // Save the VAG file
     std::lock_guard<std::recursive_mutex> lockSpu(mSpuMutex);
+    SwapInPendingSpuRam();
 
     if (!VagUtils::writePsxAdpcmSoundToVagFile(filePath.Get(), mSpu.pRam, numAdpcmBytes, sampleRate)) {
         graphics.ShowMessageBox("Unable to save to the specified .VAG file. Do you have write permissions or is the disk full?", "Error!", EMsgBoxType::kMB_OK);
@@ -1115,6 +1549,9 @@ void PsxSampler::DoLoadParamsFilePrompt(IGraphics& graphics) noexcept {
         SetSampleRateFromBaseNote();
     }
 
+    // Have the sampler engine pick up the new settings
+    mDirtyParams = kEngineParamsMask;
+
     // Make sure all displays on the UI are up to date
     mpCaption_SampleRate->SetValue(GetParam(kParamSampleRate)->GetNormalized());
     mpCaption_BaseNote->SetValue(GetParam(kParamBaseNote)->GetNormalized());
@@ -1218,70 +1655,14 @@ void PsxSampler::DoSaveParamsFilePrompt(IGraphics& graphics) noexcept {
 //------------------------------------------------------------------------------------------------------------------------------------------
 void PsxSampler::SetBaseNoteFromSampleRate() noexcept {
     const uint32_t sampleRate = (uint32_t) GetParam(kParamSampleRate)->Value();
-
-    if (sampleRate <= 22050.0) {
-        const double octavesDiff = std::log2(22050.0 / (double) sampleRate);
-        const double baseNote = 60.0 + octavesDiff * 12.0;
-        const double baseNoteRounded = std::round(baseNote * 256.0) / 256.0;    // Round to 1/256 increments
-        GetParam(kParamBaseNote)->Set(baseNoteRounded);
-    } else {
-        const double octavesDiff = std::log2((double) sampleRate / 22050.0);
-        const double baseNote = 60.0 - octavesDiff * 12.0;
-        const double baseNoteRounded = std::round(baseNote * 256.0) / 256.0;    // Round to 1/256 increments
-        GetParam(kParamBaseNote)->Set(baseNoteRounded);
-    }
+    GetParam(kParamBaseNote)->Set(SamplerEngine::getBaseNoteForSampleRate((double) sampleRate));
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Set the sample rate value from the base note
 //------------------------------------------------------------------------------------------------------------------------------------------
 void PsxSampler::SetSampleRateFromBaseNote() noexcept {
-    const double sampleRate = GetNoteSampleRate(GetParam(kParamBaseNote)->Value(), 22050.0, 60.0);
+    const double sampleRate = SamplerEngine::getSampleRateForBaseNote(GetParam(kParamBaseNote)->Value());
     const double sampleRateRounded = std::round(sampleRate);
     GetParam(kParamSampleRate)->Set(sampleRateRounded);
 }
-
-//------------------------------------------------------------------------------------------------------------------------------------------
-// Do 'note off' for any notes that are now out of range according to the note min/max settings
-//------------------------------------------------------------------------------------------------------------------------------------------
-void PsxSampler::DoNoteOffForOutOfRangeNotes() noexcept {
-    // Release any notes that are playing, not already releasing and which are now out of range...
-    const uint32_t minNote = (uint32_t) GetParam(kParamNoteMin)->Value();
-    const uint32_t maxNote = (uint32_t) GetParam(kParamNoteMax)->Value();
-
-    for (uint32_t i = 0; i < kMaxVoices; ++i) {
-        const uint16_t note = mVoiceInfos[i].midiNote;
-
-        if ((note < minNote) || (note > maxNote)) {
-            Spu::Voice& voice = mSpu.pVoices[i];
-
-            if ((voice.envPhase != Spu::EnvPhase::Release) && (voice.envPhase != Spu::EnvPhase::Off)) {
-                Spu::keyOff(voice);
-            }
-        }
-    }
-}
-
-//------------------------------------------------------------------------------------------------------------------------------------------
-// Keys off all currently playing SPU voices which are not already keying off
-//------------------------------------------------------------------------------------------------------------------------------------------
-void PsxSampler::KeyOffAllSpuVoices() noexcept {
-    for (uint32_t i = 0; i < kMaxVoices; ++i) {
-        Spu::Voice& voice = mSpu.pVoices[i];
-
-        if ((voice.envPhase != Spu::EnvPhase::Release) && (voice.envPhase != Spu::EnvPhase::Off)) {
-            Spu::keyOff(voice);
-        }
-    }
-}
-
-//------------------------------------------------------------------------------------------------------------------------------------------
-// Kills all currently playing SPU voices
-//------------------------------------------------------------------------------------------------------------------------------------------
-void PsxSampler::KillAllSpuVoices() noexcept {
-    for (uint32_t i = 0; i < kMaxVoices; ++i) {
-        Spu::Voice& voice = mSpu.pVoices[i];
-        voice.envLevel = 0;
-        voice.envPhase = Spu::EnvPhase::Off;
-    }
-}
@@ -3,8 +3,16 @@
 #include "IPlug_include_in_plug_hdr.h"
 
 #include "IControls.h"
-#include "../../PluginsCommon/Spu.h"
+#include "../../PluginsCommon/BlobCache.h"
+#include "../../PluginsCommon/DspTelemetryControl.h"
+#include "../../PluginsCommon/SamplerEngine.h"
+#include "../../PluginsCommon/SeqPlayer.h"
+#include <atomic>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 using namespace iplug;
 using namespace igraphics;
@@ -43,6 +51,13 @@ enum EParams : uint32_t {
     kNumParams
 };
 
+// The parameters which affect the sampler engine settings, as a mask of parameter bits: the rest are purely informational
+static constexpr uint32_t kEngineParamsMask = ((1u << kNumParams) - 1u) & ~(
+    (1u << kParamLengthInSamples) | (1u << kParamLengthInBlocks) | (1u << kParamLoopStartSample) | (1u << kParamLoopEndSample)
+);
+
+static_assert(kNumParams <= 32, "Parameter dirty bits must fit in 32-bits!");
+
 //------------------------------------------------------------------------------------------------------------------------------------------
 // UI control identifiers
 //------------------------------------------------------------------------------------------------------------------------------------------
@@ -50,6 +65,7 @@ enum EControlTags : uint32_t {
     kCtrlTagMeter = 0,
     kCtrlTagKeyboard,
     kCtrlTagBender,
+    kCtrlTagTelemetry,
     kNumCtrlTags
 };
 
@@ -58,32 +74,63 @@ enum EControlTags : uint32_t {
 //------------------------------------------------------------------------------------------------------------------------------------------
 class PsxSampler final : public Plugin {
 public:
-    // Maximum number of active voices: this is the hardware limit of the PS1
-    static constexpr uint32_t kMaxVoices = 24;
-
     PsxSampler(const InstanceInfo& info) noexcept;
     virtual ~PsxSampler() noexcept override;
 
     virtual void ProcessBlock(sample** pInputs, sample** pOutputs, int numFrames) noexcept override;
     virtual void ProcessMidiMsg(const IMidiMsg& msg) noexcept override;
     virtual void OnIdle() noexcept override;
+    virtual void OnUIClose() noexcept override;
     virtual bool SerializeState(IByteChunk &chunk) const noexcept override;
     virtual int UnserializeState(const IByteChunk &chunk, int startPos) noexcept override;
 
 private:
-    // Information for a playing voice
-    struct VoiceInfo {
-        uint16_t midiNote;            // The note played
-        uint16_t midiVelocity;        // 0-127 velocity
-        uint32_t numSamplesActive;    // Number of samples the voice has been active for
+    // The type of SPU used by the sampler: the one driven by the shared sampler engine
+    typedef SamplerEngine::SpuStereoSample  SpuStereoSample;
+    typedef SamplerEngine::SpuCore          SpuCore;
+
+    // The result of importing a sample on the background import thread.
+    // Contains a complete SPU RAM image for the new sample and the parameters that go with it.
+    // PCM imports produce two results: a quick draft encoding followed by a full quality re-encode of the same sound.
+    struct SampleImport {
+        std::byte*      pSpuRam;            // New SPU RAM image with the sample and it's terminator, or null if the import failed
+        uint32_t        sampleRate;
+        uint32_t        lengthInSamples;
+        uint32_t        lengthInBlocks;
+        uint32_t        loopStartSample;
+        uint32_t        loopEndSample;
+        bool            bIsRefinement;      // If set then this replaces the previous result with a better encoding of the same sound
+        std::string     errorMsg;
     };
 
-    Spu::Core                       mSpu;
+    SpuCore                         mSpu;
     mutable std::recursive_mutex    mSpuMutex;
-    uint32_t                        mCurMidiPitchBend;        // Current MIDI pitch bend value, a 14-bit value: 0x2000 = center, 0x0000 = lowest, 0x3FFF = highest
-    VoiceInfo                       mVoiceInfos[kMaxVoices];
+    SamplerEngine                   mEngine;                  // Turns MIDI into SPU voice updates, including for sound banks: guarded by the SPU lock
+    std::atomic<uint32_t>           mDirtyParams;             // A bit for each parameter changed since the engine settings were last updated
+    SeqPlayer                       mSeqPlayer;               // Plays SEQ/SEP music sequences through the engine: guarded by the SPU lock
+    uint32_t                        mSeqFramesToUpdate;       // Frames left until the sequence player must be updated again: guarded by the SPU lock
+    uint32_t                        mSeqIdx;                  // Which sequence in the loaded .seq/.sep file to play: UI thread only
     IPeakSender<2>                  mMeterSender;
+    DspTelemetry                    mTelemetry;               // Measures the cost of processing each block: audio thread only, apart from resets
+    DspTelemetry::Clock::time_point mTelemetryBlockStartTime; // When the host block being timed started: audio thread only
+    DspTelemetry::BlockCounters     mTelemetryCounters;       // Counters for the host block being timed: audio thread only
+    uint32_t                        mTelemetryBlockFrames;    // Frames of the host block processed so far, zero if none: audio thread only
+    DspTelemetryControl::Sender     mTelemetrySender;         // Sends the telemetry statistics to the UI
     IMidiQueue                      mMidiQueue;
+    std::thread                     mImportThread;            // Background thread importing a sample, if an import is in progress
+    std::mutex                      mImportResultMutex;       // Guards the import result: never locked by the audio thread
+    SampleImport                    mImportResult;            // The latest import result, waiting to be picked up by the UI thread
+    bool                            mbHaveImportResult;       // Whether 'mImportResult' holds a result
+    std::atomic<uint32_t>           mImportProgress;          // Progress of the current import stage from 0-100
+    std::atomic<bool>               mbImportRefining;         // Set while a full quality re-encode of a PCM import is being done
+    std::atomic<bool>               mbImportDone;             // Set by the import thread when it is finished
+    std::atomic<bool>               mbCancelImport;           // Requests the import thread to stop early
+    std::atomic<std::byte*>         mpPendingSpuRam;          // New SPU RAM image waiting to be swapped in by the audio thread
+    std::atomic<bool>               mbPendingKeepVoices;      // Don't kill playing voices when swapping in the pending image (same sound)
+    std::atomic<std::byte*>         mpRetiredSpuRam;          // Old SPU RAM image swapped out by the audio thread, freed on the UI thread
+    mutable BlobCache::CompressedBlobPtr mpSavedSampleBlob;   // Compressed sample last saved or restored: keeps it cached for the next save
+    IVButtonControl*                mpButton_LoadSample;
+    IVLabelControl*                 mpLabel_Song;
     ICaptionControl*                mpCaption_SampleRate;
     ICaptionControl*                mpCaption_BaseNote;
     IVKnobControl*                  mpKnob_Volume;
@@ -111,25 +158,40 @@ private:
     void DoDspSetup() noexcept;
     virtual void InformHostOfParamChange(int idx, double normalizedValue) noexcept override;
     virtual void OnRestoreState() noexcept override;
+    virtual void OnParamChange(int paramIdx) noexcept override;
     void AddSampleTerminator() noexcept;
-    void ProcessMidiQueue() noexcept;
-    void ProcessQueuedMidiMsg(const IMidiMsg& msg) noexcept;
-    void ProcessMidiNoteOn(const uint8_t note, const uint8_t velocity) noexcept;
-    void ProcessMidiNoteOff(const uint8_t note) noexcept;
-    void ProcessMidiPitchBend(const uint16_t pitchBend) noexcept;
-    void ProcessMidiAllNotesOff() noexcept;
-    void UpdateSpuVoicesFromParams() noexcept;
-    void UpdateSpuVoiceFromParams(const uint32_t voiceIdx) noexcept;
-    static Spu::Volume CalcSpuVoiceVolume(const uint32_t volume, const uint32_t pan, const uint32_t velocity) noexcept;
-    Spu::AdsrEnvelope GetCurrentSpuAdsrEnv() const noexcept;
-    float GetCurrentPitchBendInNotes() const noexcept;
+    void ProcessMidiQueue(const int frameIdx) noexcept;
+    void UpdateEngineSettings() noexcept;
+    SamplerEngine::Settings GetCurrentEngineSettings() const noexcept;
     void DoLoadVagFilePrompt(IGraphics& graphics) noexcept;
+    bool IsSampleImportInProgress() const noexcept;
+    void RunSampleImport(const std::string& filePath, const uint32_t pcmSampleRate) noexcept;
+    void ImportVagSample(const std::byte* const pFileData, const size_t fileSize) noexcept;
+    void ImportPcmSample(const std::byte* const pFileData, const size_t fileSize, const uint32_t sampleRate) noexcept;
+    void PublishSampleImport(SampleImport& result) noexcept;
+    static std::byte* MakeSampleSpuRamImage(const std::byte* const pAdpcmData, const uint32_t numAdpcmBytes, const uint32_t numAdpcmBlocks) noexcept;
+    void UpdateSampleImport() noexcept;
+    void CancelSampleImport() noexcept;
+    void SwapInPendingSpuRam() noexcept;
+    bool SerializeSampleData(IByteChunk& chunk, const uint32_t numAdpcmBytes) const noexcept;
+    bool SerializeSampleBank(IByteChunk& chunk) const noexcept;
+    int UnserializeSampleData(const IByteChunk& chunk, const int startPos, const uint32_t numAdpcmBytes) noexcept;
+    int UnserializeSampleBank(const IByteChunk& chunk, const int startPos) noexcept;
+    bool LoadSampleBank(
+        const std::string& filePath,
+        const uint8_t (&channelPrograms)[SamplerEngine::kNumMidiChannels],
+        std::string& errorMsgOut
+    ) noexcept;
+    void UnloadSampleBank() noexcept;
     void DoSaveVagFilePrompt(IGraphics& graphics) noexcept;
+    void DoLoadSongFilePrompt(IGraphics& graphics) noexcept;
+    bool LoadSong(const std::string& filePath, std::string& errorMsgOut) noexcept;
+    void PlaySong() noexcept;
+    void StopSong() noexcept;
+    void SelectSongSequence(const int32_t seqIdxOffset) noexcept;
+    void UpdateSongLabel() noexcept;
     void DoLoadParamsFilePrompt(IGraphics& graphics) noexcept;
     void DoSaveParamsFilePrompt(IGraphics& graphics) noexcept;
     void SetBaseNoteFromSampleRate() noexcept;
     void SetSampleRateFromBaseNote() noexcept;
-    void DoNoteOffForOutOfRangeNotes() noexcept;
-    void KeyOffAllSpuVoices() noexcept;
-    void KillAllSpuVoices() noexcept;
 };
@@ -0,0 +1,151 @@
+//------------------------------------------------------------------------------------------------------------------------------------------
+// A process wide cache of zlib compressed data blobs
+//------------------------------------------------------------------------------------------------------------------------------------------
+#include "BlobCache.h"
+
+#include "Asserts.h"
+
+#include "fnv64.h"
+#include "zlib.h"
+
+#include <mutex>
+#include <unordered_map>
+
+BEGIN_NAMESPACE(BlobCache)
+
+// All cached blobs by content hash, and a lock guarding the cache.
+// Note: the blobs are held weakly so that they are freed once the last user is done with them.
+static std::mutex                                                   gCacheMutex;
+static std::unordered_map<uint64_t, std::weak_ptr<const CompressedBlob>> gCache;
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Helper: find a cached blob matching the given hash and size, or return null if there is none.
+// Also prunes expired cache entries every so often. The cache lock must be held when calling this.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static CompressedBlobPtr findCachedBlob(const uint64_t contentHash, const uint32_t uncompressedSize) noexcept {
+    // Prune expired entries if the cache has grown a bit: stops it growing forever with samples that are no longer in use
+    if (gCache.size() >= 64) {
+        for (auto iter = gCache.begin(); iter != gCache.end();) {
+            iter = (iter->second.expired()) ? gCache.erase(iter) : std::next(iter);
+        }
+    }
+
+    const auto iter = gCache.find(contentHash);
+
+    if (iter != gCache.end()) {
+        CompressedBlobPtr pBlob = iter->second.lock();
+
+        if (pBlob && (pBlob->uncompressedSize == uncompressedSize))
+            return pBlob;
+    }
+
+    return {};
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Compute the content hash for the given data (64-bit FNV-1)
+//------------------------------------------------------------------------------------------------------------------------------------------
+uint64_t hashData(const std::byte* const pData, const uint32_t size) noexcept {
+    ASSERT(pData || (size == 0));
+    return WDL_FNV64(WDL_FNV64_IV, (const unsigned char*) pData, (int) size);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Get the compressed blob for the given data and content hash.
+// Returns the cached blob if there is one already, otherwise compresses the data and adds it to the cache.
+// Returns null if compression fails.
+//------------------------------------------------------------------------------------------------------------------------------------------
+CompressedBlobPtr getCompressedBlob(
+    const std::byte* const pData,
+    const uint32_t size,
+    const uint64_t contentHash
+) noexcept {
+    ASSERT(pData || (size == 0));
+
+    {
+        std::lock_guard<std::mutex> lockCache(gCacheMutex);
+        CompressedBlobPtr pBlob = findCachedBlob(contentHash, size);
+
+        if (pBlob)
+            return pBlob;
+    }
+
+    // Not cached: compress outside of the lock since it can take a while
+    try {
+        std::shared_ptr<CompressedBlob> pNewBlob = std::make_shared<CompressedBlob>();
+        pNewBlob->contentHash = contentHash;
+        pNewBlob->uncompressedSize = size;
+
+        uLongf compressedSize = compressBound((uLong) size);
+        pNewBlob->bytes.resize(compressedSize);
+
+        if (compress2((Bytef*) pNewBlob->bytes.data(), &compressedSize, (const Bytef*) pData, (uLong) size, Z_DEFAULT_COMPRESSION) != Z_OK)
+            return {};
+
+        pNewBlob->bytes.resize(compressedSize);
+        pNewBlob->bytes.shrink_to_fit();
+
+        // Add to the cache, unless another thread beat us to it
+        std::lock_guard<std::mutex> lockCache(gCacheMutex);
+        CompressedBlobPtr pBlob = findCachedBlob(contentHash, size);
+
+        if (pBlob)
+            return pBlob;
+
+        gCache[contentHash] = pNewBlob;
+        return pNewBlob;
+    } catch (...) {
+        return {};
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Add already compressed data to the cache (data read back from saved state, for example) and return the cached blob.
+// If the cache already holds a blob for the same content then that is returned instead.
+// Returns null if memory can't be allocated.
+//------------------------------------------------------------------------------------------------------------------------------------------
+CompressedBlobPtr addCompressedBlob(
+    const std::byte* const pCompressedData,
+    const uint32_t compressedSize,
+    const uint32_t uncompressedSize,
+    const uint64_t contentHash
+) noexcept {
+    ASSERT(pCompressedData || (compressedSize == 0));
+
+    try {
+        std::lock_guard<std::mutex> lockCache(gCacheMutex);
+        CompressedBlobPtr pBlob = findCachedBlob(contentHash, uncompressedSize);
+
+        if (pBlob)
+            return pBlob;
+
+        std::shared_ptr<CompressedBlob> pNewBlob = std::make_shared<CompressedBlob>();
+        pNewBlob->contentHash = contentHash;
+        pNewBlob->uncompressedSize = uncompressedSize;
+        pNewBlob->bytes.assign(pCompressedData, pCompressedData + compressedSize);
+        gCache[contentHash] = pNewBlob;
+        return pNewBlob;
+    } catch (...) {
+        return {};
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Decompress the given zlib compressed data to the given output buffer.
+// Returns 'false' on failure or if the data does not decompress to exactly the expected size.
+//------------------------------------------------------------------------------------------------------------------------------------------
+bool decompressBlob(
+    const std::byte* const pCompressedData,
+    const uint32_t compressedSize,
+    std::byte* const pDataOut,
+    const uint32_t uncompressedSize
+) noexcept {
+    ASSERT(pCompressedData || (compressedSize == 0));
+    ASSERT(pDataOut || (uncompressedSize == 0));
+
+    uLongf outputSize = uncompressedSize;
+    const int result = uncompress((Bytef*) pDataOut, &outputSize, (const Bytef*) pCompressedData, (uLong) compressedSize);
+    return ((result == Z_OK) && (outputSize == uncompressedSize));
+}
+
+END_NAMESPACE(BlobCache)
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Macros.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// A process wide cache of zlib compressed data blobs, keyed by a hash of their uncompressed contents.
+// Lets plugin instances holding identical data (the same sample loaded in several instances, for example) share one compressed copy
+// and avoid compressing the same data over and over again each time the host saves state.
+// Entries are only kept alive for as long as somebody holds a reference to the blob.
+//------------------------------------------------------------------------------------------------------------------------------------------
+BEGIN_NAMESPACE(BlobCache)
+
+// Holds a compressed blob of data
+struct CompressedBlob {
+    uint64_t                contentHash;        // Hash of the uncompressed data
+    uint32_t                uncompressedSize;   // Size of the uncompressed data
+    std::vector<std::byte>  bytes;              // The compressed data
+};
+
+typedef std::shared_ptr<const CompressedBlob> CompressedBlobPtr;
+
+uint64_t hashData(const std::byte* const pData, const uint32_t size) noexcept;
+
+CompressedBlobPtr getCompressedBlob(
+    const std::byte* const pData,
+    const uint32_t size,
+    const uint64_t contentHash
+) noexcept;
+
+CompressedBlobPtr addCompressedBlob(
+    const std::byte* const pCompressedData,
+    const uint32_t compressedSize,
+    const uint32_t uncompressedSize,
+    const uint64_t contentHash
+) noexcept;
+
+bool decompressBlob(
+    const std::byte* const pCompressedData,
+    const uint32_t compressedSize,
+    std::byte* const pDataOut,
+    const uint32_t uncompressedSize
+) noexcept;
+
+END_NAMESPACE(BlobCache)
@@ -0,0 +1,143 @@
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Measures the cost of a plugin's audio processing: see the header for details
+//------------------------------------------------------------------------------------------------------------------------------------------
+#include "DspTelemetry.h"
+
+#include <algorithm>
+#include <iterator>
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Creates the telemetry with all statistics zeroed
+//------------------------------------------------------------------------------------------------------------------------------------------
+DspTelemetry::DspTelemetry() noexcept
+    : mbResetRequested(false)
+    , mWindowDuration(0.0)
+    , mWindowProcessTime(0.0)
+    , mWindowMinLoad(0.0f)
+    , mWindowMaxLoad(0.0f)
+    , mWindowMaxBlockMicroseconds(0.0f)
+    , mWindowNumBlocks(0)
+    , mWindowMaxActiveVoices(0)
+    , mWindowNumReverbTicks(0)
+    , mWindowMaxMidiQueueDepth(0)
+    , mNumDeadlineMisses(0)
+    , mNumVoiceSteals(0)
+    , mLastVoiceStealCount(0)
+    , mLoadHistogram()
+{
+    resetWindow();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Request that the totals (deadline misses and voice steals) and the current window be reset before the next block is counted.
+// Can be called from any thread, typically when the user clicks on the telemetry display.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void DspTelemetry::requestReset() noexcept {
+    mbResetRequested = true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Count a processing block which started at the given time and has just finished.
+// Returns true and the window's statistics if this block completes a window.
+//------------------------------------------------------------------------------------------------------------------------------------------
+bool DspTelemetry::endBlock(
+    const Clock::time_point blockStartTime,
+    const uint32_t numFrames,
+    const double sampleRate,
+    const BlockCounters& counters,
+    Stats& statsOut
+) noexcept {
+    const Clock::time_point blockEndTime = Clock::now();
+
+    if (mbResetRequested.exchange(false)) {
+        mNumDeadlineMisses = 0;
+        mNumVoiceSteals = 0;
+        resetWindow();
+    }
+
+    // Voice steals are reported as a running total by the engine: note that this handles the total wrapping around
+    mNumVoiceSteals += counters.numVoiceSteals - mLastVoiceStealCount;
+    mLastVoiceStealCount = counters.numVoiceSteals;
+
+    // Blocks with no audio (or before the sample rate is known) have no deadline, so only their counters are used
+    if ((numFrames > 0) && (sampleRate > 0.0)) {
+        const double blockDuration = (double) numFrames / sampleRate;
+        const double processTime = std::chrono::duration<double>(blockEndTime - blockStartTime).count();
+        const float load = (float)(processTime / blockDuration);
+
+        mWindowMinLoad = (mWindowNumBlocks > 0) ? std::min(mWindowMinLoad, load) : load;
+        mWindowMaxLoad = std::max(mWindowMaxLoad, load);
+        mWindowMaxBlockMicroseconds = std::max(mWindowMaxBlockMicroseconds, (float)(processTime * 1000000.0));
+        mWindowDuration += blockDuration;
+        mWindowProcessTime += processTime;
+        mWindowNumBlocks++;
+
+        const uint32_t bucketIdx = (uint32_t) std::min(load * 100.0f, (float)(kNumLoadBuckets - 1));
+        mLoadHistogram[bucketIdx]++;
+
+        if (processTime > blockDuration) {
+            mNumDeadlineMisses++;
+        }
+    }
+
+    mWindowMaxActiveVoices = std::max(mWindowMaxActiveVoices, counters.numActiveVoices);
+    mWindowNumReverbTicks += counters.numReverbTicks;
+    mWindowMaxMidiQueueDepth = std::max(mWindowMaxMidiQueueDepth, counters.midiQueueDepth);
+
+    if (mWindowDuration < kWindowSeconds)
+        return false;
+
+    // The window is complete: find the 99th percentile from the histogram, rounding up to the top of the bucket it falls in
+    const uint32_t p99BlockCount = mWindowNumBlocks - mWindowNumBlocks / 100;
+    uint32_t numBlocksCounted = 0;
+    uint32_t p99BucketIdx = 0;
+
+    for (; p99BucketIdx < kNumLoadBuckets - 1; ++p99BucketIdx) {
+        numBlocksCounted += mLoadHistogram[p99BucketIdx];
+
+        if (numBlocksCounted >= p99BlockCount)
+            break;
+    }
+
+    statsOut = {};
+    statsOut.numBlocks = mWindowNumBlocks;
+    statsOut.minLoad = mWindowMinLoad;
+    statsOut.avgLoad = (float)(mWindowProcessTime / mWindowDuration);
+    statsOut.maxLoad = mWindowMaxLoad;
+    statsOut.p99Load = std::min((float)(p99BucketIdx + 1) * 0.01f, mWindowMaxLoad);
+    statsOut.maxBlockMicroseconds = mWindowMaxBlockMicroseconds;
+    statsOut.numDeadlineMisses = mNumDeadlineMisses;
+    statsOut.numActiveVoices = counters.numActiveVoices;
+    statsOut.maxActiveVoices = mWindowMaxActiveVoices;
+    statsOut.numVoiceSteals = mNumVoiceSteals;
+    statsOut.numReverbTicks = mWindowNumReverbTicks;
+    statsOut.maxMidiQueueDepth = mWindowMaxMidiQueueDepth;
+
+    resetWindow();
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Tells how many times the SPU processed reverb while it's cycle count went from the given start value to the given end value.
+// The reverb is processed on every even cycle, since it runs at half the SPU's sample rate. Handles the cycle count wrapping around.
+//------------------------------------------------------------------------------------------------------------------------------------------
+uint32_t DspTelemetry::countReverbTicks(const uint32_t startCycleCount, const uint32_t endCycleCount) noexcept {
+    const uint32_t numCycles = endCycleCount - startCycleCount;
+    return ((startCycleCount & 1) == 0) ? (numCycles + 1) / 2 : numCycles / 2;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Start a new window of statistics
+//------------------------------------------------------------------------------------------------------------------------------------------
+void DspTelemetry::resetWindow() noexcept {
+    mWindowDuration = 0.0;
+    mWindowProcessTime = 0.0;
+    mWindowMinLoad = 0.0f;
+    mWindowMaxLoad = 0.0f;
+    mWindowMaxBlockMicroseconds = 0.0f;
+    mWindowNumBlocks = 0;
+    mWindowMaxActiveVoices = 0;
+    mWindowNumReverbTicks = 0;
+    mWindowMaxMidiQueueDepth = 0;
+    std::fill(std::begin(mLoadHistogram), std::end(mLoadHistogram), 0u);
+}
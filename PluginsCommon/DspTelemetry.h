@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Measures how expensive a plugin's audio processing is, so it can be shown to the user without attaching a profiler.
+//
+// The audio thread times each processing block and reports a few counters for it (active voices, voice steals etc.). The results are
+// gathered into windows of roughly 'kWindowSeconds' of audio; when a window is complete its statistics are returned to the caller, which
+// normally pushes them to the UI through a lock free queue. Processing times are measured as a fraction of the block's duration at the
+// current sample rate (the DSP load) and a block taking longer than its duration to process counts as a missed deadline.
+//
+// Collecting the statistics does no allocation or locking and is cheap enough to leave on all the time: two clock reads per block.
+// Not thread safe apart from 'requestReset', which may be called from any thread.
+//------------------------------------------------------------------------------------------------------------------------------------------
+class DspTelemetry {
+public:
+    // The clock used to time blocks: monotonic and high resolution on all supported platforms
+    typedef std::chrono::steady_clock   Clock;
+
+    // Roughly how much audio each window of statistics covers
+    static constexpr double kWindowSeconds = 0.25;
+
+    // Number of buckets in the DSP load histogram used to find the 99th percentile: 1% of the block duration per bucket.
+    // The last bucket catches all blocks that took this long or longer.
+    static constexpr uint32_t kNumLoadBuckets = 256;
+
+    // Counters for a single processing block, reported by the plugin
+    struct BlockCounters {
+        uint32_t    numActiveVoices;        // Voices playing at the end of the block
+        uint32_t    numVoiceSteals;         // Total voice steals so far: the difference from the last block is what's counted
+        uint32_t    numReverbTicks;         // How many times the reverb was processed during the block
+        uint32_t    midiQueueDepth;         // How many MIDI messages were waiting to be processed at the start of the block
+    };
+
+    // Statistics for a completed window
+    struct Stats {
+        uint32_t    numBlocks;              // How many blocks were processed in the window
+        float       minLoad;                // Smallest block processing time as a fraction of the block's duration
+        float       avgLoad;                // Total processing time as a fraction of the total duration of all blocks
+        float       maxLoad;                // Largest block processing time as a fraction of the block's duration
+        float       p99Load;                // 99% of blocks took no more than this fraction of their duration to process
+        float       maxBlockMicroseconds;   // Longest time taken to process a block, in microseconds
+        uint32_t    numDeadlineMisses;      // Total blocks since the last reset which took longer than their duration to process
+        uint32_t    numActiveVoices;        // Voices playing at the end of the window
+        uint32_t    maxActiveVoices;        // Most voices playing at the end of any block in the window
+        uint32_t    numVoiceSteals;         // Total voice steals since the last reset
+        uint32_t    numReverbTicks;         // How many times the reverb was processed during the window
+        uint32_t    maxMidiQueueDepth;      // Most MIDI messages waiting at the start of any block in the window
+    };
+
+    DspTelemetry() noexcept;
+
+    void requestReset() noexcept;
+    inline Clock::time_point beginBlock() const noexcept { return Clock::now(); }
+
+    bool endBlock(
+        const Clock::time_point blockStartTime,
+        const uint32_t numFrames,
+        const double sampleRate,
+        const BlockCounters& counters,
+        Stats& statsOut
+    ) noexcept;
+
+    static uint32_t countReverbTicks(const uint32_t startCycleCount, const uint32_t endCycleCount) noexcept;
+
+private:
+    void resetWindow() noexcept;
+
+    std::atomic<bool>   mbResetRequested;               // Set by other threads to request the totals be reset before the next block is counted
+    double              mWindowDuration;                // Total duration of the blocks in the current window, in seconds
+    double              mWindowProcessTime;             // Total time spent processing the blocks in the current window, in seconds
+    float               mWindowMinLoad;                 // Statistics for the current window: see 'Stats'
+    float               mWindowMaxLoad;
+    float               mWindowMaxBlockMicroseconds;
+    uint32_t            mWindowNumBlocks;
+    uint32_t            mWindowMaxActiveVoices;
+    uint32_t            mWindowNumReverbTicks;
+    uint32_t            mWindowMaxMidiQueueDepth;
+    uint32_t            mNumDeadlineMisses;             // Totals since the last reset
+    uint32_t            mNumVoiceSteals;
+    uint32_t            mLastVoiceStealCount;           // The voice steal count reported for the previous block
+    uint32_t            mLoadHistogram[kNumLoadBuckets];    // How many blocks in the current window fell into each DSP load bucket
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "DspTelemetry.h"
+
+#include "IControl.h"
+#include "ISender.h"
+
+#include <cstdio>
+#include <cstring>
+#include <functional>
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// A compact overlay showing the DSP load and voice statistics of a plugin instance, gathered by 'DspTelemetry' on the audio thread.
+//
+// The statistics arrive through an 'ISender' channel: the plugin pushes each completed window from the audio thread with 'Sender::PushData'
+// and transmits them to this control (by it's tag) from 'OnIdle'. DSP load is shown as a percentage of the block duration, so anything
+// over 100% is a missed deadline. The text turns red while deadlines are being missed, and clicking the overlay resets the totals.
+//------------------------------------------------------------------------------------------------------------------------------------------
+class DspTelemetryControl final : public iplug::igraphics::IControl {
+public:
+    // The sender used to send statistics to this control and the data it sends
+    typedef iplug::igraphics::ISender<1, 8, DspTelemetry::Stats>    Sender;
+    typedef iplug::igraphics::ISenderData<1, DspTelemetry::Stats>   SenderData;
+
+    // Labels for the voice, reverb and MIDI queue statistics: null to hide statistics that don't apply to the plugin
+    struct Labels {
+        const char*     pVoices;
+        const char*     pReverb;
+        const char*     pMidiQueue;
+    };
+
+    DspTelemetryControl(const iplug::igraphics::IRECT& bounds, const Labels& labels, const std::function<void()>& resetFunc) noexcept
+        : IControl(bounds)
+        , mLabels(labels)
+        , mResetFunc(resetFunc)
+        , mStats()
+        , mbHaveStats(false)
+        , mbMissingDeadlines(false)
+    {
+        SetTooltip("DSP load as a percentage of the block duration. Click to reset the totals.");
+    }
+
+    virtual void Draw(iplug::igraphics::IGraphics& g) override {
+        using namespace iplug::igraphics;
+
+        g.FillRect(IColor(160, 0, 0, 0), mRECT);
+
+        const IText text = IText(12.0f, EVAlign::Middle)
+            .WithFGColor((mbMissingDeadlines) ? IColor(255, 255, 96, 96) : COLOR_WHITE)
+            .WithAlign(EAlign::Near);
+
+        const IRECT bndText = mRECT.GetPadded(-4.0f);
+        char line1[160];
+        char line2[160];
+
+        if (!mbHaveStats) {
+            std::snprintf(line1, sizeof(line1), "DSP: no audio processed yet");
+            line2[0] = 0;
+        } else {
+            std::snprintf(
+                line1,
+                sizeof(line1),
+                "DSP  min %.1f%%  avg %.1f%%  p99 %.1f%%  max %.1f%% (%.0f us)  misses %u",
+                (double) mStats.minLoad * 100.0,
+                (double) mStats.avgLoad * 100.0,
+                (double) mStats.p99Load * 100.0,
+                (double) mStats.maxLoad * 100.0,
+                (double) mStats.maxBlockMicroseconds,
+                (unsigned) mStats.numDeadlineMisses
+            );
+
+            int line2Len = 0;
+
+            if (mLabels.pVoices) {
+                line2Len += std::snprintf(
+                    line2 + line2Len,
+                    sizeof(line2) - line2Len,
+                    "%s %u (peak %u)  steals %u  ",
+                    mLabels.pVoices,
+                    (unsigned) mStats.numActiveVoices,
+                    (unsigned) mStats.maxActiveVoices,
+                    (unsigned) mStats.numVoiceSteals
+                );
+            }
+
+            if (mLabels.pReverb && (line2Len < (int) sizeof(line2))) {
+                line2Len += std::snprintf(line2 + line2Len, sizeof(line2) - line2Len, "%s %u  ", mLabels.pReverb, (unsigned) mStats.numReverbTicks);
+            }
+
+            if (mLabels.pMidiQueue && (line2Len < (int) sizeof(line2))) {
+                std::snprintf(line2 + line2Len, sizeof(line2) - line2Len, "%s %u", mLabels.pMidiQueue, (unsigned) mStats.maxMidiQueueDepth);
+            }
+        }
+
+        g.DrawText(text, line1, bndText.GetFromTop(bndText.H() * 0.5f));
+        g.DrawText(text, line2, bndText.GetFromBottom(bndText.H() * 0.5f));
+    }
+
+    virtual void OnMsgFromDelegate(int msgTag, int dataSize, const void* pData) override {
+        if ((msgTag != Sender::kUpdateMessage) || (dataSize != (int) sizeof(SenderData)))
+            return;
+
+        SenderData data;
+        std::memcpy(&data, pData, sizeof(SenderData));
+        const DspTelemetry::Stats& stats = data.vals[0];
+
+        mbMissingDeadlines = mbHaveStats && (stats.numDeadlineMisses > mStats.numDeadlineMisses);
+        mStats = stats;
+        mbHaveStats = true;
+        SetDirty(false);
+    }
+
+    virtual void OnMouseDown([[maybe_unused]] float x, [[maybe_unused]] float y, [[maybe_unused]] const iplug::igraphics::IMouseMod& mod) override {
+        if (mResetFunc) {
+            mResetFunc();
+        }
+
+        mStats = {};
+        mbHaveStats = false;
+        mbMissingDeadlines = false;
+        SetDirty(false);
+    }
+
+private:
+    Labels                  mLabels;                // What to call the statistics shown on the 2nd line, if they are shown at all
+    std::function<void()>   mResetFunc;             // Called when the user clicks the overlay: should reset the telemetry totals
+    DspTelemetry::Stats     mStats;                 // The latest statistics received
+    bool                    mbHaveStats;            // Whether any statistics have been received yet
+    bool                    mbMissingDeadlines;     // Whether the deadline miss count went up in the latest statistics
+};
@@ -6,6 +6,8 @@
 #include "Asserts.h"
 #include "Finally.h"
 
+#include <algorithm>
+#include <cctype>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
@@ -168,4 +170,21 @@ void getParentPath(const char* const path, std::string& parentPath) noexcept {
     }
 }
 
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Get the extension of the given file path in lower case, including the '.'. Returns an empty string if there is no extension.
+// Accepts POSIX or Windows style separators (forward or backward slash) in the path.
+//------------------------------------------------------------------------------------------------------------------------------------------
+std::string getLowerCaseFileExt(const char* const filePath) noexcept {
+    ASSERT(filePath);
+    const std::string path = filePath;
+    const size_t extPos = path.find_last_of("./\\");
+
+    if ((extPos == std::string::npos) || (path[extPos] != '.'))
+        return {};
+
+    std::string fileExt = path.substr(extPos);
+    std::transform(fileExt.begin(), fileExt.end(), fileExt.begin(), [](const char c) noexcept { return (char) std::tolower((unsigned char) c); });
+    return fileExt;
+}
+
 END_NAMESPACE(FileUtils)
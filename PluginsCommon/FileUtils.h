@@ -34,5 +34,6 @@ bool writeDataToFile(
 bool fileExists(const char* filePath) noexcept;
 int64_t getFileSize(const char* filePath) noexcept;
 void getParentPath(const char* path, std::string& parentPath) noexcept;
+std::string getLowerCaseFileExt(const char* const filePath) noexcept;
 
 END_NAMESPACE(FileUtils)
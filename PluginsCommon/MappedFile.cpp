@@ -0,0 +1,114 @@
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Read-only memory mapped files
+//------------------------------------------------------------------------------------------------------------------------------------------
+#include "MappedFile.h"
+
+#include "Asserts.h"
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <Windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+MappedFile::MappedFile() noexcept
+    : mpData(nullptr)
+    , mSize(0)
+    , mMappingHandle(nullptr)
+{
+}
+
+MappedFile::~MappedFile() noexcept {
+    close();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Map the entire contents of the given file into memory for reading, closing any previous mapping first.
+// Returns 'false' on failure, or if the file is empty (zero sized files cannot be mapped).
+//------------------------------------------------------------------------------------------------------------------------------------------
+bool MappedFile::open(const char* const filePath) noexcept {
+    ASSERT(filePath);
+    close();
+
+    #if defined(_WIN32)
+        // Open the file and figure out its size
+        const HANDLE hFile = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+        if (hFile == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER fileSize = {};
+
+        if ((!GetFileSizeEx(hFile, &fileSize)) || (fileSize.QuadPart <= 0) || ((uint64_t) fileSize.QuadPart > SIZE_MAX)) {
+            CloseHandle(hFile);
+            return false;
+        }
+
+        // Create the mapping and a view of the whole file: the file handle is no longer needed after the mapping is made
+        const HANDLE hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(hFile);
+
+        if (!hMapping)
+            return false;
+
+        const void* const pView = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+
+        if (!pView) {
+            CloseHandle(hMapping);
+            return false;
+        }
+
+        mpData = (const std::byte*) pView;
+        mSize = (size_t) fileSize.QuadPart;
+        mMappingHandle = hMapping;
+    #else
+        // Open the file and figure out its size
+        const int fd = ::open(filePath, O_RDONLY);
+
+        if (fd < 0)
+            return false;
+
+        struct stat fileInfo = {};
+
+        if ((fstat(fd, &fileInfo) != 0) || (fileInfo.st_size <= 0)) {
+            ::close(fd);
+            return false;
+        }
+
+        // Map the file: the descriptor is no longer needed after the mapping is made
+        void* const pView = mmap(nullptr, (size_t) fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+
+        if (pView == MAP_FAILED)
+            return false;
+
+        mpData = (const std::byte*) pView;
+        mSize = (size_t) fileInfo.st_size;
+    #endif
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Release the current mapping, if any
+//------------------------------------------------------------------------------------------------------------------------------------------
+void MappedFile::close() noexcept {
+    if (!mpData)
+        return;
+
+    #if defined(_WIN32)
+        UnmapViewOfFile(mpData);
+        CloseHandle((HANDLE) mMappingHandle);
+    #else
+        munmap((void*) mpData, mSize);
+    #endif
+
+    mpData = nullptr;
+    mSize = 0;
+    mMappingHandle = nullptr;
+}
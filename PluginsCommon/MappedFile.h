@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Macros.h"
+
+#include <cstddef>
+#include <cstdint>
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// A read-only memory mapping of a file on disk.
+// Uses 'mmap' on MacOS and Linux and 'MapViewOfFile' on Windows, so the file contents can be parsed and copied directly from the OS
+// page cache without first reading them into an intermediate buffer. The mapping is released when the object is destroyed.
+// To read the mapping through the stream interface, wrap it with a 'ByteInputStream'.
+//------------------------------------------------------------------------------------------------------------------------------------------
+class MappedFile {
+public:
+    MappedFile() noexcept;
+    ~MappedFile() noexcept;
+
+    bool open(const char* const filePath) noexcept;
+    void close() noexcept;
+
+    inline bool isOpen() const noexcept { return (mpData != nullptr); }
+    inline const std::byte* data() const noexcept { return mpData; }
+    inline size_t size() const noexcept { return mSize; }
+
+private:
+    MappedFile(const MappedFile& other) = delete;
+    MappedFile(MappedFile&& other) = delete;
+    MappedFile& operator = (const MappedFile& other) = delete;
+    MappedFile& operator = (MappedFile&& other) = delete;
+
+    const std::byte*    mpData;         // Start of the mapped file contents or 'nullptr' if nothing is mapped
+    size_t              mSize;          // Size of the mapped file contents in bytes
+    void*               mMappingHandle; // Windows only: the file mapping object handle for the view
+};
@@ -0,0 +1,548 @@
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Utilities for reading uncompressed PCM sound files (.wav and .aiff) and preparing them for PlayStation ADPCM encoding
+//------------------------------------------------------------------------------------------------------------------------------------------
+#include "PcmFileUtils.h"
+
+#include "Asserts.h"
+#include "Endian.h"
+
+#include "resample.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+BEGIN_NAMESPACE(AudioTools)
+BEGIN_NAMESPACE(PcmFileUtils)
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// How samples are stored in a PCM sound file
+//------------------------------------------------------------------------------------------------------------------------------------------
+enum class SampleFormat : uint8_t {
+    SignedInt,      // Signed integer samples
+    UnsignedInt,    // Unsigned integer samples: only used by 8-bit .wav files
+    Float           // IEEE floating point samples, 32 or 64-bit
+};
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Four character chunk ids, as they appear when read as a big endian 32-bit integer
+//------------------------------------------------------------------------------------------------------------------------------------------
+static constexpr uint32_t makeFourCC(const char id[5]) noexcept {
+    return ((uint32_t)(uint8_t) id[0] << 24) | ((uint32_t)(uint8_t) id[1] << 16) | ((uint32_t)(uint8_t) id[2] << 8) | (uint32_t)(uint8_t) id[3];
+}
+
+static constexpr uint32_t FOURCC_RIFF = makeFourCC("RIFF");
+static constexpr uint32_t FOURCC_WAVE = makeFourCC("WAVE");
+static constexpr uint32_t FOURCC_FMT  = makeFourCC("fmt ");
+static constexpr uint32_t FOURCC_DATA = makeFourCC("data");
+static constexpr uint32_t FOURCC_SMPL = makeFourCC("smpl");
+static constexpr uint32_t FOURCC_FORM = makeFourCC("FORM");
+static constexpr uint32_t FOURCC_AIFF = makeFourCC("AIFF");
+static constexpr uint32_t FOURCC_AIFC = makeFourCC("AIFC");
+static constexpr uint32_t FOURCC_COMM = makeFourCC("COMM");
+static constexpr uint32_t FOURCC_SSND = makeFourCC("SSND");
+static constexpr uint32_t FOURCC_NONE = makeFourCC("NONE");
+static constexpr uint32_t FOURCC_SOWT = makeFourCC("sowt");
+static constexpr uint32_t FOURCC_FL32 = makeFourCC("fl32");
+static constexpr uint32_t FOURCC_FL32U = makeFourCC("FL32");
+static constexpr uint32_t FOURCC_FL64 = makeFourCC("fl64");
+static constexpr uint32_t FOURCC_FL64U = makeFourCC("FL64");
+
+// .wav format tags
+static constexpr uint16_t WAVE_FORMAT_PCM           = 0x0001;
+static constexpr uint16_t WAVE_FORMAT_IEEE_FLOAT    = 0x0003;
+static constexpr uint16_t WAVE_FORMAT_EXTENSIBLE    = 0xFFFE;
+
+// The sinc filter size used when resampling and how many extra input frames to keep so the last wanted output sample is still exact
+static constexpr int RESAMPLE_SINC_SIZE = 64;
+static constexpr uint32_t RESAMPLE_MARGIN_FRAMES = RESAMPLE_SINC_SIZE;
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Helpers: read values of a given type and endianness from a possibly unaligned location in memory
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <class T>
+static T readLittle(const std::byte* const pData) noexcept {
+    T value;
+    std::memcpy(&value, pData, sizeof(T));
+    return Endian::littleToHost(value);
+}
+
+template <class T>
+static T readBig(const std::byte* const pData) noexcept {
+    T value;
+    std::memcpy(&value, pData, sizeof(T));
+    return Endian::bigToHost(value);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Helper: decode an 80-bit IEEE 754 extended precision float (big endian) as used for the sample rate in .aiff files
+//------------------------------------------------------------------------------------------------------------------------------------------
+static double readBigFloat80(const std::byte* const pData) noexcept {
+    const uint16_t signAndExponent = readBig<uint16_t>(pData);
+    const uint32_t mantissaHi = readBig<uint32_t>(pData + 2);
+    const uint32_t mantissaLo = readBig<uint32_t>(pData + 6);
+    const int32_t exponent = (int32_t)(signAndExponent & 0x7FFFu) - 16383;
+
+    if ((signAndExponent & 0x7FFFu) == 0)
+        return 0.0;
+
+    const double mantissa = (double) mantissaHi * 4294967296.0 + (double) mantissaLo;
+    const double value = std::ldexp(mantissa, exponent - 63);
+    return (signAndExponent & 0x8000u) ? -value : value;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Helper: read a single sample and convert it to a normalized float
+//------------------------------------------------------------------------------------------------------------------------------------------
+static float readSample(
+    const std::byte* const pData,
+    const SampleFormat format,
+    const uint32_t bytesPerSample,
+    const bool bBigEndian
+) noexcept {
+    if (format == SampleFormat::Float) {
+        if (bytesPerSample == 8) {
+            const uint64_t bits = (bBigEndian) ?
+                ((uint64_t) readBig<uint32_t>(pData) << 32) | readBig<uint32_t>(pData + 4) :
+                ((uint64_t) readLittle<uint32_t>(pData + 4) << 32) | readLittle<uint32_t>(pData);
+
+            double value;
+            std::memcpy(&value, &bits, sizeof(double));
+            return (float) value;
+        } else {
+            const uint32_t bits = (bBigEndian) ? readBig<uint32_t>(pData) : readLittle<uint32_t>(pData);
+            float value;
+            std::memcpy(&value, &bits, sizeof(float));
+            return value;
+        }
+    }
+
+    // Integer samples: assemble into the top bits of a 32-bit signed integer so all sizes share the same scale
+    uint32_t bits = 0;
+
+    for (uint32_t i = 0; i < bytesPerSample; ++i) {
+        const uint32_t byteIdx = (bBigEndian) ? i : bytesPerSample - 1 - i;
+        bits |= (uint32_t)(uint8_t) pData[byteIdx] << (24 - i * 8);
+    }
+
+    if (format == SampleFormat::UnsignedInt) {
+        bits ^= 0x80000000u;
+    }
+
+    return (float)((double)(int32_t) bits / 2147483648.0);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Helper: figure out how many frames at the given source sample rate need to be decoded to end up with the given maximum number of
+// samples once resampled to the specified rate. Includes some extra frames to account for the latency of the resampler.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static uint32_t getMaxFramesToDecode(const double srcSampleRate, const uint32_t maxNumSamples, const double maxNumSamplesRate) noexcept {
+    ASSERT(maxNumSamplesRate > 0.0);
+
+    const double maxNumFrames = std::ceil((double) maxNumSamples * srcSampleRate / maxNumSamplesRate) + RESAMPLE_MARGIN_FRAMES;
+    return (maxNumFrames < (double) UINT32_MAX) ? (uint32_t) maxNumFrames : UINT32_MAX;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Helper: decode the given interleaved sample frames and mix them down to mono
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void decodeSampleFrames(
+    const std::byte* const pData,
+    const uint32_t numFrames,
+    const uint32_t numChannels,
+    const SampleFormat format,
+    const uint32_t bytesPerSample,
+    const bool bBigEndian,
+    std::vector<float>& samplesOut
+) noexcept {
+    ASSERT(numChannels > 0);
+
+    const uint32_t bytesPerFrame = numChannels * bytesPerSample;
+    const float channelScale = 1.0f / (float) numChannels;
+    samplesOut.resize(numFrames);
+
+    for (uint32_t frameIdx = 0; frameIdx < numFrames; ++frameIdx) {
+        const std::byte* const pFrame = pData + (size_t) frameIdx * bytesPerFrame;
+        float mixedSample = 0.0f;
+
+        for (uint32_t chanIdx = 0; chanIdx < numChannels; ++chanIdx) {
+            mixedSample += readSample(pFrame + chanIdx * bytesPerSample, format, bytesPerSample, bBigEndian);
+        }
+
+        samplesOut[frameIdx] = mixedSample * channelScale;
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Tells if the given file data looks like a .wav or .aiff file
+//------------------------------------------------------------------------------------------------------------------------------------------
+bool isWavFile(const std::byte* const pFileData, const size_t fileSize) noexcept {
+    return (
+        (fileSize >= 12) &&
+        (readBig<uint32_t>(pFileData) == FOURCC_RIFF) &&
+        (readBig<uint32_t>(pFileData + 8) == FOURCC_WAVE)
+    );
+}
+
+bool isAiffFile(const std::byte* const pFileData, const size_t fileSize) noexcept {
+    if ((fileSize < 12) || (readBig<uint32_t>(pFileData) != FOURCC_FORM))
+        return false;
+
+    const uint32_t formType = readBig<uint32_t>(pFileData + 8);
+    return ((formType == FOURCC_AIFF) || (formType == FOURCC_AIFC));
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Read an uncompressed .wav file held in memory.
+// Supports 8/16/24/32-bit integer and 32/64-bit float samples, and takes the loop points from the first 'smpl' chunk loop (if any).
+// Only enough of the sound is decoded to produce 'maxNumSamples' once resampled to 'maxNumSamplesRate'; the rest is ignored.
+//------------------------------------------------------------------------------------------------------------------------------------------
+bool readWavFile(
+    const std::byte* const pFileData,
+    const size_t fileSize,
+    PcmSound& soundOut,
+    std::string& errorMsgOut,
+    const uint32_t maxNumSamples,
+    const double maxNumSamplesRate
+) noexcept {
+    ASSERT(pFileData || (fileSize == 0));
+    soundOut = {};
+
+    bool bReadOk = false;
+
+    try {
+        if (!isWavFile(pFileData, fileSize))
+            throw "File is not a .wav file!";
+
+        // Find the chunks we are interested in
+        const std::byte* pFmtChunk = nullptr;
+        const std::byte* pDataChunk = nullptr;
+        const std::byte* pSmplChunk = nullptr;
+        uint32_t fmtChunkSize = 0;
+        uint32_t dataChunkSize = 0;
+        uint32_t smplChunkSize = 0;
+
+        for (size_t offset = 12; offset + 8 <= fileSize;) {
+            const uint32_t chunkId = readBig<uint32_t>(pFileData + offset);
+            const uint32_t chunkSize = (uint32_t) std::min<size_t>(readLittle<uint32_t>(pFileData + offset + 4), fileSize - offset - 8);
+            const std::byte* const pChunkData = pFileData + offset + 8;
+
+            if ((chunkId == FOURCC_FMT) && (!pFmtChunk)) {
+                pFmtChunk = pChunkData;
+                fmtChunkSize = chunkSize;
+            } else if ((chunkId == FOURCC_DATA) && (!pDataChunk)) {
+                pDataChunk = pChunkData;
+                dataChunkSize = chunkSize;
+            } else if ((chunkId == FOURCC_SMPL) && (!pSmplChunk)) {
+                pSmplChunk = pChunkData;
+                smplChunkSize = chunkSize;
+            }
+
+            // Note: chunks are padded to 2 byte boundaries
+            offset += 8 + (size_t) chunkSize + (chunkSize & 1u);
+        }
+
+        if ((!pFmtChunk) || (fmtChunkSize < 16))
+            throw "The .wav file has no valid format chunk!";
+
+        if (!pDataChunk)
+            throw "The .wav file has no sound data!";
+
+        // Figure out the sample format
+        uint16_t formatTag = readLittle<uint16_t>(pFmtChunk);
+        const uint16_t numChannels = readLittle<uint16_t>(pFmtChunk + 2);
+        const uint32_t sampleRate = readLittle<uint32_t>(pFmtChunk + 4);
+        const uint16_t bitsPerSample = readLittle<uint16_t>(pFmtChunk + 14);
+
+        if ((formatTag == WAVE_FORMAT_EXTENSIBLE) && (fmtChunkSize >= 26)) {
+            // The first 2 bytes of the sub-format GUID are the actual format tag
+            formatTag = readLittle<uint16_t>(pFmtChunk + 24);
+        }
+
+        if ((numChannels <= 0) || (sampleRate <= 0))
+            throw "Invalid channel count or sample rate in the .wav file!";
+
+        SampleFormat format = {};
+
+        if ((formatTag == WAVE_FORMAT_PCM) && (bitsPerSample >= 8) && (bitsPerSample <= 32) && (bitsPerSample % 8 == 0)) {
+            format = (bitsPerSample == 8) ? SampleFormat::UnsignedInt : SampleFormat::SignedInt;
+        } else if ((formatTag == WAVE_FORMAT_IEEE_FLOAT) && ((bitsPerSample == 32) || (bitsPerSample == 64))) {
+            format = SampleFormat::Float;
+        } else {
+            throw "Unsupported .wav sample format! Only uncompressed integer or floating point samples are supported.";
+        }
+
+        // Decode the sound data
+        const uint32_t bytesPerSample = bitsPerSample / 8;
+        const uint32_t numFrames = dataChunkSize / (bytesPerSample * numChannels);
+        const uint32_t numFramesToDecode = std::min(numFrames, getMaxFramesToDecode(sampleRate, maxNumSamples, maxNumSamplesRate));
+        decodeSampleFrames(pDataChunk, numFramesToDecode, numChannels, format, bytesPerSample, false, soundOut.samples);
+        soundOut.sampleRate = (double) sampleRate;
+
+        // Read the first loop from the sampler chunk, if there is one.
+        // Note: the loop end in the file is inclusive, whereas ours is exclusive.
+        if (pSmplChunk && (smplChunkSize >= 36 + 24)) {
+            const uint32_t numLoops = readLittle<uint32_t>(pSmplChunk + 28);
+
+            if (numLoops > 0) {
+                const uint32_t loopStart = readLittle<uint32_t>(pSmplChunk + 36 + 8);
+                const uint32_t loopEnd = readLittle<uint32_t>(pSmplChunk + 36 + 12);
+
+                if ((loopStart <= loopEnd) && (loopEnd < numFrames)) {
+                    soundOut.loopStartSampleIdx = loopStart;
+                    soundOut.loopEndSampleIdx = loopEnd + 1;
+                }
+            }
+        }
+
+        // All good if we get to here
+        bReadOk = true;
+    }
+    catch (const char* const exceptionMsg) {
+        errorMsgOut = "An error occurred while reading the .wav file! Error message: ";
+        errorMsgOut += exceptionMsg;
+    }
+    catch (...) {
+        errorMsgOut = "An error occurred while reading the .wav file! Out of memory.";
+    }
+
+    if (!bReadOk) {
+        soundOut = {};
+    }
+
+    return bReadOk;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Read an uncompressed .aiff or .aifc file held in memory.
+// Supports 8/16/24/32-bit integer samples in either byte order and 32/64-bit float samples.
+// Loop points (from the 'MARK' and 'INST' chunks) are not read.
+// Only enough of the sound is decoded to produce 'maxNumSamples' once resampled to 'maxNumSamplesRate'; the rest is ignored.
+//------------------------------------------------------------------------------------------------------------------------------------------
+bool readAiffFile(
+    const std::byte* const pFileData,
+    const size_t fileSize,
+    PcmSound& soundOut,
+    std::string& errorMsgOut,
+    const uint32_t maxNumSamples,
+    const double maxNumSamplesRate
+) noexcept {
+    ASSERT(pFileData || (fileSize == 0));
+    soundOut = {};
+
+    bool bReadOk = false;
+
+    try {
+        if (!isAiffFile(pFileData, fileSize))
+            throw "File is not a .aiff file!";
+
+        const bool bIsAifc = (readBig<uint32_t>(pFileData + 8) == FOURCC_AIFC);
+
+        // Find the chunks we are interested in
+        const std::byte* pCommChunk = nullptr;
+        const std::byte* pSsndChunk = nullptr;
+        uint32_t commChunkSize = 0;
+        uint32_t ssndChunkSize = 0;
+
+        for (size_t offset = 12; offset + 8 <= fileSize;) {
+            const uint32_t chunkId = readBig<uint32_t>(pFileData + offset);
+            const uint32_t chunkSize = (uint32_t) std::min<size_t>(readBig<uint32_t>(pFileData + offset + 4), fileSize - offset - 8);
+            const std::byte* const pChunkData = pFileData + offset + 8;
+
+            if ((chunkId == FOURCC_COMM) && (!pCommChunk)) {
+                pCommChunk = pChunkData;
+                commChunkSize = chunkSize;
+            } else if ((chunkId == FOURCC_SSND) && (!pSsndChunk)) {
+                pSsndChunk = pChunkData;
+                ssndChunkSize = chunkSize;
+            }
+
+            // Note: chunks are padded to 2 byte boundaries
+            offset += 8 + (size_t) chunkSize + (chunkSize & 1u);
+        }
+
+        if ((!pCommChunk) || (commChunkSize < 18))
+            throw "The .aiff file has no valid common chunk!";
+
+        if ((!pSsndChunk) || (ssndChunkSize < 8))
+            throw "The .aiff file has no sound data!";
+
+        // Figure out the sample format
+        const uint16_t numChannels = readBig<uint16_t>(pCommChunk);
+        const uint32_t numFramesInHdr = readBig<uint32_t>(pCommChunk + 2);
+        const uint16_t bitsPerSample = readBig<uint16_t>(pCommChunk + 6);
+        const double sampleRate = readBigFloat80(pCommChunk + 8);
+        const uint32_t compressionType = ((bIsAifc) && (commChunkSize >= 22)) ? readBig<uint32_t>(pCommChunk + 18) : FOURCC_NONE;
+
+        if ((numChannels <= 0) || (!(sampleRate > 0.0)))
+            throw "Invalid channel count or sample rate in the .aiff file!";
+
+        SampleFormat format = SampleFormat::SignedInt;
+        uint32_t bytesPerSample = (bitsPerSample + 7u) / 8u;
+        bool bBigEndian = true;
+
+        if ((compressionType == FOURCC_NONE) || (compressionType == FOURCC_SOWT)) {
+            bBigEndian = (compressionType == FOURCC_NONE);
+
+            if ((bytesPerSample < 1) || (bytesPerSample > 4))
+                throw "Unsupported .aiff sample size!";
+        } else if ((compressionType == FOURCC_FL32) || (compressionType == FOURCC_FL32U)) {
+            format = SampleFormat::Float;
+            bytesPerSample = 4;
+        } else if ((compressionType == FOURCC_FL64) || (compressionType == FOURCC_FL64U)) {
+            format = SampleFormat::Float;
+            bytesPerSample = 8;
+        } else {
+            throw "Unsupported .aifc compression type! Only uncompressed integer or floating point samples are supported.";
+        }
+
+        // Decode the sound data: it is preceded by an offset and block size
+        const uint32_t dataOffset = readBig<uint32_t>(pSsndChunk);
+
+        if (dataOffset > ssndChunkSize - 8)
+            throw "Invalid sound data offset in the .aiff file!";
+
+        const std::byte* const pSoundData = pSsndChunk + 8 + dataOffset;
+        const uint32_t soundDataSize = ssndChunkSize - 8 - dataOffset;
+        const uint32_t numFrames = std::min({
+            numFramesInHdr,
+            soundDataSize / (bytesPerSample * numChannels),
+            getMaxFramesToDecode(sampleRate, maxNumSamples, maxNumSamplesRate)
+        });
+
+        decodeSampleFrames(pSoundData, numFrames, numChannels, format, bytesPerSample, bBigEndian, soundOut.samples);
+        soundOut.sampleRate = sampleRate;
+
+        // All good if we get to here
+        bReadOk = true;
+    }
+    catch (const char* const exceptionMsg) {
+        errorMsgOut = "An error occurred while reading the .aiff file! Error message: ";
+        errorMsgOut += exceptionMsg;
+    }
+    catch (...) {
+        errorMsgOut = "An error occurred while reading the .aiff file! Out of memory.";
+    }
+
+    if (!bReadOk) {
+        soundOut = {};
+    }
+
+    return bReadOk;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Read a .wav or .aiff file held in memory, determining the file type from it's contents
+//------------------------------------------------------------------------------------------------------------------------------------------
+bool readPcmSoundFile(
+    const std::byte* const pFileData,
+    const size_t fileSize,
+    PcmSound& soundOut,
+    std::string& errorMsgOut,
+    const uint32_t maxNumSamples,
+    const double maxNumSamplesRate
+) noexcept {
+    if (isWavFile(pFileData, fileSize))
+        return readWavFile(pFileData, fileSize, soundOut, errorMsgOut, maxNumSamples, maxNumSamplesRate);
+
+    if (isAiffFile(pFileData, fileSize))
+        return readAiffFile(pFileData, fileSize, soundOut, errorMsgOut, maxNumSamples, maxNumSamplesRate);
+
+    soundOut = {};
+    errorMsgOut = "Unrecognized sound file format! Only .wav and .aiff files are supported.";
+    return false;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Resample the given sound to the specified sample rate using WDL's sinc resampler, producing no more than 'maxNumSamples' samples.
+// Loop points are scaled to match the new sample rate. Returns 'false' and leaves the sound unchanged if out of memory.
+//------------------------------------------------------------------------------------------------------------------------------------------
+bool resamplePcmSound(PcmSound& sound, const double newSampleRate, const uint32_t maxNumSamples) noexcept {
+    ASSERT(newSampleRate > 0.0);
+
+    if ((sound.sampleRate == newSampleRate) || sound.samples.empty()) {
+        if (sound.samples.size() > maxNumSamples) {
+            sound.samples.resize(maxNumSamples);
+        }
+
+        sound.sampleRate = newSampleRate;
+        sound.loopStartSampleIdx = std::min(sound.loopStartSampleIdx, maxNumSamples);
+        sound.loopEndSampleIdx = std::min(sound.loopEndSampleIdx, maxNumSamples);
+        return true;
+    }
+
+    // Figure out how many samples the output will have
+    const double rateRatio = newSampleRate / sound.sampleRate;
+    const size_t numInputSamples = sound.samples.size();
+    const size_t numOutputSamples = (size_t) std::min(std::ceil((double) numInputSamples * rateRatio), (double) maxNumSamples);
+
+    try {
+        // Setup the resampler: input driven, so we can just feed it the whole sound in chunks
+        WDL_Resampler resampler;
+        resampler.SetMode(false, 0, true, RESAMPLE_SINC_SIZE);
+        resampler.SetFeedMode(true);
+        resampler.SetRates(sound.sampleRate, newSampleRate);
+
+        constexpr int CHUNK_SIZE = 4096;
+        const int maxChunkOutputSize = (int) std::ceil(CHUNK_SIZE * rateRatio) + 16;
+
+        std::vector<float> samplesOut;
+        std::vector<WDL_ResampleSample> chunkOutput((size_t) maxChunkOutputSize);
+        samplesOut.reserve(numOutputSamples);
+
+        // Feed the input, followed by silence to flush out the resampler's latency until we have all the output required
+        size_t inputIdx = 0;
+
+        while (samplesOut.size() < numOutputSamples) {
+            WDL_ResampleSample* pChunkInput = nullptr;
+            const int numChunkInputSamples = resampler.ResamplePrepare(CHUNK_SIZE, 1, &pChunkInput);
+
+            for (int i = 0; i < numChunkInputSamples; ++i) {
+                pChunkInput[i] = (inputIdx < numInputSamples) ? (WDL_ResampleSample) sound.samples[inputIdx] : 0;
+                ++inputIdx;
+            }
+
+            const int numChunkOutputSamples = resampler.ResampleOut(chunkOutput.data(), numChunkInputSamples, maxChunkOutputSize, 1);
+            const size_t numSamplesToKeep = std::min<size_t>((size_t) numChunkOutputSamples, numOutputSamples - samplesOut.size());
+            samplesOut.insert(samplesOut.end(), chunkOutput.begin(), chunkOutput.begin() + numSamplesToKeep);
+
+            // Should never happen but guard against the resampler not producing anything
+            if ((numChunkOutputSamples <= 0) && (inputIdx > numInputSamples + (size_t) CHUNK_SIZE * 4))
+                break;
+        }
+
+        samplesOut.resize(numOutputSamples, 0.0f);
+        sound.samples.swap(samplesOut);
+    }
+    catch (...) {
+        return false;
+    }
+
+    sound.sampleRate = newSampleRate;
+    sound.loopStartSampleIdx = (uint32_t) std::min<double>(std::round(sound.loopStartSampleIdx * rateRatio), (double) numOutputSamples);
+    sound.loopEndSampleIdx = (uint32_t) std::min<double>(std::round(sound.loopEndSampleIdx * rateRatio), (double) numOutputSamples);
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Convert the samples of the given sound to 16-bit signed integers, clamping any samples which are out of range.
+// Returns 'false' if out of memory.
+//------------------------------------------------------------------------------------------------------------------------------------------
+bool convertPcmSoundToInt16(const PcmSound& sound, std::vector<int16_t>& samplesOut) noexcept {
+    try {
+        samplesOut.resize(sound.samples.size());
+    }
+    catch (...) {
+        return false;
+    }
+
+    for (size_t i = 0; i < sound.samples.size(); ++i) {
+        const float sample = std::round(sound.samples[i] * (float) INT16_MAX);
+        samplesOut[i] = (int16_t) std::clamp(sample, (float) INT16_MIN, (float) INT16_MAX);
+    }
+
+    return true;
+}
+
+END_NAMESPACE(PcmFileUtils)
+END_NAMESPACE(AudioTools)
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Macros.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+BEGIN_NAMESPACE(AudioTools)
+BEGIN_NAMESPACE(PcmFileUtils)
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// A sound read from an uncompressed PCM audio file (.wav or .aiff).
+// All channels are mixed down to a single mono channel, since that is all the PlayStation SPU can play per voice.
+// If the sound is NOT looped then the loop start and end will both be zero.
+//------------------------------------------------------------------------------------------------------------------------------------------
+struct PcmSound {
+    std::vector<float>  samples;                // Mono samples, nominally in the range -1 to +1
+    double              sampleRate;             // Sample rate of the sound
+    uint32_t            loopStartSampleIdx;     // Where the loop starts (inclusive)
+    uint32_t            loopEndSampleIdx;       // Where the loop ends (exclusive)
+};
+
+bool isWavFile(const std::byte* const pFileData, const size_t fileSize) noexcept;
+bool isAiffFile(const std::byte* const pFileData, const size_t fileSize) noexcept;
+
+bool readWavFile(
+    const std::byte* const pFileData,
+    const size_t fileSize,
+    PcmSound& soundOut,
+    std::string& errorMsgOut,
+    const uint32_t maxNumSamples,
+    const double maxNumSamplesRate
+) noexcept;
+
+bool readAiffFile(
+    const std::byte* const pFileData,
+    const size_t fileSize,
+    PcmSound& soundOut,
+    std::string& errorMsgOut,
+    const uint32_t maxNumSamples,
+    const double maxNumSamplesRate
+) noexcept;
+
+bool readPcmSoundFile(
+    const std::byte* const pFileData,
+    const size_t fileSize,
+    PcmSound& soundOut,
+    std::string& errorMsgOut,
+    const uint32_t maxNumSamples,
+    const double maxNumSamplesRate
+) noexcept;
+
+bool resamplePcmSound(PcmSound& sound, const double newSampleRate, const uint32_t maxNumSamples) noexcept;
+bool convertPcmSoundToInt16(const PcmSound& sound, std::vector<int16_t>& samplesOut) noexcept;
+
+END_NAMESPACE(PcmFileUtils)
+END_NAMESPACE(AudioTools)
@@ -0,0 +1,300 @@
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Block conversion of audio samples between the host's double or float format and the 16-bit integer and float formats used by the SPU
+//------------------------------------------------------------------------------------------------------------------------------------------
+#include "SampleConvert.h"
+
+#include "Asserts.h"
+
+// Use SSE2 for the conversion kernels if available: all x64 CPUs have it
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+    #define SAMPLE_CONVERT_SSE2 1
+    #include <emmintrin.h>
+#else
+    #define SAMPLE_CONVERT_SSE2 0
+#endif
+
+BEGIN_NAMESPACE(SampleConvert)
+
+#if SAMPLE_CONVERT_SSE2
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// SSE2 helper: converts a stereo frame pair in double format to 16-bit, following the exact same rules as 'doubleToInt16'.
+// Returns 4 x 32-bit integers: left 0, right 0, left 1, right 1.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static __m128i sse2DoubleFramesToInt32(const __m128d frame0, const __m128d frame1) noexcept {
+    const __m128d minusOne = _mm_set1_pd(-1.0);
+    const __m128d plusOne = _mm_set1_pd(1.0);
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d negScale = _mm_set1_pd(-double(INT16_MIN));
+    const __m128d posScale = _mm_set1_pd(double(INT16_MAX));
+
+    const auto convert = [&](const __m128d samples) noexcept {
+        const __m128d clamped = _mm_min_pd(_mm_max_pd(samples, minusOne), plusOne);
+        const __m128d bNegative = _mm_cmplt_pd(clamped, zero);
+        const __m128d scale = _mm_or_pd(_mm_and_pd(bNegative, negScale), _mm_andnot_pd(bNegative, posScale));
+        return _mm_cvttpd_epi32(_mm_mul_pd(clamped, scale));    // Truncates, same as a C++ cast
+    };
+
+    return _mm_unpacklo_epi64(convert(frame0), convert(frame1));
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// SSE2 helper: converts 2 x 16-bit samples (already sign extended to 32-bit) to double, following the same rules as 'int16ToDouble'
+//------------------------------------------------------------------------------------------------------------------------------------------
+static __m128d sse2Int32ToDouble(const __m128i samples) noexcept {
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d negScale = _mm_set1_pd(-double(INT16_MIN));
+    const __m128d posScale = _mm_set1_pd(double(INT16_MAX));
+
+    // Note: -x / -32768 is always exactly the same as x / 32768, so the negative case needs no negation
+    const __m128d asDouble = _mm_cvtepi32_pd(samples);
+    const __m128d bNegative = _mm_cmplt_pd(asDouble, zero);
+    const __m128d scale = _mm_or_pd(_mm_and_pd(bNegative, negScale), _mm_andnot_pd(bNegative, posScale));
+    return _mm_div_pd(asDouble, scale);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// SSE2 helper: stores a stereo frame pair (left 0, right 0) and (left 1, right 1) to separate left and right channel buffers
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void sse2StoreDoubleFrames(const __m128d frame0, const __m128d frame1, double* const pOutL, double* const pOutR) noexcept {
+    _mm_storeu_pd(pOutL, _mm_unpacklo_pd(frame0, frame1));
+
+    if (pOutR) {
+        _mm_storeu_pd(pOutR, _mm_unpackhi_pd(frame0, frame1));
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// SSE2 helper: converts 4 x 16-bit samples (already sign extended to 32-bit) in stereo frame order to float, following the same rules as
+// 'int16ToFloat'. The samples are converted to double first so that the results match exactly.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static __m128 sse2Int32ToFloat(const __m128i samples) noexcept {
+    const __m128 frame0 = _mm_cvtpd_ps(sse2Int32ToDouble(samples));
+    const __m128 frame1 = _mm_cvtpd_ps(sse2Int32ToDouble(_mm_unpackhi_epi64(samples, samples)));
+    return _mm_movelh_ps(frame0, frame1);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// SSE2 helper: stores 4 interleaved stereo frames (2 frames per input) to separate left and right channel buffers
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void sse2StoreFloatFrames(const __m128 frames01, const __m128 frames23, float* const pOutL, float* const pOutR) noexcept {
+    _mm_storeu_ps(pOutL, _mm_shuffle_ps(frames01, frames23, _MM_SHUFFLE(2, 0, 2, 0)));
+
+    if (pOutR) {
+        _mm_storeu_ps(pOutR, _mm_shuffle_ps(frames01, frames23, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+}
+
+#endif  // #if SAMPLE_CONVERT_SSE2
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Converts separate left and right channel buffers in double format to interleaved 16-bit stereo frames.
+// For mono input the same buffer can be given for both channels.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void stereoDoubleToInt16(const double* const pInL, const double* const pInR, int16_t* const pOutLR, const uint32_t numFrames) noexcept {
+    ASSERT(pInL && pInR && pOutLR);
+    uint32_t frameIdx = 0;
+
+    #if SAMPLE_CONVERT_SSE2
+        for (; frameIdx + 4 <= numFrames; frameIdx += 4) {
+            const __m128d inL01 = _mm_loadu_pd(pInL + frameIdx);
+            const __m128d inL23 = _mm_loadu_pd(pInL + frameIdx + 2);
+            const __m128d inR01 = _mm_loadu_pd(pInR + frameIdx);
+            const __m128d inR23 = _mm_loadu_pd(pInR + frameIdx + 2);
+            const __m128i out01 = sse2DoubleFramesToInt32(_mm_unpacklo_pd(inL01, inR01), _mm_unpackhi_pd(inL01, inR01));
+            const __m128i out23 = sse2DoubleFramesToInt32(_mm_unpacklo_pd(inL23, inR23), _mm_unpackhi_pd(inL23, inR23));
+            _mm_storeu_si128((__m128i*)(pOutLR + frameIdx * 2), _mm_packs_epi32(out01, out23));
+        }
+    #endif
+
+    for (; frameIdx < numFrames; ++frameIdx) {
+        pOutLR[frameIdx * 2 + 0] = doubleToInt16(pInL[frameIdx]);
+        pOutLR[frameIdx * 2 + 1] = doubleToInt16(pInR[frameIdx]);
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Converts interleaved 16-bit stereo frames to separate left and right channel buffers in double format.
+// If the right channel buffer is null then only the left channel is output.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void stereoInt16ToDouble(const int16_t* const pInLR, double* const pOutL, double* const pOutR, const uint32_t numFrames) noexcept {
+    ASSERT(pInLR && pOutL);
+    uint32_t frameIdx = 0;
+
+    #if SAMPLE_CONVERT_SSE2
+        for (; frameIdx + 4 <= numFrames; frameIdx += 4) {
+            // Sign extend the 8 input samples to 32-bit, then convert 2 at a time
+            const __m128i in = _mm_loadu_si128((const __m128i*)(pInLR + frameIdx * 2));
+            const __m128i in0123 = _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16);
+            const __m128i in4567 = _mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16);
+            const __m128d frame0 = sse2Int32ToDouble(in0123);
+            const __m128d frame1 = sse2Int32ToDouble(_mm_unpackhi_epi64(in0123, in0123));
+            const __m128d frame2 = sse2Int32ToDouble(in4567);
+            const __m128d frame3 = sse2Int32ToDouble(_mm_unpackhi_epi64(in4567, in4567));
+            sse2StoreDoubleFrames(frame0, frame1, pOutL + frameIdx, (pOutR) ? pOutR + frameIdx : nullptr);
+            sse2StoreDoubleFrames(frame2, frame3, pOutL + frameIdx + 2, (pOutR) ? pOutR + frameIdx + 2 : nullptr);
+        }
+    #endif
+
+    for (; frameIdx < numFrames; ++frameIdx) {
+        pOutL[frameIdx] = int16ToDouble(pInLR[frameIdx * 2 + 0]);
+
+        if (pOutR) {
+            pOutR[frameIdx] = int16ToDouble(pInLR[frameIdx * 2 + 1]);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Converts separate left and right channel buffers in double format to interleaved float stereo frames.
+// For mono input the same buffer can be given for both channels.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void stereoDoubleToFloat(const double* const pInL, const double* const pInR, float* const pOutLR, const uint32_t numFrames) noexcept {
+    ASSERT(pInL && pInR && pOutLR);
+    uint32_t frameIdx = 0;
+
+    #if SAMPLE_CONVERT_SSE2
+        for (; frameIdx + 2 <= numFrames; frameIdx += 2) {
+            const __m128d inL = _mm_loadu_pd(pInL + frameIdx);
+            const __m128d inR = _mm_loadu_pd(pInR + frameIdx);
+            const __m128 frame0 = _mm_cvtpd_ps(_mm_unpacklo_pd(inL, inR));
+            const __m128 frame1 = _mm_cvtpd_ps(_mm_unpackhi_pd(inL, inR));
+            _mm_storeu_ps(pOutLR + frameIdx * 2, _mm_movelh_ps(frame0, frame1));
+        }
+    #endif
+
+    for (; frameIdx < numFrames; ++frameIdx) {
+        pOutLR[frameIdx * 2 + 0] = (float) pInL[frameIdx];
+        pOutLR[frameIdx * 2 + 1] = (float) pInR[frameIdx];
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Converts interleaved float stereo frames to separate left and right channel buffers in double format.
+// If the right channel buffer is null then only the left channel is output.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void stereoFloatToDouble(const float* const pInLR, double* const pOutL, double* const pOutR, const uint32_t numFrames) noexcept {
+    ASSERT(pInLR && pOutL);
+    uint32_t frameIdx = 0;
+
+    #if SAMPLE_CONVERT_SSE2
+        for (; frameIdx + 2 <= numFrames; frameIdx += 2) {
+            const __m128 in = _mm_loadu_ps(pInLR + frameIdx * 2);
+            const __m128d frame0 = _mm_cvtps_pd(in);
+            const __m128d frame1 = _mm_cvtps_pd(_mm_movehl_ps(in, in));
+            sse2StoreDoubleFrames(frame0, frame1, pOutL + frameIdx, (pOutR) ? pOutR + frameIdx : nullptr);
+        }
+    #endif
+
+    for (; frameIdx < numFrames; ++frameIdx) {
+        pOutL[frameIdx] = pInLR[frameIdx * 2 + 0];
+
+        if (pOutR) {
+            pOutR[frameIdx] = pInLR[frameIdx * 2 + 1];
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Converts separate left and right channel buffers in float format to interleaved 16-bit stereo frames.
+// For mono input the same buffer can be given for both channels.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void stereoFloatToInt16(const float* const pInL, const float* const pInR, int16_t* const pOutLR, const uint32_t numFrames) noexcept {
+    ASSERT(pInL && pInR && pOutLR);
+    uint32_t frameIdx = 0;
+
+    #if SAMPLE_CONVERT_SSE2
+        for (; frameIdx + 4 <= numFrames; frameIdx += 4) {
+            const __m128 inL = _mm_loadu_ps(pInL + frameIdx);
+            const __m128 inR = _mm_loadu_ps(pInR + frameIdx);
+            const __m128d inL01 = _mm_cvtps_pd(inL);
+            const __m128d inL23 = _mm_cvtps_pd(_mm_movehl_ps(inL, inL));
+            const __m128d inR01 = _mm_cvtps_pd(inR);
+            const __m128d inR23 = _mm_cvtps_pd(_mm_movehl_ps(inR, inR));
+            const __m128i out01 = sse2DoubleFramesToInt32(_mm_unpacklo_pd(inL01, inR01), _mm_unpackhi_pd(inL01, inR01));
+            const __m128i out23 = sse2DoubleFramesToInt32(_mm_unpacklo_pd(inL23, inR23), _mm_unpackhi_pd(inL23, inR23));
+            _mm_storeu_si128((__m128i*)(pOutLR + frameIdx * 2), _mm_packs_epi32(out01, out23));
+        }
+    #endif
+
+    for (; frameIdx < numFrames; ++frameIdx) {
+        pOutLR[frameIdx * 2 + 0] = floatToInt16(pInL[frameIdx]);
+        pOutLR[frameIdx * 2 + 1] = floatToInt16(pInR[frameIdx]);
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Converts interleaved 16-bit stereo frames to separate left and right channel buffers in float format.
+// If the right channel buffer is null then only the left channel is output.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void stereoInt16ToFloat(const int16_t* const pInLR, float* const pOutL, float* const pOutR, const uint32_t numFrames) noexcept {
+    ASSERT(pInLR && pOutL);
+    uint32_t frameIdx = 0;
+
+    #if SAMPLE_CONVERT_SSE2
+        for (; frameIdx + 4 <= numFrames; frameIdx += 4) {
+            const __m128i in = _mm_loadu_si128((const __m128i*)(pInLR + frameIdx * 2));
+            const __m128 frames01 = sse2Int32ToFloat(_mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16));
+            const __m128 frames23 = sse2Int32ToFloat(_mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16));
+            sse2StoreFloatFrames(frames01, frames23, pOutL + frameIdx, (pOutR) ? pOutR + frameIdx : nullptr);
+        }
+    #endif
+
+    for (; frameIdx < numFrames; ++frameIdx) {
+        pOutL[frameIdx] = int16ToFloat(pInLR[frameIdx * 2 + 0]);
+
+        if (pOutR) {
+            pOutR[frameIdx] = int16ToFloat(pInLR[frameIdx * 2 + 1]);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Interleaves separate left and right channel buffers in float format into float stereo frames.
+// For mono input the same buffer can be given for both channels.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void stereoInterleaveFloat(const float* const pInL, const float* const pInR, float* const pOutLR, const uint32_t numFrames) noexcept {
+    ASSERT(pInL && pInR && pOutLR);
+    uint32_t frameIdx = 0;
+
+    #if SAMPLE_CONVERT_SSE2
+        for (; frameIdx + 4 <= numFrames; frameIdx += 4) {
+            const __m128 inL = _mm_loadu_ps(pInL + frameIdx);
+            const __m128 inR = _mm_loadu_ps(pInR + frameIdx);
+            _mm_storeu_ps(pOutLR + frameIdx * 2, _mm_unpacklo_ps(inL, inR));
+            _mm_storeu_ps(pOutLR + frameIdx * 2 + 4, _mm_unpackhi_ps(inL, inR));
+        }
+    #endif
+
+    for (; frameIdx < numFrames; ++frameIdx) {
+        pOutLR[frameIdx * 2 + 0] = pInL[frameIdx];
+        pOutLR[frameIdx * 2 + 1] = pInR[frameIdx];
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Splits float stereo frames into separate left and right channel buffers in float format.
+// If the right channel buffer is null then only the left channel is output.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void stereoDeinterleaveFloat(const float* const pInLR, float* const pOutL, float* const pOutR, const uint32_t numFrames) noexcept {
+    ASSERT(pInLR && pOutL);
+    uint32_t frameIdx = 0;
+
+    #if SAMPLE_CONVERT_SSE2
+        for (; frameIdx + 4 <= numFrames; frameIdx += 4) {
+            const __m128 frames01 = _mm_loadu_ps(pInLR + frameIdx * 2);
+            const __m128 frames23 = _mm_loadu_ps(pInLR + frameIdx * 2 + 4);
+            sse2StoreFloatFrames(frames01, frames23, pOutL + frameIdx, (pOutR) ? pOutR + frameIdx : nullptr);
+        }
+    #endif
+
+    for (; frameIdx < numFrames; ++frameIdx) {
+        pOutL[frameIdx] = pInLR[frameIdx * 2 + 0];
+
+        if (pOutR) {
+            pOutR[frameIdx] = pInLR[frameIdx * 2 + 1];
+        }
+    }
+}
+
+END_NAMESPACE(SampleConvert)
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Macros.h"
+
+#include <algorithm>
+#include <cstdint>
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Block conversion of audio samples between the host's double or float format and the 16-bit integer and float formats used by the SPU.
+// Plugins built with 'SAMPLE_TYPE_FLOAT' get the host's float buffers directly, so the float versions are used in that case.
+//
+// The SPU works with interleaved stereo frames (left, right) while hosts give us separate buffers for each channel, so the block functions
+// interleave and de-interleave while they convert. Mono input can be duplicated to both SPU channels by passing the same buffer for the
+// left and right inputs. The block functions are SIMD accelerated where possible and always give the exact same results as the single
+// sample conversion functions.
+//------------------------------------------------------------------------------------------------------------------------------------------
+BEGIN_NAMESPACE(SampleConvert)
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Convert a single sample in double format to 16-bit.
+// Input is clamped to -1 to +1 and the scaled result is truncated: negative samples are scaled by 32768 and positive ones by 32767.
+//------------------------------------------------------------------------------------------------------------------------------------------
+inline int16_t doubleToInt16(const double origSample) noexcept {
+    const double origClamped = std::clamp(origSample, -1.0, 1.0);
+    return (origClamped < 0) ? (int16_t)(-origClamped * double(INT16_MIN)) : (int16_t)(origClamped * double(INT16_MAX));
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Convert a single sample in 16-bit format to double: the reverse scaling of 'doubleToInt16'
+//------------------------------------------------------------------------------------------------------------------------------------------
+inline double int16ToDouble(const int16_t origSample) noexcept {
+    return (origSample < 0) ? -double(origSample) / double(INT16_MIN) : double(origSample) / double(INT16_MAX);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Float versions of the above: these give the exact same results as converting the float to double first, or converting the double result
+// to float afterwards. That is, the same results as a plugin processing in double format running in a host which uses float.
+//------------------------------------------------------------------------------------------------------------------------------------------
+inline int16_t floatToInt16(const float origSample) noexcept {
+    return doubleToInt16((double) origSample);
+}
+
+inline float int16ToFloat(const int16_t origSample) noexcept {
+    return (float) int16ToDouble(origSample);
+}
+
+void stereoDoubleToInt16(const double* const pInL, const double* const pInR, int16_t* const pOutLR, const uint32_t numFrames) noexcept;
+void stereoInt16ToDouble(const int16_t* const pInLR, double* const pOutL, double* const pOutR, const uint32_t numFrames) noexcept;
+void stereoDoubleToFloat(const double* const pInL, const double* const pInR, float* const pOutLR, const uint32_t numFrames) noexcept;
+void stereoFloatToDouble(const float* const pInLR, double* const pOutL, double* const pOutR, const uint32_t numFrames) noexcept;
+void stereoFloatToInt16(const float* const pInL, const float* const pInR, int16_t* const pOutLR, const uint32_t numFrames) noexcept;
+void stereoInt16ToFloat(const int16_t* const pInLR, float* const pOutL, float* const pOutR, const uint32_t numFrames) noexcept;
+void stereoInterleaveFloat(const float* const pInL, const float* const pInR, float* const pOutLR, const uint32_t numFrames) noexcept;
+void stereoDeinterleaveFloat(const float* const pInLR, float* const pOutL, float* const pOutR, const uint32_t numFrames) noexcept;
+
+END_NAMESPACE(SampleConvert)
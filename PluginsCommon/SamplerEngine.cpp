@@ -0,0 +1,967 @@
+//------------------------------------------------------------------------------------------------------------------------------------------
+// The instrument logic of the PlayStation 1 sampler: turns MIDI messages into SPU voice key on/off and voice settings
+//------------------------------------------------------------------------------------------------------------------------------------------
+#include "SamplerEngine.h"
+
+#include "Asserts.h"
+#include "FileUtils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace AudioTools;
+
+static constexpr uint32_t   PITCH_BEND_CENTER   = 0x2000u;      // Pitch bend center value
+static constexpr uint32_t   PITCH_BEND_MAX      = 0x3FFFu;      // Maximum pitch bend value
+
+// MIDI status message types (upper 4 bits of the status byte) handled by the engine
+static constexpr uint8_t    MIDI_NOTE_OFF       = 0x8u;
+static constexpr uint8_t    MIDI_NOTE_ON        = 0x9u;
+static constexpr uint8_t    MIDI_CONTROL_CHANGE = 0xBu;
+static constexpr uint8_t    MIDI_PROGRAM_CHANGE = 0xCu;
+static constexpr uint8_t    MIDI_PITCH_WHEEL    = 0xEu;
+static constexpr uint8_t    MIDI_CC_VOLUME      = 7;
+static constexpr uint8_t    MIDI_CC_PAN         = 10;
+static constexpr uint8_t    MIDI_CC_ALL_NOTES_OFF = 123;
+
+// Which parts of an SPU voice to update from the current settings and MIDI channel state, so that a change only touches what it affects
+static constexpr uint8_t    VOICE_UPDATE_PITCH      = 0x01u;    // Sample rate: the note, pitch bend and base note
+static constexpr uint8_t    VOICE_UPDATE_VOLUME     = 0x02u;    // Left/right volume: instrument and channel volume and pan, velocity
+static constexpr uint8_t    VOICE_UPDATE_ENVELOPE   = 0x04u;    // ADSR envelope
+static constexpr uint8_t    VOICE_UPDATE_REVERB     = 0x08u;    // Whether the voice is sent to the reverb
+static constexpr uint8_t    VOICE_UPDATE_ALL        = 0xFFu;    // Everything, including the sample played: used when a note is sounded
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// --- COPIED FROM PSYDOOM ---
+//
+// This table defines the sample rates for an entire octave of notes (12 semitones) in 1/16 semitone steps.
+// The first note in the octave plays at 44,100 Hz (0x1000) and the last note (the start of the next octave) at 88,200 Hz (0x2000).
+// The sample rates are in the scale/format used by the PlayStation SPU.
+// This table is used by 'LIBSPU__spu_note2pitch' to figure out the sample rate for a note to be played.
+// The sample rates are scaled appropriately depending on the octave of the note to play.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static const uint16_t OCTAVE_SAMPLE_RATES[] = {
+    0x1000, 0x100E, 0x101D, 0x102C, 0x103B, 0x104A, 0x1059, 0x1068,     // C
+    0x1078, 0x1087, 0x1096, 0x10A5, 0x10B5, 0x10C4, 0x10D4, 0x10E3,
+    0x10F3, 0x1103, 0x1113, 0x1122, 0x1132, 0x1142, 0x1152, 0x1162,     // C#
+    0x1172, 0x1182, 0x1193, 0x11A3, 0x11B3, 0x11C4, 0x11D4, 0x11E5,
+    0x11F5, 0x1206, 0x1216, 0x1227, 0x1238, 0x1249, 0x125A, 0x126B,     // D
+    0x127C, 0x128D, 0x129E, 0x12AF, 0x12C1, 0x12D2, 0x12E3, 0x12F5,
+    0x1306, 0x1318, 0x132A, 0x133C, 0x134D, 0x135F, 0x1371, 0x1383,     // D#
+    0x1395, 0x13A7, 0x13BA, 0x13CC, 0x13DE, 0x13F1, 0x1403, 0x1416,
+    0x1428, 0x143B, 0x144E, 0x1460, 0x1473, 0x1486, 0x1499, 0x14AC,     // E
+    0x14BF, 0x14D3, 0x14E6, 0x14F9, 0x150D, 0x1520, 0x1534, 0x1547,
+    0x155B, 0x156F, 0x1583, 0x1597, 0x15AB, 0x15BF, 0x15D3, 0x15E7,     // F
+    0x15FB, 0x1610, 0x1624, 0x1638, 0x164D, 0x1662, 0x1676, 0x168B,
+    0x16A0, 0x16B5, 0x16CA, 0x16DF, 0x16F4, 0x170A, 0x171F, 0x1734,     // F#
+    0x174A, 0x175F, 0x1775, 0x178B, 0x17A1, 0x17B6, 0x17CC, 0x17E2,
+    0x17F9, 0x180F, 0x1825, 0x183B, 0x1852, 0x1868, 0x187F, 0x1896,     // G
+    0x18AC, 0x18C3, 0x18DA, 0x18F1, 0x1908, 0x191F, 0x1937, 0x194E,
+    0x1965, 0x197D, 0x1995, 0x19AC, 0x19C4, 0x19DC, 0x19F4, 0x1A0C,     // G#
+    0x1A24, 0x1A3C, 0x1A55, 0x1A6D, 0x1A85, 0x1A9E, 0x1AB7, 0x1ACF,
+    0x1AE8, 0x1B01, 0x1B1A, 0x1B33, 0x1B4C, 0x1B66, 0x1B7F, 0x1B98,     // A
+    0x1BB2, 0x1BCC, 0x1BE5, 0x1BFF, 0x1C19, 0x1C33, 0x1C4D, 0x1C67,
+    0x1C82, 0x1C9C, 0x1CB7, 0x1CD1, 0x1CEC, 0x1D07, 0x1D22, 0x1D3D,     // A#
+    0x1D58, 0x1D73, 0x1D8E, 0x1DA9, 0x1DC5, 0x1DE0, 0x1DFC, 0x1E18,
+    0x1E34, 0x1E50, 0x1E6C, 0x1E88, 0x1EA4, 0x1EC1, 0x1EDD, 0x1EFA,     // B
+    0x1F16, 0x1F33, 0x1F50, 0x1F6D, 0x1F8A, 0x1FA7, 0x1FC5, 0x1FE2,
+    0x2000,                                                             // C, Next octave
+};
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// --- COPIED FROM PSYDOOM ---
+//
+// Internal LIBSPU function which converts a musical note to a frequency that can be set on a voice.
+// The returned integer frequency is such that 4,096 units = 44,100 Hz.
+//
+// Params:
+//  baseNote:       Note at which the frequency is considered 44,100 Hz.
+//                  For example '60' would be C5 (12 semitones per octave, 1st note of 5th octave).
+//  baseNoteFrac:   Fractional offset to 'baseNote' in 1/128 units.
+//  note:           The note to get the frequency for.
+//  noteFrac:       Fractional offset to 'note' in 1/128 units.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static uint16_t LIBSPU__spu_note2pitch(
+    const int32_t centerNote,
+    const uint16_t centerNoteFrac,
+    const int32_t offsetNote,
+    const uint16_t offsetNoteFrac
+) noexcept {
+    // Get the fractional component of the note (which may be a semitone or more).
+    // Once we have that drop 3 bits of precision to convert from 1/128 to 1/16 semitone steps, and wrap to a fraction.
+    const int32_t noteFracUnwrapped = offsetNoteFrac + centerNoteFrac;
+    const int32_t noteFrac = (noteFracUnwrapped >> 3) & 0xF;
+
+    // Compute the note to sound relative to the center/root note which plays at 44,100 Hz.
+    // Note: also need to account for fractional note parts that are >= 1 semitone.
+    const int32_t note = offsetNote - centerNote + noteFracUnwrapped / 128;
+
+    // Compute what octave is being sounded, relative to the center/root note and the index of the note in that octave.
+    const int32_t octave = (note < 0) ? (note - 11) / 12 : note / 12;
+    const int32_t octaveStartNote = octave * 12;
+    const int32_t noteInOctave = note - octaveStartNote;
+    ASSERT((noteInOctave >= 0) && (noteInOctave <= 11));
+
+    // Using the octave relative note, and the fractional note component (1/16 semitone steps) compute the sample rate table lookup index
+    const uint32_t lutIndex = (noteInOctave << 4) | noteFrac;
+    ASSERT(lutIndex < 12 * 16);
+    const uint16_t baseSampleRate = OCTAVE_SAMPLE_RATES[lutIndex];
+
+    // Scale the sample rate depending on how many octaves up or down we are from the one that starts at 44,100 Hz
+    if (octave > 0) {
+        return baseSampleRate << +octave;
+    } else if (octave < 0) {
+        return baseSampleRate >> -octave;
+    } else {
+        return baseSampleRate;
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Figures out the sample rate of a given note (specified in semitones) using a reference base note (in semitones).
+// Returns the sample rate in PlayStation SPU sample rate format, such that '4096' = 44100 Hz.
+// Uses the reimplementation of PsyQ SDK 'LIBSPU__spu_note2pitch' to perform the calculation, which would have been used by PSX games.
+// This method is less precise than 'getNoteSampleRate' but sounds more accurate as to how samples are sounded in PlayStation games.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static uint16_t getNoteSpuSampleRate(const float baseNote, const float note) noexcept {
+    int32_t baseNoteInt = (int32_t) baseNote;
+    int32_t noteInt = (int32_t) note;
+    const uint16_t baseNoteFrac = (int32_t)(baseNote * 128.0f) & 0x7F;
+    const uint16_t noteFrac = (int32_t)(note * 128.0f) & 0x7F;
+
+    if (baseNote < 0) {
+        baseNoteInt--;
+    }
+
+    if (note < 0) {
+        noteInt--;
+    }
+
+    return LIBSPU__spu_note2pitch(baseNoteInt, baseNoteFrac, noteInt, noteFrac);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Lookup tables used to compute SPU voice volumes without any divisions.
+// Each entry holds exactly what the division it replaces would compute, so voice volumes are unchanged by using them.
+//------------------------------------------------------------------------------------------------------------------------------------------
+struct VoiceVolumeTables {
+    float   levels[128];    // 0-127 volume or velocity to a 0.0 to 1.0 scale
+    float   pans[128];      // 0-127 pan (64 = center) to a -1.0 (left) to +1.0 (right) scale
+};
+
+static constexpr VoiceVolumeTables makeVoiceVolumeTables() noexcept {
+    VoiceVolumeTables tables = {};
+
+    for (uint32_t i = 0; i < 128; ++i) {
+        tables.levels[i] = (float) i / 127.0f;
+        tables.pans[i] = (i < 64) ? ((float) i - 64.0f) / 64.0f : ((float) i - 64.0f) / 63.0f;
+    }
+
+    return tables;
+}
+
+static constexpr VoiceVolumeTables VOICE_VOLUME_TABLES = makeVoiceVolumeTables();
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Figures out the sample rate of a given note (specified in semitones) using a reference base note (in semitones) and the sample
+// rate that the base note sounds at. This is similar to 'getNoteSpuSampleRate' but more precise and not relying on lookup tables.
+//
+// For a good explantion of the conversion from note to frequency, see:
+//  https://www.translatorscafe.com/unit-converter/en-US/calculator/note-frequency/
+//------------------------------------------------------------------------------------------------------------------------------------------
+static double getNoteSampleRate(const double baseNote, const double baseNoteSampleRate, const double note) noexcept {
+    const double noteOffset = note - baseNote;
+    const double sampleRate = baseNoteSampleRate * std::pow(2.0, noteOffset / 12.0);
+    return sampleRate;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Creates the engine for the given SPU core.
+// Note: the core does not need to be initialized yet, but it must be before calling 'reset' or any other engine functions.
+//------------------------------------------------------------------------------------------------------------------------------------------
+SamplerEngine::SamplerEngine(SpuCore& spu) noexcept
+    : mSpu(spu)
+    , mSettings()
+    , mMidiPitchBends{}
+    , mMidiVolumes{}
+    , mMidiPans{}
+    , mPitchBendsInNotes{}
+    , mNoteSpuSampleRates{}
+    , mVoiceInfos{}
+    , mpSampleBank()
+    , mNumVoiceSteals(0)
+{
+    mSettings.volume = 127;
+    mSettings.pan = 64;
+    mSettings.noteMax = 127;
+
+    for (VoiceInfo& voiceInfo : mVoiceInfos) {
+        voiceInfo.midiNote = 0xFFFFu;
+        voiceInfo.midiVelocity = 0xFFFFu;
+        voiceInfo.bankToneIdx = kNoBankTone;
+    }
+
+    std::fill(std::begin(mMidiPitchBends), std::end(mMidiPitchBends), PITCH_BEND_CENTER);
+    std::fill(std::begin(mMidiVolumes), std::end(mMidiVolumes), uint8_t(127));
+    std::fill(std::begin(mMidiPans), std::end(mMidiPans), uint8_t(64));
+    updateNoteSpuSampleRates();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Frees the loaded sound bank (if any): the SPU core is left alone since it belongs to the owner
+//------------------------------------------------------------------------------------------------------------------------------------------
+SamplerEngine::~SamplerEngine() noexcept {
+    mpSampleBank.reset();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Kills all voices and resets the pitch bend, volume and pan for all MIDI channels.
+// Must be called once the SPU core has been initialized.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SamplerEngine::reset() noexcept {
+    ASSERT(mSpu.numVoices >= kMaxVoices);
+    killAllVoices();
+
+    for (VoiceInfo& voiceInfo : mVoiceInfos) {
+        voiceInfo.midiNote = 0xFFFFu;
+        voiceInfo.midiVelocity = 0xFFFFu;
+        voiceInfo.midiChannel = 0;
+        voiceInfo.bankProgram = 0;
+        voiceInfo.priority = 0;
+        voiceInfo.numSamplesActive = 0;
+        voiceInfo.bankToneIdx = kNoBankTone;
+        voiceInfo.spuStartAddr8 = 0;
+    }
+
+    std::fill(std::begin(mMidiPitchBends), std::end(mMidiPitchBends), PITCH_BEND_CENTER);
+    std::fill(std::begin(mMidiVolumes), std::end(mMidiVolumes), uint8_t(127));
+    std::fill(std::begin(mMidiPans), std::end(mMidiPans), uint8_t(64));
+
+    for (uint8_t channel = 0; channel < kNumMidiChannels; ++channel) {
+        updatePitchBendInNotes(channel);
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Change the instrument settings: releases any notes which are now out of range and updates the playing SPU voices.
+// Only the settings which actually changed are applied to the voices, so this is cheap to call when little or nothing has changed.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SamplerEngine::setSettings(const Settings& settings) noexcept {
+    const Settings oldSettings = mSettings;
+    mSettings = settings;
+
+    // Figure out which parts of the voices are affected by the changes
+    uint8_t updateFlags = 0;
+
+    if (settings.baseNote != oldSettings.baseNote) {
+        updateNoteSpuSampleRates();
+        updateFlags |= VOICE_UPDATE_PITCH;
+    }
+
+    const bool bPitchBendChanged = (
+        (settings.pitchstepUp != oldSettings.pitchstepUp) ||
+        (settings.pitchstepDown != oldSettings.pitchstepDown) ||
+        (settings.pitchBendUpOffset != oldSettings.pitchBendUpOffset) ||
+        (settings.pitchBendDownOffset != oldSettings.pitchBendDownOffset)
+    );
+
+    if (bPitchBendChanged) {
+        for (uint8_t channel = 0; channel < kNumMidiChannels; ++channel) {
+            updatePitchBendInNotes(channel);
+        }
+
+        updateFlags |= VOICE_UPDATE_PITCH;
+    }
+
+    if ((settings.volume != oldSettings.volume) || (settings.pan != oldSettings.pan)) {
+        updateFlags |= VOICE_UPDATE_VOLUME;
+    }
+
+    if (std::memcmp(&settings.adsrEnv, &oldSettings.adsrEnv, sizeof(Spu::AdsrEnvelope)) != 0) {
+        updateFlags |= VOICE_UPDATE_ENVELOPE;
+    }
+
+    if (settings.bReverb != oldSettings.bReverb) {
+        updateFlags |= VOICE_UPDATE_REVERB;
+    }
+
+    if ((settings.noteMin != oldSettings.noteMin) || (settings.noteMax != oldSettings.noteMax)) {
+        doNoteOffForOutOfRangeNotes();
+    }
+
+    if (updateFlags != 0) {
+        updateSpuVoices(updateFlags);
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Process a single MIDI channel message, given as the status byte and the two data bytes following it (if used by the message).
+// A note on with a velocity of zero is treated as a note off, as is the convention for MIDI running status.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SamplerEngine::processMidiMsg(const uint8_t status, const uint8_t data1, const uint8_t data2) noexcept {
+    // What type of message is it and what channel is it for?
+    const uint8_t statusMsgType = status >> 4;
+    const uint8_t channel = status & uint8_t(0x0Fu);
+
+    switch (statusMsgType) {
+        case MIDI_NOTE_ON: {
+            if ((data2 & uint8_t(0x7Fu)) != 0) {
+                processMidiNoteOn(channel, data1 & uint8_t(0x7Fu), data2 & uint8_t(0x7Fu));
+            } else {
+                processMidiNoteOff(channel, data1 & uint8_t(0x7Fu));
+            }
+        }   break;
+
+        case MIDI_NOTE_OFF:
+            processMidiNoteOff(channel, data1 & uint8_t(0x7Fu));
+            break;
+
+        case MIDI_PITCH_WHEEL: {
+            const uint16_t hiBits = (uint16_t) data2 & 0x7Fu;
+            const uint16_t loBits = (uint16_t) data1 & 0x7Fu;
+            processMidiPitchBend(channel, (hiBits << 7) | loBits);
+        }   break;
+
+        // Channel volume and pan apply straight away to notes already playing on the channel, as they do in the PS1 sound library
+        case MIDI_CONTROL_CHANGE: {
+            if (data1 == MIDI_CC_ALL_NOTES_OFF) {
+                processMidiAllNotesOff(channel);
+            } else if (data1 == MIDI_CC_VOLUME) {
+                mMidiVolumes[channel] = data2 & uint8_t(0x7Fu);
+                updateChannelSpuVoices(channel, VOICE_UPDATE_VOLUME);
+            } else if (data1 == MIDI_CC_PAN) {
+                mMidiPans[channel] = data2 & uint8_t(0x7Fu);
+                updateChannelSpuVoices(channel, VOICE_UPDATE_VOLUME);
+            }
+        }   break;
+
+        // Program changes only affect notes played on the channel afterwards, just like on the PS1
+        case MIDI_PROGRAM_CHANGE:
+            setChannelProgram(channel, data1 & uint8_t(0x7Fu));
+            break;
+
+        default:
+            break;
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Voice management, to be called after the SPU has been run for the given number of frames: updates the number of samples playing voices
+// have been active for and resets the info for voices which have stopped.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SamplerEngine::advanceVoices(const uint32_t numFrames) noexcept {
+    for (uint32_t i = 0; i < kMaxVoices; ++i) {
+        VoiceInfo& voiceInfo = mVoiceInfos[i];
+
+        if (mSpu.pVoices[i].envPhase != Spu::EnvPhase::Off) {
+            voiceInfo.numSamplesActive += numFrames;
+        } else {
+            voiceInfo.midiNote = 0xFFFFu;
+            voiceInfo.midiVelocity = 0xFFFFu;
+            voiceInfo.midiChannel = 0;
+            voiceInfo.bankProgram = 0;
+            voiceInfo.priority = 0;
+            voiceInfo.numSamplesActive = 0;
+            voiceInfo.bankToneIdx = kNoBankTone;
+            voiceInfo.spuStartAddr8 = 0;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Tells how many SPU voices are currently playing, including voices which are being released
+//------------------------------------------------------------------------------------------------------------------------------------------
+uint32_t SamplerEngine::getNumActiveVoices() const noexcept {
+    uint32_t numActiveVoices = 0;
+
+    for (uint32_t i = 0; i < kMaxVoices; ++i) {
+        if (mSpu.pVoices[i].envPhase != Spu::EnvPhase::Off) {
+            numActiveVoices++;
+        }
+    }
+
+    return numActiveVoices;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Keys off all currently playing SPU voices which are not already keying off
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SamplerEngine::keyOffAllVoices() noexcept {
+    for (uint32_t i = 0; i < kMaxVoices; ++i) {
+        SpuVoice& voice = mSpu.pVoices[i];
+
+        if ((voice.envPhase != Spu::EnvPhase::Release) && (voice.envPhase != Spu::EnvPhase::Off)) {
+            Spu::keyOff(voice);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Kills all currently playing SPU voices
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SamplerEngine::killAllVoices() noexcept {
+    for (uint32_t i = 0; i < kMaxVoices; ++i) {
+        SpuVoice& voice = mSpu.pVoices[i];
+        voice.envLevel = 0;
+        voice.envPhase = Spu::EnvPhase::Off;
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Open a VAB sound bank from a .vab file or a .vh file (with the .vb file alongside it), ready to be swapped into an engine.
+// The bank files are memory mapped and indexed, but no sample data is copied until the bank is uploaded with 'uploadSampleBank'.
+// All MIDI channels start out playing the given program; if it's not used by the bank then the first program that is used is selected.
+// Returns null and an error message on failure.
+//------------------------------------------------------------------------------------------------------------------------------------------
+std::unique_ptr<SamplerEngine::SampleBank> SamplerEngine::openSampleBank(
+    const std::string& filePath,
+    const uint8_t program,
+    std::string& errorMsgOut
+) noexcept {
+    std::unique_ptr<SampleBank> pBank;
+
+    try {
+        pBank = std::make_unique<SampleBank>();
+        pBank->filePath = filePath;
+    } catch (...) {
+        errorMsgOut = "Out of memory!";
+        return {};
+    }
+
+    if (!pBank->headerFile.open(filePath.c_str())) {
+        errorMsgOut = "Unable to open the chosen file!\nDoes the file path exist and is it accessible?";
+        return {};
+    }
+
+    // If this is just a .vh header then the body should be in a .vb file with the same name
+    if (FileUtils::getLowerCaseFileExt(filePath.c_str()) == ".vh") {
+        const std::string bodyFilePath = filePath.substr(0, filePath.size() - 1) + ((filePath.back() == 'H') ? "B" : "b");
+
+        if (!pBank->bodyFile.open(bodyFilePath.c_str())) {
+            errorMsgOut = "Unable to open the .vb file for the chosen .vh file!\nIt must be in the same folder and have the same name.";
+            return {};
+        }
+    }
+
+    // Index the bank
+    const MappedFile& headerFile = pBank->headerFile;
+    const MappedFile& bodyFile = pBank->bodyFile;
+
+    if (!VabUtils::parseVab(headerFile.data(), headerFile.size(), bodyFile.data(), bodyFile.size(), pBank->vab, errorMsgOut))
+        return {};
+
+    try {
+        pBank->sampleSpuAddrs8.assign(pBank->vab.samples.size(), 0);
+    } catch (...) {
+        errorMsgOut = "Out of memory!";
+        return {};
+    }
+
+    pBank->spuRamUsed = Spu::ADPCM_BLOCK_SIZE * 2;
+    std::fill(std::begin(pBank->channelPrograms), std::end(pBank->channelPrograms), getUsedBankProgram(pBank->vab, program));
+    return pBank;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Upload all of the samples in the given sound bank to the given SPU RAM image, which should then be swapped in along with the bank.
+// Reads the whole bank body, so this should be done off the audio thread and before the bank is swapped into an engine.
+// The image starts with a silent sample terminator and each sample is followed by a terminator of it's own so it always stops.
+// Samples which don't fit in SPU RAM are left out and their tones won't play; real banks are made to fit so this should be rare.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SamplerEngine::uploadSampleBank(SampleBank& bank, std::byte* const pRam, const uint32_t ramSize) noexcept {
+    constexpr uint32_t kBankRamStart = Spu::ADPCM_BLOCK_SIZE * 2;
+    ASSERT(ramSize >= kBankRamStart);
+
+    std::memset(pRam, 0, ramSize);
+    writeSampleTerminator(pRam, ramSize, 0);
+    bank.spuRamUsed = kBankRamStart;
+
+    for (size_t sampleIdx = 0; sampleIdx < bank.vab.samples.size(); ++sampleIdx) {
+        // Figure out how much room the sample and it's terminator need and skip it if there is not enough
+        const VabUtils::VabSample& sample = bank.vab.samples[sampleIdx];
+        const uint32_t numSampleBlocks = (sample.size + Spu::ADPCM_BLOCK_SIZE - 1) / Spu::ADPCM_BLOCK_SIZE;
+        const uint32_t uploadSize = (numSampleBlocks + 2) * Spu::ADPCM_BLOCK_SIZE;
+
+        if (uploadSize > ramSize - bank.spuRamUsed) {
+            bank.sampleSpuAddrs8[sampleIdx] = 0;
+            continue;
+        }
+
+        // Copy the sample from the bank body (the rest of the last block is already zeroed) and terminate it
+        std::byte* const pDst = pRam + bank.spuRamUsed;
+        std::memcpy(pDst, bank.vab.pBody + sample.offset, sample.size);
+        writeSampleTerminator(pDst, uploadSize, numSampleBlocks);
+
+        bank.sampleSpuAddrs8[sampleIdx] = bank.spuRamUsed / 8;
+        bank.spuRamUsed += uploadSize;
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Swap the given sound bank (which may be null) with the one in use by the engine, killing all voices if a bank was or is now in use.
+// Once a bank is in use SPU RAM belongs to it: the owner must make sure SPU RAM holds the image the bank was uploaded to.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SamplerEngine::swapSampleBank(std::unique_ptr<SampleBank>& pBank) noexcept {
+    if (mpSampleBank || pBank) {
+        killAllVoices();
+    }
+
+    mpSampleBank.swap(pBank);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Set the sound bank program played by the given MIDI channel, if a bank is loaded.
+// Only affects notes played on the channel afterwards.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SamplerEngine::setChannelProgram(const uint8_t channel, const uint8_t program) noexcept {
+    ASSERT(channel < kNumMidiChannels);
+
+    if (mpSampleBank) {
+        mpSampleBank->channelPrograms[channel] = program & uint8_t(0x7Fu);
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Writes a terminator for a sample of the given length (in ADPCM blocks) to the given SPU RAM image, consisting of two silent ADPCM blocks
+// which will loop indefinitely. Used to guarantee a sound will stop playing after it reaches the end, since SPU voices technically never
+// stop. The SPU emulation however will kill them to save on CPU time...
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SamplerEngine::writeSampleTerminator(std::byte* const pRam, const uint32_t ramSize, const uint32_t numSampleBlocks) noexcept {
+    // Figure out which ADPCM sample block to write the terminators
+    const uint32_t maxSampleBlocks = ramSize / Spu::ADPCM_BLOCK_SIZE;
+    ASSERT(maxSampleBlocks >= 2);
+    const uint32_t termAdpcmBlocksStartIdx = std::min(numSampleBlocks, maxSampleBlocks - 2);
+    std::byte* const pTermAdpcmBlocks = pRam + (size_t) Spu::ADPCM_BLOCK_SIZE * termAdpcmBlocksStartIdx;
+
+    // Zero the bytes for the two ADPCM sample blocks firstly
+    std::memset(pTermAdpcmBlocks, 0, Spu::ADPCM_BLOCK_SIZE * 2);
+
+    // The 2nd byte of each ADPCM block is the flags byte, and is where we indicate loop start/end.
+    // Make the first block be the loop start, and the second block be loop end:
+    pTermAdpcmBlocks[1]   = (std::byte) Spu::ADPCM_FLAG_LOOP_START;
+    pTermAdpcmBlocks[17]  = (std::byte) Spu::ADPCM_FLAG_LOOP_END;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Get the base note (the note which plays the sample at 44,100 Hz) for a sample recorded at the given sample rate.
+// The result is rounded to 1/256 semitone increments, which is the precision of the base note in saved instrument settings.
+//------------------------------------------------------------------------------------------------------------------------------------------
+double SamplerEngine::getBaseNoteForSampleRate(const double sampleRate) noexcept {
+    if (sampleRate <= 22050.0) {
+        const double octavesDiff = std::log2(22050.0 / sampleRate);
+        const double baseNote = 60.0 + octavesDiff * 12.0;
+        return std::round(baseNote * 256.0) / 256.0;
+    } else {
+        const double octavesDiff = std::log2(sampleRate / 22050.0);
+        const double baseNote = 60.0 - octavesDiff * 12.0;
+        return std::round(baseNote * 256.0) / 256.0;
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Get the sample rate of a sample that plays at 44,100 Hz on the given base note: the reverse of 'getBaseNoteForSampleRate'
+//------------------------------------------------------------------------------------------------------------------------------------------
+double SamplerEngine::getSampleRateForBaseNote(const double baseNote) noexcept {
+    return getNoteSampleRate(baseNote, 22050.0, 60.0);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Handle a MIDI note on message
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SamplerEngine::processMidiNoteOn(const uint8_t channel, const uint8_t note, const uint8_t velocity) noexcept {
+    // Release any playing instances of this note on this channel that are not already being released
+    processMidiNoteOff(channel, note);
+
+    // Only allow the note to be played if it's within the acceptable range
+    if ((note < mSettings.noteMin) || (note > mSettings.noteMax))
+        return;
+
+    // If a sound bank is loaded then it decides what to play
+    if (mpSampleBank) {
+        processBankNoteOn(channel, note, velocity);
+        return;
+    }
+
+    // Save the info for the voice to play the note: the instrument's own sample always plays at the highest priority
+    const uint32_t spuVoiceIdx = allocSpuVoice(kMaxVoicePriority);
+    VoiceInfo& voiceInfo = mVoiceInfos[spuVoiceIdx];
+    voiceInfo.midiNote = note;
+    voiceInfo.midiVelocity = velocity;
+    voiceInfo.midiChannel = channel;
+    voiceInfo.bankProgram = 0;
+    voiceInfo.priority = kMaxVoicePriority;
+    voiceInfo.numSamplesActive = 0;
+    voiceInfo.bankToneIdx = kNoBankTone;
+    voiceInfo.spuStartAddr8 = 0;
+
+    // Make sure the voice parameters are up to date and sound the voice
+    updateSpuVoice(spuVoiceIdx, VOICE_UPDATE_ALL);
+    Spu::keyOn(mSpu.pVoices[spuVoiceIdx]);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Handle a MIDI note on message when a sound bank is loaded.
+// Plays every tone in the channel's bank program which covers the note, using the samples uploaded to SPU RAM when the bank was loaded.
+// Tones whose sample didn't fit in SPU RAM or which can't get a voice because all voices are busy playing higher priority tones are dropped.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SamplerEngine::processBankNoteOn(const uint8_t channel, const uint8_t note, const uint8_t velocity) noexcept {
+    ASSERT(mpSampleBank);
+    ASSERT(channel < kNumMidiChannels);
+    const SampleBank& bank = *mpSampleBank;
+    const uint8_t programIdx = bank.channelPrograms[channel] & 0x7Fu;
+    const VabUtils::VabProgram& program = bank.vab.programs[programIdx];
+    const uint32_t endToneIdx = (uint32_t) program.firstToneIdx + program.numTones;
+
+    // Sound a voice for each of the tones
+    for (uint32_t toneIdx = program.firstToneIdx; toneIdx < endToneIdx; ++toneIdx) {
+        const VabUtils::VabTone& tone = bank.vab.tones[toneIdx];
+
+        if ((note < tone.minNote) || (note > tone.maxNote))
+            continue;
+
+        const uint32_t spuStartAddr8 = (tone.sampleIdx < bank.sampleSpuAddrs8.size()) ? bank.sampleSpuAddrs8[tone.sampleIdx] : 0;
+
+        if (spuStartAddr8 == 0)
+            continue;
+
+        const uint32_t spuVoiceIdx = allocSpuVoice(tone.priority);
+
+        if (spuVoiceIdx == UINT32_MAX)
+            continue;
+
+        VoiceInfo& voiceInfo = mVoiceInfos[spuVoiceIdx];
+        voiceInfo.midiNote = note;
+        voiceInfo.midiVelocity = velocity;
+        voiceInfo.midiChannel = channel;
+        voiceInfo.bankProgram = programIdx;
+        voiceInfo.priority = tone.priority;
+        voiceInfo.numSamplesActive = 0;
+        voiceInfo.bankToneIdx = (uint16_t) toneIdx;
+        voiceInfo.spuStartAddr8 = spuStartAddr8;
+
+        updateSpuVoice(spuVoiceIdx, VOICE_UPDATE_ALL);
+        Spu::keyOn(mSpu.pVoices[spuVoiceIdx]);
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Pick an SPU voice to play a new note with the given priority, stealing a voice if there are no free ones.
+// Voice stealing follows the same rules as the PS1 sound library: the lowest priority voice is stolen, preferring voices which are being
+// released and then the voice which has been playing the longest. Voices with a higher priority than the new note are never stolen.
+// Returns UINT32_MAX if there is no voice that can be used.
+//------------------------------------------------------------------------------------------------------------------------------------------
+uint32_t SamplerEngine::allocSpuVoice(const uint8_t priority) noexcept {
+    // Try to find a free SPU voice firstly to service this request
+    for (uint32_t i = 0; i < kMaxVoices; ++i) {
+        if (mSpu.pVoices[i].envPhase == Spu::EnvPhase::Off)
+            return i;
+    }
+
+    // If that fails find the best voice to steal
+    uint32_t spuVoiceIdx = UINT32_MAX;
+
+    for (uint32_t i = 0; i < kMaxVoices; ++i) {
+        const VoiceInfo& voiceInfo = mVoiceInfos[i];
+
+        if (voiceInfo.priority > priority)
+            continue;
+
+        if (spuVoiceIdx == UINT32_MAX) {
+            spuVoiceIdx = i;
+            continue;
+        }
+
+        // Lower priority voices first
+        const VoiceInfo& bestInfo = mVoiceInfos[spuVoiceIdx];
+
+        if (voiceInfo.priority != bestInfo.priority) {
+            if (voiceInfo.priority < bestInfo.priority) {
+                spuVoiceIdx = i;
+            }
+
+            continue;
+        }
+
+        // Then voices being released
+        const bool bReleasing = (mSpu.pVoices[i].envPhase == Spu::EnvPhase::Release);
+        const bool bBestReleasing = (mSpu.pVoices[spuVoiceIdx].envPhase == Spu::EnvPhase::Release);
+
+        if (bReleasing != bBestReleasing) {
+            if (bReleasing) {
+                spuVoiceIdx = i;
+            }
+
+            continue;
+        }
+
+        // Then the oldest voices
+        if (voiceInfo.numSamplesActive > bestInfo.numSamplesActive) {
+            spuVoiceIdx = i;
+        }
+    }
+
+    if (spuVoiceIdx != UINT32_MAX) {
+        mNumVoiceSteals++;
+    }
+
+    return spuVoiceIdx;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Handle a MIDI note off message
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SamplerEngine::processMidiNoteOff(const uint8_t channel, const uint8_t note) noexcept {
+    // Find voices playing this note on this channel which are not already being released and release them
+    for (uint32_t i = 0; i < kMaxVoices; ++i) {
+        if ((mVoiceInfos[i].midiNote == note) && (mVoiceInfos[i].midiChannel == channel)) {
+            SpuVoice& voice = mSpu.pVoices[i];
+
+            if ((voice.envPhase != Spu::EnvPhase::Release) && (voice.envPhase != Spu::EnvPhase::Off)) {
+                Spu::keyOff(voice);
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Handle a MIDI pitch bend message: only changes the sample rate of the voices playing notes on the given channel.
+// Dense pitch bend automation can send hundreds of these a second, so nothing else about the voices is touched.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SamplerEngine::processMidiPitchBend(const uint8_t channel, const uint16_t pitchBend) noexcept {
+    ASSERT(channel < kNumMidiChannels);
+
+    if (mMidiPitchBends[channel] == pitchBend)
+        return;
+
+    mMidiPitchBends[channel] = pitchBend;
+    updatePitchBendInNotes(channel);
+    updateChannelSpuVoices(channel, VOICE_UPDATE_PITCH);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Process an 'all notes off' MIDI message for the given channel
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SamplerEngine::processMidiAllNotesOff(const uint8_t channel) noexcept {
+    for (uint32_t i = 0; i < kMaxVoices; ++i) {
+        SpuVoice& voice = mSpu.pVoices[i];
+
+        if ((mVoiceInfos[i].midiChannel == channel) && (voice.envPhase != Spu::EnvPhase::Release) && (voice.envPhase != Spu::EnvPhase::Off)) {
+            Spu::keyOff(voice);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Update the given parts of the playing SPU voices on the given channel, after one of the channel's controllers has changed.
+// Voices which are not playing are skipped: they are fully updated when they are next used to sound a note.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SamplerEngine::updateChannelSpuVoices(const uint8_t channel, const uint8_t updateFlags) noexcept {
+    for (uint32_t i = 0; i < kMaxVoices; ++i) {
+        if ((mVoiceInfos[i].midiChannel == channel) && (mSpu.pVoices[i].envPhase != Spu::EnvPhase::Off)) {
+            updateSpuVoice(i, updateFlags);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Do 'note off' for any notes that are now out of range according to the note min/max settings
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SamplerEngine::doNoteOffForOutOfRangeNotes() noexcept {
+    // Release any notes that are playing, not already releasing and which are now out of range...
+    for (uint32_t i = 0; i < kMaxVoices; ++i) {
+        const uint16_t note = mVoiceInfos[i].midiNote;
+
+        if ((note < mSettings.noteMin) || (note > mSettings.noteMax)) {
+            SpuVoice& voice = mSpu.pVoices[i];
+
+            if ((voice.envPhase != Spu::EnvPhase::Release) && (voice.envPhase != Spu::EnvPhase::Off)) {
+                Spu::keyOff(voice);
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Update the given parts of all the playing SPU voices from the current settings.
+// Voices which are not playing are skipped: they are fully updated when they are next used to sound a note.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SamplerEngine::updateSpuVoices(const uint8_t updateFlags) noexcept {
+    for (uint32_t voiceIdx = 0; voiceIdx < kMaxVoices; ++voiceIdx) {
+        if (mSpu.pVoices[voiceIdx].envPhase != Spu::EnvPhase::Off) {
+            updateSpuVoice(voiceIdx, updateFlags);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Update the given parts (a combination of 'VOICE_UPDATE' flags) of a single SPU voice from the current settings
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SamplerEngine::updateSpuVoice(const uint32_t voiceIdx, const uint8_t updateFlags) noexcept {
+    ASSERT(voiceIdx < kMaxVoices);
+
+    // Get the current pitch bend for the channel the voice is playing on and combine the instrument volume and pan with the channel's
+    const VoiceInfo& voiceInfo = mVoiceInfos[voiceIdx];
+    const uint8_t channel = voiceInfo.midiChannel;
+    const float pitchBendInNotes = mPitchBendsInNotes[channel];
+    const uint32_t volume = mSettings.volume * mMidiVolumes[channel] / 127u;
+    const uint32_t pan = (uint32_t) std::clamp<int32_t>((int32_t) mSettings.pan + (int32_t) mMidiPans[channel] - 64, 0, 127);
+
+    // Sound bank tones have their own pitch, volume and envelope
+    if (voiceInfo.bankToneIdx != kNoBankTone) {
+        applyBankToneToSpuVoice(voiceIdx, volume, pan, pitchBendInNotes, updateFlags);
+        return;
+    }
+
+    // Update the voice: note that the base note is the note at which the sample rate is 44,100 Hz (4096.0 in SPU units) so the calculation is based on that.
+    // Unbent notes are the most common case and their sample rates are looked up rather than calculated.
+    SpuVoice& voice = mSpu.pVoices[voiceIdx];
+
+    if (updateFlags == VOICE_UPDATE_ALL) {
+        voice.adpcmStartAddr8 = voiceInfo.spuStartAddr8;
+        voice.bDisabled = false;
+    }
+
+    if (updateFlags & VOICE_UPDATE_PITCH) {
+        voice.sampleRate = ((pitchBendInNotes == 0.0f) && (voiceInfo.midiNote < 128)) ?
+            mNoteSpuSampleRates[voiceInfo.midiNote] :
+            getNoteSpuSampleRate(mSettings.baseNote, (float) voiceInfo.midiNote + pitchBendInNotes);
+    }
+
+    if (updateFlags & VOICE_UPDATE_REVERB) {
+        voice.bDoReverb = mSettings.bReverb;
+    }
+
+    if (updateFlags & VOICE_UPDATE_ENVELOPE) {
+        voice.env = mSettings.adsrEnv;
+    }
+
+    if (updateFlags & VOICE_UPDATE_VOLUME) {
+        voice.volume = calcSpuVoiceVolume(volume, pan, voiceInfo.midiVelocity);
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Update the given parts (a combination of 'VOICE_UPDATE' flags) of an SPU voice playing a sound bank tone, from the settings for that tone.
+// The tone's root note, tuning and ADSR envelope are used; the given instrument and channel volume and pan are combined with the bank,
+// program and tone volume and pan. The instrument's pitch bend and reverb settings still apply.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SamplerEngine::applyBankToneToSpuVoice(
+    const uint32_t voiceIdx,
+    const uint32_t volume,
+    const uint32_t pan,
+    const float pitchBendInNotes,
+    const uint8_t updateFlags
+) noexcept {
+    ASSERT(voiceIdx < kMaxVoices);
+    const VoiceInfo& voiceInfo = mVoiceInfos[voiceIdx];
+    SpuVoice& voice = mSpu.pVoices[voiceIdx];
+
+    if (updateFlags == VOICE_UPDATE_ALL) {
+        voice.adpcmStartAddr8 = voiceInfo.spuStartAddr8;
+        voice.bDisabled = false;
+    }
+
+    if (updateFlags & VOICE_UPDATE_REVERB) {
+        voice.bDoReverb = mSettings.bReverb;
+    }
+
+    if ((!mpSampleBank) || (voiceInfo.bankToneIdx >= mpSampleBank->vab.tones.size()))
+        return;
+
+    const VabUtils::VabBank& vab = mpSampleBank->vab;
+    const VabUtils::VabTone& tone = vab.tones[voiceInfo.bankToneIdx];
+
+    // The tone's root note plays the sample at 44,100 Hz, plus or minus any fine tuning
+    if (updateFlags & VOICE_UPDATE_PITCH) {
+        const float baseNote = (float) tone.rootNote + (float) tone.fineTune / 128.0f;
+        voice.sampleRate = getNoteSpuSampleRate(baseNote, (float) voiceInfo.midiNote + pitchBendInNotes);
+    }
+
+    // Note: the instrument's envelope doesn't apply to sound bank tones, so only a full update sets the envelope
+    if (updateFlags == VOICE_UPDATE_ALL) {
+        voice.envBits = tone.adsrBits;
+    }
+
+    // Combine all the volume levels (0-127 each) and pan offsets (64 = center)
+    if (updateFlags & VOICE_UPDATE_VOLUME) {
+        const VabUtils::VabProgram& program = vab.programs[voiceInfo.bankProgram & 0x7Fu];
+        const uint32_t bankVolume = (uint32_t) tone.volume * program.volume * vab.masterVolume / (127u * 127u);
+        const int32_t panOffset = ((int32_t) tone.pan - 64) + ((int32_t) program.pan - 64) + ((int32_t) vab.masterPan - 64);
+        const uint32_t bankPan = (uint32_t) std::clamp<int32_t>((int32_t) pan + panOffset, 0, 127);
+        voice.volume = calcSpuVoiceVolume(volume * bankVolume / 127u, bankPan, voiceInfo.midiVelocity);
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Recompute the sample rate of each note played with the instrument's own sample when there is no pitch bend, after the base note changes
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SamplerEngine::updateNoteSpuSampleRates() noexcept {
+    for (uint32_t note = 0; note < 128; ++note) {
+        mNoteSpuSampleRates[note] = getNoteSpuSampleRate(mSettings.baseNote, (float) note);
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Recompute how many semitones of pitch bend are being applied to the given MIDI channel, after the channel's pitch bend or the pitch
+// bend settings change. The result is saved so voices can be updated without doing this again for each of them.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SamplerEngine::updatePitchBendInNotes(const uint8_t channel) noexcept {
+    ASSERT(channel < kNumMidiChannels);
+    mPitchBendsInNotes[channel] = calcPitchBendInNotes(channel);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Return how many semitones of pitch bend should be applied to the given MIDI channel, based on the channel's current MIDI pitch bend
+// value and the pitchbend range.
+//------------------------------------------------------------------------------------------------------------------------------------------
+float SamplerEngine::calcPitchBendInNotes(const uint8_t channel) const noexcept {
+    ASSERT(channel < kNumMidiChannels);
+    const uint32_t curMidiPitchBend = mMidiPitchBends[channel];
+
+    // Get the clamped MIDI pitch bend
+    const uint32_t midiPitchBend = std::min<uint32_t>(curMidiPitchBend, PITCH_BEND_MAX);
+
+    // Get the normalized pitch bend in a -1.0 to +1.0 range:
+    const float pitchBendNormalized = (midiPitchBend < PITCH_BEND_CENTER) ?
+        ((float) curMidiPitchBend - (float) PITCH_BEND_CENTER) / (float)(PITCH_BEND_CENTER) :
+        ((float) curMidiPitchBend - (float) PITCH_BEND_CENTER) / (float)(PITCH_BEND_CENTER - 1);
+
+    // Figure out the semitone pitch bend and return
+    float pitchBendOffset = 0.0f;
+
+    if (midiPitchBend < PITCH_BEND_CENTER) {
+        pitchBendOffset -= mSettings.pitchBendDownOffset;
+    } else if (midiPitchBend > PITCH_BEND_CENTER) {
+        pitchBendOffset += mSettings.pitchBendUpOffset;
+    }
+
+    const float scaledPitchBend = (pitchBendNormalized < 0) ? pitchBendNormalized * mSettings.pitchstepDown : pitchBendNormalized * mSettings.pitchstepUp;
+    const float totalPitchBend = scaledPitchBend + pitchBendOffset;
+    return totalPitchBend;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Returns the given bank program if it is used by the bank, otherwise the first program that is used
+//------------------------------------------------------------------------------------------------------------------------------------------
+uint8_t SamplerEngine::getUsedBankProgram(const VabUtils::VabBank& vab, const uint8_t program) noexcept {
+    return (vab.programs[program & 0x7Fu].numTones > 0) ? (program & 0x7Fu) : VabUtils::getFirstUsedVabProgram(vab);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Compute the left/right volume for an SPU voice given the instrument volume (0-127) and pan (0-127, 64 = center) and the velocity
+// that the note was sounded with, from 0-127. Values outside of those ranges are clamped.
+//------------------------------------------------------------------------------------------------------------------------------------------
+Spu::Volume SamplerEngine::calcSpuVoiceVolume(const uint32_t volume, const uint32_t pan, const uint32_t velocity) noexcept {
+    const float volumeF = VOICE_VOLUME_TABLES.levels[std::min(volume, 127u)];
+    const float velocityF = VOICE_VOLUME_TABLES.levels[std::min(velocity, 127u)];
+    const float scaleF = volumeF * velocityF;
+    const float panF = VOICE_VOLUME_TABLES.pans[std::min(pan, 127u)];
+    const float volumeLF = ((1.0f - panF) / 2.0f) * scaleF;
+    const float volumeRF = ((1.0f + panF) / 2.0f) * scaleF;
+
+    return Spu::Volume{
+        (int16_t) std::round(volumeLF * (float) 0x7FFF),
+        (int16_t) std::round(volumeRF * (float) 0x7FFF)
+    };
+}
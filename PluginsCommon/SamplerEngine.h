@@ -0,0 +1,142 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "Spu.h"
+#include "VabUtils.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// The instrument logic of the PlayStation 1 sampler: turns MIDI messages into SPU voice key on/off and voice settings.
+//
+// Plays either a single sample (placed at the start of SPU RAM by the owner) across the keyboard, or a VAB sound bank with a separate bank
+// program for each MIDI channel. All channels share the voices of the one SPU core and the same voice allocator, just like on the PS1.
+// This is shared by the sampler plugin and the command line renderer, so that both produce exactly the same output for the same input.
+// Not thread safe: the owner must make sure the engine and it's SPU core are only used by one thread at a time.
+//------------------------------------------------------------------------------------------------------------------------------------------
+class SamplerEngine {
+public:
+    // The type of SPU driven by the engine: floating point, so that voices never clip or lose precision when mixed
+    typedef Spu::FloatSample                SpuSample;
+    typedef Spu::StereoSample<SpuSample>    SpuStereoSample;
+    typedef Spu::Voice<SpuSample>           SpuVoice;
+    typedef Spu::Core<SpuSample>            SpuCore;
+
+    // Maximum number of active voices: this is the hardware limit of the PS1
+    static constexpr uint32_t kMaxVoices = 24;
+
+    // Number of MIDI channels: when a sound bank is loaded each channel plays its own bank program
+    static constexpr uint32_t kNumMidiChannels = 16;
+
+    // Value for 'VoiceInfo::bankToneIdx' when the voice is not playing a sound bank tone
+    static constexpr uint16_t kNoBankTone = 0xFFFFu;
+
+    // Voice allocation priority used for notes played with the instrument's own sample: the highest priority a sound bank tone can have
+    static constexpr uint8_t kMaxVoicePriority = 127;
+
+    // Settings for the instrument's own sample, some of which also apply to sound bank tones
+    struct Settings {
+        float               baseNote;               // The note at which the sample plays at 44,100 Hz
+        uint32_t            volume;                 // 0-127: instrument volume
+        uint32_t            pan;                    // 0-127: instrument pan, 64 = center
+        float               pitchstepUp;            // Pitch bend range up in semitones
+        float               pitchstepDown;          // Pitch bend range down in semitones
+        float               pitchBendUpOffset;      // Semitones added to any upwards pitch bend
+        float               pitchBendDownOffset;    // Semitones subtracted from any downwards pitch bend
+        uint32_t            noteMin;                // Lowest note that can be played (inclusive)
+        uint32_t            noteMax;                // Highest note that can be played (inclusive)
+        Spu::AdsrEnvelope   adsrEnv;                // Envelope for the instrument's own sample: sound bank tones have their own envelopes
+        bool                bReverb;                // Whether voices are sent to the SPU reverb
+    };
+
+    // Information for a playing voice
+    struct VoiceInfo {
+        uint16_t midiNote;            // The note played
+        uint16_t midiVelocity;        // 0-127 velocity
+        uint8_t  midiChannel;         // 0-15: the MIDI channel the note was played on
+        uint8_t  bankProgram;         // Sound bank program played by the voice: unused if not playing a sound bank tone
+        uint8_t  priority;            // 0-127: voice allocation priority, lower priority voices are stolen first when voices run out
+        uint32_t numSamplesActive;    // Number of samples the voice has been active for
+        uint16_t bankToneIdx;         // Sound bank tone played by the voice, or 'kNoBankTone' if playing the instrument's own sample
+        uint32_t spuStartAddr8;       // Where the sample played by the voice starts in SPU RAM, in 8 byte units
+    };
+
+    // A VAB sound bank loaded into the sampler, which replaces the instrument's own sample.
+    // The bank files stay memory mapped and are indexed without copying the body. All of the samples are uploaded to an SPU RAM image
+    // when the bank is loaded, off the audio thread, so playing a note only has to look up where its samples are.
+    struct SampleBank {
+        MappedFile                          headerFile;         // The .vab file, or the .vh file of a .vh/.vb pair
+        MappedFile                          bodyFile;           // The .vb file of a .vh/.vb pair, unused for .vab files
+        AudioTools::VabUtils::VabBank       vab;                // Index of the bank's programs, tones and samples
+        std::string                         filePath;           // Path to the .vab or .vh file
+        std::vector<uint32_t>               sampleSpuAddrs8;    // Where each sample is in SPU RAM (8 byte units), or 0 if it didn't fit
+        uint32_t                            spuRamUsed;         // How much SPU RAM (from the start) is in use by uploaded samples
+        uint8_t                             channelPrograms[kNumMidiChannels];  // Bank program played by each MIDI channel, changed with MIDI program change messages
+    };
+
+    explicit SamplerEngine(SpuCore& spu) noexcept;
+    ~SamplerEngine() noexcept;
+
+    void reset() noexcept;
+    inline const Settings& getSettings() const noexcept { return mSettings; }
+    void setSettings(const Settings& settings) noexcept;
+    inline const VoiceInfo& getVoiceInfo(const uint32_t voiceIdx) const noexcept { return mVoiceInfos[voiceIdx]; }
+    void processMidiMsg(const uint8_t status, const uint8_t data1, const uint8_t data2) noexcept;
+    void advanceVoices(const uint32_t numFrames) noexcept;
+    uint32_t getNumActiveVoices() const noexcept;
+    inline uint32_t getNumVoiceSteals() const noexcept { return mNumVoiceSteals; }
+    void keyOffAllVoices() noexcept;
+    void killAllVoices() noexcept;
+
+    static std::unique_ptr<SampleBank> openSampleBank(const std::string& filePath, const uint8_t program, std::string& errorMsgOut) noexcept;
+    static void uploadSampleBank(SampleBank& bank, std::byte* const pRam, const uint32_t ramSize) noexcept;
+    void swapSampleBank(std::unique_ptr<SampleBank>& pBank) noexcept;
+    inline const SampleBank* getSampleBank() const noexcept { return mpSampleBank.get(); }
+    void setChannelProgram(const uint8_t channel, const uint8_t program) noexcept;
+    static uint8_t getUsedBankProgram(const AudioTools::VabUtils::VabBank& vab, const uint8_t program) noexcept;
+
+    static void writeSampleTerminator(std::byte* const pRam, const uint32_t ramSize, const uint32_t numSampleBlocks) noexcept;
+    static double getBaseNoteForSampleRate(const double sampleRate) noexcept;
+    static double getSampleRateForBaseNote(const double baseNote) noexcept;
+
+private:
+    SamplerEngine(const SamplerEngine& other) = delete;
+    SamplerEngine& operator = (const SamplerEngine& other) = delete;
+
+    void processMidiNoteOn(const uint8_t channel, const uint8_t note, const uint8_t velocity) noexcept;
+    void processBankNoteOn(const uint8_t channel, const uint8_t note, const uint8_t velocity) noexcept;
+    uint32_t allocSpuVoice(const uint8_t priority) noexcept;
+    void processMidiNoteOff(const uint8_t channel, const uint8_t note) noexcept;
+    void processMidiPitchBend(const uint8_t channel, const uint16_t pitchBend) noexcept;
+    void processMidiAllNotesOff(const uint8_t channel) noexcept;
+    void updateChannelSpuVoices(const uint8_t channel, const uint8_t updateFlags) noexcept;
+    void doNoteOffForOutOfRangeNotes() noexcept;
+    void updateSpuVoices(const uint8_t updateFlags) noexcept;
+    void updateSpuVoice(const uint32_t voiceIdx, const uint8_t updateFlags) noexcept;
+
+    void applyBankToneToSpuVoice(
+        const uint32_t voiceIdx,
+        const uint32_t volume,
+        const uint32_t pan,
+        const float pitchBendInNotes,
+        const uint8_t updateFlags
+    ) noexcept;
+
+    void updateNoteSpuSampleRates() noexcept;
+    void updatePitchBendInNotes(const uint8_t channel) noexcept;
+    float calcPitchBendInNotes(const uint8_t channel) const noexcept;
+    static Spu::Volume calcSpuVoiceVolume(const uint32_t volume, const uint32_t pan, const uint32_t velocity) noexcept;
+
+    SpuCore&                        mSpu;                               // The SPU core driven by the engine: owned by the engine's owner
+    Settings                        mSettings;                          // Current instrument settings
+    uint32_t                        mMidiPitchBends[kNumMidiChannels];  // Current MIDI pitch bend per channel, 14-bit values: 0x2000 = center, 0x0000 = lowest, 0x3FFF = highest
+    uint8_t                         mMidiVolumes[kNumMidiChannels];     // Current MIDI channel volume (CC 7) per channel: 0-127
+    uint8_t                         mMidiPans[kNumMidiChannels];        // Current MIDI channel pan (CC 10) per channel: 0-127, 64 = center
+    float                           mPitchBendsInNotes[kNumMidiChannels];   // Semitones of pitch bend for each channel: from the channel's pitch bend and the settings
+    uint16_t                        mNoteSpuSampleRates[128];           // SPU sample rate of each note for the instrument's own sample with no pitch bend
+    VoiceInfo                       mVoiceInfos[kMaxVoices];            // Info for each SPU voice
+    std::unique_ptr<SampleBank>     mpSampleBank;                       // The loaded sound bank, if any
+    uint32_t                        mNumVoiceSteals;                    // How many times a playing voice has been stolen for a new note: wraps around
+};
@@ -0,0 +1,290 @@
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Plays PlayStation SEQ/SEP music sequences through a sampler engine
+//------------------------------------------------------------------------------------------------------------------------------------------
+#include "SeqPlayer.h"
+
+#include "Asserts.h"
+#include "FileUtils.h"
+#include "SamplerEngine.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace AudioTools;
+
+// MIDI messages and controllers used by the player
+static constexpr uint8_t    MIDI_CONTROL_CHANGE     = 0xBu;
+static constexpr uint8_t    MIDI_PITCH_WHEEL        = 0xEu;
+static constexpr uint8_t    MIDI_CC_DATA_ENTRY      = 6;
+static constexpr uint8_t    MIDI_CC_VOLUME          = 7;
+static constexpr uint8_t    MIDI_CC_PAN             = 10;
+static constexpr uint8_t    MIDI_CC_NRPN_MSB        = 99;
+
+// NRPN values used by SEQ files to mark loops
+static constexpr uint8_t    SEQ_NRPN_LOOP_START     = 20;
+static constexpr uint8_t    SEQ_NRPN_LOOP_END       = 30;
+static constexpr uint8_t    SEQ_LOOP_FOREVER        = 127;
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Creates the player for the given sampler engine, with no song loaded
+//------------------------------------------------------------------------------------------------------------------------------------------
+SeqPlayer::SeqPlayer(SamplerEngine& engine) noexcept
+    : mEngine(engine)
+    , mpSong()
+    , mpSequence(nullptr)
+    , mbPlaying(false)
+    , mNumPlays(0)
+    , mNumPlaysDone(0)
+    , mMaxLoopRepeats(kNoLoopLimit)
+    , mOffset(0)
+    , mRunningStatus(0)
+    , mbHaveEvent(false)
+    , mNextEvent()
+    , mFramesPerTick(0.0)
+    , mFramesToNextEvent(0.0)
+    , mLoopStartOffset(0)
+    , mLoopRunningStatus(0)
+    , mLoopCount(0)
+    , mNumLoopRepeats(0)
+    , mLoopTicks(0)
+    , mPlayTicks(0)
+    , mbInLoop(false)
+    , mbLoopCountNext(false)
+{
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Frees the loaded song (if any): playing notes are left alone since the engine belongs to the owner
+//------------------------------------------------------------------------------------------------------------------------------------------
+SeqPlayer::~SeqPlayer() noexcept {
+    mpSequence = nullptr;
+    mpSong.reset();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Open a .seq or .sep file, ready to be swapped into a player.
+// The file is memory mapped and indexed, and each sequence is checked to make sure it can be played.
+// Returns null and an error message on failure.
+//------------------------------------------------------------------------------------------------------------------------------------------
+std::unique_ptr<SeqPlayer::Song> SeqPlayer::openSong(const std::string& filePath, std::string& errorMsgOut) noexcept {
+    std::unique_ptr<Song> pSong;
+
+    try {
+        pSong = std::make_unique<Song>();
+        pSong->filePath = filePath;
+    } catch (...) {
+        errorMsgOut = "Out of memory!";
+        return {};
+    }
+
+    if (!pSong->file.open(filePath.c_str())) {
+        errorMsgOut = "Unable to open the chosen file!\nDoes the file path exist and is it accessible?";
+        return {};
+    }
+
+    // The two formats can't be reliably told apart from their contents, so go by the file extension
+    const MappedFile& file = pSong->file;
+    const bool bIsSep = (FileUtils::getLowerCaseFileExt(filePath.c_str()) == ".sep");
+    const bool bParsedOk = (bIsSep) ?
+        SeqUtils::parseSep(file.data(), file.size(), pSong->seqFile, errorMsgOut) :
+        SeqUtils::parseSeq(file.data(), file.size(), pSong->seqFile, errorMsgOut);
+
+    return (bParsedOk) ? std::move(pSong) : std::unique_ptr<Song>();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Swap the given song (which may be null) with the one loaded in the player, stopping playback first
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SeqPlayer::swapSong(std::unique_ptr<Song>& pSong) noexcept {
+    stop();
+    mpSequence = nullptr;
+    mpSong.swap(pSong);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Start playing the given sequence in the loaded song from the beginning, the given number of times (0 = forever).
+// Resets the pitch bend, volume and pan for all MIDI channels first; the bank program for each channel is left for the sequence to set.
+// Returns false if there is no such sequence.
+//------------------------------------------------------------------------------------------------------------------------------------------
+bool SeqPlayer::play(const uint32_t seqIdx, const uint32_t numPlays) noexcept {
+    stop();
+
+    if ((!mpSong) || (seqIdx >= mpSong->seqFile.sequences.size()))
+        return false;
+
+    for (uint8_t channel = 0; channel < SamplerEngine::kNumMidiChannels; ++channel) {
+        mEngine.processMidiMsg((MIDI_PITCH_WHEEL << 4) | channel, 0x00, 0x40);
+        mEngine.processMidiMsg((MIDI_CONTROL_CHANGE << 4) | channel, MIDI_CC_VOLUME, 127);
+        mEngine.processMidiMsg((MIDI_CONTROL_CHANGE << 4) | channel, MIDI_CC_PAN, 64);
+    }
+
+    mpSequence = &mpSong->seqFile.sequences[seqIdx];
+    mbPlaying = true;
+    mNumPlays = numPlays;
+    mNumPlaysDone = 0;
+    mFramesToNextEvent = 0.0;
+    restart();
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Stop playback, if playing, and release all playing notes
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SeqPlayer::stop() noexcept {
+    if (mbPlaying) {
+        mbPlaying = false;
+        mEngine.keyOffAllVoices();
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Send all of the sequence events which are due to the engine and return how many frames the owner should run the SPU for before calling
+// this again: from 1 up to the given maximum. The player's time is moved forward by that number of frames.
+// If nothing is playing then the maximum is always returned.
+//------------------------------------------------------------------------------------------------------------------------------------------
+uint32_t SeqPlayer::update(const uint32_t maxFrames) noexcept {
+    ASSERT(maxFrames > 0);
+
+    while (mbPlaying && (mFramesToNextEvent <= 0.0)) {
+        // Process the next event once it is due, then read the one after it to find out when that is due
+        if (mbHaveEvent) {
+            mbHaveEvent = false;
+            processEvent(mNextEvent);
+            continue;
+        }
+
+        // A sequence that runs out of data without an end of track event just ends there
+        if ((mOffset >= mpSequence->dataSize) || (!SeqUtils::readSeqEvent(*mpSequence, mOffset, mRunningStatus, mNextEvent))) {
+            endSequence();
+            continue;
+        }
+
+        mbHaveEvent = true;
+        mLoopTicks += mNextEvent.deltaTicks;
+        mPlayTicks += mNextEvent.deltaTicks;
+        mFramesToNextEvent += (double) mNextEvent.deltaTicks * mFramesPerTick;
+    }
+
+    if (!mbPlaying)
+        return maxFrames;
+
+    // Note: the event is rounded to the next whole frame but the remainder is carried over, so timing doesn't drift
+    const uint32_t numFrames = (uint32_t) std::min<double>(std::ceil(mFramesToNextEvent), (double) maxFrames);
+    mFramesToNextEvent -= (double) numFrames;
+    return numFrames;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Go back to the start of the sequence being played and reset the tempo and loop state
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SeqPlayer::restart() noexcept {
+    ASSERT(mpSequence);
+    mOffset = 0;
+    mRunningStatus = 0;
+    mbHaveEvent = false;
+    mLoopStartOffset = 0;
+    mLoopRunningStatus = 0;
+    mLoopCount = 0;
+    mNumLoopRepeats = 0;
+    mLoopTicks = 0;
+    mPlayTicks = 0;
+    mbInLoop = false;
+    mbLoopCountNext = false;
+    setTempo(mpSequence->tempo);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Process a single sequence event once it is due
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SeqPlayer::processEvent(const SeqUtils::SeqEvent& event) noexcept {
+    switch (event.type) {
+        case SeqUtils::SeqEventType::Midi: {
+            if ((event.status >> 4) == MIDI_CONTROL_CHANGE) {
+                processControlChange(event.data1, event.data2);
+            }
+
+            // Note: loop markers are sent too, since the engine ignores controllers it doesn't use
+            mEngine.processMidiMsg(event.status, event.data1, event.data2);
+        }   break;
+
+        case SeqUtils::SeqEventType::Tempo:
+            setTempo(event.tempo);
+            break;
+
+        case SeqUtils::SeqEventType::End:
+            endSequence();
+            break;
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Handle the controllers used by SEQ files to mark loops, which apply to the whole sequence rather than just the channel they are on
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SeqPlayer::processControlChange(const uint8_t controller, const uint8_t value) noexcept {
+    if (controller == MIDI_CC_DATA_ENTRY) {
+        if (mbLoopCountNext) {
+            mLoopCount = value;
+            mbLoopCountNext = false;
+        }
+
+        return;
+    }
+
+    if (controller != MIDI_CC_NRPN_MSB)
+        return;
+
+    if (value == SEQ_NRPN_LOOP_START) {
+        // The loop starts after this event: the loop count comes next but only needs to be read once
+        mLoopStartOffset = mOffset;
+        mLoopRunningStatus = mRunningStatus;
+        mLoopCount = 0;
+        mNumLoopRepeats = 0;
+        mLoopTicks = 0;
+        mbInLoop = true;
+        mbLoopCountNext = true;
+    }
+    else if ((value == SEQ_NRPN_LOOP_END) && mbInLoop) {
+        // Decide whether to go round again: a loop which takes no time at all is never repeated, since it would hang the player
+        const bool bLoopForever = ((mLoopCount == 0) || (mLoopCount == SEQ_LOOP_FOREVER));
+        bool bRepeat = false;
+
+        if (mLoopTicks > 0) {
+            if (bLoopForever) {
+                bRepeat = ((mMaxLoopRepeats == kNoLoopLimit) || (mNumLoopRepeats < mMaxLoopRepeats));
+            } else {
+                bRepeat = (mNumLoopRepeats + 1 < mLoopCount);
+            }
+        }
+
+        if (bRepeat) {
+            mOffset = mLoopStartOffset;
+            mRunningStatus = mLoopRunningStatus;
+            mNumLoopRepeats++;
+            mLoopTicks = 0;
+        } else {
+            mbInLoop = false;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Called when the end of the sequence is reached: plays it again if it is to be played more times, otherwise stops playback.
+// As with loops, a sequence which takes no time at all is never repeated.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SeqPlayer::endSequence() noexcept {
+    mNumPlaysDone++;
+
+    if ((mPlayTicks > 0) && ((mNumPlays == 0) || (mNumPlaysDone < mNumPlays))) {
+        restart();
+    } else {
+        stop();
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Set the current tempo, in microseconds per quarter note
+//------------------------------------------------------------------------------------------------------------------------------------------
+void SeqPlayer::setTempo(const uint32_t tempo) noexcept {
+    ASSERT(mpSequence && (mpSequence->resolution > 0));
+    mFramesPerTick = ((double) tempo * (double) kSampleRate) / (1000000.0 * (double) mpSequence->resolution);
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "SeqUtils.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class SamplerEngine;
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Plays PlayStation SEQ/SEP music sequences through a sampler engine, which normally has the VAB sound bank for the music loaded.
+//
+// The player works in SPU output frames (44,100 Hz) so it can be driven sample accurately from the audio thread or as fast as possible for
+// offline rendering. The owner calls 'update' which sends all events that are due straight to the engine and tells how many frames to run
+// the SPU for before calling it again. Tempo changes and the SEQ loop markers are handled the same way as the PS1 sound library:
+//
+//  - NRPN (CC 99) with a value of 20 marks the start of a loop and the data entry (CC 6) that follows it gives the loop count.
+//    A loop count of 0 or 127 loops forever.
+//  - NRPN (CC 99) with a value of 30 marks the end of a loop: playback jumps back to the loop start until the loop count is used up.
+//
+// Not thread safe: the owner must make sure the player is only used by the same thread as the engine it drives, at any one time.
+//------------------------------------------------------------------------------------------------------------------------------------------
+class SeqPlayer {
+public:
+    // SPU output sample rate: sequence ticks are converted to frames at this rate
+    static constexpr uint32_t kSampleRate = 44100;
+
+    // Value for 'setMaxLoopRepeats' to never stop repeating loops which loop forever
+    static constexpr uint32_t kNoLoopLimit = UINT32_MAX;
+
+    // A .seq or .sep file loaded into the player.
+    // The file stays memory mapped and the sequences reference their event data directly in the mapping.
+    struct Song {
+        MappedFile                      file;           // The .seq or .sep file
+        AudioTools::SeqUtils::SeqFile   seqFile;        // Index of the sequences in the file
+        std::string                     filePath;       // Path to the .seq or .sep file
+    };
+
+    explicit SeqPlayer(SamplerEngine& engine) noexcept;
+    ~SeqPlayer() noexcept;
+
+    static std::unique_ptr<Song> openSong(const std::string& filePath, std::string& errorMsgOut) noexcept;
+    void swapSong(std::unique_ptr<Song>& pSong) noexcept;
+    inline const Song* getSong() const noexcept { return mpSong.get(); }
+
+    bool play(const uint32_t seqIdx, const uint32_t numPlays) noexcept;
+    void stop() noexcept;
+    inline bool isPlaying() const noexcept { return mbPlaying; }
+    inline void setMaxLoopRepeats(const uint32_t maxRepeats) noexcept { mMaxLoopRepeats = maxRepeats; }
+    uint32_t update(const uint32_t maxFrames) noexcept;
+
+private:
+    SeqPlayer(const SeqPlayer& other) = delete;
+    SeqPlayer& operator = (const SeqPlayer& other) = delete;
+
+    void restart() noexcept;
+    void processEvent(const AudioTools::SeqUtils::SeqEvent& event) noexcept;
+    void processControlChange(const uint8_t controller, const uint8_t value) noexcept;
+    void endSequence() noexcept;
+    void setTempo(const uint32_t tempo) noexcept;
+
+    SamplerEngine&                              mEngine;                // The engine which the sequence events are sent to
+    std::unique_ptr<Song>                       mpSong;                 // The loaded .seq or .sep file, if any
+    const AudioTools::SeqUtils::SeqSequence*    mpSequence;             // The sequence being played, if any
+    bool                                        mbPlaying;              // Whether a sequence is currently playing
+    uint32_t                                    mNumPlays;              // How many times to play the sequence, or 0 to play it forever
+    uint32_t                                    mNumPlaysDone;          // How many times the sequence has been played to the end so far
+    uint32_t                                    mMaxLoopRepeats;        // Most times to repeat a loop that loops forever: for offline rendering
+    uint32_t                                    mOffset;                // Where the next event is in the sequence data
+    uint8_t                                     mRunningStatus;         // Current MIDI running status for the sequence
+    bool                                        mbHaveEvent;            // Whether 'mNextEvent' holds the next event to process
+    AudioTools::SeqUtils::SeqEvent              mNextEvent;             // The next event to process, once it's delta time has elapsed
+    double                                      mFramesPerTick;         // How many output frames each sequence tick lasts at the current tempo
+    double                                      mFramesToNextEvent;     // How many output frames until the next event is due: may be fractional
+    uint32_t                                    mLoopStartOffset;       // Where the current loop starts in the sequence data
+    uint8_t                                     mLoopRunningStatus;     // The running status at the start of the current loop
+    uint8_t                                     mLoopCount;             // How many times to play the current loop: 0 or 127 = forever
+    uint32_t                                    mNumLoopRepeats;        // How many times the current loop has been repeated so far
+    uint32_t                                    mLoopTicks;             // Ticks elapsed since the current loop (re)started
+    uint32_t                                    mPlayTicks;             // Ticks elapsed since the sequence (re)started
+    bool                                        mbInLoop;               // Whether a loop start has been seen
+    bool                                        mbLoopCountNext;        // Whether the next data entry controller gives the loop count
+};
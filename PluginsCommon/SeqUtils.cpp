@@ -0,0 +1,276 @@
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Utilities for reading PlayStation SEQ/SEP music sequences (.seq files with a single sequence, .sep files with several)
+//------------------------------------------------------------------------------------------------------------------------------------------
+#include "SeqUtils.h"
+
+#include "Asserts.h"
+#include "Endian.h"
+
+#include <cstring>
+
+BEGIN_NAMESPACE(AudioTools)
+BEGIN_NAMESPACE(SeqUtils)
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Layout of SEQ/SEP files. All values are big endian.
+//
+//  .seq:   File id (4 bytes), version (4 bytes, always 1), resolution (2 bytes), tempo (3 bytes), rhythm (2 bytes), event data.
+//  .sep:   File id (4 bytes), version (2 bytes, always 0), then for each sequence:
+//              Sequence id (2 bytes), resolution (2 bytes), tempo (3 bytes), rhythm (2 bytes), event data size (4 bytes), event data.
+//
+// The event data is much like a MIDI file track: each event is preceded by a variable length delta time and running status is used.
+// The only meta events are tempo changes (FF 51 + 3 byte tempo) and end of track (FF 2F) and neither of them has a length byte.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static constexpr uint32_t SEQ_HDR_SIZE          = 15;
+static constexpr uint32_t SEQ_VERSION           = 1;
+static constexpr uint32_t SEP_HDR_SIZE          = 6;
+static constexpr uint32_t SEP_SEQ_HDR_SIZE      = 13;
+static constexpr uint32_t SEP_VERSION           = 0;
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Helper: read a big endian value from a possibly unaligned location in memory
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <class T>
+static T readBig(const std::byte* const pData) noexcept {
+    T value;
+    std::memcpy(&value, pData, sizeof(T));
+    return Endian::bigToHost(value);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Helper: read a 3 byte big endian tempo value, substituting the default tempo for a tempo of zero
+//------------------------------------------------------------------------------------------------------------------------------------------
+static uint32_t readTempo(const std::byte* const pData) noexcept {
+    const uint32_t tempo = ((uint32_t) pData[0] << 16) | ((uint32_t) pData[1] << 8) | (uint32_t) pData[2];
+    return (tempo != 0) ? tempo : SEQ_DEFAULT_TEMPO;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Helper: reads through all of the events in the given sequence to make sure they can be played, throwing if they can't.
+// Trims the sequence data to end at the end of track event, which is followed by padding in some files.
+// A sequence which runs out of data without an end of track event is allowed and simply ends there.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void validateSequence(SeqSequence& sequence) {
+    if (sequence.resolution == 0)
+        throw "A sequence has a resolution of zero!";
+
+    uint32_t offset = 0;
+    uint8_t runningStatus = 0;
+    SeqEvent event = {};
+
+    while (offset < sequence.dataSize) {
+        if (!readSeqEvent(sequence, offset, runningStatus, event))
+            throw "A sequence contains an invalid or truncated event!";
+
+        if (event.type == SeqEventType::End) {
+            sequence.dataSize = offset;
+            break;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Tells if the given data starts with a SEQ/SEP file id
+//------------------------------------------------------------------------------------------------------------------------------------------
+bool isSeqHeader(const std::byte* const pData, const size_t dataSize) noexcept {
+    ASSERT(pData || (dataSize == 0));
+    return ((dataSize >= sizeof(uint32_t)) && (readBig<uint32_t>(pData) == SEQ_FILE_ID));
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Index a .seq file held in memory, which contains a single sequence.
+// The event data is checked to make sure it can be played but is not copied.
+//------------------------------------------------------------------------------------------------------------------------------------------
+bool parseSeq(const std::byte* const pData, const size_t dataSize, SeqFile& fileOut, std::string& errorMsgOut) noexcept {
+    ASSERT(pData || (dataSize == 0));
+    fileOut.sequences.clear();
+    bool bParseOk = false;
+
+    try {
+        if ((dataSize < SEQ_HDR_SIZE) || (!isSeqHeader(pData, dataSize)))
+            throw "The file is not a valid .seq file!";
+
+        if (readBig<uint32_t>(pData + 4) != SEQ_VERSION)
+            throw "Unsupported .seq file version!";
+
+        if (dataSize - SEQ_HDR_SIZE > UINT32_MAX)
+            throw "The file is too big!";
+
+        SeqSequence sequence = {};
+        sequence.pData = pData + SEQ_HDR_SIZE;
+        sequence.dataSize = (uint32_t)(dataSize - SEQ_HDR_SIZE);
+        sequence.seqId = 0;
+        sequence.resolution = readBig<uint16_t>(pData + 8);
+        sequence.tempo = readTempo(pData + 10);
+        validateSequence(sequence);
+
+        fileOut.sequences.push_back(sequence);
+        bParseOk = true;
+    }
+    catch (const char* const exceptionMsg) {
+        errorMsgOut = "An error occurred while reading the sequence! It may not be a valid .seq file. Error message: ";
+        errorMsgOut += exceptionMsg;
+    }
+    catch (...) {
+        errorMsgOut = "An error occurred while reading the sequence! Out of memory.";
+    }
+
+    if (!bParseOk) {
+        fileOut.sequences.clear();
+    }
+
+    return bParseOk;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Index a .sep file held in memory, which contains one or more sequences.
+// The event data for each sequence is checked to make sure it can be played but is not copied.
+//------------------------------------------------------------------------------------------------------------------------------------------
+bool parseSep(const std::byte* const pData, const size_t dataSize, SeqFile& fileOut, std::string& errorMsgOut) noexcept {
+    ASSERT(pData || (dataSize == 0));
+    fileOut.sequences.clear();
+    bool bParseOk = false;
+
+    try {
+        if ((dataSize < SEP_HDR_SIZE) || (!isSeqHeader(pData, dataSize)))
+            throw "The file is not a valid .sep file!";
+
+        if (readBig<uint16_t>(pData + 4) != SEP_VERSION)
+            throw "Unsupported .sep file version!";
+
+        // Read sequences until there is no room left for another: anything left over is just padding
+        size_t offset = SEP_HDR_SIZE;
+
+        while (dataSize - offset >= SEP_SEQ_HDR_SIZE) {
+            const std::byte* const pSeqHdr = pData + offset;
+            const uint32_t seqDataSize = readBig<uint32_t>(pSeqHdr + 9);
+            offset += SEP_SEQ_HDR_SIZE;
+
+            if (seqDataSize > dataSize - offset)
+                throw "A sequence is truncated!";
+
+            SeqSequence sequence = {};
+            sequence.pData = pData + offset;
+            sequence.dataSize = seqDataSize;
+            sequence.seqId = readBig<uint16_t>(pSeqHdr);
+            sequence.resolution = readBig<uint16_t>(pSeqHdr + 2);
+            sequence.tempo = readTempo(pSeqHdr + 4);
+            validateSequence(sequence);
+
+            fileOut.sequences.push_back(sequence);
+            offset += seqDataSize;
+        }
+
+        if (fileOut.sequences.empty())
+            throw "The file contains no sequences!";
+
+        bParseOk = true;
+    }
+    catch (const char* const exceptionMsg) {
+        errorMsgOut = "An error occurred while reading the sequences! It may not be a valid .sep file. Error message: ";
+        errorMsgOut += exceptionMsg;
+    }
+    catch (...) {
+        errorMsgOut = "An error occurred while reading the sequences! Out of memory.";
+    }
+
+    if (!bParseOk) {
+        fileOut.sequences.clear();
+    }
+
+    return bParseOk;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Read the sequence event at the given offset in the sequence data, moving the offset past it and updating the MIDI running status.
+// Returns false if the event is invalid or truncated, in which case the offset and running status are left alone.
+//------------------------------------------------------------------------------------------------------------------------------------------
+bool readSeqEvent(
+    const SeqSequence& sequence,
+    uint32_t& offset,
+    uint8_t& runningStatus,
+    SeqEvent& eventOut
+) noexcept {
+    const std::byte* const pData = sequence.pData;
+    const uint32_t dataSize = sequence.dataSize;
+    uint32_t curOffset = offset;
+
+    // Read the delta time: a variable length quantity of up to 4 bytes, 7 bits per byte with the top bit set on all but the last byte
+    uint32_t deltaTicks = 0;
+
+    for (uint32_t numBytes = 0; ; ++numBytes) {
+        if ((numBytes >= 4) || (curOffset >= dataSize))
+            return false;
+
+        const uint8_t deltaByte = (uint8_t) pData[curOffset++];
+        deltaTicks = (deltaTicks << 7) | (deltaByte & 0x7Fu);
+
+        if ((deltaByte & 0x80u) == 0)
+            break;
+    }
+
+    // Read the status byte or use the running status if there is none
+    if (curOffset >= dataSize)
+        return false;
+
+    uint8_t status = (uint8_t) pData[curOffset];
+
+    if (status & 0x80u) {
+        curOffset++;
+    } else {
+        status = runningStatus;
+
+        if (status == 0)
+            return false;
+    }
+
+    eventOut = {};
+    eventOut.deltaTicks = deltaTicks;
+    eventOut.status = status;
+
+    if (status == 0xFFu) {
+        // Meta event: note that running status is unaffected by these
+        if (curOffset >= dataSize)
+            return false;
+
+        const uint8_t metaType = (uint8_t) pData[curOffset++];
+
+        if (metaType == 0x2Fu) {
+            eventOut.type = SeqEventType::End;
+        } else if (metaType == 0x51u) {
+            if (dataSize - curOffset < 3)
+                return false;
+
+            eventOut.type = SeqEventType::Tempo;
+            eventOut.tempo = readTempo(pData + curOffset);
+            curOffset += 3;
+        } else {
+            return false;
+        }
+    } else if (status >= 0xF0u) {
+        // System messages are never used in sequences
+        return false;
+    } else {
+        // MIDI channel message: program change and channel pressure have 1 data byte, everything else has 2
+        const uint8_t statusMsgType = status >> 4;
+        const uint32_t numDataBytes = ((statusMsgType == 0xCu) || (statusMsgType == 0xDu)) ? 1 : 2;
+
+        if (dataSize - curOffset < numDataBytes)
+            return false;
+
+        eventOut.type = SeqEventType::Midi;
+        eventOut.data1 = (uint8_t) pData[curOffset++] & 0x7Fu;
+
+        if (numDataBytes >= 2) {
+            eventOut.data2 = (uint8_t) pData[curOffset++] & 0x7Fu;
+        }
+
+        runningStatus = status;
+    }
+
+    offset = curOffset;
+    return true;
+}
+
+END_NAMESPACE(SeqUtils)
+END_NAMESPACE(AudioTools)
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Macros.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+BEGIN_NAMESPACE(AudioTools)
+BEGIN_NAMESPACE(SeqUtils)
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// SEQ/SEP sequence constants
+//------------------------------------------------------------------------------------------------------------------------------------------
+static constexpr uint32_t SEQ_FILE_ID               = 0x70514553;   // SEQ/SEP file id: reads as 'pQES' in the (big endian) file
+static constexpr uint32_t SEQ_DEFAULT_TEMPO         = 500000;       // Tempo used if a sequence specifies none: 120 BPM
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// A single sequence in a .seq or .sep file.
+// The event data is NOT copied and is instead referenced directly in the file data, so it is only valid for as long as that memory is.
+//------------------------------------------------------------------------------------------------------------------------------------------
+struct SeqSequence {
+    const std::byte*    pData;          // Event data for the sequence: starts with the delta time of the first event
+    uint32_t            dataSize;       // Size of the event data, up to and including the end of track event
+    uint16_t            seqId;          // Id of the sequence within a .sep file: always zero for .seq files
+    uint16_t            resolution;     // Number of ticks per quarter note
+    uint32_t            tempo;          // Initial tempo in microseconds per quarter note
+};
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// An index of all the sequences in a .seq file (always one sequence) or a .sep file (one or more sequences)
+//------------------------------------------------------------------------------------------------------------------------------------------
+struct SeqFile {
+    std::vector<SeqSequence>    sequences;
+};
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// A single event read from a sequence.
+// Sequence events are MIDI channel messages with running status, plus tempo change and end of track meta events.
+//------------------------------------------------------------------------------------------------------------------------------------------
+enum class SeqEventType : uint8_t {
+    Midi,       // A MIDI channel message
+    Tempo,      // Tempo change
+    End         // End of the sequence
+};
+
+struct SeqEvent {
+    uint32_t        deltaTicks;     // Ticks since the previous event
+    SeqEventType    type;
+    uint8_t         status;         // MIDI events: status byte, including the channel
+    uint8_t         data1;          // MIDI events: first data byte, if used by the message
+    uint8_t         data2;          // MIDI events: second data byte, if used by the message
+    uint32_t        tempo;          // Tempo events: the new tempo in microseconds per quarter note
+};
+
+bool isSeqHeader(const std::byte* const pData, const size_t dataSize) noexcept;
+bool parseSeq(const std::byte* const pData, const size_t dataSize, SeqFile& fileOut, std::string& errorMsgOut) noexcept;
+bool parseSep(const std::byte* const pData, const size_t dataSize, SeqFile& fileOut, std::string& errorMsgOut) noexcept;
+
+bool readSeqEvent(
+    const SeqSequence& sequence,
+    uint32_t& offset,
+    uint8_t& runningStatus,
+    SeqEvent& eventOut
+) noexcept;
+
+END_NAMESPACE(SeqUtils)
+END_NAMESPACE(AudioTools)
@@ -3,6 +3,8 @@
 #include "Asserts.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 
 // Additions by JDM
 
@@ -45,6 +47,11 @@ static constexpr int32_t INTERP_GAUSS_TABLE[512] = {
     0x593A, 0x5949, 0x5958, 0x5965, 0x5971, 0x597C, 0x5986, 0x598F, 0x5997, 0x599E, 0x59A4, 0x59A9, 0x59AD, 0x59B0, 0x59B2, 0x59B3,
 };
 
+// Float SPU: reverb work area values smaller than this are flushed to zero when written.
+// As reverb decays it would otherwise fill the work area with denormal floats, which are very slow to process on some CPUs.
+// This level is about -200 dB, far below anything audible (even at 24-bit) but well above the denormal range.
+static constexpr float REVERB_FLUSH_LEVEL = 1.0e-10f;
+
 // A series of co-efficients used by the SPU's reverb down/upsampler.
 // See https://psx-spx.consoledev.net/soundprocessingunitspu/#reverb-buffer-resampling for details.
 static constexpr int32_t NUM_TAPS = 39;
@@ -78,20 +85,24 @@ static void sramRead(
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Decode an ADPCM block for the given voice
 //------------------------------------------------------------------------------------------------------------------------------------------
-static void decodeAdpcmBlock(Voice& voice, std::byte adpcmBlock[ADPCM_BLOCK_SIZE]) noexcept {
+template <class SampleT>
+static void decodeAdpcmBlock(Voice<SampleT>& voice, std::byte adpcmBlock[ADPCM_BLOCK_SIZE]) noexcept {
     // Hold the last 2 ADPCM samples we decoded here with the newest first.
     // They are required for the adaptive decoding throughout and carry across ADPCM blocks.
-    Sample prevSamples[2] = {
-        voice.samples[Voice::SAMPLE_BUFFER_SIZE - 1],
-        voice.samples[Voice::SAMPLE_BUFFER_SIZE - 2],
+    constexpr int32_t NUM_PREV_SAMPLES = Voice<SampleT>::NUM_PREV_SAMPLES;
+    constexpr int32_t SAMPLE_BUFFER_SIZE = Voice<SampleT>::SAMPLE_BUFFER_SIZE;
+
+    SampleT prevSamples[2] = {
+        voice.samples[SAMPLE_BUFFER_SIZE - 1],
+        voice.samples[SAMPLE_BUFFER_SIZE - 2],
     };
 
     // Save the last 3 samples of the previous ADPCM block in the part of the samples buffer reserved for that.
     // We'll need them later for interpolation.
-    static_assert(Voice::NUM_PREV_SAMPLES == 3);
-    voice.samples[0] = voice.samples[Voice::SAMPLE_BUFFER_SIZE - 3];
-    voice.samples[1] = voice.samples[Voice::SAMPLE_BUFFER_SIZE - 2];
-    voice.samples[2] = voice.samples[Voice::SAMPLE_BUFFER_SIZE - 1];
+    static_assert(NUM_PREV_SAMPLES == 3);
+    voice.samples[0] = voice.samples[SAMPLE_BUFFER_SIZE - 3];
+    voice.samples[1] = voice.samples[SAMPLE_BUFFER_SIZE - 2];
+    voice.samples[2] = voice.samples[SAMPLE_BUFFER_SIZE - 1];
 
     // Get the shift and filter to use from the first ADPCM header byte.
     // Note that the filter must be from 0-4 so if it goes beyond that then use filter mode '0' (no filter).
@@ -108,20 +119,15 @@ static void decodeAdpcmBlock(Voice& voice, std::byte adpcmBlock[ADPCM_BLOCK_SIZE
     }
 
     // Get the ADPCM filter co-efficients, both positive and negative.
+    // The float SPU uses these as fractions of 64 instead of doing the division afterwards (all are exactly representable as floats).
     // For more details on this see: https://problemkaputt.de/psx-spx.htm#cdromxaaudioadpcmcompression
-    #if SIMPLE_SPU_FLOAT_SPU
-        constexpr float FILTER_COEF_POS[5] = { 0, 60.0f / 64.0f, 115.0f / 64.0f,  98.0f / 64.0f, 122.0f / 64.0f };
-        constexpr float FILTER_COEF_NEG[5] = { 0,             0, -52.0f / 64.0f, -55.0f / 64.0f, -60.0f / 64.0f };
-
-        const float filterCoefPos = FILTER_COEF_POS[adpcmFilter];
-        const float filterCoefNeg = FILTER_COEF_NEG[adpcmFilter];
-    #else
-        constexpr int32_t FILTER_COEF_POS[5] = { 0, 60, 115,  98, 122 };
-        constexpr int32_t FILTER_COEF_NEG[5] = { 0,  0, -52, -55, -60 };
+    constexpr int32_t FILTER_COEF_POS[5] = { 0, 60, 115,  98, 122 };
+    constexpr int32_t FILTER_COEF_NEG[5] = { 0,  0, -52, -55, -60 };
 
-        const int32_t filterCoefPos = FILTER_COEF_POS[adpcmFilter];
-        const int32_t filterCoefNeg = FILTER_COEF_NEG[adpcmFilter];
-    #endif
+    const int32_t filterCoefPos = FILTER_COEF_POS[adpcmFilter];
+    const int32_t filterCoefNeg = FILTER_COEF_NEG[adpcmFilter];
+    const float filterCoefPosF = (float) filterCoefPos / 64.0f;
+    const float filterCoefNegF = (float) filterCoefNeg / 64.0f;
 
     // Decode all of the samples
     for (int32_t sampleIdx = 0; sampleIdx < ADPCM_BLOCK_NUM_SAMPLES; sampleIdx++) {
@@ -130,21 +136,21 @@ static void decodeAdpcmBlock(Voice& voice, std::byte adpcmBlock[ADPCM_BLOCK_SIZE
             ((uint16_t) adpcmBlock[2 + sampleIdx / 2] & 0x0F) >> 0:
             ((uint16_t) adpcmBlock[2 + sampleIdx / 2] & 0xF0) >> 4;
 
-        #if SIMPLE_SPU_FLOAT_SPU
+        if constexpr (SampleT::IS_FLOAT) {
             // The 4-bit sample gets extended to 16-bit by shifting and is sign extended to 32-bit.
             // After that we scale by the sample shift.
             const int16_t sampleI16 = ((int16_t)(nibble << 12)) >> sampleShift;
-            Sample sample(sampleI16);
+            SampleT sample(sampleI16);
 
             // Mix in previous samples using the filter coefficients chosen and scale the result
-            sample += prevSamples[0].value * filterCoefPos + prevSamples[1].value * filterCoefNeg;
+            sample += prevSamples[0].value * filterCoefPosF + prevSamples[1].value * filterCoefNegF;
             sample = std::clamp(sample.value, -1.0f, 1.0f);
-            voice.samples[Voice::NUM_PREV_SAMPLES + sampleIdx] = sample;
+            voice.samples[NUM_PREV_SAMPLES + sampleIdx] = sample;
 
             // Move previous samples forward
             prevSamples[1] = prevSamples[0];
             prevSamples[0] = sample;
-        #else
+        } else {
             // The 4-bit sample gets extended to 16-bit by shifting and is sign extended to 32-bit.
             // After that we scale by the sample shift.
             int32_t sample = (int32_t)(int16_t)(nibble << 12);
@@ -153,12 +159,12 @@ static void decodeAdpcmBlock(Voice& voice, std::byte adpcmBlock[ADPCM_BLOCK_SIZE
             // Mix in previous samples using the filter coefficients chosen and scale the result; also clamp to a 16-bit range
             sample += (prevSamples[0].value * filterCoefPos + prevSamples[1].value * filterCoefNeg + 32) / 64;
             sample = std::clamp<int32_t>(sample, INT16_MIN, INT16_MAX);
-            voice.samples[Voice::NUM_PREV_SAMPLES + sampleIdx] = (int16_t) sample;
+            voice.samples[NUM_PREV_SAMPLES + sampleIdx] = (int16_t) sample;
 
             // Move previous samples forward
             prevSamples[1] = prevSamples[0];
             prevSamples[0] = (int16_t) sample;
-        #endif
+        }
     }
 }
 
@@ -251,7 +257,8 @@ static EnvPhaseParams getEnvPhaseParams(const AdsrEnvelope env, const EnvPhase p
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Step the ADSR envelope for the given voice
 //------------------------------------------------------------------------------------------------------------------------------------------
-static void stepVoiceEnvelope(Voice& voice) noexcept {
+template <class SampleT>
+static void stepVoiceEnvelope(Voice<SampleT>& voice) noexcept {
     // Don't process the envelope if we must wait a few more cycles
     if (voice.envWaitCycles > 0) {
         voice.envWaitCycles--;
@@ -290,9 +297,10 @@ static void stepVoiceEnvelope(Voice& voice) noexcept {
 // Get a requested sample from the voice's sample buffer.
 // Returns a zeroed sample if the sample buffer has not been filled or if the index is out of range.
 //------------------------------------------------------------------------------------------------------------------------------------------
-static Sample getVoiceSample(const Voice& voice, const uint32_t index) noexcept {
+template <class SampleT>
+static SampleT getVoiceSample(const Voice<SampleT>& voice, const uint32_t index) noexcept {
     if (voice.bSamplesLoaded) {
-        if (index < Voice::SAMPLE_BUFFER_SIZE)
+        if (index < Voice<SampleT>::SAMPLE_BUFFER_SIZE)
             return voice.samples[index];
     }
 
@@ -302,16 +310,18 @@ static Sample getVoiceSample(const Voice& voice, const uint32_t index) noexcept
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Get the current (interpolated) sample for the given voice
 //------------------------------------------------------------------------------------------------------------------------------------------
-static Sample getInterpolatedVoiceSample(const Voice& voice) noexcept {
+template <class SampleT>
+static SampleT getInterpolatedVoiceSample(const Voice<SampleT>& voice) noexcept {
     // What sample and interpolation index should we use?
     const int32_t curSampleIdx  = (int32_t) voice.adpcmBlockPos.fields.sampleIdx;
     const int32_t gaussTableIdx = (int32_t)(uint8_t) voice.adpcmBlockPos.fields.gaussIdx;
 
     // Get the most recent sample and previous 3 samples
-    const Sample samp1 = getVoiceSample(voice, Voice::NUM_PREV_SAMPLES + curSampleIdx - 3);
-    const Sample samp2 = getVoiceSample(voice, Voice::NUM_PREV_SAMPLES + curSampleIdx - 2);
-    const Sample samp3 = getVoiceSample(voice, Voice::NUM_PREV_SAMPLES + curSampleIdx - 1);
-    const Sample samp4 = getVoiceSample(voice, Voice::NUM_PREV_SAMPLES + curSampleIdx    );
+    constexpr int32_t NUM_PREV_SAMPLES = Voice<SampleT>::NUM_PREV_SAMPLES;
+    const SampleT samp1 = getVoiceSample(voice, NUM_PREV_SAMPLES + curSampleIdx - 3);
+    const SampleT samp2 = getVoiceSample(voice, NUM_PREV_SAMPLES + curSampleIdx - 2);
+    const SampleT samp3 = getVoiceSample(voice, NUM_PREV_SAMPLES + curSampleIdx - 1);
+    const SampleT samp4 = getVoiceSample(voice, NUM_PREV_SAMPLES + curSampleIdx    );
 
     // Sanity check...
     static_assert(-1 >> 1 == -1, "Right shift on signed types must be an arithmetic shift!");
@@ -329,20 +339,20 @@ static Sample getInterpolatedVoiceSample(const Voice& voice) noexcept {
 
     // According to No$PSX it shouldn't be possible for this table to cause an overflow past 16-bits.
     // Hence I'm not bothering to clamp here...
-    #if SIMPLE_SPU_FLOAT_SPU
-        const Sample sampMix1 = samp1 * int16_t(gaussFactor1);
-        const Sample sampMix2 = samp2 * int16_t(gaussFactor2);
-        const Sample sampMix3 = samp3 * int16_t(gaussFactor3);
-        const Sample sampMix4 = samp4 * int16_t(gaussFactor4);
+    if constexpr (SampleT::IS_FLOAT) {
+        const SampleT sampMix1 = samp1 * int16_t(gaussFactor1);
+        const SampleT sampMix2 = samp2 * int16_t(gaussFactor2);
+        const SampleT sampMix3 = samp3 * int16_t(gaussFactor3);
+        const SampleT sampMix4 = samp4 * int16_t(gaussFactor4);
         return sampMix1 + sampMix2 + sampMix3 + sampMix4;
-    #else
+    } else {
         const int32_t sampMix1 = (gaussFactor1 * samp1.value) >> 15;
         const int32_t sampMix2 = (gaussFactor2 * samp2.value) >> 15;
         const int32_t sampMix3 = (gaussFactor3 * samp3.value) >> 15;
         const int32_t sampMix4 = (gaussFactor4 * samp4.value) >> 15;
 
         return (int16_t)(sampMix1 + sampMix2 + sampMix3 + sampMix4);
-    #endif
+    }
 }
 
 // Resampler implementation somewhat borrowed from PCSX2
@@ -350,23 +360,24 @@ static Sample getInterpolatedVoiceSample(const Voice& voice) noexcept {
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Get the current downsampled sample for reverb input
 //------------------------------------------------------------------------------------------------------------------------------------------
-static StereoSample firDownsample(const Core& core) noexcept {
+template <class SampleT>
+static StereoSample<SampleT> firDownsample(const Core<SampleT>& core) noexcept {
     // What sample and interpolation index should we use?
     const int32_t curBufferIdx = (int32_t)core.reverbResampleBufPos;
     const int32_t firIdx = (int32_t)((curBufferIdx - NUM_TAPS) & 63);
     int32_t currentFir;
-    StereoSample output = {};
+    StereoSample<SampleT> output = {};
 
     // Apply FIR to our samples and accumulate the result
     for (int32_t i = 0; i < NUM_TAPS; i++) {
       currentFir = INTERP_FIR_TABLE[i];
-#if SIMPLE_SPU_FLOAT_SPU
-      output.left.value += core.reverbDownsampleBuffer[firIdx + i].left * int16_t(currentFir);
-      output.right.value += core.reverbDownsampleBuffer[firIdx + i].right * int16_t(currentFir);
-#else
-      output.left += ((int32_t)core.reverbDownsampleBuffer[firIdx + i].left * currentFir) >> 15;
-      output.right += ((int32_t)core.reverbDownsampleBuffer[firIdx + i].right * currentFir) >> 15;
-#endif
+      if constexpr (SampleT::IS_FLOAT) {
+        output.left.value += core.reverbDownsampleBuffer[firIdx + i].left * int16_t(currentFir);
+        output.right.value += core.reverbDownsampleBuffer[firIdx + i].right * int16_t(currentFir);
+      } else {
+        output.left += ((int32_t)core.reverbDownsampleBuffer[firIdx + i].left * currentFir) >> 15;
+        output.right += ((int32_t)core.reverbDownsampleBuffer[firIdx + i].right * currentFir) >> 15;
+      }
     }
     return output;
 }
@@ -374,24 +385,25 @@ static StereoSample firDownsample(const Core& core) noexcept {
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Get the current upsampled sample for reverb output
 //------------------------------------------------------------------------------------------------------------------------------------------
-static StereoSample firUpsample(const Core& core) noexcept {
+template <class SampleT>
+static StereoSample<SampleT> firUpsample(const Core<SampleT>& core) noexcept {
   // What sample and interpolation index should we use?
   const int32_t curBufferIdx = (int32_t)core.reverbResampleBufPos;
   const int32_t firIdx = (int32_t)((curBufferIdx - NUM_TAPS) & 63);
   int32_t currentFir;
-  StereoSample output = {};
+  StereoSample<SampleT> output = {};
 
   // We multiply values we read from the FIR table by two since we're upsampling
   for (int32_t i = 0; i < NUM_TAPS; i++) {
-#if SIMPLE_SPU_FLOAT_SPU
-    currentFir = INTERP_FIR_TABLE[i] * 2;
-    output.left.value += core.reverbUpsampleBuffer[firIdx + i].left * int16_t(currentFir);
-    output.right.value += core.reverbUpsampleBuffer[firIdx + i].right * int16_t(currentFir);
-#else
-    currentFir = std::clamp<int32_t>(INTERP_FIR_TABLE[i] * 2, INT16_MIN, INT16_MAX);
-    output.left += ((int32_t)core.reverbUpsampleBuffer[firIdx + i].left * currentFir) >> 15;
-    output.right += ((int32_t)core.reverbUpsampleBuffer[firIdx + i].right * currentFir) >> 15;
-#endif
+    if constexpr (SampleT::IS_FLOAT) {
+      currentFir = INTERP_FIR_TABLE[i] * 2;
+      output.left.value += core.reverbUpsampleBuffer[firIdx + i].left * int16_t(currentFir);
+      output.right.value += core.reverbUpsampleBuffer[firIdx + i].right * int16_t(currentFir);
+    } else {
+      currentFir = std::clamp<int32_t>(INTERP_FIR_TABLE[i] * 2, INT16_MIN, INT16_MAX);
+      output.left += ((int32_t)core.reverbUpsampleBuffer[firIdx + i].left * currentFir) >> 15;
+      output.right += ((int32_t)core.reverbUpsampleBuffer[firIdx + i].right * currentFir) >> 15;
+    }
   }
   return output;
 }
@@ -399,12 +411,13 @@ static StereoSample firUpsample(const Core& core) noexcept {
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Process/update a single voice and return it's output and output to be reverberated
 //------------------------------------------------------------------------------------------------------------------------------------------
+template <class SampleT>
 static void stepVoice(
-    Voice& voice,
+    Voice<SampleT>& voice,
     const std::byte* pRam,
     const uint32_t ramSize,
-    StereoSample& output,
-    StereoSample& outputToReverb
+    StereoSample<SampleT>& output,
+    StereoSample<SampleT>& outputToReverb
 ) noexcept {
     // Nothing to do if the voice is switched off
     if (voice.envPhase == EnvPhase::Off)
@@ -429,12 +442,12 @@ static void stepVoice(
     // Get the interpolated sample for the voice, attenuate by the volume envelope and voice volume, and add to the output.
     // Only bother doing this however if the voice is actually turned on.
     if (!voice.bDisabled) {
-        const Sample rawSample = getInterpolatedVoiceSample(voice);
-        const Sample sampleEnvScaled = rawSample * voice.envLevel;
+        const SampleT rawSample = getInterpolatedVoiceSample(voice);
+        const SampleT sampleEnvScaled = rawSample * voice.envLevel;
         const int16_t realVoiceVolL = (int16_t) std::clamp((int32_t) voice.volume.left * 2, INT16_MIN, +INT16_MAX);     // N.B: voice volume was divided by 2
         const int16_t realVoiceVolR = (int16_t) std::clamp((int32_t) voice.volume.right * 2, INT16_MIN, +INT16_MAX);
 
-        const StereoSample sampleVolScaled = {
+        const StereoSample<SampleT> sampleVolScaled = {
             sampleEnvScaled * realVoiceVolL,
             sampleEnvScaled * realVoiceVolR
         };
@@ -492,13 +505,14 @@ static void stepVoice(
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Process/update all voices and get 1 sample of output from them
 //------------------------------------------------------------------------------------------------------------------------------------------
+template <class SampleT>
 static void stepVoices(
-    Voice* const pVoices,
+    Voice<SampleT>* const pVoices,
     const int32_t numVoices,
     const std::byte* pRam,
     const uint32_t ramSize,
-    StereoSample& output,
-    StereoSample& outputToReverb
+    StereoSample<SampleT>& output,
+    StereoSample<SampleT>& outputToReverb
 ) noexcept {
     ASSERT(pVoices || (numVoices == 0));
 
@@ -508,21 +522,17 @@ static void stepVoices(
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Mixes sound from an external input; does nothing if there is no current external input
+// Mixes a sample of sound from an external input
 //------------------------------------------------------------------------------------------------------------------------------------------
+template <class SampleT>
 static void mixExternalInput(
-    const ExtInputCallback pExtCallback,
-    void* const pExtCallbackUserData,
+    const StereoSample<SampleT> extSample,
     const Volume extVolume,
     const bool bExtReverbEnabled,
-    StereoSample& output,
-    StereoSample& outputToReverb
+    StereoSample<SampleT>& output,
+    StereoSample<SampleT>& outputToReverb
 ) noexcept {
-    if (!pExtCallback)
-        return;
-
-    const StereoSample extSample = pExtCallback(pExtCallbackUserData);
-    const StereoSample extSampleScaled = extSample * extVolume;
+    const StereoSample<SampleT> extSampleScaled = extSample * extVolume;
     output += extSampleScaled;
 
     if (bExtReverbEnabled) {
@@ -531,22 +541,21 @@ static void mixExternalInput(
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Add the given sample to reverb input and return a sample of reverb output
+// Add the given sample to reverb input and return a sample of reverb output.
+// The 16-bit SPU uses the reverb work area in SPU RAM, the float SPU uses it's own separate reverb RAM instead.
 //------------------------------------------------------------------------------------------------------------------------------------------
+template <class SampleT>
 static void doReverb(
-#if SIMPLE_SPU_FLOAT_SPU
+    std::byte* pRam,
     float* pReverbRam,
     const uint32_t numReverbRamSamples,
-#else
-    std::byte* pRam,
-#endif
     const uint32_t ramSize,
     const uint32_t reverbBaseAddr8,
     uint32_t& reverbCurAddr,
     const bool bReverbWriteEnable,
     const ReverbRegs& reverbRegs,
-    const StereoSample reverbInput,
-    StereoSample& reverbOutput
+    const StereoSample<SampleT> reverbInput,
+    StereoSample<SampleT>& reverbOutput
 ) noexcept {
     // Helper: wrap an address to be within the reverb work area and guarantee that 16-bits (or a single float, for the float SPU) can be read safely.
     // If there is no reverb work area (which should never be the case) then the address '0' is returned.
@@ -554,23 +563,21 @@ static void doReverb(
     const uint32_t reverbBaseAddr = reverbBaseAddr8 * 8;
     const uint32_t reverbBaseAddr2 = reverbBaseAddr / 2;
 
-    #if SIMPLE_SPU_FLOAT_SPU
-        const uint32_t reverbWorkAreaSize2 = std::min((ramSize - reverbBaseAddr) / 2, numReverbRamSamples);
-    #else
-        const uint32_t reverbWorkAreaSize2 = (ramSize - reverbBaseAddr) / 2;
-    #endif
+    const uint32_t reverbWorkAreaSize2 = (SampleT::IS_FLOAT) ?
+        std::min((ramSize - reverbBaseAddr) / 2, numReverbRamSamples) :
+        (ramSize - reverbBaseAddr) / 2;
 
     const auto wrapRevAddr16 = [=](uint32_t addr) noexcept -> uint32_t {
         if (reverbWorkAreaSize2 > 0) {
             const uint32_t addr2 = addr / 2;
             const uint32_t relativeAddr2 = (addr2 - reverbBaseAddr2) % reverbWorkAreaSize2;
 
-            #if SIMPLE_SPU_FLOAT_SPU
+            if constexpr (SampleT::IS_FLOAT) {
                 // For the float SPU the reverb work area always starts at element '0' in reverb RAM
                 return relativeAddr2 * 2;
-            #else
+            } else {
                 return (reverbBaseAddr2 + relativeAddr2) * 2;
-            #endif
+            }
         }
 
         return 0;
@@ -578,28 +585,28 @@ static void doReverb(
 
     // Helpers: read and write a 16-bit sample relative to the current reverb address.
     // Wraps the read or write to be within the work area for reverb.
-    const auto revR = [=](uint32_t addrRelative) noexcept -> Sample {
+    const auto revR = [=](uint32_t addrRelative) noexcept -> SampleT {
         const uint32_t addr = wrapRevAddr16(reverbCurAddr + addrRelative);
 
-        #if SIMPLE_SPU_FLOAT_SPU
+        if constexpr (SampleT::IS_FLOAT) {
             return pReverbRam[addr / 2];
-        #else
+        } else {
             const uint16_t data = (uint16_t) pRam[addr] | ((uint16_t) pRam[addr + 1] << 8);
             return (int16_t) data;
-        #endif
+        }
     };
 
-    const auto revW = [=](uint32_t addrRelative, const Sample sample) noexcept {
+    const auto revW = [=](uint32_t addrRelative, const SampleT sample) noexcept {
         if (bReverbWriteEnable) {
             const uint32_t addr = wrapRevAddr16(reverbCurAddr + addrRelative);
 
-            #if SIMPLE_SPU_FLOAT_SPU
-                pReverbRam[addr / 2] = sample.value;
-            #else
+            if constexpr (SampleT::IS_FLOAT) {
+                pReverbRam[addr / 2] = (std::fabs(sample.value) >= REVERB_FLUSH_LEVEL) ? sample.value : 0.0f;
+            } else {
                 const uint16_t data = (uint16_t) sample;
                 pRam[addr] = (std::byte) data;
                 pRam[addr + 1] = (std::byte)(data >> 8);
-            #endif
+            }
         }
     };
 
@@ -638,15 +645,15 @@ static void doReverb(
     const int16_t volAPF2   = reverbRegs.volAPF2;
 
     // Scale the sample which is being fed into the reverb:
-    const Sample inputL = reverbInput.left * reverbRegs.volLIn;
-    const Sample inputR = reverbInput.right * reverbRegs.volRIn;
+    const SampleT inputL = reverbInput.left * reverbRegs.volLIn;
+    const SampleT inputR = reverbInput.right * reverbRegs.volRIn;
 
     // Same side reflection (left-to-left and right-to-right)
     {
-        const Sample l1 = revR(addrLSame2);
-        const Sample r1 = revR(addrRSame2);
-        const Sample l2 = revR(addrLSame1 - 2);
-        const Sample r2 = revR(addrRSame1 - 2);
+        const SampleT l1 = revR(addrLSame2);
+        const SampleT r1 = revR(addrRSame2);
+        const SampleT l2 = revR(addrLSame1 - 2);
+        const SampleT r2 = revR(addrRSame1 - 2);
 
         revW(addrLSame1, (inputL + l1 * volWall - l2) * volIIR + l2);   // Left to left
         revW(addrRSame1, (inputR + r1 * volWall - r2) * volIIR + r2);   // Right to right
@@ -654,18 +661,18 @@ static void doReverb(
 
     // Different side reflection (left-to-right and right-to-left)
     {
-        const Sample l1 = revR(addrLDiff2);
-        const Sample r1 = revR(addrRDiff2);
-        const Sample l2 = revR(addrLDiff1 - 2);
-        const Sample r2 = revR(addrRDiff1 - 2);
+        const SampleT l1 = revR(addrLDiff2);
+        const SampleT r1 = revR(addrRDiff2);
+        const SampleT l2 = revR(addrLDiff1 - 2);
+        const SampleT r2 = revR(addrRDiff1 - 2);
 
         revW(addrLDiff1, (inputL + r1 * volWall - l2) * volIIR + l2);   // Right to left
         revW(addrRDiff1, (inputR + l1 * volWall - r2) * volIIR + r2);   // Left to right
     }
 
     // Early echo (comb filter, with input from buffer)
-    Sample outL;
-    Sample outR;
+    SampleT outL;
+    SampleT outR;
 
     outL = (
         revR(addrLComb1) * volComb1 +
@@ -700,11 +707,11 @@ static void doReverb(
     outR = outR * volAPF2 + revR(addrRAPF2 - dispAPF2);
 
     // Move along the reverb address for the next update by 1 16-bit sample
-    #if SIMPLE_SPU_FLOAT_SPU
+    if constexpr (SampleT::IS_FLOAT) {
         reverbCurAddr = reverbBaseAddr + wrapRevAddr16(reverbCurAddr + 2);  // 'wrapRevAddr16' returns the address starting from '0' for the float SPU, need to fix up
-    #else
+    } else {
         reverbCurAddr = wrapRevAddr16(reverbCurAddr + 2);
-    #endif
+    }
 
     // Scale and return the reverb output
     //reverbOutput = StereoSample {
@@ -712,22 +719,58 @@ static void doReverb(
     //    outR * reverbVol.right
     //};
     // Return the reverb output
-    reverbOutput = StereoSample{ outL, outR };
+    reverbOutput = StereoSample<SampleT>{ outL, outR };
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Feeds a sample of input to the reverb for one SPU step, processing the reverb itself every 2nd step.
+// The new reverb output is ready for upsampling after this.
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <class SampleT>
+static void stepReverb(Core<SampleT>& core, const StereoSample<SampleT> outputToReverb) noexcept {
+    // Store recent effect sample for FIR downsampling
+    core.reverbDownsampleBuffer[core.reverbResampleBufPos] = outputToReverb;
+    core.reverbDownsampleBuffer[core.reverbResampleBufPos | 64] = outputToReverb; // Mirror copy
+
+    // Do reverb every 2 cycles: PSX reverb operates at 22,050 Hz and the SPU operates at 44,100 Hz
+    if ((core.cycleCount & 1) == 0) {
+        // Only necessary to downsample when we're about to proccess reverb
+        StereoSample<SampleT> downsampledInput = firDownsample(core);
+        doReverb(
+            core.pRam,
+            core.pReverbRam,
+            core.numReverbRamSamples,
+            core.ramSize,
+            core.reverbBaseAddr8,
+            core.reverbCurAddr,
+            core.bReverbWriteEnable,
+            core.reverbRegs,
+            downsampledInput,
+            core.processedReverb
+        );
+        // Store fresh reverb sample for FIR upsampling
+        core.reverbUpsampleBuffer[core.reverbResampleBufPos] = core.processedReverb;
+        core.reverbUpsampleBuffer[core.reverbResampleBufPos | 64] = core.processedReverb; // Mirror copy
+    }
+
+    //Advance resampler buffer position
+    core.reverbResampleBufPos = (core.reverbResampleBufPos + 1) & 63;
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Does the final mix and attenuation of dry sound and reverb sound, and scales according to the master volume
 //------------------------------------------------------------------------------------------------------------------------------------------
-void doMasterMix(
-    const StereoSample dryOutput,
-    const StereoSample reverbOutput,
+template <class SampleT>
+static void doMasterMix(
+    const StereoSample<SampleT> dryOutput,
+    const StereoSample<SampleT> reverbOutput,
     const Volume masterVol,
     const Volume reverbVol,
-    StereoSample& output
+    StereoSample<SampleT>& output
 ) noexcept {
     // Note: master volume is expected to be +/- 0x3FFF.
     // Need to clamp if exceeding this and also scale by 2.
-    const StereoSample wetOutput = dryOutput + (reverbOutput * reverbVol);
+    const StereoSample<SampleT> wetOutput = dryOutput + (reverbOutput * reverbVol);
     const Volume scaledMasterVol = {
         (int16_t)(std::clamp(masterVol.left, MIN_MASTER_VOLUME, MAX_MASTER_VOLUME) * 2),
         (int16_t)(std::clamp(masterVol.right, MIN_MASTER_VOLUME, MAX_MASTER_VOLUME) * 2),
@@ -739,18 +782,14 @@ void doMasterMix(
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Core initialization and teardown
 //------------------------------------------------------------------------------------------------------------------------------------------
-#if SIMPLE_SPU_FLOAT_SPU
-    void Spu::initCore(Core& core, const uint32_t ramSize, const uint32_t voiceCount, const uint32_t numReverbRamSamples) noexcept
-#else
-    void Spu::initCore(Core& core, const uint32_t ramSize, const uint32_t voiceCount) noexcept
-#endif
-{
+template <class SampleT>
+void Spu::initCore(Core<SampleT>& core, const uint32_t ramSize, const uint32_t voiceCount, const uint32_t numReverbRamSamples) noexcept {
     // Zero init everything by default
-    core = {};
+    core = Core<SampleT>();
 
     // Zero voices is a valid use-case, if for example you wanted to use this as a PS1 reverb DSP
     if (voiceCount > 0) {
-        core.pVoices = new Voice[voiceCount];
+        core.pVoices = new Voice<SampleT>[voiceCount];
         core.numVoices = voiceCount;
 
         for (uint32_t i = 0; i < voiceCount; ++i) {
@@ -768,31 +807,31 @@ void doMasterMix(
     std::memset(core.pRam, 0, roundedRamSize);
 
     // For floating point SPUs allocate reverb RAM too
-    #if SIMPLE_SPU_FLOAT_SPU
+    if constexpr (SampleT::IS_FLOAT) {
         ASSERT(numReverbRamSamples > 0);
         core.pReverbRam = new float[numReverbRamSamples];
         core.numReverbRamSamples = numReverbRamSamples;
         std::memset(core.pReverbRam, 0, numReverbRamSamples * sizeof(float));
-    #endif
+    }
 }
 
-void Spu::destroyCore(Core& core) noexcept {
-    #if SIMPLE_SPU_FLOAT_SPU
-        delete[] core.pReverbRam;
-    #endif
+template <class SampleT>
+void Spu::destroyCore(Core<SampleT>& core) noexcept {
+    delete[] core.pReverbRam;
 
     delete[] core.pVoices;
     delete[] core.pRam;
-    core = {};
+    core = Core<SampleT>();
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Start playing the given voice
 //------------------------------------------------------------------------------------------------------------------------------------------
-StereoSample Spu::stepCore(Core& core) noexcept {
+template <class SampleT>
+StereoSample<SampleT> Spu::stepCore(Core<SampleT>& core) noexcept {
     // Process all voices firstly and silence the output if we are not unmuted
-    StereoSample output = {};
-    StereoSample outputToReverb = {};
+    StereoSample<SampleT> output = {};
+    StereoSample<SampleT> outputToReverb = {};
     stepVoices(core.pVoices, core.numVoices, core.pRam, core.ramSize, output, outputToReverb);
 
     if (!core.bUnmute) {
@@ -801,10 +840,9 @@ StereoSample Spu::stepCore(Core& core) noexcept {
     }
 
     // Mix any external input
-    if (core.bExtEnabled) {
+    if (core.bExtEnabled && core.pExtInputCallback) {
         mixExternalInput(
-            core.pExtInputCallback,
-            core.pExtInputUserData,
+            core.pExtInputCallback(core.pExtInputUserData),
             core.extInputVol,
             core.bExtReverbEnable,
             output,
@@ -812,39 +850,9 @@ StereoSample Spu::stepCore(Core& core) noexcept {
         );
     }
 
-    // Store recent effect sample for FIR downsampling
-    core.reverbDownsampleBuffer[core.reverbResampleBufPos] = outputToReverb;
-    core.reverbDownsampleBuffer[core.reverbResampleBufPos | 64] = outputToReverb; // Mirror copy
-
-    // Do reverb every 2 cycles: PSX reverb operates at 22,050 Hz and the SPU operates at 44,100 Hz
-    if ((core.cycleCount & 1) == 0) {
-        // Only necessary to downsample when we're about to proccess reverb
-        StereoSample downsampledInput = firDownsample(core);
-        doReverb(
-        #if SIMPLE_SPU_FLOAT_SPU
-            core.pReverbRam,
-            core.numReverbRamSamples,
-        #else
-            core.pRam,
-        #endif
-            core.ramSize,
-            core.reverbBaseAddr8,
-            core.reverbCurAddr,
-            core.bReverbWriteEnable,
-            core.reverbRegs,
-            downsampledInput,
-            core.processedReverb
-        );
-        // Store fresh reverb sample for FIR upsampling
-        core.reverbUpsampleBuffer[core.reverbResampleBufPos] = core.processedReverb;
-        core.reverbUpsampleBuffer[core.reverbResampleBufPos | 64] = core.processedReverb; // Mirror copy
-    }
-
-    //Advance resampler buffer position
-    core.reverbResampleBufPos = (core.reverbResampleBufPos + 1) & 63;
-
-    //Resample reverb to be outputted
-    StereoSample upsampledInput = firUpsample(core);
+    // Feed the reverb and get the reverb output
+    stepReverb(core, outputToReverb);
+    StereoSample<SampleT> upsampledInput = firUpsample(core);
 
     // Do the final mixing and finish up
     doMasterMix(output, upsampledInput, core.masterVol, core.reverbVol, output);
@@ -852,10 +860,49 @@ StereoSample Spu::stepCore(Core& core) noexcept {
     return output;
 }
 
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Reverb only processing for a block of samples: see the header for details.
+// Only the parts of 'stepCore' which the reverb needs are done, and the output is exactly the same as 'stepCore' would produce.
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <class SampleT>
+void Spu::processReverbBlock(
+    Core<SampleT>& core,
+    const StereoSample<SampleT>* const pInput,
+    StereoSample<SampleT>* const pOutput,
+    const uint32_t numSamples,
+    const uint32_t stepsPerSample
+) noexcept {
+    ASSERT((pInput && pOutput) || (numSamples == 0));
+    ASSERT(stepsPerSample >= 1);
+
+    for (uint32_t sampleIdx = 0; sampleIdx < numSamples; ++sampleIdx) {
+        // Mix the external input: this is the same for each step done for the sample
+        StereoSample<SampleT> output = {};
+        StereoSample<SampleT> outputToReverb = {};
+
+        if (core.bExtEnabled) {
+            mixExternalInput(pInput[sampleIdx], core.extInputVol, core.bExtReverbEnable, output, outputToReverb);
+        }
+
+        // The first step produces the output.
+        // Any other steps only need to feed the reverb since their output is discarded, so skip the upsampling and final mix for them.
+        stepReverb(core, outputToReverb);
+        StereoSample<SampleT> upsampledInput = firUpsample(core);
+        doMasterMix(output, upsampledInput, core.masterVol, core.reverbVol, pOutput[sampleIdx]);
+        core.cycleCount++;
+
+        for (uint32_t stepIdx = 1; stepIdx < stepsPerSample; ++stepIdx) {
+            stepReverb(core, outputToReverb);
+            core.cycleCount++;
+        }
+    }
+}
+
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Start playing the given voice
 //------------------------------------------------------------------------------------------------------------------------------------------
-void Spu::keyOn(Voice& voice) noexcept {
+template <class SampleT>
+void Spu::keyOn(Voice<SampleT>& voice) noexcept {
     // Jump to the sample start address and flag that we need to load samples
     voice.bSamplesLoaded = false;
     voice.adpcmBlockPos = {};
@@ -871,18 +918,41 @@ void Spu::keyOn(Voice& voice) noexcept {
     voice.bRepeat = false;
 
     // Zero the 3 previous samples used for interpolation and previous 2 samples used for ADPCM decoding
-    static_assert(Voice::NUM_PREV_SAMPLES == 3);
+    static_assert(Voice<SampleT>::NUM_PREV_SAMPLES == 3);
     voice.samples[0] = {};
     voice.samples[1] = {};
     voice.samples[2] = {};
-    voice.samples[Voice::SAMPLE_BUFFER_SIZE - 2] = {};
-    voice.samples[Voice::SAMPLE_BUFFER_SIZE - 1] = {};
+    voice.samples[Voice<SampleT>::SAMPLE_BUFFER_SIZE - 2] = {};
+    voice.samples[Voice<SampleT>::SAMPLE_BUFFER_SIZE - 1] = {};
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Puts the given voice into release mode
 //------------------------------------------------------------------------------------------------------------------------------------------
-void Spu::keyOff(Voice& voice) noexcept {
+template <class SampleT>
+void Spu::keyOff(Voice<SampleT>& voice) noexcept {
     voice.envPhase = EnvPhase::Release;
     voice.envWaitCycles = 0;
 }
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Instantiate the SPU for all of the supported sample types: each gets it's own fully specialized code with no runtime branching.
+//------------------------------------------------------------------------------------------------------------------------------------------
+#define SPU_INSTANTIATE_FOR_SAMPLE_TYPE(SampleT)\
+    template void Spu::initCore<SampleT>(Core<SampleT>& core, const uint32_t ramSize, const uint32_t voiceCount, const uint32_t numReverbRamSamples) noexcept;\
+    template void Spu::destroyCore<SampleT>(Core<SampleT>& core) noexcept;\
+    template StereoSample<SampleT> Spu::stepCore<SampleT>(Core<SampleT>& core) noexcept;\
+    template void Spu::processReverbBlock<SampleT>(\
+        Core<SampleT>& core,\
+        const StereoSample<SampleT>* const pInput,\
+        StereoSample<SampleT>* const pOutput,\
+        const uint32_t numSamples,\
+        const uint32_t stepsPerSample\
+    ) noexcept;\
+    template void Spu::keyOn<SampleT>(Voice<SampleT>& voice) noexcept;\
+    template void Spu::keyOff<SampleT>(Voice<SampleT>& voice) noexcept;
+
+SPU_INSTANTIATE_FOR_SAMPLE_TYPE(Int16Sample)
+SPU_INSTANTIATE_FOR_SAMPLE_TYPE(FloatSample)
+
+#undef SPU_INSTANTIATE_FOR_SAMPLE_TYPE
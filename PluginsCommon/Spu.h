@@ -154,8 +154,6 @@ inline constexpr int16_t toInt16Sample(const float sample) noexcept {
     return (int16_t) std::clamp(sample * 32768.0f, float(INT16_MIN), float(INT16_MAX));
 }
 
-#if !SIMPLE_SPU_FLOAT_SPU
-
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Do a saturated/clamped addition and subtraction of 16-bit sample values
 //------------------------------------------------------------------------------------------------------------------------------------------
@@ -179,76 +177,84 @@ inline int16_t sampleAttenuate(const int16_t sample, const int16_t volume) noexc
     return (int16_t)(frac32 >> 15);
 }
 
-#endif  // #if !SIMPLE_SPU_FLOAT_SPU
-
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Convenience container for a 16-bit sample which supports sample add, subtract & attenuate operations
+// Sample types which the SPU core can be built with: these determine how the SPU does all of it's sample math.
+//
+//  Int16Sample:    Authentic 16-bit integer samples with saturating arithmetic, as per the original hardware.
+//                  Reverb uses a work area in SPU RAM, just like the original hardware.
+//  FloatSample:    Clean floating point samples which never clip internally.
+//                  Reverb uses it's own floating point work area, separate to SPU RAM.
+//
+// Both support sample add, subtract & attenuate operations by volume levels of either type.
 //------------------------------------------------------------------------------------------------------------------------------------------
-#if SIMPLE_SPU_FLOAT_SPU
-    struct Sample {
-        float value;
+struct FloatSample {
+    static constexpr bool IS_FLOAT = true;
 
-        inline Sample() noexcept : value(0) {}
-        inline Sample(const float value) noexcept : value(value) {}
-        inline Sample(const int16_t value) noexcept: value(toFloatSample(value)) {}     // Convenience auto-conversion from 16-bit
+    float value;
 
-        Sample(const Sample& other) noexcept = default;
-        Sample& operator = (const Sample& other) noexcept = default;
+    inline FloatSample() noexcept : value(0) {}
+    inline FloatSample(const float value) noexcept : value(value) {}
+    inline FloatSample(const int16_t value) noexcept: value(toFloatSample(value)) {}    // Convenience auto-conversion from 16-bit
 
-        // Convenience overloads for attenuating by a 16-bit volume level
-        inline Sample operator * (const int16_t other) const noexcept {
-            return value * toFloatSample(other);
-        }
+    FloatSample(const FloatSample& other) noexcept = default;
+    FloatSample& operator = (const FloatSample& other) noexcept = default;
 
-        inline void operator *= (const int16_t other) noexcept {
-            value *= toFloatSample(other);
-        }
+    // Convenience overloads for attenuating by a 16-bit volume level
+    inline FloatSample operator * (const int16_t other) const noexcept {
+        return value * toFloatSample(other);
+    }
+
+    inline void operator *= (const int16_t other) noexcept {
+        value *= toFloatSample(other);
+    }
 
-        inline Sample operator *  (const float other) const noexcept   { return value * other; }
-        inline void   operator *= (const float other) noexcept         { value *= other;       }
-        inline Sample operator +  (const float other) const noexcept   { return value + other; }
-        inline void   operator += (const float other) noexcept         { value += other;       }
-        inline Sample operator -  (const float other) const noexcept   { return value - other; }
-        inline void   operator -= (const float other) noexcept         { value -= other;       }
+    inline FloatSample operator *  (const float other) const noexcept  { return value * other; }
+    inline void        operator *= (const float other) noexcept        { value *= other;       }
+    inline FloatSample operator +  (const float other) const noexcept  { return value + other; }
+    inline void        operator += (const float other) noexcept        { value += other;       }
+    inline FloatSample operator -  (const float other) const noexcept  { return value - other; }
+    inline void        operator -= (const float other) noexcept        { value -= other;       }
 
-        operator float() const noexcept { return value; }
-    };
-#else
-    struct Sample {
-        int16_t value;
+    operator float() const noexcept { return value; }
+};
 
-        inline Sample() noexcept : value(0) {}
-        inline Sample(const int16_t value) noexcept : value(value) {}
+struct Int16Sample {
+    static constexpr bool IS_FLOAT = false;
 
-        Sample(const Sample& other) noexcept = default;
-        Sample& operator = (const Sample& other) noexcept = default;
+    int16_t value;
 
-        // Convenience overloads for attenuating by a float volume level
-        inline Sample operator * (const float other) const noexcept {
-            return toInt16Sample(toFloatSample(value) * other);
-        }
+    inline Int16Sample() noexcept : value(0) {}
+    inline Int16Sample(const int16_t value) noexcept : value(value) {}
 
-        inline void operator *= (const float other) noexcept {
-            value = (*this) * other;
-        }
+    Int16Sample(const Int16Sample& other) noexcept = default;
+    Int16Sample& operator = (const Int16Sample& other) noexcept = default;
 
-        inline Sample operator *  (const int16_t other) const noexcept { return sampleAttenuate(value, other);     }
-        inline void   operator *= (const int16_t other) noexcept       { value = sampleAttenuate(value, other);    }
-        inline Sample operator +  (const int16_t other) const noexcept { return sampleAdd(value, other);           }
-        inline void   operator += (const int16_t other) noexcept       { value = sampleAdd(value, other);          }
-        inline Sample operator -  (const int16_t other) const noexcept { return sampleSub(value, other);           }
-        inline void   operator -= (const int16_t other) noexcept       { value = sampleSub(value, other);          }
+    // Convenience overloads for attenuating by a float volume level
+    inline Int16Sample operator * (const float other) const noexcept {
+        return toInt16Sample(toFloatSample(value) * other);
+    }
 
-        operator int16_t() const noexcept { return value; }
-    };
-#endif
+    inline void operator *= (const float other) noexcept {
+        value = (*this) * other;
+    }
+
+    inline Int16Sample operator *  (const int16_t other) const noexcept    { return sampleAttenuate(value, other);     }
+    inline void        operator *= (const int16_t other) noexcept          { value = sampleAttenuate(value, other);    }
+    inline Int16Sample operator +  (const int16_t other) const noexcept    { return sampleAdd(value, other);           }
+    inline void        operator += (const int16_t other) noexcept          { value = sampleAdd(value, other);          }
+    inline Int16Sample operator -  (const int16_t other) const noexcept    { return sampleSub(value, other);           }
+    inline void        operator -= (const int16_t other) noexcept          { value = sampleSub(value, other);          }
+
+    operator int16_t() const noexcept { return value; }
+};
 
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Holds a stereo sample and allows add/subtract/attenuate operations on that stereo sample
 //------------------------------------------------------------------------------------------------------------------------------------------
+template <class SampleT>
 struct StereoSample {
-    Sample left;
-    Sample right;
+    SampleT left;
+    SampleT right;
 
     StereoSample operator + (const StereoSample other) const noexcept {
         return StereoSample{ left + other.left, right + other.right };
@@ -334,6 +340,7 @@ struct ReverbRegs {
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Holds all of the state for a hardware SPU voice
 //------------------------------------------------------------------------------------------------------------------------------------------
+template <class SampleT>
 struct Voice {
     // How many previous decoded samples to store for an SPU voice; these are required sometimes for sample interpolation
     static constexpr int32_t NUM_PREV_SAMPLES = 3;
@@ -394,7 +401,7 @@ struct Voice {
     // Previously decoded samples from the last ADPCM block (3 previous samples) and the currently decoded ADPCM block.
     // At the beginning of the buffer there is 'NUM_PREV_SAMPLES' samples from the last ADPCM block, with the most recent sample last.
     // Those previous samples are used for gaussian interpolation.
-    Sample samples[SAMPLE_BUFFER_SIZE];
+    SampleT samples[SAMPLE_BUFFER_SIZE];
 };
 
 //------------------------------------------------------------------------------------------------------------------------------------------
@@ -402,66 +409,79 @@ struct Voice {
 // Can be used to mix in CD audio or anything else and run it through the reverb processing of the SPU.
 // The callback takes a single piece of user data and must return 1 sound sample.
 //------------------------------------------------------------------------------------------------------------------------------------------
-typedef StereoSample (*ExtInputCallback)(void* pUserData) noexcept;
+template <class SampleT>
+using ExtInputCallback = StereoSample<SampleT> (*)(void* pUserData) noexcept;
 
 //------------------------------------------------------------------------------------------------------------------------------------------
 // The SPU core/device itself
 //------------------------------------------------------------------------------------------------------------------------------------------
+template <class SampleT>
 struct Core {
-    std::byte*          pRam;                   // Sound RAM used by the SPU core
-    uint32_t            ramSize;                // How big the RAM size for the SPU core
-#if SIMPLE_SPU_FLOAT_SPU
-    float*              pReverbRam;             // Holds floating point reverb samples for the extended floating point SPU
-    uint32_t            numReverbRamSamples;    // The number of floating point samples in reverb RAM
-#endif
-    Voice*              pVoices;                // Each of the hardware voices for the SPU
-    uint32_t            numVoices;              // How many voices the core provides
-    Volume              masterVol;              // Master volume. Note: expected to be from -0x3FFF to +0x3FFF.
-    Volume              reverbVol;              // Reverb volume level
-    Volume              extInputVol;            // External input volume (I'm using this for CD audio mixing)
-    bool                bUnmute;                // If 'true' then the output from voices is mixed into the output
-    bool                bReverbWriteEnable;     // Whether reverb can write output to the reverb work area
-    bool                bExtEnabled;            // Whether to mix input from the external input source
-    bool                bExtReverbEnable;       // Whether to apply reverb on the input from the external source
-    ExtInputCallback    pExtInputCallback;      // Callback used to source external input: if null no external input is mixed with SPU voices
-    void*               pExtInputUserData;      // User data passed to the external input callback
-    uint32_t            cycleCount;             // How many cycles has the SPU done (44,100 == 1 second of audio): each cycle is generating a 16-bit left & right audio sample
-    uint32_t            reverbBaseAddr8;        // Start address of the reverb work area in 8 byte units; anything past this address in SPU RAM is for reverb
-    uint32_t            reverbCurAddr;          // Used for relative reads and writes to the reverb work area; continously incremented and wrapped as reverb is processed
-    uint32_t            reverbResampleBufPos;   // Which sample to use for resampling, should never exceed 64
-    StereoSample        reverbDownsampleBuffer[128] = {}; // Recent reverb input for FIR downsampling
-    StereoSample        reverbUpsampleBuffer[128] = {}; // Recent reverb input for FIR upsampling, values lower than 128 cause problems
-    StereoSample        processedReverb;        // The processed reverb that is to be added into the final mix: only updated at 22,050 Hz instead of 44,100 Hz (every 2 SPU steps)
-    ReverbRegs          reverbRegs;             // Registers with settings determining how reverb is processed: determines the type of reverb
+    std::byte*                  pRam;                   // Sound RAM used by the SPU core
+    uint32_t                    ramSize;                // How big the RAM size for the SPU core
+    float*                      pReverbRam;             // Holds floating point reverb samples for the floating point SPU: unused by the 16-bit SPU
+    uint32_t                    numReverbRamSamples;    // The number of floating point samples in reverb RAM
+    Voice<SampleT>*             pVoices;                // Each of the hardware voices for the SPU
+    uint32_t                    numVoices;              // How many voices the core provides
+    Volume                      masterVol;              // Master volume. Note: expected to be from -0x3FFF to +0x3FFF.
+    Volume                      reverbVol;              // Reverb volume level
+    Volume                      extInputVol;            // External input volume (I'm using this for CD audio mixing)
+    bool                        bUnmute;                // If 'true' then the output from voices is mixed into the output
+    bool                        bReverbWriteEnable;     // Whether reverb can write output to the reverb work area
+    bool                        bExtEnabled;            // Whether to mix input from the external input source
+    bool                        bExtReverbEnable;       // Whether to apply reverb on the input from the external source
+    ExtInputCallback<SampleT>   pExtInputCallback;      // Callback used to source external input: if null no external input is mixed with SPU voices
+    void*                       pExtInputUserData;      // User data passed to the external input callback
+    uint32_t                    cycleCount;             // How many cycles has the SPU done (44,100 == 1 second of audio): each cycle is generating a 16-bit left & right audio sample
+    uint32_t                    reverbBaseAddr8;        // Start address of the reverb work area in 8 byte units; anything past this address in SPU RAM is for reverb
+    uint32_t                    reverbCurAddr;          // Used for relative reads and writes to the reverb work area; continously incremented and wrapped as reverb is processed
+    uint32_t                    reverbResampleBufPos;   // Which sample to use for resampling, should never exceed 64
+    StereoSample<SampleT>       reverbDownsampleBuffer[128] = {}; // Recent reverb input for FIR downsampling
+    StereoSample<SampleT>       reverbUpsampleBuffer[128] = {}; // Recent reverb input for FIR upsampling, values lower than 128 cause problems
+    StereoSample<SampleT>       processedReverb;        // The processed reverb that is to be added into the final mix: only updated at 22,050 Hz instead of 44,100 Hz (every 2 SPU steps)
+    ReverbRegs                  reverbRegs;             // Registers with settings determining how reverb is processed: determines the type of reverb
 };
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// SPU and voice manipulation
+// SPU and voice manipulation.
+// These are implemented for (and only available for) the 'Int16Sample' and 'FloatSample' sample types.
 //------------------------------------------------------------------------------------------------------------------------------------------
 
-// Initialize and destroy an SPU core
-#if SIMPLE_SPU_FLOAT_SPU
-    void initCore(
-        Core& core,
-        const uint32_t ramSize,
-        const uint32_t voiceCount,
-        const uint32_t numReverbRamSamples = 128 * 1024     // More than big enough for any of the reverb modes in LIBSPU
-    ) noexcept;
-#else
-    void initCore(
-        Core& core,
-        const uint32_t ramSize,
-        const uint32_t voiceCount
-    ) noexcept;
-#endif
+// Initialize and destroy an SPU core.
+// The number of reverb RAM samples only applies to the floating point SPU, which has it's own reverb work area.
+template <class SampleT>
+void initCore(
+    Core<SampleT>& core,
+    const uint32_t ramSize,
+    const uint32_t voiceCount,
+    const uint32_t numReverbRamSamples = 128 * 1024     // More than big enough for any of the reverb modes in LIBSPU
+) noexcept;
 
-void destroyCore(Core& core) noexcept;
+template <class SampleT>
+void destroyCore(Core<SampleT>& core) noexcept;
 
 // Step the given SPU core
-StereoSample stepCore(Core& core) noexcept;
+template <class SampleT>
+StereoSample<SampleT> stepCore(Core<SampleT>& core) noexcept;
+
+// Reverb only processing for a block of samples, for using the SPU purely as a reverb effect.
+// Each input sample is fed to the SPU as external input (instead of using the external input callback) for 'stepsPerSample' SPU steps,
+// and the output of the first of those steps is returned. Voices are NOT processed, and steps with discarded output only update the reverb.
+// The output is exactly the same as what stepping the core with 'stepCore' (and discarding the extra steps) would produce.
+template <class SampleT>
+void processReverbBlock(
+    Core<SampleT>& core,
+    const StereoSample<SampleT>* const pInput,
+    StereoSample<SampleT>* const pOutput,
+    const uint32_t numSamples,
+    const uint32_t stepsPerSample = 1
+) noexcept;
 
 // Key on or off the given SPU voice
-void keyOn(Voice& voice) noexcept;
-void keyOff(Voice& voice) noexcept;
+template <class SampleT>
+void keyOn(Voice<SampleT>& voice) noexcept;
+
+template <class SampleT>
+void keyOff(Voice<SampleT>& voice) noexcept;
 
 END_NAMESPACE(Spu)
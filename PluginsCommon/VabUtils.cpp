@@ -0,0 +1,196 @@
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Utilities for reading PlayStation VAB sound banks (.vab files, or .vh header files with matching .vb body files)
+//------------------------------------------------------------------------------------------------------------------------------------------
+#include "VabUtils.h"
+
+#include "Asserts.h"
+#include "Endian.h"
+
+#include <algorithm>
+#include <cstring>
+
+BEGIN_NAMESPACE(AudioTools)
+BEGIN_NAMESPACE(VabUtils)
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Layout of the VAB header (.vh data). All values are little endian.
+//
+//  - The bank header.
+//  - Program attributes for all 128 programs.
+//  - Tone attributes for each program that is used (has tones): always 16 tone slots per program, used or not.
+//  - The size of each sample in the body in 8 byte units: 256 entries, the first of which is unused.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static constexpr uint32_t VAB_BANK_HDR_SIZE     = 32;
+static constexpr uint32_t VAB_PROGRAM_ATTR_SIZE = 16;
+static constexpr uint32_t VAB_TONE_ATTR_SIZE    = 32;
+static constexpr uint32_t VAB_SAMPLE_SIZES_SIZE = 256 * sizeof(uint16_t);
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Helper: read a little endian value from a possibly unaligned location in memory
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <class T>
+static T readLittle(const std::byte* const pData) noexcept {
+    T value;
+    std::memcpy(&value, pData, sizeof(T));
+    return Endian::littleToHost(value);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Tells if the given data starts with a VAB header
+//------------------------------------------------------------------------------------------------------------------------------------------
+bool isVabHeader(const std::byte* const pData, const size_t dataSize) noexcept {
+    ASSERT(pData || (dataSize == 0));
+    return ((dataSize >= VAB_BANK_HDR_SIZE) && (readLittle<uint32_t>(pData) == VAB_FILE_ID));
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Index a VAB sound bank held in memory: reads the programs, tones and sample locations from the header without copying any sample data.
+// If no body data is given then the body is expected to follow the header directly, as it does in a .vab file.
+// Tones which reference samples that don't exist are skipped.
+//------------------------------------------------------------------------------------------------------------------------------------------
+bool parseVab(
+    const std::byte* const pHeaderData,
+    const size_t headerDataSize,
+    const std::byte* const pBodyData,
+    const size_t bodyDataSize,
+    VabBank& bankOut,
+    std::string& errorMsgOut
+) noexcept {
+    ASSERT(pHeaderData || (headerDataSize == 0));
+    ASSERT(pBodyData || (bodyDataSize == 0));
+
+    bankOut.pBody = nullptr;
+    bankOut.bodySize = 0;
+    bankOut.tones.clear();
+    bankOut.samples.clear();
+
+    bool bParseOk = false;
+
+    try {
+        // Read the bank header and verify it
+        if (!isVabHeader(pHeaderData, headerDataSize))
+            throw "The file is not a valid .vab or .vh file!";
+
+        const uint16_t numPrograms = readLittle<uint16_t>(pHeaderData + 18);
+        const uint16_t numSamples = readLittle<uint16_t>(pHeaderData + 22);
+
+        if (numPrograms > VAB_MAX_PROGRAMS)
+            throw "The bank has too many programs!";
+
+        if (numSamples > VAB_MAX_SAMPLES)
+            throw "The bank has too many samples!";
+
+        const size_t programAttrsOffset = VAB_BANK_HDR_SIZE;
+        const size_t toneAttrsOffset = programAttrsOffset + VAB_MAX_PROGRAMS * VAB_PROGRAM_ATTR_SIZE;
+        const size_t sampleSizesOffset = toneAttrsOffset + (size_t) numPrograms * VAB_MAX_PROGRAM_TONES * VAB_TONE_ATTR_SIZE;
+        const size_t headerSize = sampleSizesOffset + VAB_SAMPLE_SIZES_SIZE;
+
+        if (headerDataSize < headerSize)
+            throw "The bank header is truncated!";
+
+        bankOut.masterVolume = (uint8_t) pHeaderData[24];
+        bankOut.masterPan = (uint8_t) pHeaderData[25];
+
+        // Figure out where the body is: follows the header if not given separately
+        if (pBodyData) {
+            bankOut.pBody = pBodyData;
+            bankOut.bodySize = bodyDataSize;
+        } else {
+            bankOut.pBody = pHeaderData + headerSize;
+            bankOut.bodySize = headerDataSize - headerSize;
+        }
+
+        // Locate all of the samples in the body: the first entry in the sample sizes table is always unused
+        bankOut.samples.reserve(numSamples);
+        size_t sampleOffset = 0;
+
+        for (uint32_t sampleIdx = 0; sampleIdx < numSamples; ++sampleIdx) {
+            const size_t sampleSize = (size_t) readLittle<uint16_t>(pHeaderData + sampleSizesOffset + (sampleIdx + 1) * sizeof(uint16_t)) * 8;
+
+            if (sampleOffset + sampleSize > bankOut.bodySize)
+                throw "The bank body is truncated or does not match the header!";
+
+            bankOut.samples.push_back(VabSample{ (uint32_t) sampleOffset, (uint32_t) sampleSize });
+            sampleOffset += sampleSize;
+        }
+
+        // Read the tones for all programs: tone attributes are stored in order for just the programs which are used
+        bankOut.tones.reserve((size_t) numPrograms * VAB_MAX_PROGRAM_TONES);
+        uint32_t numToneBlocksRead = 0;
+
+        for (uint32_t programIdx = 0; programIdx < VAB_MAX_PROGRAMS; ++programIdx) {
+            const std::byte* const pProgramAttr = pHeaderData + programAttrsOffset + programIdx * VAB_PROGRAM_ATTR_SIZE;
+            const uint8_t numProgramTones = (uint8_t) pProgramAttr[0];
+
+            VabProgram& program = bankOut.programs[programIdx];
+            program.firstToneIdx = (uint16_t) bankOut.tones.size();
+            program.numTones = 0;
+            program.volume = (uint8_t) pProgramAttr[1];
+            program.pan = (uint8_t) pProgramAttr[4];
+
+            if ((numProgramTones == 0) || (numToneBlocksRead >= numPrograms))
+                continue;
+
+            const std::byte* const pToneAttrs = pHeaderData + toneAttrsOffset + (size_t) numToneBlocksRead * VAB_MAX_PROGRAM_TONES * VAB_TONE_ATTR_SIZE;
+            numToneBlocksRead++;
+
+            for (uint32_t toneIdx = 0; toneIdx < std::min<uint32_t>(numProgramTones, VAB_MAX_PROGRAM_TONES); ++toneIdx) {
+                const std::byte* const pToneAttr = pToneAttrs + toneIdx * VAB_TONE_ATTR_SIZE;
+                const int16_t sampleNum = readLittle<int16_t>(pToneAttr + 22);
+
+                if ((sampleNum <= 0) || (sampleNum > numSamples))
+                    continue;
+
+                VabTone tone = {};
+                tone.sampleIdx = (uint16_t)(sampleNum - 1);
+                tone.priority = (uint8_t) pToneAttr[0];
+                tone.volume = (uint8_t) pToneAttr[2];
+                tone.pan = (uint8_t) pToneAttr[3];
+                tone.rootNote = (uint8_t) pToneAttr[4];
+                tone.fineTune = (uint8_t) pToneAttr[5];
+                tone.minNote = (uint8_t) pToneAttr[6];
+                tone.maxNote = (uint8_t) pToneAttr[7];
+                tone.pitchBendMin = (uint8_t) pToneAttr[12];
+                tone.pitchBendMax = (uint8_t) pToneAttr[13];
+                tone.adsrBits = (uint32_t) readLittle<uint16_t>(pToneAttr + 16) | ((uint32_t) readLittle<uint16_t>(pToneAttr + 18) << 16);
+
+                bankOut.tones.push_back(tone);
+                program.numTones++;
+            }
+        }
+
+        // All good if we get to here
+        bParseOk = true;
+    }
+    catch (const char* const exceptionMsg) {
+        errorMsgOut = "An error occurred while reading the sound bank! It may not be a valid .vab or .vh/.vb pair. Error message: ";
+        errorMsgOut += exceptionMsg;
+    }
+    catch (...) {
+        errorMsgOut = "An error occurred while reading the sound bank! Out of memory.";
+    }
+
+    if (!bParseOk) {
+        bankOut.pBody = nullptr;
+        bankOut.bodySize = 0;
+        bankOut.tones.clear();
+        bankOut.samples.clear();
+    }
+
+    return bParseOk;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Returns the number of the first program in the bank which has tones, or zero if there are none
+//------------------------------------------------------------------------------------------------------------------------------------------
+uint8_t getFirstUsedVabProgram(const VabBank& bank) noexcept {
+    for (uint32_t programIdx = 0; programIdx < VAB_MAX_PROGRAMS; ++programIdx) {
+        if (bank.programs[programIdx].numTones > 0)
+            return (uint8_t) programIdx;
+    }
+
+    return 0;
+}
+
+END_NAMESPACE(VabUtils)
+END_NAMESPACE(AudioTools)
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Macros.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+BEGIN_NAMESPACE(AudioTools)
+BEGIN_NAMESPACE(VabUtils)
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// VAB sound bank constants
+//------------------------------------------------------------------------------------------------------------------------------------------
+static constexpr uint32_t VAB_FILE_ID               = 0x56414270;   // VAB file id: reads as 'pBAV' in the (little endian) file
+static constexpr uint32_t VAB_MAX_PROGRAMS          = 128;          // Maximum number of programs (instruments) in a bank
+static constexpr uint32_t VAB_MAX_PROGRAM_TONES     = 16;           // Maximum number of tones (key zones) in a program
+static constexpr uint32_t VAB_MAX_SAMPLES           = 254;          // Maximum number of samples in a bank
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// A single tone in a bank program: maps a range of notes to one of the bank's samples.
+// Several tones in a program can cover the same note, in which case they are all played together.
+//------------------------------------------------------------------------------------------------------------------------------------------
+struct VabTone {
+    uint16_t    sampleIdx;          // Index of the sample played by the tone in the bank's sample list
+    uint8_t     priority;           // 0-127: voice allocation priority, lower priority voices are stolen first when voices run out
+    uint8_t     volume;             // 0-127: tone volume
+    uint8_t     pan;                // 0-127: tone pan, 64 = center
+    uint8_t     rootNote;           // The note at which the sample plays at 44,100 Hz
+    uint8_t     fineTune;           // Pitch correction for the root note, in 1/128 semitone units
+    uint8_t     minNote;            // Lowest note played by the tone (inclusive)
+    uint8_t     maxNote;            // Highest note played by the tone (inclusive)
+    uint8_t     pitchBendMin;       // Pitch bend range down in semitones
+    uint8_t     pitchBendMax;       // Pitch bend range up in semitones
+    uint32_t    adsrBits;           // SPU ADSR envelope register values: same bit layout as 'Spu::AdsrEnvelope'
+};
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// A program (instrument) in a bank: a set of consecutive tones in the bank's tone list
+//------------------------------------------------------------------------------------------------------------------------------------------
+struct VabProgram {
+    uint16_t    firstToneIdx;       // Index of the program's first tone in the bank's tone list
+    uint8_t     numTones;           // How many tones the program has: zero if the program is not used
+    uint8_t     volume;             // 0-127: program volume
+    uint8_t     pan;                // 0-127: program pan, 64 = center
+};
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Where a sample's ADPCM data is located within the bank body (.vb data)
+//------------------------------------------------------------------------------------------------------------------------------------------
+struct VabSample {
+    uint32_t    offset;             // Offset of the sample from the start of the body
+    uint32_t    size;               // Size of the sample in bytes
+};
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// An index of a VAB sound bank held in memory (a memory mapped file, for example).
+// Programs, tones and sample locations are parsed from the header (.vh data); the sample data itself is NOT copied and is instead
+// referenced directly in the body (.vb data). The body pointer is only valid for as long as that memory is.
+//------------------------------------------------------------------------------------------------------------------------------------------
+struct VabBank {
+    const std::byte*            pBody;                          // The bank body containing the ADPCM data for all samples
+    size_t                      bodySize;                       // Size of the bank body
+    uint8_t                     masterVolume;                   // 0-127: master volume for the bank
+    uint8_t                     masterPan;                      // 0-127: master pan for the bank, 64 = center
+    VabProgram                  programs[VAB_MAX_PROGRAMS];     // All programs in the bank, by program number
+    std::vector<VabTone>        tones;                          // All tones for all programs
+    std::vector<VabSample>      samples;                        // All samples in the bank
+};
+
+bool isVabHeader(const std::byte* const pData, const size_t dataSize) noexcept;
+
+bool parseVab(
+    const std::byte* const pHeaderData,
+    const size_t headerDataSize,
+    const std::byte* const pBodyData,
+    const size_t bodyDataSize,
+    VabBank& bankOut,
+    std::string& errorMsgOut
+) noexcept;
+
+uint8_t getFirstUsedVabProgram(const VabBank& bank) noexcept;
+
+END_NAMESPACE(VabUtils)
+END_NAMESPACE(AudioTools)
@@ -2,11 +2,12 @@
 
 #include "Asserts.h"
 #include "Endian.h"
-#include "FileInputStream.h"
 #include "FileOutputStream.h"
-#include "FileUtils.h"
+#include "InputStream.h"
+#include "MappedFile.h"
 
 #include <algorithm>
+#include <cstring>
 
 BEGIN_NAMESPACE(AudioTools)
 BEGIN_NAMESPACE(VagUtils)
@@ -76,6 +77,33 @@ bool VagFileHdr::validate() noexcept {
     );
 }
 
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Checks an endian corrected .VAG file header before loading the file, throwing an error message if the header is not usable.
+// This is more lenient than 'VagFileHdr::validate' for the sake of compatibility.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void checkVagFileHdrForLoading(const VagFileHdr& hdr) THROWS {
+    // These checks SHOULD be done, but some of the PlayStation SDK tools don't seem to populate these fields always correctly.
+    // Therefore skip the file id and version checks for the sake of compatibility...
+    #if false
+        if (hdr.fileId != VAG_FILE_ID)
+            throw "File is not a .vag file! Invalid file id!";
+
+        if (hdr.version != VAG_FILE_VERSION)
+            throw "The .vag file version is not recognized! The only supported version is '3'.";
+    #endif
+
+    // Verify the size in the header file: it must be greater than '0' and be block size aligned
+    if (hdr.adpcmDataSize <= 0)
+        throw "Invalid size specified in the .vag file header!";
+
+    if (hdr.adpcmDataSize % ADPCM_BLOCK_SIZE != 0)
+        throw "Invalid size specified in the .vag file header!";
+
+    // Make sure a sample rate is specified
+    if (hdr.sampleRate <= 0)
+        throw "Invalid sample rate specified in the .vag file header!";
+}
+
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Read the contents of a .VAG file
 //------------------------------------------------------------------------------------------------------------------------------------------
@@ -97,27 +125,7 @@ bool readVagFile(
         in.read(hdr);
         hdr.endianCorrect();
 
-        // These checks SHOULD be done, but some of the PlayStation SDK tools don't seem to populate these fields always correctly.
-        // Therefore skip the file id and version checks for the sake of compatibility...
-        #if false
-            if (hdr.fileId != VAG_FILE_ID)
-                throw "File is not a .vag file! Invalid file id!";
-
-            if (hdr.version != VAG_FILE_VERSION)
-                throw "The .vag file version is not recognized! The only supported version is '3'.";
-        #endif
-
-        // Verify the size in the header file: it must be greater than '0' and be block size aligned
-        if (hdr.adpcmDataSize <= 0)
-            throw "Invalid size specified in the .vag file header!";
-
-        if (hdr.adpcmDataSize % ADPCM_BLOCK_SIZE != 0)
-            throw "Invalid size specified in the .vag file header!";
-
-        // Make sure a sample rate is specified
-        if (hdr.sampleRate <= 0)
-            throw "Invalid sample rate specified in the .vag file header!";
-
+        checkVagFileHdrForLoading(hdr);
         sampleRate = hdr.sampleRate;
 
         // Read the adpcm data for the VAG file.
@@ -146,7 +154,54 @@ bool readVagFile(
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Helper: read a .vag file from a file on disk
+// Parse a .VAG file that is held entirely in memory without copying the ADPCM data.
+// The ADPCM data pointer in the output view points into the given file data.
+//------------------------------------------------------------------------------------------------------------------------------------------
+bool parseVagFile(
+    const std::byte* const pFileData,
+    const size_t fileSize,
+    VagFileView& vagOut,
+    std::string& errorMsgOut
+) noexcept {
+    ASSERT(pFileData || (fileSize == 0));
+    vagOut = {};
+
+    bool bParseOk = false;
+
+    try {
+        // Read the header and verify it
+        if (fileSize < sizeof(VagFileHdr))
+            throw "The file is too small to contain a .vag file header!";
+
+        VagFileHdr hdr = {};
+        std::memcpy(&hdr, pFileData, sizeof(VagFileHdr));
+        hdr.endianCorrect();
+        checkVagFileHdrForLoading(hdr);
+
+        // Save the details of the ADPCM data: note that some of it may be implicit (all zeros) and not present in the file
+        vagOut.pAdpcmData = pFileData + sizeof(VagFileHdr);
+        vagOut.adpcmDataSize = hdr.adpcmDataSize;
+        vagOut.adpcmDataSizeInFile = (uint32_t) std::min<size_t>(fileSize - sizeof(VagFileHdr), hdr.adpcmDataSize);
+        vagOut.sampleRate = hdr.sampleRate;
+
+        // All good if we get to here
+        bParseOk = true;
+    }
+    catch (const char* const exceptionMsg) {
+        errorMsgOut = "An error occurred while reading the .vag file! It may not be a valid .vag. Error message: ";
+        errorMsgOut += exceptionMsg;
+    }
+
+    if (!bParseOk) {
+        vagOut = {};
+    }
+
+    return bParseOk;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Helper: read a .vag file from a file on disk.
+// The file is memory mapped so the ADPCM data is copied only once, straight from the mapping to the output buffer.
 //------------------------------------------------------------------------------------------------------------------------------------------
 bool readVagFile(
     const char* const filePath,
@@ -154,37 +209,35 @@ bool readVagFile(
     uint32_t& sampleRate,
     std::string& errorMsgOut
 ) noexcept {
-    // Determine the file size firstly (needed to read the VAG)
-    const int64_t fileSize = FileUtils::getFileSize(filePath);
+    sampleRate = {};
+    adpcmDataOut.clear();
+
+    // Map the file into memory
+    MappedFile file;
 
-    if (fileSize < 0) {
-        errorMsgOut = "Failed to determine the size of VAG format file '";
+    if (!file.open(filePath)) {
+        errorMsgOut = "Failed to open VAG format file '";
         errorMsgOut += filePath;
-        errorMsgOut += "'!";
+        errorMsgOut += "' for reading! Does the file path exist and is it accessible?";
         return false;
     }
 
-    // Read the VAG file itself
-    bool bReadFileOk = false;
+    // Parse the VAG file and add the file name as additional context if that fails
+    VagFileView vag = {};
 
-    try {
-        FileInputStream in(filePath);
-        bReadFileOk = readVagFile(in, (size_t) fileSize, adpcmDataOut, sampleRate, errorMsgOut);
-
-        // If reading failed add the file name as additional context
-        if (!bReadFileOk) {
-            std::string errorPrefix = "Failed to read VAG format file '";
-            errorPrefix += filePath;
-            errorPrefix += "'! ";
-            errorMsgOut.insert(errorMsgOut.begin(), errorPrefix.begin(), errorPrefix.end());
-        }
-    } catch (...) {
-        errorMsgOut = "Failed to open VAG format file '";
-        errorMsgOut += filePath;
-        errorMsgOut += "' for reading! Does the file path exist and is it accessible?";
+    if (!parseVagFile(file.data(), file.size(), vag, errorMsgOut)) {
+        std::string errorPrefix = "Failed to read VAG format file '";
+        errorPrefix += filePath;
+        errorPrefix += "'! ";
+        errorMsgOut.insert(errorMsgOut.begin(), errorPrefix.begin(), errorPrefix.end());
+        return false;
     }
 
-    return bReadFileOk;
+    // Copy out the ADPCM data, zero filling any implicit data which isn't present in the file
+    adpcmDataOut.resize(vag.adpcmDataSize);
+    std::memcpy(adpcmDataOut.data(), vag.pAdpcmData, vag.adpcmDataSizeInFile);
+    sampleRate = vag.sampleRate;
+    return true;
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
@@ -287,6 +340,46 @@ void decodePsxAdpcmSamples(
     }
 }
 
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Finds the loop start and end sample indexes for the specified PSX ADPCM data by scanning the ADPCM block flags only.
+// Gives the same loop points as 'decodePsxAdpcmSamples' but without decoding any of the samples.
+// If the sample is NOT looped then these will both be set to zero.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void findPsxAdpcmLoopPoints(
+    const std::byte* const pData,
+    const uint32_t dataSize,
+    uint32_t& loopStartSampleIdx,
+    uint32_t& loopEndSampleIdx
+) noexcept {
+    ASSERT(pData || (dataSize == 0));
+
+    loopStartSampleIdx = 0;
+    loopEndSampleIdx = 0;
+
+    const uint32_t numSampleBlocks = dataSize / ADPCM_BLOCK_SIZE;
+    bool bFoundLoopEnd = false;
+
+    for (uint32_t sampleBlockIdx = 0; sampleBlockIdx < numSampleBlocks; ++sampleBlockIdx) {
+        const uint8_t blockFlags = (uint8_t) pData[sampleBlockIdx * ADPCM_BLOCK_SIZE + 1];
+
+        // Only use loop start if we haven't encountered a loop end yet
+        if ((blockFlags & ADPCM_FLAG_LOOP_START) && (!bFoundLoopEnd)) {
+            loopStartSampleIdx = sampleBlockIdx * ADPCM_BLOCK_NUM_SAMPLES;
+        }
+
+        // Note that the loop end happens AFTER the end of the current block
+        if ((blockFlags & ADPCM_FLAG_LOOP_END) && (blockFlags & ADPCM_FLAG_REPEAT)) {
+            bFoundLoopEnd = true;
+            loopEndSampleIdx = (sampleBlockIdx + 1) * ADPCM_BLOCK_NUM_SAMPLES;
+        }
+    }
+
+    // If we didn't find a loop end then ignore any loop starts encountered
+    if (!bFoundLoopEnd) {
+        loopStartSampleIdx = 0;
+    }
+}
+
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Write a sound encoded in the PlayStation's ADPCM format to the given VAG file on disk.
 // Returns 'true' if the write was successful.
@@ -379,14 +472,18 @@ bool writePcmSoundToVagFile(
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Encode the given sound to PSX adpcm
+// Encode the given sound to PSX adpcm.
+// Returns 'false' if the encode was aborted by the progress callback, in which case the output is incomplete.
 //------------------------------------------------------------------------------------------------------------------------------------------
-void encodePcmSoundToPsxAdpcm(
+bool encodePcmSoundToPsxAdpcm(
     const int16_t* const pSamples,
     const uint32_t numSamples,
     const uint32_t loopStartSampleIdx,
     const uint32_t loopEndSampleIdx,
-    std::vector<std::byte>& adpcmDataOut
+    std::vector<std::byte>& adpcmDataOut,
+    const EncodeQuality quality,
+    const EncodeProgressCallback pProgressCallback,
+    void* const pProgressUserData
 ) noexcept {
     // Figure out which blocks we apply these flags for
     uint32_t loopStartBlock = UINT32_MAX;
@@ -411,7 +508,16 @@ void encodePcmSoundToPsxAdpcm(
     adpcmDataOut.clear();
     adpcmDataOut.resize((size_t) numAdpcmBlocks * ADPCM_BLOCK_SIZE);
 
+    // How often to report progress, in blocks
+    constexpr uint32_t PROGRESS_INTERVAL = 256;
+
     for (uint32_t blockIdx = 0; blockIdx < numAdpcmBlocks; ++blockIdx) {
+        // Report progress every so often and abort if requested
+        if (pProgressCallback && (blockIdx % PROGRESS_INTERVAL == 0)) {
+            if (!pProgressCallback(pProgressUserData, blockIdx, numAdpcmBlocks))
+                return false;
+        }
+
         // Grab all of the samples for this block, zero pad to 28 samples if required (if we are at the end of the sound)
         const bool bIsLastBlock = (blockIdx + 1 >= numAdpcmBlocks);
 
@@ -435,9 +541,16 @@ void encodePcmSoundToPsxAdpcm(
             ((blockIdx != 0) && bIsSoundLooped),
             adpcmDataOut.data() + (size_t) blockIdx * ADPCM_BLOCK_SIZE,
             prevEncSamples[0],
-            prevEncSamples[1]
+            prevEncSamples[1],
+            quality
         );
     }
+
+    if (pProgressCallback) {
+        pProgressCallback(pProgressUserData, numAdpcmBlocks, numAdpcmBlocks);
+    }
+
+    return true;
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
@@ -494,6 +607,39 @@ static void tryPsxAdpcmEncoding(
     outPrevSample2 = prevSamples[1];
 }
 
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Estimates the best sample shift to use for the given prediction filter when doing a draft quality encode.
+// Picks the highest shift (finest step size) at which the peak open-loop prediction error for the block still fits in a 4-bit nibble.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static int32_t estimatePsxAdpcmSampleShift(
+    const uint32_t sampleFilter,
+    const int16_t inSamples[ADPCM_BLOCK_NUM_SAMPLES],
+    const int16_t inPrevSample1,
+    const int16_t inPrevSample2
+) noexcept {
+    const int32_t predictCoefPos = ADPCM_PREDICT_COEF_POS[sampleFilter];
+    const int32_t predictCoefNeg = ADPCM_PREDICT_COEF_NEG[sampleFilter];
+
+    int32_t prevSamples[2] = { inPrevSample1, inPrevSample2 };
+    int32_t peakError = 0;
+
+    for (uint32_t sampleIdx = 0; sampleIdx < ADPCM_BLOCK_NUM_SAMPLES; ++sampleIdx) {
+        const int32_t realSample = inSamples[sampleIdx];
+        const int32_t predictedSample = (prevSamples[0] * predictCoefPos + prevSamples[1] * predictCoefNeg + 32) / 64;
+        peakError = std::max(peakError, std::abs(realSample - predictedSample));
+        prevSamples[1] = prevSamples[0];
+        prevSamples[0] = realSample;
+    }
+
+    int32_t sampleShift = 12;
+
+    while ((sampleShift > 0) && (((int32_t) 7 << (12 - sampleShift)) < peakError)) {
+        --sampleShift;
+    }
+
+    return sampleShift;
+}
+
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Encode the given samples in the PlayStation's ADPCM format
 //------------------------------------------------------------------------------------------------------------------------------------------
@@ -506,16 +652,26 @@ void encodePcmToPsxAdpcmBlock(
     const bool bRepeatFlag,
     std::byte adpcmDataOut[ADPCM_BLOCK_SIZE],
     int16_t& prevEncSampleOut1,
-    int16_t& prevEncSampleOut2
+    int16_t& prevEncSampleOut2,
+    const EncodeQuality quality
 ) noexcept {
-    // Try various combinations of ADPCM encoding and sample shift adjust to find the best one
+    // Try various combinations of ADPCM encoding and sample shift adjust to find the best one.
+    // For draft quality only try the estimated best sample shift for each filter.
     uint64_t bestError = UINT64_MAX;
     uint32_t bestSampleFilter = 0;
     uint32_t bestSampleShift = 0;
     uint8_t bestSampleNibbles[ADPCM_BLOCK_NUM_SAMPLES] = {};
 
     for (uint32_t sampleFilter = 0; sampleFilter <= 4; ++sampleFilter) {
-        for (int32_t sampleShift = 0; sampleShift <= 12; ++sampleShift) {
+        int32_t minSampleShift = 0;
+        int32_t maxSampleShift = 12;
+
+        if (quality == EncodeQuality::Draft) {
+            minSampleShift = estimatePsxAdpcmSampleShift(sampleFilter, samples, prevSample1, prevSample2);
+            maxSampleShift = minSampleShift;
+        }
+
+        for (int32_t sampleShift = minSampleShift; sampleShift <= maxSampleShift; ++sampleShift) {
             // Evaluate this encoding
             uint8_t sampleNibbles[ADPCM_BLOCK_NUM_SAMPLES];
             int16_t lastEncSample1;
@@ -38,6 +38,22 @@ static constexpr uint8_t ADPCM_FLAG_LOOP_END    = 0x01;
 static constexpr uint8_t ADPCM_FLAG_REPEAT      = 0x02;
 static constexpr uint8_t ADPCM_FLAG_LOOP_START  = 0x04;
 
+//------------------------------------------------------------------------------------------------------------------------------------------
+// How thorough the ADPCM encoder should be.
+//
+//  Full:   Tries every combination of prediction filter and sample shift for each block and picks the best.
+//  Draft:  Estimates the sample shift for each prediction filter from the peak prediction error of the block and only tries that.
+//          Roughly an order of magnitude faster than 'Full' at some cost in quality; useful to get a sound playable quickly.
+//------------------------------------------------------------------------------------------------------------------------------------------
+enum class EncodeQuality : uint8_t {
+    Full,
+    Draft
+};
+
+// Optional callback invoked periodically during long encodes with the number of ADPCM blocks done so far.
+// Return 'false' from the callback to abort the encode.
+typedef bool (*EncodeProgressCallback)(void* pUserData, const uint32_t numBlocksDone, const uint32_t numBlocksTotal) noexcept;
+
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Header format for a PS1 .VAG.
 // Note that this header is stored in BIG ENDIAN format in the file!
@@ -58,6 +74,18 @@ struct VagFileHdr {
 
 static_assert(sizeof(VagFileHdr) == 64);
 
+//------------------------------------------------------------------------------------------------------------------------------------------
+// A view of a .VAG file that is held in memory (a memory mapped file, for example).
+// The ADPCM data pointer points directly into the file data and is only valid for as long as that memory is.
+// Note that the header can specify more ADPCM data than is actually present in the file: the missing data is implicitly all zeros.
+//------------------------------------------------------------------------------------------------------------------------------------------
+struct VagFileView {
+    const std::byte*    pAdpcmData;             // The ADPCM data contained in the file
+    uint32_t            adpcmDataSize;          // Size of the ADPCM data as specified by the header, including implicit zeroed data
+    uint32_t            adpcmDataSizeInFile;    // How much of the ADPCM data is actually present in the file
+    uint32_t            sampleRate;             // Sound data sample rate
+};
+
 bool readVagFile(
     InputStream& in,
     const size_t fileSize,
@@ -66,6 +94,13 @@ bool readVagFile(
     std::string& errorMsgOut
 ) noexcept;
 
+bool parseVagFile(
+    const std::byte* const pFileData,
+    const size_t fileSize,
+    VagFileView& vagOut,
+    std::string& errorMsgOut
+) noexcept;
+
 bool readVagFile(
     const char* const filePath,
     std::vector<std::byte>& adpcmDataOut,
@@ -81,6 +116,13 @@ void decodePsxAdpcmSamples(
     uint32_t& loopEndSampleIdx
 ) noexcept;
 
+void findPsxAdpcmLoopPoints(
+    const std::byte* const pData,
+    const uint32_t dataSize,
+    uint32_t& loopStartSampleIdx,
+    uint32_t& loopEndSampleIdx
+) noexcept;
+
 bool writePsxAdpcmSoundToVagFile(
     OutputStream& out,
     const std::byte* const pAdpcmData,
@@ -113,12 +155,15 @@ bool writePcmSoundToVagFile(
     const uint32_t loopEndSampleIdx
 ) noexcept;
 
-void encodePcmSoundToPsxAdpcm(
+bool encodePcmSoundToPsxAdpcm(
     const int16_t* const pSamples,
     const uint32_t numSamples,
     const uint32_t loopStartSampleIdx,
     const uint32_t loopEndSampleIdx,
-    std::vector<std::byte>& adpcmDataOut
+    std::vector<std::byte>& adpcmDataOut,
+    const EncodeQuality quality = EncodeQuality::Full,
+    const EncodeProgressCallback pProgressCallback = nullptr,
+    void* const pProgressUserData = nullptr
 ) noexcept;
 
 void encodePcmToPsxAdpcmBlock(
@@ -130,7 +175,8 @@ void encodePcmToPsxAdpcmBlock(
     const bool bRepeatFlag,
     std::byte adpcmDataOut[ADPCM_BLOCK_SIZE],
     int16_t& prevEncSampleOut1,
-    int16_t& prevEncSampleOut2
+    int16_t& prevEncSampleOut2,
+    const EncodeQuality quality = EncodeQuality::Full
 ) noexcept;
 
 END_NAMESPACE(VagUtils)
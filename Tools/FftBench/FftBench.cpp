@@ -0,0 +1,205 @@
+//------------------------------------------------------------------------------------------------------------------------------------------
+// WDL FFT benchmark.
+//
+// Times 'WDL_fft' (forward + inverse) and 'WDL_real_fft' (forward + inverse) for every size WDL supports, with each of the FFT
+// implementations that the CPU supports, and reports the speedup over the scalar code. 'WDL_fft_complexmul3' (the multiply-accumulate
+// used by 'WDL_ConvolutionEngine') is timed too. Every implementation's output is checked to be identical to the scalar output.
+//
+// Usage:
+//      FftBench [--min-size <num points>] [--max-size <num points>] [--runs <num runs>]
+//
+// Build (from the repository root), for example:
+//      gcc -O2 -c WDL/fft.c -o fft.o
+//      g++ -std=c++17 -O2 -IWDL Tools/FftBench/FftBench.cpp fft.o -o FftBench
+//
+// Add -DWDL_FFT_REALSIZE=8 to both lines to benchmark the double precision FFT.
+//------------------------------------------------------------------------------------------------------------------------------------------
+#include "fft.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <random>
+#include <vector>
+
+static constexpr int32_t    kMinFftSize         = 2;            // Smallest transform WDL supports
+static constexpr int32_t    kMaxFftSize         = 32768;        // Largest transform WDL supports
+static constexpr uint32_t   kPointsPerRun       = 1u << 23;     // Roughly how many points to transform for each timing, whatever the size
+
+// Benchmark settings
+struct BenchSettings {
+    int32_t     minSize;    // Smallest transform to time
+    int32_t     maxSize;    // Largest transform to time
+    uint32_t    numRuns;    // How many times to time each test: the best run is reported
+};
+
+// A test to time at a given size: transforms the buffer in place, 'numIters' times
+struct Test {
+    const char*     pName;
+    void            (*pRunFunc)(std::vector<WDL_FFT_COMPLEX>& buf, const std::vector<WDL_FFT_COMPLEX>& src, int32_t size, uint32_t numIters);
+};
+
+// The transforms start from the source data each time, so the values don't grow without bound
+static void RunComplexFft(std::vector<WDL_FFT_COMPLEX>& buf, const std::vector<WDL_FFT_COMPLEX>& src, const int32_t size, const uint32_t numIters) {
+    for (uint32_t iter = 0; iter < numIters; ++iter) {
+        std::memcpy(buf.data(), src.data(), (size_t) size * sizeof(WDL_FFT_COMPLEX));
+        WDL_fft(buf.data(), size, 0);
+        WDL_fft(buf.data(), size, 1);
+    }
+}
+
+static void RunRealFft(std::vector<WDL_FFT_COMPLEX>& buf, const std::vector<WDL_FFT_COMPLEX>& src, const int32_t size, const uint32_t numIters) {
+    for (uint32_t iter = 0; iter < numIters; ++iter) {
+        std::memcpy(buf.data(), src.data(), (size_t) size * sizeof(WDL_FFT_REAL));
+        WDL_real_fft((WDL_FFT_REAL*) buf.data(), size, 0);
+        WDL_real_fft((WDL_FFT_REAL*) buf.data(), size, 1);
+    }
+}
+
+static void RunComplexMul(std::vector<WDL_FFT_COMPLEX>& buf, const std::vector<WDL_FFT_COMPLEX>& src, const int32_t size, const uint32_t numIters) {
+    // Half the size, as used by the convolution engine on the output of 'WDL_real_fft'
+    for (uint32_t iter = 0; iter < numIters; ++iter) {
+        WDL_fft_complexmul3(buf.data(), (WDL_FFT_COMPLEX*) src.data(), (WDL_FFT_COMPLEX*) src.data() + size / 2, size / 2);
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Run a test with the current FFT implementation on a copy of the source data and return the time taken in seconds.
+// The output is left in 'buf'.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static double TimeTest(
+    const Test& test,
+    std::vector<WDL_FFT_COMPLEX>& buf,
+    const std::vector<WDL_FFT_COMPLEX>& src,
+    const int32_t size,
+    const uint32_t numIters
+) noexcept {
+    buf = src;
+    const auto startTime = std::chrono::steady_clock::now();
+    test.pRunFunc(buf, src, size, numIters);
+    const auto endTime = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(endTime - startTime).count();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Read the benchmark settings from the command line; returns nothing if the command line is invalid
+//------------------------------------------------------------------------------------------------------------------------------------------
+static std::optional<BenchSettings> ReadSettings(const int argc, const char* const* const argv) noexcept {
+    BenchSettings settings = { 32, kMaxFftSize, 5 };
+
+    for (int argIdx = 1; argIdx < argc; ++argIdx) {
+        const char* const arg = argv[argIdx];
+        const bool bHasValue = (argIdx + 1 < argc);
+
+        if ((std::strcmp(arg, "--min-size") == 0) && bHasValue) {
+            settings.minSize = std::clamp(std::atoi(argv[++argIdx]), kMinFftSize, kMaxFftSize);
+        } else if ((std::strcmp(arg, "--max-size") == 0) && bHasValue) {
+            settings.maxSize = std::clamp(std::atoi(argv[++argIdx]), kMinFftSize, kMaxFftSize);
+        } else if ((std::strcmp(arg, "--runs") == 0) && bHasValue) {
+            settings.numRuns = (uint32_t) std::max(std::atoi(argv[++argIdx]), 1);
+        } else {
+            return std::nullopt;
+        }
+    }
+
+    return settings;
+}
+
+int main(int argc, char* argv[]) {
+    const std::optional<BenchSettings> settings = ReadSettings(argc, argv);
+
+    if (!settings) {
+        std::printf("Usage: FftBench [--min-size <num points>] [--max-size <num points>] [--runs <num runs>]\n");
+        return 1;
+    }
+
+    WDL_fft_init();
+
+    // Which implementations to compare against the scalar code
+    std::vector<int> impls;
+
+    for (int impl = WDL_FFT_IMPL_SCALAR + 1; impl < WDL_FFT_IMPL_COUNT; ++impl) {
+        if (WDL_fft_impl_name(impl)) {
+            impls.push_back(impl);
+        }
+    }
+
+    const Test tests[] = {
+        { "complex",    RunComplexFft },
+        { "real",       RunRealFft },
+        { "cmul3",      RunComplexMul },
+    };
+
+    std::printf(
+        "%d bit reals, default implementation: %s, best of %u runs\n",
+        (int) sizeof(WDL_FFT_REAL) * 8,
+        WDL_fft_impl_name(WDL_fft_get_impl()),
+        settings->numRuns
+    );
+
+    std::printf("%8s %6s %12s", "test", "size", "scalar ns");
+
+    for (const int impl : impls) {
+        std::printf(" %9s ns %8s", WDL_fft_impl_name(impl), "speedup");
+    }
+
+    std::printf("\n");
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    bool bAllIdentical = true;
+
+    for (const Test& test : tests) {
+        for (int32_t size = std::max(settings->minSize, kMinFftSize); size <= settings->maxSize; size *= 2) {
+            // The complex FFT uses all of the buffer, the others half of it
+            std::vector<WDL_FFT_COMPLEX> src((size_t) size);
+
+            for (WDL_FFT_COMPLEX& c : src) {
+                c.re = (WDL_FFT_REAL) dist(rng);
+                c.im = (WDL_FFT_REAL) dist(rng);
+            }
+
+            const uint32_t numIters = std::max<uint32_t>(kPointsPerRun / (uint32_t) size, 1);
+            std::vector<WDL_FFT_COMPLEX> scalarOut;
+            std::vector<WDL_FFT_COMPLEX> out;
+            double scalarSeconds = 0.0;
+
+            WDL_fft_set_impl(WDL_FFT_IMPL_SCALAR);
+
+            for (uint32_t runIdx = 0; runIdx < settings->numRuns; ++runIdx) {
+                const double seconds = TimeTest(test, scalarOut, src, size, numIters);
+                scalarSeconds = (runIdx == 0) ? seconds : std::min(scalarSeconds, seconds);
+            }
+
+            std::printf("%8s %6d %12.1f", test.pName, (int) size, scalarSeconds * 1e9 / numIters);
+
+            for (const int impl : impls) {
+                WDL_fft_set_impl(impl);
+                double bestSeconds = 0.0;
+
+                for (uint32_t runIdx = 0; runIdx < settings->numRuns; ++runIdx) {
+                    const double seconds = TimeTest(test, out, src, size, numIters);
+                    bestSeconds = (runIdx == 0) ? seconds : std::min(bestSeconds, seconds);
+                }
+
+                const bool bIdentical = (std::memcmp(out.data(), scalarOut.data(), out.size() * sizeof(WDL_FFT_COMPLEX)) == 0);
+                bAllIdentical &= bIdentical;
+                std::printf(" %12.1f %7.2fx%s", bestSeconds * 1e9 / numIters, scalarSeconds / bestSeconds, (bIdentical) ? " " : "!");
+            }
+
+            std::printf("\n");
+        }
+    }
+
+    WDL_fft_set_impl(WDL_FFT_IMPL_AUTO);
+
+    if (!bAllIdentical) {
+        std::printf("Output marked with '!' differs from the scalar output!\n");
+        return 1;
+    }
+
+    return 0;
+}
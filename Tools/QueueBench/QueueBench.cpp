@@ -0,0 +1,289 @@
+//------------------------------------------------------------------------------------------------------------------------------------------
+// IPlugQueue transfer benchmark.
+//
+// Streams MIDI messages from a producer thread to a consumer thread through a lock free queue, as happens between the audio and UI
+// threads for parameter, MIDI and 'ISender' traffic, and reports the throughput. Each way of moving the messages is timed:
+//
+//      unpadded    The previous queue layout: adjacent read/write indices, one element and one acquire/release per push and pop
+//      single      IPlugQueue with one element per 'Push' and 'Pop'
+//      batch       IPlugQueue with 'PushN' on the producer side and 'Drain' on the consumer side
+//
+// The consumer checks that every message arrives, in order.
+//
+// Usage:
+//      QueueBench [--messages <num messages>] [--queue-size <num elements>] [--batch <num elements>] [--runs <num runs>]
+//
+// Build (from the repository root), for example:
+//      g++ -std=c++17 -O2 -IIPlug -IWDL Tools/QueueBench/QueueBench.cpp -lpthread -o QueueBench
+//------------------------------------------------------------------------------------------------------------------------------------------
+#include "IPlugMidi.h"
+#include "IPlugQueue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <thread>
+#include <vector>
+
+using iplug::IMidiMsg;
+using iplug::IPlugQueue;
+
+// Benchmark settings
+struct BenchSettings {
+    uint32_t    numMessages;    // How many messages to send through the queue for each run
+    int32_t     queueSize;      // How many elements the queue can hold
+    int32_t     batchSize;      // How many elements to push at a time in batch mode
+    uint32_t    numRuns;        // How many times to time each mode: the best run is reported
+};
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// A copy of the IPlugQueue layout before the indices were padded and cached, for comparison
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <class T>
+class UnpaddedQueue {
+public:
+    UnpaddedQueue(const int size) noexcept : mData((size_t) size + 1) {}
+
+    bool Push(const T& item) noexcept {
+        const size_t currentWriteIndex = mWriteIndex.load(std::memory_order_relaxed);
+        const size_t nextWriteIndex = (currentWriteIndex + 1) % mData.size();
+
+        if (nextWriteIndex == mReadIndex.load(std::memory_order_acquire))
+            return false;
+
+        mData[currentWriteIndex] = item;
+        mWriteIndex.store(nextWriteIndex, std::memory_order_release);
+        return true;
+    }
+
+    bool Pop(T& item) noexcept {
+        const size_t currentReadIndex = mReadIndex.load(std::memory_order_relaxed);
+
+        if (currentReadIndex == mWriteIndex.load(std::memory_order_acquire))
+            return false;
+
+        item = mData[currentReadIndex];
+        mReadIndex.store((currentReadIndex + 1) % mData.size(), std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::vector<T>          mData;
+    std::atomic<size_t>     mWriteIndex{0};
+    std::atomic<size_t>     mReadIndex{0};
+};
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Makes the message with the given sequence number: the number is spread over the message so the consumer can check it
+//------------------------------------------------------------------------------------------------------------------------------------------
+static IMidiMsg MakeMessage(const uint32_t seqNum) noexcept {
+    return IMidiMsg((int) seqNum, 0xB0, (uint8_t)(seqNum & 0x7F), (uint8_t)((seqNum >> 7) & 0x7F));
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Checks that a received message is the one expected, exiting if not
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void CheckMessage(const IMidiMsg& msg, const uint32_t expectedSeqNum) noexcept {
+    if (msg.mOffset != (int) expectedSeqNum) {
+        std::printf("Message %u arrived out of order, expected %u!\n", (unsigned) msg.mOffset, expectedSeqNum);
+        std::exit(1);
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Runs a producer and a consumer thread with the given functions and returns how long it took to transfer all of the messages, in seconds.
+// Each function is called repeatedly with the number of messages it has sent or received so far and returns the new number.
+// A thread which can't make progress (queue full or empty) yields, so the benchmark also works on machines with a single core.
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <class ProduceFunc, class ConsumeFunc>
+static double TimeTransfer(const uint32_t numMessages, ProduceFunc&& produce, ConsumeFunc&& consume) noexcept {
+    std::atomic<bool> bStart(false);
+
+    std::thread producer([&]() {
+        while (!bStart.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+
+        for (uint32_t numSent = 0; numSent < numMessages;) {
+            const uint32_t prevNumSent = numSent;
+            numSent = produce(numSent);
+
+            if (numSent == prevNumSent) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    std::thread consumer([&]() {
+        while (!bStart.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+
+        for (uint32_t numReceived = 0; numReceived < numMessages;) {
+            const uint32_t prevNumReceived = numReceived;
+            numReceived = consume(numReceived);
+
+            if (numReceived == prevNumReceived) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    const auto startTime = std::chrono::steady_clock::now();
+    bStart.store(true, std::memory_order_release);
+    producer.join();
+    consumer.join();
+    const auto endTime = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(endTime - startTime).count();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Time a single run of each mode and return the time taken in seconds
+//------------------------------------------------------------------------------------------------------------------------------------------
+static double RunUnpadded(const BenchSettings& settings) noexcept {
+    UnpaddedQueue<IMidiMsg> queue(settings.queueSize);
+
+    return TimeTransfer(
+        settings.numMessages,
+        [&](const uint32_t numSent) noexcept { return (queue.Push(MakeMessage(numSent))) ? numSent + 1 : numSent; },
+        [&](const uint32_t numReceived) noexcept {
+            IMidiMsg msg;
+
+            if (!queue.Pop(msg))
+                return numReceived;
+
+            CheckMessage(msg, numReceived);
+            return numReceived + 1;
+        }
+    );
+}
+
+static double RunSingle(const BenchSettings& settings) noexcept {
+    IPlugQueue<IMidiMsg> queue(settings.queueSize);
+
+    return TimeTransfer(
+        settings.numMessages,
+        [&](const uint32_t numSent) noexcept { return (queue.Push(MakeMessage(numSent))) ? numSent + 1 : numSent; },
+        [&](const uint32_t numReceived) noexcept {
+            IMidiMsg msg;
+
+            if (!queue.Pop(msg))
+                return numReceived;
+
+            CheckMessage(msg, numReceived);
+            return numReceived + 1;
+        }
+    );
+}
+
+static double RunBatch(const BenchSettings& settings) noexcept {
+    IPlugQueue<IMidiMsg> queue(settings.queueSize);
+    std::vector<IMidiMsg> batch((size_t) settings.batchSize);
+    uint32_t batchStart = 0;
+    int32_t batchLen = 0;
+
+    return TimeTransfer(
+        settings.numMessages,
+        [&](const uint32_t numSent) noexcept {
+            // Fill up the next batch once all of the previous one has been pushed
+            if (numSent == batchStart + (uint32_t) batchLen) {
+                batchStart = numSent;
+                batchLen = (int32_t) std::min<uint32_t>(settings.numMessages - numSent, (uint32_t) settings.batchSize);
+
+                for (int32_t i = 0; i < batchLen; ++i) {
+                    batch[i] = MakeMessage(batchStart + (uint32_t) i);
+                }
+            }
+
+            const uint32_t batchOffset = numSent - batchStart;
+            return numSent + (uint32_t) queue.PushN(batch.data() + batchOffset, batchLen - (int32_t) batchOffset);
+        },
+        [&](uint32_t numReceived) noexcept {
+            queue.Drain([&](const IMidiMsg& msg) noexcept {
+                CheckMessage(msg, numReceived);
+                numReceived++;
+            });
+
+            return numReceived;
+        }
+    );
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Read the benchmark settings from the command line; returns nothing if the command line is invalid
+//------------------------------------------------------------------------------------------------------------------------------------------
+static std::optional<BenchSettings> ReadSettings(const int argc, const char* const* const argv) noexcept {
+    BenchSettings settings = { 10000000, PARAM_TRANSFER_SIZE, 32, 5 };
+
+    for (int argIdx = 1; argIdx < argc; ++argIdx) {
+        const char* const arg = argv[argIdx];
+        const bool bHasValue = (argIdx + 1 < argc);
+
+        if ((std::strcmp(arg, "--messages") == 0) && bHasValue) {
+            settings.numMessages = (uint32_t) std::max(std::atoi(argv[++argIdx]), 1);
+        } else if ((std::strcmp(arg, "--queue-size") == 0) && bHasValue) {
+            settings.queueSize = std::max(std::atoi(argv[++argIdx]), 1);
+        } else if ((std::strcmp(arg, "--batch") == 0) && bHasValue) {
+            settings.batchSize = std::max(std::atoi(argv[++argIdx]), 1);
+        } else if ((std::strcmp(arg, "--runs") == 0) && bHasValue) {
+            settings.numRuns = (uint32_t) std::max(std::atoi(argv[++argIdx]), 1);
+        } else {
+            return std::nullopt;
+        }
+    }
+
+    return settings;
+}
+
+int main(int argc, char* argv[]) {
+    const std::optional<BenchSettings> settings = ReadSettings(argc, argv);
+
+    if (!settings) {
+        std::printf("Usage: QueueBench [--messages <num messages>] [--queue-size <num elements>] [--batch <num elements>] [--runs <num runs>]\n");
+        return 1;
+    }
+
+    struct Mode {
+        const char*     pName;
+        double          (*pRunFunc)(const BenchSettings&) noexcept;
+    };
+
+    const Mode modes[] = {
+        { "unpadded",   RunUnpadded },
+        { "single",     RunSingle },
+        { "batch",      RunBatch },
+    };
+
+    std::printf(
+        "Messages: %u, queue size: %d, batch size: %d, best of %u runs\n",
+        settings->numMessages,
+        settings->queueSize,
+        settings->batchSize,
+        settings->numRuns
+    );
+
+    std::printf("%10s %12s %16s %12s\n", "mode", "ms", "messages/s", "ns/message");
+
+    for (const Mode& mode : modes) {
+        double bestSeconds = 0.0;
+
+        for (uint32_t runIdx = 0; runIdx < settings->numRuns; ++runIdx) {
+            const double seconds = mode.pRunFunc(*settings);
+            bestSeconds = (runIdx == 0) ? seconds : std::min(bestSeconds, seconds);
+        }
+
+        std::printf(
+            "%10s %12.2f %16.0f %12.2f\n",
+            mode.pName,
+            bestSeconds * 1000.0,
+            (double) settings->numMessages / bestSeconds,
+            bestSeconds * 1e9 / (double) settings->numMessages
+        );
+    }
+
+    return 0;
+}
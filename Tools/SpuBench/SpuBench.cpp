@@ -0,0 +1,174 @@
+//------------------------------------------------------------------------------------------------------------------------------------------
+// SPU reverb tail benchmark.
+//
+// Feeds a short burst of noise into the SPU reverb and then times how long it takes to render each following second of the decaying
+// reverb tail. With denormals handled properly the cost per second should stay flat all the way through the tail; without that the
+// float SPU slows down massively as the tail decays into denormal floats.
+//
+// Usage:
+//      SpuBench [--int16] [--no-ftz] [--preset <1-9>] [--seconds <num seconds of tail>]
+//
+// Build (from the repository root), for example:
+//      g++ -std=c++17 -O2 -IPluginsCommon Tools/SpuBench/SpuBench.cpp PluginsCommon/Spu.cpp PluginsCommon/FatalErrors.cpp
+//          Plugins/PsxReverb/SpuReverbPresets.cpp -IWDL -o SpuBench
+//------------------------------------------------------------------------------------------------------------------------------------------
+#include "Spu.h"
+
+#include "../../Plugins/PsxReverb/SpuReverbPresets.h"
+
+#define WDL_DENORMAL_WANTS_SCOPED_FTZ
+#include "denormal.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <random>
+
+static constexpr uint32_t   kSpuRamSize     = 512 * 1024;   // SPU RAM size: this is the size that the PS1 had
+static constexpr uint32_t   kSampleRate     = 44100;        // SPU output sample rate
+static constexpr uint32_t   kBurstSeconds   = 1;            // How many seconds of noise to feed into the reverb before the tail
+
+// Benchmark settings
+struct BenchSettings {
+    bool        bInt16;         // Benchmark the 16-bit SPU rather than the float SPU
+    bool        bNoFtz;         // Don't flush denormals to zero while rendering
+    int32_t     preset;         // Which LIBSPU reverb preset to use
+    uint32_t    tailSeconds;    // How many seconds of reverb tail to render
+};
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Source of external input for the SPU: white noise until the burst is over, then silence
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <class SampleT>
+struct NoiseInput {
+    std::mt19937    rng;
+    uint32_t        samplesLeft;
+
+    static Spu::StereoSample<SampleT> Callback(void* pUserData) noexcept {
+        NoiseInput& input = *(NoiseInput*) pUserData;
+
+        if (input.samplesLeft == 0)
+            return {};
+
+        input.samplesLeft--;
+        const int16_t left = (int16_t)(input.rng() >> 16);
+        const int16_t right = (int16_t)(input.rng() >> 16);
+
+        if constexpr (SampleT::IS_FLOAT) {
+            return { Spu::toFloatSample(left), Spu::toFloatSample(right) };
+        } else {
+            return { left, right };
+        }
+    }
+};
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Read the benchmark settings from the command line; returns nothing if the command line is invalid
+//------------------------------------------------------------------------------------------------------------------------------------------
+static std::optional<BenchSettings> ReadSettings(const int argc, const char* const* const argv) noexcept {
+    BenchSettings settings = { false, false, SpuReverbPresets::SPU_REV_MODE_HALL, 120 };
+
+    for (int argIdx = 1; argIdx < argc; ++argIdx) {
+        const char* const arg = argv[argIdx];
+        const bool bHasValue = (argIdx + 1 < argc);
+
+        if (std::strcmp(arg, "--int16") == 0) {
+            settings.bInt16 = true;
+        } else if (std::strcmp(arg, "--no-ftz") == 0) {
+            settings.bNoFtz = true;
+        } else if ((std::strcmp(arg, "--preset") == 0) && bHasValue) {
+            settings.preset = std::atoi(argv[++argIdx]);
+        } else if ((std::strcmp(arg, "--seconds") == 0) && bHasValue) {
+            settings.tailSeconds = (uint32_t) std::max(std::atoi(argv[++argIdx]), 1);
+        } else {
+            return std::nullopt;
+        }
+    }
+
+    if ((settings.preset <= SpuReverbPresets::SPU_REV_MODE_OFF) || (settings.preset >= SpuReverbPresets::SPU_REV_MODE_MAX))
+        return std::nullopt;
+
+    return settings;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Run the benchmark for a particular type of SPU and print the cost of each second of output
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <class SampleT>
+static void RunBench(const BenchSettings& settings) noexcept {
+    using namespace SpuReverbPresets;
+
+    // Setup the SPU for reverb only with the requested preset, same as the reverb plugin does
+    Spu::Core<SampleT> spu;
+    Spu::initCore(spu, kSpuRamSize, 0);
+
+    static_assert(sizeof(SpuReverbDef) == sizeof(Spu::ReverbRegs));
+    std::memcpy(&spu.reverbRegs, &gReverbDefs[settings.preset], sizeof(Spu::ReverbRegs));
+    spu.reverbBaseAddr8 = gReverbWorkAreaBaseAddrs[settings.preset];
+    spu.reverbCurAddr = spu.reverbBaseAddr8 * 8;
+    spu.masterVol = { 0x3FFF, 0x3FFF };
+    spu.reverbVol = { 0x2FFF, 0x2FFF };
+    spu.extInputVol = { 0x7FFF, 0x7FFF };
+    spu.bUnmute = true;
+    spu.bReverbWriteEnable = true;
+    spu.bExtEnabled = true;
+    spu.bExtReverbEnable = true;
+
+    NoiseInput<SampleT> noiseInput = { std::mt19937(1234), kBurstSeconds * kSampleRate };
+    spu.pExtInputCallback = NoiseInput<SampleT>::Callback;
+    spu.pExtInputUserData = &noiseInput;
+
+    // Render the burst and the tail one second at a time and time each second
+    std::printf("SPU: %s, FTZ/DAZ: %s, preset: %s\n", (SampleT::IS_FLOAT) ? "float" : "int16", (settings.bNoFtz) ? "off" : "on", gReverbModeNames[settings.preset]);
+    std::printf("%8s %12s %12s %14s\n", "second", "ms", "x realtime", "peak level");
+
+    double totalMs = 0;
+
+    for (uint32_t second = 0; second < kBurstSeconds + settings.tailSeconds; ++second) {
+        float peakLevel = 0.0f;
+        const auto startTime = std::chrono::steady_clock::now();
+
+        {
+            std::optional<WDL_denormal_ftz_scope> ftzScope;
+
+            if (!settings.bNoFtz) {
+                ftzScope.emplace();
+            }
+
+            for (uint32_t sampleIdx = 0; sampleIdx < kSampleRate; ++sampleIdx) {
+                const Spu::StereoSample<SampleT> output = Spu::stepCore(spu);
+                const float left = (SampleT::IS_FLOAT) ? (float) output.left.value : Spu::toFloatSample((int16_t) output.left.value);
+                peakLevel = std::max(peakLevel, std::abs(left));
+            }
+        }
+
+        const auto endTime = std::chrono::steady_clock::now();
+        const double ms = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+        totalMs += ms;
+        std::printf("%8u %12.2f %12.1f %14g\n", second, ms, 1000.0 / ms, peakLevel);
+    }
+
+    std::printf("Total: %.2f ms\n", totalMs);
+    Spu::destroyCore(spu);
+}
+
+int main(int argc, char* argv[]) {
+    const std::optional<BenchSettings> settings = ReadSettings(argc, argv);
+
+    if (!settings) {
+        std::printf("Usage: SpuBench [--int16] [--no-ftz] [--preset <1-9>] [--seconds <num seconds of tail>]\n");
+        return 1;
+    }
+
+    if (settings->bInt16) {
+        RunBench<Spu::Int16Sample>(*settings);
+    } else {
+        RunBench<Spu::FloatSample>(*settings);
+    }
+
+    return 0;
+}
@@ -0,0 +1,554 @@
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Golden render check for the SPU and the ADPCM encoder.
+//
+// Renders a fixed corpus through the SPU and the .vag encoder and checks that the output is bit for bit the same as before, by comparing
+// a hash of each output against a file of reference hashes ('SpuGoldenRefs.txt' alongside this tool). Run this before and after making
+// optimizations to 'Spu.cpp' or 'VagUtils.cpp': any change in the output shows up as a failed case. The corpus is:
+//
+//  - SPU voices, for both the 16-bit and float SPU: every ADSR envelope mode, pitch extremes (including rates above 'MAX_SAMPLE_RATE'
+//    which must be clamped) and looping and non looping samples. The sample data is generated directly as ADPCM, using all 5 filters.
+//  - SPU reverb, for both the 16-bit and float SPU: every LIBSPU reverb preset, fed by a voice and also fed through 'processReverbBlock'.
+//  - The ADPCM encoder: generated PCM sounds encoded at both qualities, decoded again and written to and read back from .vag files.
+//
+// All of the input is generated with integer math, so it doesn't depend on the C runtime. The references for the float SPU are only valid
+// for builds that produce the same floating point results though: x64 SSE2 code without '-ffast-math' or FMA contraction.
+// When a change to the output is intended, update the references with '--update' and commit them along with the change.
+//
+// Usage:
+//      SpuGolden [--update] <refs file>
+//
+// Build (from the repository root), for example:
+//      g++ -std=c++17 -O2 -IPluginsCommon -IWDL Tools/SpuGolden/SpuGolden.cpp PluginsCommon/Spu.cpp PluginsCommon/VagUtils.cpp
+//          PluginsCommon/FatalErrors.cpp PluginsCommon/MappedFile.cpp Plugins/PsxReverb/SpuReverbPresets.cpp -o SpuGolden
+//------------------------------------------------------------------------------------------------------------------------------------------
+#include "ByteVecOutputStream.h"
+#include "Spu.h"
+#include "VagUtils.h"
+
+#include "../../Plugins/PsxReverb/SpuReverbPresets.h"
+
+#define WDL_DENORMAL_WANTS_SCOPED_FTZ
+#include "denormal.h"
+#include "fnv64.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace AudioTools;
+
+static constexpr uint32_t   kSpuRamSize         = 512 * 1024;   // SPU RAM size: this is the size that the PS1 had
+static constexpr uint32_t   kSampleRate         = 44100;        // SPU output sample rate
+static constexpr uint32_t   kNumSampleBlocks    = 64;           // Length of the generated ADPCM samples in blocks
+static constexpr uint32_t   kLoopStartBlock     = 16;           // Where the looping ADPCM sample loops back to
+static constexpr uint32_t   kOneShotAddr8       = 0;            // Where the non looping sample is in SPU RAM (8 byte units)
+static constexpr uint32_t   kLoopingAddr8       = 0x1000 / 8;   // Where the looping sample is in SPU RAM (8 byte units)
+static constexpr uint32_t   kNumPcmSamples      = 28 * 200;     // Length of the generated PCM sounds used to test the encoder
+
+// Settings, read from the command line
+struct GoldenSettings {
+    bool            bUpdate;        // Write new references instead of checking against the existing ones
+    std::string     refsPath;       // The file of reference hashes
+};
+
+// The hash of the output for a single case in the corpus
+struct GoldenResult {
+    std::string     name;
+    uint64_t        hash;
+};
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Read the settings from the command line; returns nothing if the command line is invalid
+//------------------------------------------------------------------------------------------------------------------------------------------
+static std::optional<GoldenSettings> ReadSettings(const int argc, const char* const* const argv) noexcept {
+    GoldenSettings settings = {};
+
+    for (int argIdx = 1; argIdx < argc; ++argIdx) {
+        const char* const arg = argv[argIdx];
+
+        if (std::strcmp(arg, "--update") == 0) {
+            settings.bUpdate = true;
+        } else if ((arg[0] == '-') || (!settings.refsPath.empty())) {
+            return std::nullopt;
+        } else {
+            settings.refsPath = arg;
+        }
+    }
+
+    if (settings.refsPath.empty())
+        return std::nullopt;
+
+    return settings;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// A simple deterministic random number generator, so the corpus is the same everywhere
+//------------------------------------------------------------------------------------------------------------------------------------------
+struct Lcg {
+    uint32_t state;
+
+    inline uint32_t next() noexcept {
+        state = state * 1664525u + 1013904223u;
+        return state >> 8;
+    }
+};
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Hashes a run of output: each case hashes all of it's output, in order
+//------------------------------------------------------------------------------------------------------------------------------------------
+static uint64_t HashBytes(const uint64_t hash, const void* const pData, const size_t size) noexcept {
+    return WDL_FNV64(hash, (const unsigned char*) pData, (int) size);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Write a generated ADPCM sample to SPU RAM: random sample data cycling through all 5 ADPCM filters and a range of shifts.
+// The sample is either silenced when it ends, or loops back to 'kLoopStartBlock'.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void WriteAdpcmSample(std::byte* const pDst, const bool bLooping, const uint32_t seed) noexcept {
+    Lcg rng = { seed };
+
+    for (uint32_t blockIdx = 0; blockIdx < kNumSampleBlocks; ++blockIdx) {
+        std::byte* const pBlock = pDst + blockIdx * Spu::ADPCM_BLOCK_SIZE;
+        const uint8_t filter = (uint8_t)(blockIdx % 5);
+        const uint8_t shift = (uint8_t)(2 + (blockIdx / 5) % 10);
+        uint8_t flags = 0;
+
+        if (bLooping && (blockIdx == kLoopStartBlock)) {
+            flags |= Spu::ADPCM_FLAG_LOOP_START;
+        }
+
+        if (blockIdx + 1 == kNumSampleBlocks) {
+            flags |= (bLooping) ? Spu::ADPCM_FLAG_LOOP_END | Spu::ADPCM_FLAG_REPEAT : Spu::ADPCM_FLAG_LOOP_END;
+        }
+
+        pBlock[0] = (std::byte)((filter << 4) | shift);
+        pBlock[1] = (std::byte) flags;
+
+        for (int32_t i = 2; i < Spu::ADPCM_BLOCK_SIZE; ++i) {
+            pBlock[i] = (std::byte) rng.next();
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Make an ADSR envelope from it's individual settings
+//------------------------------------------------------------------------------------------------------------------------------------------
+static Spu::AdsrEnvelope MakeEnvelope(
+    const uint32_t attackShift,
+    const uint32_t attackStep,
+    const bool bAttackExp,
+    const uint32_t decayShift,
+    const uint32_t sustainLevel,
+    const uint32_t sustainShift,
+    const uint32_t sustainStep,
+    const bool bSustainDec,
+    const bool bSustainExp,
+    const uint32_t releaseShift,
+    const bool bReleaseExp
+) noexcept {
+    Spu::AdsrEnvelope env = {};
+    env.attackShift = attackShift;
+    env.attackStep = attackStep;
+    env.bAttackExp = bAttackExp;
+    env.decayShift = decayShift;
+    env.sustainLevel = sustainLevel;
+    env.sustainShift = sustainShift;
+    env.sustainStep = sustainStep;
+    env.bSustainDec = bSustainDec;
+    env.bSustainExp = bSustainExp;
+    env.releaseShift = releaseShift;
+    env.bReleaseExp = bReleaseExp;
+    return env;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Setup an SPU core for the corpus: both generated samples in RAM and the given reverb preset (which may be off)
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <class SampleT>
+static void InitCorpusCore(Spu::Core<SampleT>& spu, const int32_t reverbPreset) noexcept {
+    using namespace SpuReverbPresets;
+
+    Spu::initCore(spu, kSpuRamSize, 2);
+    WriteAdpcmSample(spu.pRam + kOneShotAddr8 * 8, false, 1);
+    WriteAdpcmSample(spu.pRam + kLoopingAddr8 * 8, true, 2);
+
+    static_assert(sizeof(SpuReverbDef) == sizeof(Spu::ReverbRegs));
+    std::memcpy(&spu.reverbRegs, &gReverbDefs[reverbPreset], sizeof(Spu::ReverbRegs));
+    spu.reverbBaseAddr8 = (reverbPreset != SPU_REV_MODE_OFF) ? gReverbWorkAreaBaseAddrs[reverbPreset] : (kSpuRamSize / 8) - 1;
+    spu.reverbCurAddr = spu.reverbBaseAddr8 * 8;
+    spu.masterVol = { 0x3FFF, 0x3FFF };
+    spu.reverbVol = (reverbPreset != SPU_REV_MODE_OFF) ? Spu::Volume{ 0x2FFF, 0x2FFF } : Spu::Volume{ 0, 0 };
+    spu.extInputVol = { 0, 0 };
+    spu.bUnmute = true;
+    spu.bReverbWriteEnable = (reverbPreset != SPU_REV_MODE_OFF);
+    spu.bExtEnabled = false;
+    spu.bExtReverbEnable = false;
+    spu.pExtInputCallback = nullptr;
+    spu.pExtInputUserData = nullptr;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Run the SPU for the given number of frames and add the output to the given hash
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <class SampleT>
+static uint64_t RenderAndHash(Spu::Core<SampleT>& spu, const uint32_t numFrames, uint64_t hash) noexcept {
+    for (uint32_t i = 0; i < numFrames; ++i) {
+        const Spu::StereoSample<SampleT> output = Spu::stepCore(spu);
+        hash = HashBytes(hash, &output.left.value, sizeof(output.left.value));
+        hash = HashBytes(hash, &output.right.value, sizeof(output.right.value));
+    }
+
+    return hash;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Play a single note on voice 0 of a corpus SPU core and hash the output: the note is held and then released.
+// Voice 1 plays the other sample at a fixed pitch, so mixing is covered too.
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <class SampleT>
+static uint64_t RenderVoiceCase(
+    const int32_t reverbPreset,
+    const bool bLooping,
+    const uint16_t sampleRate,
+    const Spu::AdsrEnvelope& env,
+    const uint32_t numHeldFrames,
+    const uint32_t numReleasedFrames
+) noexcept {
+    Spu::Core<SampleT> spu;
+    InitCorpusCore(spu, reverbPreset);
+
+    const bool bReverb = (reverbPreset != SpuReverbPresets::SPU_REV_MODE_OFF);
+    Spu::Voice<SampleT>& voice = spu.pVoices[0];
+    voice.adpcmStartAddr8 = (bLooping) ? kLoopingAddr8 : kOneShotAddr8;
+    voice.sampleRate = sampleRate;
+    voice.env = env;
+    voice.volume = { 0x3000, 0x1800 };
+    voice.bDoReverb = bReverb;
+
+    Spu::Voice<SampleT>& otherVoice = spu.pVoices[1];
+    otherVoice.adpcmStartAddr8 = (bLooping) ? kOneShotAddr8 : kLoopingAddr8;
+    otherVoice.sampleRate = 0x0C00;
+    otherVoice.env = MakeEnvelope(0, 3, false, 0, 15, 31, 0, false, true, 8, false);
+    otherVoice.volume = { 0x0800, -0x1000 };
+    otherVoice.bDoReverb = bReverb;
+
+    Spu::keyOn(voice);
+    Spu::keyOn(otherVoice);
+
+    WDL_denormal_ftz_scope ftzScope;
+    uint64_t hash = WDL_FNV64_IV;
+    hash = RenderAndHash(spu, numHeldFrames, hash);
+    Spu::keyOff(voice);
+    Spu::keyOff(otherVoice);
+    hash = RenderAndHash(spu, numReleasedFrames, hash);
+
+    Spu::destroyCore(spu);
+    return hash;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Feed noise through a reverb preset with the reverb only block processing and hash the output
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <class SampleT>
+static uint64_t RenderReverbBlockCase(const int32_t reverbPreset, const uint32_t stepsPerSample) noexcept {
+    Spu::Core<SampleT> spu;
+    InitCorpusCore(spu, reverbPreset);
+    spu.extInputVol = { 0x7FFF, 0x7FFF };
+    spu.bExtEnabled = true;
+    spu.bExtReverbEnable = true;
+
+    constexpr uint32_t kBlockSize = 256;
+    constexpr uint32_t kNumBlocks = kSampleRate / kBlockSize;
+    constexpr uint32_t kNumNoiseBlocks = kNumBlocks / 4;
+    Spu::StereoSample<SampleT> input[kBlockSize];
+    Spu::StereoSample<SampleT> output[kBlockSize];
+    Lcg rng = { 3 };
+
+    WDL_denormal_ftz_scope ftzScope;
+    uint64_t hash = WDL_FNV64_IV;
+
+    for (uint32_t blockIdx = 0; blockIdx < kNumBlocks; ++blockIdx) {
+        // A burst of noise followed by silence, to get the tail
+        for (uint32_t i = 0; i < kBlockSize; ++i) {
+            const int16_t left = (blockIdx < kNumNoiseBlocks) ? (int16_t)(rng.next() >> 8) : 0;
+            const int16_t right = (blockIdx < kNumNoiseBlocks) ? (int16_t)(rng.next() >> 8) : 0;
+
+            if constexpr (SampleT::IS_FLOAT) {
+                input[i] = { Spu::toFloatSample(left), Spu::toFloatSample(right) };
+            } else {
+                input[i] = { left, right };
+            }
+        }
+
+        Spu::processReverbBlock(spu, input, output, kBlockSize, stepsPerSample);
+
+        for (uint32_t i = 0; i < kBlockSize; ++i) {
+            hash = HashBytes(hash, &output[i].left.value, sizeof(output[i].left.value));
+            hash = HashBytes(hash, &output[i].right.value, sizeof(output[i].right.value));
+        }
+    }
+
+    Spu::destroyCore(spu);
+    return hash;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Render all of the SPU cases for one type of SPU
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <class SampleT>
+static void RunSpuCases(std::vector<GoldenResult>& results) noexcept {
+    using namespace SpuReverbPresets;
+
+    const std::string prefix = (SampleT::IS_FLOAT) ? "float/" : "int16/";
+    const Spu::AdsrEnvelope defaultEnv = MakeEnvelope(0, 3, false, 0, 15, 31, 0, false, true, 4, false);
+
+    // Every envelope mode: attack, decay, sustain (increasing and decreasing) and release, both linear and exponential
+    struct EnvCase {
+        const char*         name;
+        Spu::AdsrEnvelope   env;
+    };
+
+    const EnvCase envCases[] = {
+        { "adsr/attack-linear",         MakeEnvelope(10, 1, false, 0, 15, 31, 0, false, false, 0, false) },
+        { "adsr/attack-exp",            MakeEnvelope(12, 2, true,  0, 15, 31, 0, false, false, 0, false) },
+        { "adsr/decay",                 MakeEnvelope(0, 3, false, 8, 6, 31, 0, false, false, 0, false) },
+        { "adsr/sustain-inc-linear",    MakeEnvelope(0, 3, false, 4, 2, 12, 1, false, false, 0, false) },
+        { "adsr/sustain-inc-exp",       MakeEnvelope(0, 3, false, 4, 2, 12, 1, false, true, 0, false) },
+        { "adsr/sustain-dec-linear",    MakeEnvelope(0, 3, false, 2, 12, 14, 2, true, false, 0, false) },
+        { "adsr/sustain-dec-exp",       MakeEnvelope(0, 3, false, 2, 12, 10, 2, true, true, 0, false) },
+        { "adsr/release-linear",        MakeEnvelope(0, 3, false, 0, 15, 31, 0, false, false, 14, false) },
+        { "adsr/release-exp",           MakeEnvelope(0, 3, false, 0, 15, 31, 0, false, false, 12, true) },
+        { "adsr/slowest",               MakeEnvelope(31, 0, true, 15, 0, 31, 3, true, true, 31, true) },
+    };
+
+    for (const EnvCase& envCase : envCases) {
+        const uint64_t hash = RenderVoiceCase<SampleT>(SPU_REV_MODE_OFF, true, 0x1000, envCase.env, kSampleRate / 2, kSampleRate / 2);
+        results.push_back({ prefix + envCase.name, hash });
+    }
+
+    // Pitch extremes, including rates above the maximum which must be clamped
+    const uint16_t sampleRates[] = { 0x0001, 0x0100, 0x0FFF, 0x1000, 0x1001, 0x3FFF, Spu::MAX_SAMPLE_RATE, 0x4001, 0x8000, 0xFFFF };
+
+    for (const uint16_t sampleRate : sampleRates) {
+        char name[64];
+        std::snprintf(name, sizeof(name), "pitch/%04X", (unsigned) sampleRate);
+        const uint64_t hash = RenderVoiceCase<SampleT>(SPU_REV_MODE_OFF, true, sampleRate, defaultEnv, kSampleRate / 4, kSampleRate / 8);
+        results.push_back({ prefix + name, hash });
+    }
+
+    // Looping and non looping samples, played well past their end
+    results.push_back({ prefix + "sample/oneshot", RenderVoiceCase<SampleT>(SPU_REV_MODE_OFF, false, 0x1000, defaultEnv, kSampleRate, 0) });
+    results.push_back({ prefix + "sample/looping", RenderVoiceCase<SampleT>(SPU_REV_MODE_OFF, true, 0x1000, defaultEnv, kSampleRate, 0) });
+
+    // Every reverb preset, fed by voices and through the reverb only block processing
+    for (int32_t preset = SPU_REV_MODE_OFF + 1; preset < SPU_REV_MODE_MAX; ++preset) {
+        std::string presetName = gReverbModeNames[preset];
+        std::replace(presetName.begin(), presetName.end(), ' ', '-');
+
+        const uint64_t voiceHash = RenderVoiceCase<SampleT>(preset, true, 0x1000, defaultEnv, kSampleRate / 2, kSampleRate);
+        results.push_back({ prefix + "reverb/" + presetName, voiceHash });
+
+        for (uint32_t stepsPerSample = 1; stepsPerSample <= 2; ++stepsPerSample) {
+            const uint64_t blockHash = RenderReverbBlockCase<SampleT>(preset, stepsPerSample);
+            results.push_back({ prefix + "reverb-block/" + presetName + "/x" + std::to_string(stepsPerSample), blockHash });
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Generate one of the PCM sounds used to test the encoder: a decaying sweep, noise bursts or a square wave with hard edges
+//------------------------------------------------------------------------------------------------------------------------------------------
+static std::vector<int16_t> MakePcmSound(const uint32_t soundIdx) noexcept {
+    std::vector<int16_t> samples(kNumPcmSamples);
+    Lcg rng = { 4 + soundIdx };
+    uint32_t phase = 0;
+
+    for (uint32_t i = 0; i < kNumPcmSamples; ++i) {
+        const int32_t decay = (int32_t)(kNumPcmSamples - i);
+        int32_t sample = 0;
+
+        if (soundIdx == 0) {
+            // Triangle wave sweeping upwards
+            phase += 0x00200000u + i * 0x00000400u;
+            const int32_t tri = (int32_t)(phase >> 16) - 0x8000;
+            sample = ((tri < 0) ? -tri : tri) * 2 - 0x7FFF;
+            sample = sample * decay / (int32_t) kNumPcmSamples;
+        } else if (soundIdx == 1) {
+            // Noise, loudest at the start of every 1000 samples
+            sample = ((int32_t)(rng.next() & 0xFFFF) - 0x8000) * (1000 - (int32_t)(i % 1000)) / 1000;
+        } else {
+            // Full scale square wave
+            sample = ((i / 50) & 1) ? 0x7FFF : -0x8000;
+        }
+
+        samples[i] = (int16_t) std::clamp<int32_t>(sample, INT16_MIN, INT16_MAX);
+    }
+
+    return samples;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Run all of the encoder cases: encode each generated sound at both qualities, decode it again and round trip it through a .vag file.
+// Failures of the round trip itself are recorded as a hash of zero, which never matches the references.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void RunEncoderCases(std::vector<GoldenResult>& results) noexcept {
+    const char* const soundNames[] = { "sweep", "noise", "square" };
+
+    for (uint32_t soundIdx = 0; soundIdx < 3; ++soundIdx) {
+        const std::vector<int16_t> pcm = MakePcmSound(soundIdx);
+        const std::string soundName = soundNames[soundIdx];
+
+        // The noise is looped, the others are not
+        const bool bLooping = (soundIdx == 1);
+        const uint32_t loopStartSampleIdx = (bLooping) ? 28 * 50 : 0;
+        const uint32_t loopEndSampleIdx = (bLooping) ? kNumPcmSamples : 0;
+
+        for (const VagUtils::EncodeQuality quality : { VagUtils::EncodeQuality::Full, VagUtils::EncodeQuality::Draft }) {
+            const std::string qualityName = (quality == VagUtils::EncodeQuality::Full) ? "full" : "draft";
+            std::vector<std::byte> adpcm;
+
+            if (!VagUtils::encodePcmSoundToPsxAdpcm(pcm.data(), kNumPcmSamples, loopStartSampleIdx, loopEndSampleIdx, adpcm, quality)) {
+                results.push_back({ "encode/" + soundName + "/" + qualityName, 0 });
+                continue;
+            }
+
+            results.push_back({ "encode/" + soundName + "/" + qualityName, HashBytes(WDL_FNV64_IV, adpcm.data(), adpcm.size()) });
+
+            // Decode it again, including the loop points
+            std::vector<int16_t> decoded;
+            uint32_t decodedLoopStart = 0;
+            uint32_t decodedLoopEnd = 0;
+            VagUtils::decodePsxAdpcmSamples(adpcm.data(), (uint32_t) adpcm.size(), decoded, decodedLoopStart, decodedLoopEnd);
+
+            uint64_t decodeHash = HashBytes(WDL_FNV64_IV, decoded.data(), decoded.size() * sizeof(int16_t));
+            decodeHash = HashBytes(decodeHash, &decodedLoopStart, sizeof(decodedLoopStart));
+            decodeHash = HashBytes(decodeHash, &decodedLoopEnd, sizeof(decodedLoopEnd));
+            results.push_back({ "decode/" + soundName + "/" + qualityName, decodeHash });
+        }
+
+        // Write a .vag file and read it back: the ADPCM data read must be exactly what was written
+        ByteVecOutputStream vagOut;
+        VagUtils::VagFileView vagView = {};
+        std::vector<std::byte> adpcm;
+        std::string errorMsg;
+        uint64_t vagHash = 0;
+
+        const bool bRoundTripOk = (
+            VagUtils::writePcmSoundToVagFile(vagOut, pcm.data(), kNumPcmSamples, 22050, loopStartSampleIdx, loopEndSampleIdx) &&
+            VagUtils::parseVagFile(vagOut.getBytes().data(), vagOut.getBytes().size(), vagView, errorMsg) &&
+            VagUtils::encodePcmSoundToPsxAdpcm(pcm.data(), kNumPcmSamples, loopStartSampleIdx, loopEndSampleIdx, adpcm) &&
+            (vagView.sampleRate == 22050) &&
+            (vagView.adpcmDataSizeInFile == adpcm.size()) &&
+            (std::memcmp(vagView.pAdpcmData, adpcm.data(), adpcm.size()) == 0)
+        );
+
+        if (bRoundTripOk) {
+            vagHash = HashBytes(WDL_FNV64_IV, vagOut.getBytes().data(), vagOut.getBytes().size());
+        }
+
+        results.push_back({ "vag/" + soundName, vagHash });
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Read the reference hashes from the given file: one case per line, with the case name followed by the hash in hex.
+// Blank lines and lines starting with '#' are ignored. Returns nothing if the file can't be read.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static std::optional<std::map<std::string, uint64_t>> ReadRefs(const std::string& filePath) noexcept {
+    std::ifstream file(filePath);
+
+    if (!file.is_open())
+        return std::nullopt;
+
+    std::map<std::string, uint64_t> refs;
+    std::string line;
+
+    while (std::getline(file, line)) {
+        if (line.empty() || (line[0] == '#') || (line[0] == '\r'))
+            continue;
+
+        char name[256] = {};
+        uint64_t hash = 0;
+
+        if (std::sscanf(line.c_str(), "%255s %" SCNx64, name, &hash) == 2) {
+            refs[name] = hash;
+        }
+    }
+
+    return refs;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Write the given results as the new reference hashes
+//------------------------------------------------------------------------------------------------------------------------------------------
+static bool WriteRefs(const std::string& filePath, const std::vector<GoldenResult>& results) noexcept {
+    std::FILE* const pFile = std::fopen(filePath.c_str(), "w");
+
+    if (!pFile)
+        return false;
+
+    std::fprintf(pFile, "# Reference output hashes for the SPU and encoder golden render check (Tools/SpuGolden).\n");
+    std::fprintf(pFile, "# Regenerate with 'SpuGolden --update <this file>' only when a change to the output is intended.\n");
+
+    for (const GoldenResult& result : results) {
+        std::fprintf(pFile, "%s %016" PRIx64 "\n", result.name.c_str(), result.hash);
+    }
+
+    return (std::fclose(pFile) == 0);
+}
+
+int main(int argc, char* argv[]) {
+    const std::optional<GoldenSettings> settings = ReadSettings(argc, argv);
+
+    if (!settings) {
+        std::printf("Usage: SpuGolden [--update] <refs file>\n");
+        return 1;
+    }
+
+    // Render the whole corpus
+    std::vector<GoldenResult> results;
+    RunSpuCases<Spu::Int16Sample>(results);
+    RunSpuCases<Spu::FloatSample>(results);
+    RunEncoderCases(results);
+
+    if (settings->bUpdate) {
+        if (!WriteRefs(settings->refsPath, results)) {
+            std::fprintf(stderr, "Unable to write the references file '%s'!\n", settings->refsPath.c_str());
+            return 1;
+        }
+
+        std::printf("Wrote %u reference hashes to '%s'.\n", (unsigned) results.size(), settings->refsPath.c_str());
+        return 0;
+    }
+
+    // Compare against the references: anything that doesn't match, or which has no reference, fails
+    const std::optional<std::map<std::string, uint64_t>> refs = ReadRefs(settings->refsPath);
+
+    if (!refs) {
+        std::fprintf(stderr, "Unable to read the references file '%s'!\n", settings->refsPath.c_str());
+        return 1;
+    }
+
+    uint32_t numFailed = 0;
+
+    for (const GoldenResult& result : results) {
+        const auto refIter = refs->find(result.name);
+
+        if (refIter == refs->end()) {
+            std::printf("NO REF  %s %016" PRIx64 "\n", result.name.c_str(), result.hash);
+            numFailed++;
+        } else if ((refIter->second != result.hash) || (result.hash == 0)) {
+            std::printf("FAILED  %s %016" PRIx64 " (expected %016" PRIx64 ")\n", result.name.c_str(), result.hash, refIter->second);
+            numFailed++;
+        }
+    }
+
+    std::printf("%u of %u cases match the references.\n", (unsigned)(results.size() - numFailed), (unsigned) results.size());
+    return (numFailed > 0) ? 1 : 0;
+}
@@ -0,0 +1,829 @@
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Headless SPU renderer.
+//
+// Renders Standard MIDI Files and PlayStation SEQ/SEP music sequences through the PlayStation 1 sampler to 32-bit float WAV files, as fast
+// as the CPU allows. Uses the exact same sampler engine and sequence player as the sampler plugin, configured from a JSON file saved by the
+// plugin ('Save Params') and either a .vag sample or a VAB sound bank. Optionally runs the output through one of the LIBSPU reverb presets.
+// Each input file is rendered separately to a .wav file with the same name and multiple files are rendered in parallel, one per thread.
+// Each sequence in a .sep file is rendered to it's own file, with the sequence number appended to the name.
+//
+// Sequences are played once. Loops in a sequence which loop forever are repeated the number of times given by '--loops' (default 1).
+//
+// Usage:
+//      SpuRender --config <params.json> (--vag <sample.vag> | --bank <bank.vab/.vh> [--program <0-127>]) [--reverb <1-9>]
+//                [--tail <seconds>] [--loops <num repeats>] [--threads <num threads>] [--out-dir <dir>]
+//                <input.mid/.seq/.sep> [<input.mid/.seq/.sep> ...]
+//
+// Build (from the repository root), for example:
+//      g++ -std=c++17 -O2 -pthread -IPluginsCommon -IWDL -IDependencies/Plugins/rapidjson/include Tools/SpuRender/SpuRender.cpp
+//          PluginsCommon/SamplerEngine.cpp PluginsCommon/SeqPlayer.cpp PluginsCommon/SeqUtils.cpp PluginsCommon/Spu.cpp
+//          PluginsCommon/FatalErrors.cpp PluginsCommon/FileUtils.cpp PluginsCommon/MappedFile.cpp PluginsCommon/VabUtils.cpp
+//          PluginsCommon/VagUtils.cpp Plugins/PsxReverb/SpuReverbPresets.cpp -o SpuRender
+//------------------------------------------------------------------------------------------------------------------------------------------
+#include "FileUtils.h"
+#include "JsonUtils.h"
+#include "SamplerEngine.h"
+#include "SeqPlayer.h"
+#include "VagUtils.h"
+
+#include "../../Plugins/PsxReverb/SpuReverbPresets.h"
+
+#define WDL_DENORMAL_WANTS_SCOPED_FTZ
+#include "denormal.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace AudioTools;
+
+typedef SamplerEngine::SpuCore          SpuCore;
+typedef SamplerEngine::SpuStereoSample  SpuStereoSample;
+
+static constexpr uint32_t   kSpuRamSize         = 512 * 1024;   // SPU RAM size: this is the size that the PS1 had
+static constexpr uint32_t   kSampleRate         = 44100;        // SPU output sample rate
+static constexpr uint32_t   kMaxRenderBlockSize = 256;          // Maximum number of frames rendered between voice management updates
+
+// Render settings, read from the command line
+struct RenderSettings {
+    std::string                 configPath;     // JSON file with the sampler parameters
+    std::string                 vagPath;        // Sample to play, if not using a sound bank
+    std::string                 bankPath;       // Sound bank to play, if not using a single sample
+    uint8_t                     program;        // Sound bank program that all MIDI channels start out with
+    int32_t                     reverbPreset;   // LIBSPU reverb preset to use, or 'SPU_REV_MODE_OFF' for no reverb
+    uint32_t                    tailSeconds;    // How many seconds to keep rendering after the last MIDI event or the end of a sequence
+    uint32_t                    loopRepeats;    // How many times to repeat loops in sequences which loop forever
+    uint32_t                    numThreads;     // How many files to render in parallel
+    std::string                 outDir;         // Where to put the output files, or empty to put them next to the input files
+    std::vector<std::string>    inputPaths;     // MIDI and SEQ/SEP files to render
+};
+
+// A single file to render: either a MIDI file or one sequence of a .seq or .sep file
+struct RenderJob {
+    std::string     inputPath;
+    bool            bIsSeq;         // Whether the input is a .seq or .sep file rather than a MIDI file
+    uint32_t        seqIdx;         // Which sequence to render, for .seq and .sep files
+    std::string     outputPath;     // The WAV file to write
+};
+
+// Everything needed to render, shared (read only) by all render threads
+struct RenderSetup {
+    SamplerEngine::Settings     engineSettings;     // Sampler settings read from the JSON config
+    std::vector<std::byte>      sampleSpuRam;       // SPU RAM image with the sample and it's terminator, if not using a sound bank
+};
+
+// A MIDI channel message to be sent to the sampler engine at a particular output frame
+struct MidiEvent {
+    uint64_t    frame;
+    uint8_t     status;
+    uint8_t     data1;
+    uint8_t     data2;
+};
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Read the render settings from the command line; returns nothing if the command line is invalid
+//------------------------------------------------------------------------------------------------------------------------------------------
+static std::optional<RenderSettings> ReadSettings(const int argc, const char* const* const argv) noexcept {
+    RenderSettings settings = {};
+    settings.reverbPreset = SpuReverbPresets::SPU_REV_MODE_OFF;
+    settings.tailSeconds = 2;
+    settings.loopRepeats = 1;
+    settings.numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    for (int argIdx = 1; argIdx < argc; ++argIdx) {
+        const char* const arg = argv[argIdx];
+        const bool bHasValue = (argIdx + 1 < argc);
+
+        if ((std::strcmp(arg, "--config") == 0) && bHasValue) {
+            settings.configPath = argv[++argIdx];
+        } else if ((std::strcmp(arg, "--vag") == 0) && bHasValue) {
+            settings.vagPath = argv[++argIdx];
+        } else if ((std::strcmp(arg, "--bank") == 0) && bHasValue) {
+            settings.bankPath = argv[++argIdx];
+        } else if ((std::strcmp(arg, "--program") == 0) && bHasValue) {
+            settings.program = (uint8_t) std::clamp(std::atoi(argv[++argIdx]), 0, 127);
+        } else if ((std::strcmp(arg, "--reverb") == 0) && bHasValue) {
+            settings.reverbPreset = std::atoi(argv[++argIdx]);
+        } else if ((std::strcmp(arg, "--tail") == 0) && bHasValue) {
+            settings.tailSeconds = (uint32_t) std::max(std::atoi(argv[++argIdx]), 0);
+        } else if ((std::strcmp(arg, "--loops") == 0) && bHasValue) {
+            settings.loopRepeats = (uint32_t) std::max(std::atoi(argv[++argIdx]), 0);
+        } else if ((std::strcmp(arg, "--threads") == 0) && bHasValue) {
+            settings.numThreads = (uint32_t) std::max(std::atoi(argv[++argIdx]), 1);
+        } else if ((std::strcmp(arg, "--out-dir") == 0) && bHasValue) {
+            settings.outDir = argv[++argIdx];
+        } else if ((arg[0] == '-') && (arg[1] == '-')) {
+            return std::nullopt;
+        } else {
+            settings.inputPaths.push_back(arg);
+        }
+    }
+
+    // Need a config, exactly one sound source and something to render
+    if (settings.configPath.empty() || (settings.vagPath.empty() == settings.bankPath.empty()) || settings.inputPaths.empty())
+        return std::nullopt;
+
+    if ((settings.reverbPreset < SpuReverbPresets::SPU_REV_MODE_OFF) || (settings.reverbPreset >= SpuReverbPresets::SPU_REV_MODE_MAX))
+        return std::nullopt;
+
+    return settings;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Read the sampler engine settings from a JSON file saved by the sampler plugin.
+// Follows the same rules as loading the file in the plugin: missing fields keep their default values and values are constrained to the
+// ranges of the plugin parameters. The sample rate is preferred over the base note since it is more precise.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static bool ReadEngineSettings(const std::string& filePath, SamplerEngine::Settings& settingsOut, std::string& errorMsgOut) noexcept {
+    const FileData fileData = FileUtils::getContentsOfFile(filePath.c_str(), 8, std::byte(0));
+    rapidjson::Document jsonDoc;
+
+    if ((!fileData.bytes) || jsonDoc.ParseInsitu((char*) fileData.bytes.get()).HasParseError() || (!jsonDoc.IsObject())) {
+        errorMsgOut = "Unable to read the JSON file. File may be corrupt or have a parse error!";
+        return false;
+    }
+
+    const auto readInt = [&](const char* const name, const int32_t defaultVal, const int32_t minVal, const int32_t maxVal) noexcept {
+        const double value = JsonUtils::getOrDefault<double>(jsonDoc, name, (double) defaultVal);
+        return (uint32_t) std::clamp<double>(std::round(value), (double) minVal, (double) maxVal);
+    };
+
+    const auto readBool = [&](const char* const name, const bool defaultVal) noexcept {
+        return JsonUtils::getOrDefault<bool>(jsonDoc, name, defaultVal);
+    };
+
+    // Defaults and ranges are the same as the plugin parameters
+    SamplerEngine::Settings settings = {};
+    settings.volume = readInt("volume", 127, 0, 127);
+    settings.pan = readInt("pan", 64, 0, 127);
+    settings.noteMin = readInt("noteMin", 0, 0, 127);
+    settings.noteMax = readInt("noteMax", 127, 0, 127);
+    settings.pitchstepUp = (float) readInt("pitchstepUp", 1, 0, 48);
+    settings.pitchstepDown = (float) readInt("pitchstepDown", 1, 0, 48);
+    settings.pitchBendUpOffset = (float) std::clamp(JsonUtils::getOrDefault<double>(jsonDoc, "pitchBendUpOffset", 0.0), 0.0, 48.0);
+    settings.pitchBendDownOffset = (float) std::clamp(JsonUtils::getOrDefault<double>(jsonDoc, "pitchBendDownOffset", 0.0), 0.0, 48.0);
+    settings.adsrEnv.sustainLevel = readInt("adsr_sustainLevel", 15, 0, 15);
+    settings.adsrEnv.decayShift = readInt("adsr_decayShift", 0, 0, 15);
+    settings.adsrEnv.attackStep = readInt("adsr_attackStep", 3, 0, 3);
+    settings.adsrEnv.attackShift = readInt("adsr_attackShift", 0, 0, 31);
+    settings.adsrEnv.bAttackExp = readBool("adsr_attackExponential", false);
+    settings.adsrEnv.releaseShift = readInt("adsr_releaseShift", 0, 0, 31);
+    settings.adsrEnv.bReleaseExp = readBool("adsr_releaseExponential", false);
+    settings.adsrEnv.sustainStep = readInt("adsr_sustainStep", 0, 0, 3);
+    settings.adsrEnv.sustainShift = readInt("adsr_sustainShift", 31, 0, 31);
+    settings.adsrEnv.bSustainDec = readBool("adsr_sustainDecrease", false);
+    settings.adsrEnv.bSustainExp = readBool("adsr_sustainExponential", true);
+
+    if (jsonDoc.HasMember("sampleRate")) {
+        const double sampleRate = std::clamp<double>(std::round(JsonUtils::getOrDefault<double>(jsonDoc, "sampleRate", 11025.0)), 1.0, INT32_MAX);
+        settings.baseNote = (float) SamplerEngine::getBaseNoteForSampleRate(sampleRate);
+    } else if (jsonDoc.HasMember("baseNote")) {
+        const double baseNote = JsonUtils::getOrDefault<double>(jsonDoc, "baseNote", 84.0);
+        const double baseNoteFrac = JsonUtils::getOrDefault<double>(jsonDoc, "baseNoteFrac", 0.0);
+        settings.baseNote = (float) std::clamp(baseNote + baseNoteFrac / 256.0, 0.00001, 10000.0);
+    } else {
+        settings.baseNote = (float) SamplerEngine::getBaseNoteForSampleRate(11025.0);
+    }
+
+    settingsOut = settings;
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Load a .vag sample into an SPU RAM image, placed at the start of RAM and followed by a terminator, the same as the sampler plugin does
+//------------------------------------------------------------------------------------------------------------------------------------------
+static bool LoadVagSample(const std::string& filePath, std::vector<std::byte>& spuRamOut, std::string& errorMsgOut) noexcept {
+    std::vector<std::byte> adpcmData;
+    uint32_t sampleRate = 0;
+
+    if (!VagUtils::readVagFile(filePath.c_str(), adpcmData, sampleRate, errorMsgOut))
+        return false;
+
+    const uint32_t numAdpcmBlocks = (uint32_t)(adpcmData.size() / Spu::ADPCM_BLOCK_SIZE);
+    const uint32_t numAdpcmBytes = numAdpcmBlocks * Spu::ADPCM_BLOCK_SIZE;
+
+    if (numAdpcmBytes + Spu::ADPCM_BLOCK_SIZE * 2 > kSpuRamSize) {
+        errorMsgOut = "The sample is too big to fit in SPU RAM!";
+        return false;
+    }
+
+    spuRamOut.assign(kSpuRamSize, std::byte(0));
+    std::memcpy(spuRamOut.data(), adpcmData.data(), numAdpcmBytes);
+    SamplerEngine::writeSampleTerminator(spuRamOut.data(), kSpuRamSize, numAdpcmBlocks);
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Helpers for reading big endian values and variable length quantities from a MIDI file.
+// All of them fail (return false) if reading would go past the end of the data.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static bool ReadMidiU16(const std::byte*& pCur, const std::byte* const pEnd, uint32_t& valueOut) noexcept {
+    if (pEnd - pCur < 2)
+        return false;
+
+    valueOut = ((uint32_t) pCur[0] << 8) | (uint32_t) pCur[1];
+    pCur += 2;
+    return true;
+}
+
+static bool ReadMidiU32(const std::byte*& pCur, const std::byte* const pEnd, uint32_t& valueOut) noexcept {
+    if (pEnd - pCur < 4)
+        return false;
+
+    valueOut = ((uint32_t) pCur[0] << 24) | ((uint32_t) pCur[1] << 16) | ((uint32_t) pCur[2] << 8) | (uint32_t) pCur[3];
+    pCur += 4;
+    return true;
+}
+
+static bool ReadMidiVarLen(const std::byte*& pCur, const std::byte* const pEnd, uint32_t& valueOut) noexcept {
+    valueOut = 0;
+
+    for (uint32_t i = 0; i < 4; ++i) {
+        if (pCur >= pEnd)
+            return false;
+
+        const uint32_t byte = (uint32_t) *pCur++;
+        valueOut = (valueOut << 7) | (byte & 0x7Fu);
+
+        if ((byte & 0x80u) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Parse a Standard MIDI File (format 0 or 1) into a list of channel messages, timed in output frames and in the order they should be sent.
+// Handles running status, tempo changes (the tempo map is shared by all tracks) and SMPTE time division. System exclusive messages and
+// all meta events other than tempo changes are ignored.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static bool ParseMidiFile(const std::string& filePath, std::vector<MidiEvent>& eventsOut, std::string& errorMsgOut) noexcept {
+    const FileData fileData = FileUtils::getContentsOfFile(filePath.c_str());
+
+    if (!fileData.bytes) {
+        errorMsgOut = "Unable to read the MIDI file!";
+        return false;
+    }
+
+    const std::byte* pCur = fileData.bytes.get();
+    const std::byte* const pFileEnd = pCur + fileData.size;
+
+    // Read the header chunk
+    uint32_t chunkSize = 0;
+    uint32_t format = 0;
+    uint32_t numTracks = 0;
+    uint32_t division = 0;
+
+    const bool bValidHeader = (
+        (fileData.size >= 14) &&
+        (std::memcmp(pCur, "MThd", 4) == 0) &&
+        ReadMidiU32(pCur += 4, pFileEnd, chunkSize) &&
+        (chunkSize >= 6) &&
+        (chunkSize <= (uint32_t)(pFileEnd - pCur)) &&
+        ReadMidiU16(pCur, pFileEnd, format) &&
+        ReadMidiU16(pCur, pFileEnd, numTracks) &&
+        ReadMidiU16(pCur, pFileEnd, division)
+    );
+
+    if ((!bValidHeader) || (format > 1) || (division == 0)) {
+        errorMsgOut = "Not a format 0 or 1 Standard MIDI File!";
+        return false;
+    }
+
+    pCur += chunkSize - 6;
+
+    // Gather the events from all tracks, timed in ticks, with tempo changes as meta events (status 0xFF)
+    struct TickEvent {
+        uint64_t    tick;
+        uint8_t     status;
+        uint8_t     data1;
+        uint8_t     data2;
+        uint32_t    tempo;
+    };
+
+    std::vector<TickEvent> tickEvents;
+
+    for (uint32_t trackIdx = 0; (trackIdx < numTracks) && (pCur < pFileEnd); ) {
+        if ((pFileEnd - pCur < 8) || (!ReadMidiU32(pCur += 4, pFileEnd, chunkSize)) || (chunkSize > (uint32_t)(pFileEnd - pCur))) {
+            errorMsgOut = "The MIDI file is truncated!";
+            return false;
+        }
+
+        const std::byte* const pChunkStart = pCur - 8;
+        const std::byte* const pTrackEnd = pCur + chunkSize;
+        pCur = pTrackEnd;
+
+        // Skip over any unknown chunks
+        if (std::memcmp(pChunkStart, "MTrk", 4) != 0)
+            continue;
+
+        const std::byte* pTrackCur = pChunkStart + 8;
+        uint64_t tick = 0;
+        uint8_t runningStatus = 0;
+
+        while (pTrackCur < pTrackEnd) {
+            uint32_t deltaTicks = 0;
+
+            if (!ReadMidiVarLen(pTrackCur, pTrackEnd, deltaTicks))
+                break;
+
+            tick += deltaTicks;
+
+            if (pTrackCur >= pTrackEnd)
+                break;
+
+            uint8_t status = (uint8_t) *pTrackCur;
+
+            if (status == 0xFF) {
+                // Meta event: only tempo changes and the end of the track matter
+                if (pTrackEnd - pTrackCur < 2)
+                    break;
+
+                const uint8_t metaType = (uint8_t) pTrackCur[1];
+                uint32_t length = 0;
+                pTrackCur += 2;
+
+                if ((!ReadMidiVarLen(pTrackCur, pTrackEnd, length)) || (length > (uint32_t)(pTrackEnd - pTrackCur)))
+                    break;
+
+                if ((metaType == 0x51) && (length >= 3)) {
+                    const uint32_t tempo = ((uint32_t) pTrackCur[0] << 16) | ((uint32_t) pTrackCur[1] << 8) | (uint32_t) pTrackCur[2];
+                    tickEvents.push_back({ tick, 0xFF, 0, 0, tempo });
+                }
+
+                pTrackCur += length;
+
+                if (metaType == 0x2F)
+                    break;
+
+                continue;
+            }
+
+            if ((status == 0xF0) || (status == 0xF7)) {
+                // System exclusive: skip it. This also cancels running status.
+                uint32_t length = 0;
+                ++pTrackCur;
+
+                if ((!ReadMidiVarLen(pTrackCur, pTrackEnd, length)) || (length > (uint32_t)(pTrackEnd - pTrackCur)))
+                    break;
+
+                pTrackCur += length;
+                runningStatus = 0;
+                continue;
+            }
+
+            // Channel message, possibly using running status
+            if (status & 0x80u) {
+                runningStatus = status;
+                ++pTrackCur;
+            } else if (runningStatus != 0) {
+                status = runningStatus;
+            } else {
+                errorMsgOut = "The MIDI file has a data byte without a status byte!";
+                return false;
+            }
+
+            const uint8_t msgType = status >> 4;
+            const uint32_t numDataBytes = ((msgType == 0xC) || (msgType == 0xD)) ? 1 : 2;
+
+            if ((uint32_t)(pTrackEnd - pTrackCur) < numDataBytes)
+                break;
+
+            const uint8_t data1 = (uint8_t) pTrackCur[0];
+            const uint8_t data2 = (numDataBytes > 1) ? (uint8_t) pTrackCur[1] : 0;
+            pTrackCur += numDataBytes;
+            tickEvents.push_back({ tick, status, data1, data2, 0 });
+        }
+
+        ++trackIdx;
+    }
+
+    // Merge the tracks: events at the same tick keep the order of their tracks
+    std::stable_sort(tickEvents.begin(), tickEvents.end(), [](const TickEvent& e1, const TickEvent& e2) noexcept {
+        return (e1.tick < e2.tick);
+    });
+
+    // Convert ticks to output frames using the tempo map (or the fixed rate for SMPTE time division)
+    const bool bSmpte = ((division & 0x8000u) != 0);
+    const double smpteFps = (bSmpte) ? (double)(-(int8_t)(division >> 8)) : 0.0;
+    const double smpteTickSecs = (bSmpte) ? 1.0 / (((smpteFps == 29.0) ? 29.97 : smpteFps) * (double)(division & 0xFFu)) : 0.0;
+    double tickSecs = (bSmpte) ? smpteTickSecs : 0.5 / (double) division;     // 120 BPM until the first tempo change
+    double curSecs = 0.0;
+    uint64_t curTick = 0;
+
+    eventsOut.clear();
+    eventsOut.reserve(tickEvents.size());
+
+    for (const TickEvent& event : tickEvents) {
+        curSecs += (double)(event.tick - curTick) * tickSecs;
+        curTick = event.tick;
+
+        if (event.status == 0xFF) {
+            if (!bSmpte) {
+                tickSecs = (double) event.tempo / (1000000.0 * (double) division);
+            }
+        } else {
+            eventsOut.push_back({ (uint64_t) std::llround(curSecs * kSampleRate), event.status, event.data1, event.data2 });
+        }
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Write interleaved stereo float samples to a 32-bit float WAV file
+//------------------------------------------------------------------------------------------------------------------------------------------
+static bool WriteWavFile(const std::string& filePath, const std::vector<float>& samples) noexcept {
+    const uint32_t dataSize = (uint32_t)(samples.size() * sizeof(float));
+    std::vector<std::byte> fileData;
+
+    try {
+        fileData.reserve(44 + (size_t) dataSize);
+    } catch (...) {
+        return false;
+    }
+
+    const auto putBytes = [&](const void* const pData, const size_t size) noexcept {
+        fileData.insert(fileData.end(), (const std::byte*) pData, (const std::byte*) pData + size);
+    };
+
+    const auto putU32 = [&](const uint32_t value) noexcept {
+        const std::byte bytes[4] = { std::byte(value), std::byte(value >> 8), std::byte(value >> 16), std::byte(value >> 24) };
+        putBytes(bytes, 4);
+    };
+
+    const auto putU16 = [&](const uint16_t value) noexcept {
+        const std::byte bytes[2] = { std::byte(value), std::byte(value >> 8) };
+        putBytes(bytes, 2);
+    };
+
+    putBytes("RIFF", 4);
+    putU32(36 + dataSize);
+    putBytes("WAVE", 4);
+    putBytes("fmt ", 4);
+    putU32(16);
+    putU16(3);                              // WAVE_FORMAT_IEEE_FLOAT
+    putU16(2);                              // Number of channels
+    putU32(kSampleRate);
+    putU32(kSampleRate * 2 * sizeof(float));
+    putU16(2 * sizeof(float));              // Block align
+    putU16(32);                             // Bits per sample
+    putBytes("data", 4);
+    putU32(dataSize);
+
+    for (const float sample : samples) {
+        uint32_t sampleBits = 0;
+        std::memcpy(&sampleBits, &sample, sizeof(float));
+        putU32(sampleBits);
+    }
+
+    return FileUtils::writeDataToFile(filePath.c_str(), fileData.data(), fileData.size());
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Get the output WAV file path for the given input file path, with the given suffix added to the file name
+//------------------------------------------------------------------------------------------------------------------------------------------
+static std::string GetOutputPath(const RenderSettings& settings, const std::string& inputPath, const std::string& nameSuffix) noexcept {
+    const size_t nameStart = inputPath.find_last_of("/\\");
+    const size_t extPos = inputPath.find_last_of('.');
+    const size_t nameEnd = ((extPos != std::string::npos) && ((nameStart == std::string::npos) || (extPos > nameStart))) ? extPos : inputPath.size();
+
+    if (settings.outDir.empty())
+        return inputPath.substr(0, nameEnd) + nameSuffix + ".wav";
+
+    const size_t nameBegin = (nameStart != std::string::npos) ? nameStart + 1 : 0;
+    const char lastDirChar = settings.outDir.back();
+    const bool bDirHasSeparator = ((lastDirChar == '/') || (lastDirChar == '\\'));
+    return settings.outDir + ((bDirHasSeparator) ? "" : "/") + inputPath.substr(nameBegin, nameEnd - nameBegin) + nameSuffix + ".wav";
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Setup an SPU core and sampler engine for rendering, the same way as the sampler plugin does, plus the reverb if wanted.
+// The core is always initialized and must be destroyed by the caller, even on failure.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static bool SetupRenderEngine(
+    const RenderSettings& settings,
+    const RenderSetup& setup,
+    SpuCore& spu,
+    SamplerEngine& engine,
+    std::string& errorMsgOut
+) noexcept {
+    Spu::initCore(spu, kSpuRamSize, SamplerEngine::kMaxVoices);
+
+    spu.masterVol = { 0x3FFF, 0x3FFF };
+    spu.reverbVol = { 0, 0 };
+    spu.extInputVol = { 0, 0 };
+    spu.bUnmute = true;
+    spu.bReverbWriteEnable = false;
+    spu.bExtEnabled = false;
+    spu.bExtReverbEnable = false;
+    spu.pExtInputCallback = nullptr;
+    spu.pExtInputUserData = nullptr;
+    spu.reverbBaseAddr8 = (kSpuRamSize / 8) - 1;
+
+    if (settings.reverbPreset != SpuReverbPresets::SPU_REV_MODE_OFF) {
+        using namespace SpuReverbPresets;
+        static_assert(sizeof(SpuReverbDef) == sizeof(Spu::ReverbRegs));
+        std::memcpy(&spu.reverbRegs, &gReverbDefs[settings.reverbPreset], sizeof(Spu::ReverbRegs));
+        spu.reverbBaseAddr8 = gReverbWorkAreaBaseAddrs[settings.reverbPreset];
+        spu.reverbCurAddr = spu.reverbBaseAddr8 * 8;
+        spu.reverbVol = { 0x2FFF, 0x2FFF };
+        spu.bReverbWriteEnable = true;
+    }
+
+    SamplerEngine::Settings engineSettings = setup.engineSettings;
+    engineSettings.bReverb = (settings.reverbPreset != SpuReverbPresets::SPU_REV_MODE_OFF);
+    engine.setSettings(engineSettings);
+    engine.reset();
+
+    if (!settings.bankPath.empty()) {
+        std::unique_ptr<SamplerEngine::SampleBank> pBank = SamplerEngine::openSampleBank(settings.bankPath, settings.program, errorMsgOut);
+
+        if (!pBank)
+            return false;
+
+        SamplerEngine::uploadSampleBank(*pBank, spu.pRam, kSpuRamSize);
+        engine.swapSampleBank(pBank);
+    } else {
+        std::memcpy(spu.pRam, setup.sampleSpuRam.data(), kSpuRamSize);
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Run the SPU for the given number of frames (up to the maximum render block size), writing interleaved stereo output.
+// Does voice management for the engine afterwards.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void RenderFrames(SpuCore& spu, SamplerEngine& engine, const uint32_t numFrames, float* const pOutput) noexcept {
+    for (uint32_t i = 0; i < numFrames; ++i) {
+        const SpuStereoSample sample = Spu::stepCore(spu);
+        pOutput[i * 2 + 0] = sample.left.value;
+        pOutput[i * 2 + 1] = sample.right.value;
+    }
+
+    engine.advanceVoices(numFrames);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Render a single MIDI file to a WAV file, using it's own SPU core and sampler engine
+//------------------------------------------------------------------------------------------------------------------------------------------
+static bool RenderMidiFile(
+    const RenderSettings& settings,
+    const RenderSetup& setup,
+    const RenderJob& job,
+    uint64_t& numFramesOut,
+    std::string& errorMsgOut
+) noexcept {
+    std::vector<MidiEvent> events;
+
+    if (!ParseMidiFile(job.inputPath, events, errorMsgOut))
+        return false;
+
+    SpuCore spu;
+    SamplerEngine engine(spu);
+
+    if (!SetupRenderEngine(settings, setup, spu, engine, errorMsgOut)) {
+        Spu::destroyCore(spu);
+        return false;
+    }
+
+    // Render until the last event plus the tail
+    const uint64_t numFrames = ((events.empty()) ? 0 : events.back().frame) + (uint64_t) settings.tailSeconds * kSampleRate;
+    std::vector<float> output;
+
+    try {
+        output.resize(numFrames * 2);
+    } catch (...) {
+        errorMsgOut = "Out of memory!";
+        Spu::destroyCore(spu);
+        return false;
+    }
+
+    {
+        // Flush denormals to zero while running the float SPU, same as the plugin does
+        WDL_denormal_ftz_scope ftzScope;
+        size_t eventIdx = 0;
+        uint64_t frame = 0;
+
+        while (frame < numFrames) {
+            // Send all the events due at this frame, then run the SPU up until the next event
+            while ((eventIdx < events.size()) && (events[eventIdx].frame <= frame)) {
+                const MidiEvent& event = events[eventIdx++];
+                engine.processMidiMsg(event.status, event.data1, event.data2);
+            }
+
+            const uint64_t nextEventFrame = (eventIdx < events.size()) ? events[eventIdx].frame : numFrames;
+            const uint32_t blockSize = (uint32_t) std::min<uint64_t>({ nextEventFrame - frame, numFrames - frame, kMaxRenderBlockSize });
+            RenderFrames(spu, engine, blockSize, output.data() + frame * 2);
+            frame += blockSize;
+        }
+    }
+
+    Spu::destroyCore(spu);
+    numFramesOut = numFrames;
+
+    if (!WriteWavFile(job.outputPath, output)) {
+        errorMsgOut = "Unable to write the output WAV file!";
+        return false;
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Render a single sequence of a .seq or .sep file to a WAV file, using it's own SPU core, sampler engine and sequence player.
+// The sequence is played once, followed by the tail.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static bool RenderSeqFile(
+    const RenderSettings& settings,
+    const RenderSetup& setup,
+    const RenderJob& job,
+    uint64_t& numFramesOut,
+    std::string& errorMsgOut
+) noexcept {
+    std::unique_ptr<SeqPlayer::Song> pSong = SeqPlayer::openSong(job.inputPath, errorMsgOut);
+
+    if (!pSong)
+        return false;
+
+    SpuCore spu;
+    SamplerEngine engine(spu);
+    SeqPlayer player(engine);
+
+    if (!SetupRenderEngine(settings, setup, spu, engine, errorMsgOut)) {
+        Spu::destroyCore(spu);
+        return false;
+    }
+
+    player.swapSong(pSong);
+    player.setMaxLoopRepeats(settings.loopRepeats);
+
+    if (!player.play(job.seqIdx, 1)) {
+        errorMsgOut = "The file does not contain the sequence to render!";
+        Spu::destroyCore(spu);
+        return false;
+    }
+
+    // The length isn't known up front, so grow the output as the sequence plays
+    std::vector<float> output;
+
+    try {
+        // Flush denormals to zero while running the float SPU, same as the plugin does
+        WDL_denormal_ftz_scope ftzScope;
+
+        while (true) {
+            const uint32_t blockSize = player.update(kMaxRenderBlockSize);
+
+            if (!player.isPlaying())
+                break;
+
+            const size_t outputSize = output.size();
+            output.resize(outputSize + (size_t) blockSize * 2);
+            RenderFrames(spu, engine, blockSize, output.data() + outputSize);
+        }
+
+        for (uint64_t tailFrames = (uint64_t) settings.tailSeconds * kSampleRate; tailFrames > 0;) {
+            const uint32_t blockSize = (uint32_t) std::min<uint64_t>(tailFrames, kMaxRenderBlockSize);
+            const size_t outputSize = output.size();
+            output.resize(outputSize + (size_t) blockSize * 2);
+            RenderFrames(spu, engine, blockSize, output.data() + outputSize);
+            tailFrames -= blockSize;
+        }
+    } catch (...) {
+        errorMsgOut = "Out of memory!";
+        player.swapSong(pSong);
+        Spu::destroyCore(spu);
+        return false;
+    }
+
+    // Note: unload the song before the SPU core goes away
+    player.swapSong(pSong);
+    Spu::destroyCore(spu);
+    numFramesOut = output.size() / 2;
+
+    if (!WriteWavFile(job.outputPath, output)) {
+        errorMsgOut = "Unable to write the output WAV file!";
+        return false;
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Get the list of files to render for the given input files: one for each MIDI file and .seq file and one per sequence in each .sep file.
+// Returns false if any of the .sep files can't be read.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static bool GetRenderJobs(const RenderSettings& settings, std::vector<RenderJob>& jobsOut) noexcept {
+    bool bAllOk = true;
+
+    for (const std::string& inputPath : settings.inputPaths) {
+        const std::string fileExt = FileUtils::getLowerCaseFileExt(inputPath.c_str());
+
+        if (fileExt == ".sep") {
+            std::string errorMsg;
+            const std::unique_ptr<SeqPlayer::Song> pSong = SeqPlayer::openSong(inputPath, errorMsg);
+
+            if (!pSong) {
+                std::fprintf(stderr, "%s: %s\n", inputPath.c_str(), errorMsg.c_str());
+                bAllOk = false;
+                continue;
+            }
+
+            const uint32_t numSequences = (uint32_t) pSong->seqFile.sequences.size();
+
+            for (uint32_t seqIdx = 0; seqIdx < numSequences; ++seqIdx) {
+                const std::string nameSuffix = "_" + std::to_string(seqIdx);
+                jobsOut.push_back(RenderJob{ inputPath, true, seqIdx, GetOutputPath(settings, inputPath, nameSuffix) });
+            }
+        } else {
+            jobsOut.push_back(RenderJob{ inputPath, (fileExt == ".seq"), 0, GetOutputPath(settings, inputPath, "") });
+        }
+    }
+
+    return bAllOk;
+}
+
+int main(int argc, char* argv[]) {
+    const std::optional<RenderSettings> settings = ReadSettings(argc, argv);
+
+    if (!settings) {
+        std::printf(
+            "Usage: SpuRender --config <params.json> (--vag <sample.vag> | --bank <bank.vab/.vh> [--program <0-127>]) [--reverb <1-9>]\n"
+            "                 [--tail <seconds>] [--loops <num repeats>] [--threads <num threads>] [--out-dir <dir>]\n"
+            "                 <input.mid/.seq/.sep> [<input.mid/.seq/.sep> ...]\n"
+        );
+        return 1;
+    }
+
+    // Read everything that is shared by all the renders
+    RenderSetup setup = {};
+    std::string errorMsg;
+
+    if (!ReadEngineSettings(settings->configPath, setup.engineSettings, errorMsg)) {
+        std::fprintf(stderr, "%s: %s\n", settings->configPath.c_str(), errorMsg.c_str());
+        return 1;
+    }
+
+    if ((!settings->vagPath.empty()) && (!LoadVagSample(settings->vagPath, setup.sampleSpuRam, errorMsg))) {
+        std::fprintf(stderr, "%s: %s\n", settings->vagPath.c_str(), errorMsg.c_str());
+        return 1;
+    }
+
+    // Figure out what to render: each sequence in a .sep file is rendered separately
+    std::vector<RenderJob> jobs;
+    std::atomic<uint32_t> numFailed = (GetRenderJobs(*settings, jobs)) ? 0 : 1;
+
+    // Render all the files, each thread grabbing the next file to render until there are none left
+    const size_t numJobs = jobs.size();
+    const uint32_t numThreads = (uint32_t) std::clamp<size_t>(numJobs, 1, settings->numThreads);
+    std::atomic<size_t> nextJobIdx = 0;
+    std::mutex printMutex;
+
+    const auto renderThread = [&]() noexcept {
+        for (size_t jobIdx = nextJobIdx++; jobIdx < numJobs; jobIdx = nextJobIdx++) {
+            const RenderJob& job = jobs[jobIdx];
+            const auto startTime = std::chrono::steady_clock::now();
+            uint64_t numFrames = 0;
+            std::string renderErrorMsg;
+            const bool bRenderedOk = (job.bIsSeq) ?
+                RenderSeqFile(*settings, setup, job, numFrames, renderErrorMsg) :
+                RenderMidiFile(*settings, setup, job, numFrames, renderErrorMsg);
+            const auto endTime = std::chrono::steady_clock::now();
+            const double ms = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+
+            std::lock_guard<std::mutex> lockPrint(printMutex);
+
+            if (bRenderedOk) {
+                const double seconds = (double) numFrames / kSampleRate;
+                std::printf("%s: %.1f s of audio in %.1f ms (%.0fx realtime)\n", job.outputPath.c_str(), seconds, ms, seconds * 1000.0 / std::max(ms, 0.001));
+            } else {
+                std::fprintf(stderr, "%s: %s\n", job.inputPath.c_str(), renderErrorMsg.c_str());
+                numFailed++;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+
+    for (uint32_t i = 1; i < numThreads; ++i) {
+        threads.emplace_back(renderThread);
+    }
+
+    renderThread();
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    return (numFailed > 0) ? 1 : 0;
+}
@@ -935,6 +935,288 @@ int WDL_ConvolutionEngine_Div::Avail(int wantSamples)
 }
 
 
+/****************************************************************
+**  low latency version, with the tail convolved on a worker thread
+*/
+
+WDL_ConvolutionEngine_Thread::WDL_ConvolutionEngine_Thread()
+{
+  m_worker_blocksize=4096;
+  m_head_len=m_worker_blocksize*2;
+  m_has_tail=false;
+  m_tailin_mask=m_tailout_mask=0;
+  m_tailin_wr=m_tailin_rd=m_tailout_wr=m_tailout_rd=0;
+  m_tail_nch=2;
+  m_head_mixed=0;
+  m_tailin_pending=0;
+  m_tailout_skip=0;
+  m_tail_underruns=0;
+  m_worker_quit=false;
+}
+
+WDL_ConvolutionEngine_Thread::~WDL_ConvolutionEngine_Thread()
+{
+  StopWorker();
+}
+
+int WDL_ConvolutionEngine_Thread::SetImpulse(WDL_ImpulseBuffer *impulse, int maxfft_size, int known_blocksize, int max_imp_size, int impulse_offset, int latency_allowed, int worker_blocksize)
+{
+  StopWorker();
+
+  int bs=256;
+  while (bs < worker_blocksize && bs < 16384) bs*=2;
+  m_worker_blocksize=bs;
+
+  // the tail engine has bs samples of latency, and the host block which completes one of its blocks can run up to known_blocksize
+  // samples past the block boundary: the head covers both plus another bs, which is the time the worker gets to deliver each block
+  m_head_len=bs*2 + (known_blocksize>0 ? known_blocksize : 0);
+
+  int samplesleft=impulse->impulses[0].GetSize()-impulse_offset;
+  if (max_imp_size>0 && samplesleft>max_imp_size) samplesleft=max_imp_size;
+
+  m_has_tail = samplesleft > m_head_len;
+
+  const int rv=m_head.SetImpulse(impulse,maxfft_size,known_blocksize,m_has_tail ? m_head_len : max_imp_size,impulse_offset,latency_allowed);
+
+  if (m_has_tail)
+  {
+    m_tail.SetImpulse(impulse,0,0,samplesleft-m_head_len,impulse_offset+m_head_len,bs);
+
+    // room for several worker blocks (and host blocks) of slack either way, plus the head delay on the output
+    int insize=bs*8;
+    while (insize < known_blocksize*4) insize*=2;
+    int outsize=insize;
+    while (outsize < insize+m_head_len) outsize*=2;
+
+    m_tailin_mask=insize-1;
+    m_tailout_mask=outsize-1;
+    for (int x = 0; x < WDL_CONVO_MAX_PROC_NCH; x ++)
+    {
+      m_tailin[x].Resize(insize);
+      m_tailout[x].Resize(outsize);
+    }
+    m_worker_buf.Resize(bs*WDL_CONVO_MAX_PROC_NCH);
+  }
+  else
+  {
+    for (int x = 0; x < WDL_CONVO_MAX_PROC_NCH; x ++)
+    {
+      m_tailin[x].Resize(0);
+      m_tailout[x].Resize(0);
+    }
+    m_worker_buf.Resize(0);
+  }
+
+  Reset();
+
+  return rv;
+}
+
+void WDL_ConvolutionEngine_Thread::Reset()
+{
+  StopWorker();
+
+  m_head.Reset();
+  m_tail.Reset();
+
+  m_head_mixed=0;
+  m_tailin_pending=0;
+  m_tailout_skip=0;
+  m_tail_underruns=0;
+
+  m_tailin_wr=m_tailin_rd=0;
+  m_tailout_rd=0;
+  if (m_has_tail)
+  {
+    // the tail's output starts m_head_len samples in
+    for (int x = 0; x < WDL_CONVO_MAX_PROC_NCH; x ++)
+      memset(m_tailout[x].Get(),0,m_head_len*sizeof(WDL_FFT_REAL));
+    m_tailout_wr=m_head_len;
+
+    StartWorker();
+  }
+  else
+  {
+    m_tailout_wr=0;
+  }
+}
+
+void WDL_ConvolutionEngine_Thread::StartWorker()
+{
+  m_worker_quit=false;
+  m_worker=std::thread(&WDL_ConvolutionEngine_Thread::WorkerProc,this);
+}
+
+void WDL_ConvolutionEngine_Thread::StopWorker()
+{
+  if (!m_worker.joinable()) return;
+
+  m_worker_quit=true;
+  m_worker.join();
+}
+
+void WDL_ConvolutionEngine_Thread::Add(WDL_FFT_REAL **bufs, int len, int nch)
+{
+  m_head.Add(bufs,len,nch);
+
+  if (!m_has_tail || len<1) return;
+
+  if (nch>WDL_CONVO_MAX_PROC_NCH) nch=WDL_CONVO_MAX_PROC_NCH;
+  m_tail_nch.store(nch,std::memory_order_relaxed);
+
+  const unsigned int size=m_tailin_mask+1;
+  unsigned int wr=m_tailin_wr.load(std::memory_order_relaxed);
+  int space=(int)(size - (wr - m_tailin_rd.load(std::memory_order_acquire)));
+
+  // input the worker wasn't able to take before goes in as silence, so the tail stays in step with the head
+  int n = m_tailin_pending < space ? m_tailin_pending : space;
+  m_tailin_pending-=n;
+  space-=n;
+  while (n>0)
+  {
+    const unsigned int pos=wr&m_tailin_mask;
+    const int l = (int)(size-pos) < n ? (int)(size-pos) : n;
+    for (int x = 0; x < nch; x ++) memset(m_tailin[x].Get()+pos,0,l*sizeof(WDL_FFT_REAL));
+    wr+=l;
+    n-=l;
+  }
+
+  n = len < space ? len : space;
+  m_tailin_pending += len-n;
+  int offs=0;
+  while (offs<n)
+  {
+    const unsigned int pos=wr&m_tailin_mask;
+    const int l = (int)(size-pos) < n-offs ? (int)(size-pos) : n-offs;
+    for (int x = 0; x < nch; x ++)
+    {
+      if (bufs && bufs[x]) memcpy(m_tailin[x].Get()+pos,bufs[x]+offs,l*sizeof(WDL_FFT_REAL));
+      else memset(m_tailin[x].Get()+pos,0,l*sizeof(WDL_FFT_REAL));
+    }
+    wr+=l;
+    offs+=l;
+  }
+
+  // the worker polls for this, so nothing here can block
+  m_tailin_wr.store(wr,std::memory_order_release);
+}
+
+int WDL_ConvolutionEngine_Thread::Avail(int wantSamples)
+{
+  const int av=m_head.Avail(wantSamples);
+
+  if (m_has_tail && av > m_head_mixed)
+  {
+    MixTail(m_head.Get(),m_head_mixed,av-m_head_mixed,m_tail_nch.load(std::memory_order_relaxed));
+    m_head_mixed=av;
+  }
+  return av;
+}
+
+void WDL_ConvolutionEngine_Thread::Advance(int len)
+{
+  m_head.Advance(len);
+  m_head_mixed-=len;
+  if (m_head_mixed<0) m_head_mixed=0;
+}
+
+void WDL_ConvolutionEngine_Thread::MixTail(WDL_FFT_REAL **bufs, int offs, int len, int nch)
+{
+  const unsigned int size=m_tailout_mask+1;
+  unsigned int rd=m_tailout_rd.load(std::memory_order_relaxed);
+  int av=(int)(m_tailout_wr.load(std::memory_order_acquire) - rd);
+
+  // drop the tail for samples that were output without it
+  if (m_tailout_skip>0)
+  {
+    const int n = m_tailout_skip < av ? m_tailout_skip : av;
+    m_tailout_skip-=n;
+    rd+=n;
+    av-=n;
+  }
+
+  int n = len < av ? len : av;
+  if (n < len)
+  {
+    m_tailout_skip += len-n;
+    m_tail_underruns.fetch_add(len-n,std::memory_order_relaxed);
+  }
+
+  while (n>0)
+  {
+    const unsigned int pos=rd&m_tailout_mask;
+    const int l = (int)(size-pos) < n ? (int)(size-pos) : n;
+    for (int x = 0; x < nch; x ++)
+    {
+      WDL_FFT_REAL *o=bufs[x]+offs;
+      const WDL_FFT_REAL *in=m_tailout[x].Get()+pos;
+      int i=l;
+      while (i-->0) *o++ += *in++;
+    }
+    rd+=l;
+    offs+=l;
+    n-=l;
+  }
+
+  m_tailout_rd.store(rd,std::memory_order_release);
+}
+
+void WDL_ConvolutionEngine_Thread::WorkerProc()
+{
+  const int bs=m_worker_blocksize;
+  const unsigned int insize=m_tailin_mask+1, outsize=m_tailout_mask+1;
+
+  while (!m_worker_quit.load())
+  {
+    const unsigned int rd=m_tailin_rd.load(std::memory_order_relaxed);
+    int n=(int)(m_tailin_wr.load(std::memory_order_acquire) - rd);
+    if (n<1)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+
+    // take input as soon as it's there, up to the tail engine's next block boundary, so a block is processed the moment its
+    // last sample arrives rather than waiting on a full block of new input
+    const int toboundary=bs - (int)(rd & (unsigned int)(bs-1));
+    if (n>toboundary) n=toboundary;
+
+    const int nch=m_tail_nch.load(std::memory_order_relaxed);
+    WDL_FFT_REAL *bufs[WDL_CONVO_MAX_PROC_NCH];
+    const unsigned int pos=rd&m_tailin_mask;
+    const int l1 = (int)(insize-pos) < n ? (int)(insize-pos) : n;
+    for (int x = 0; x < nch; x ++)
+    {
+      bufs[x]=m_worker_buf.Get()+x*bs;
+      memcpy(bufs[x],m_tailin[x].Get()+pos,l1*sizeof(WDL_FFT_REAL));
+      if (n>l1) memcpy(bufs[x]+l1,m_tailin[x].Get(),(n-l1)*sizeof(WDL_FFT_REAL));
+    }
+    m_tailin_rd.store(rd+n,std::memory_order_release);
+
+    m_tail.Add(bufs,n,nch);
+
+    unsigned int wr=m_tailout_wr.load(std::memory_order_relaxed);
+    const int space=(int)(outsize - (wr - m_tailout_rd.load(std::memory_order_acquire)));
+    int av=space>0 ? m_tail.Avail(space) : 0;
+    if (av>0)
+    {
+      WDL_FFT_REAL **p=m_tail.Get();
+      int offs=0;
+      while (offs<av)
+      {
+        const unsigned int opos=wr&m_tailout_mask;
+        const int l = (int)(outsize-opos) < av-offs ? (int)(outsize-opos) : av-offs;
+        for (int x = 0; x < nch; x ++) memcpy(m_tailout[x].Get()+opos,p[x]+offs,l*sizeof(WDL_FFT_REAL));
+        wr+=l;
+        offs+=l;
+      }
+      m_tail.Advance(av);
+      m_tailout_wr.store(wr,std::memory_order_release);
+    }
+  }
+}
+
+
 #ifdef WDL_TEST_CONVO
 
 #include <stdio.h>
@@ -34,6 +34,10 @@
 #include "fastqueue.h"
 #include "fft.h"
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+
 #ifndef WDL_CONVO_MAX_IMPULSE_NCH
 #define WDL_CONVO_MAX_IMPULSE_NCH 2
 #endif
@@ -143,7 +147,7 @@ public:
   int SetImpulse(WDL_ImpulseBuffer *impulse, int maxfft_size=0, int known_blocksize=0, int max_imp_size=0, int impulse_offset=0, int latency_allowed=0);
 
   int GetLatency();
-  void Reset();
+  void Reset(); // not real-time safe, see above
 
   void Add(WDL_FFT_REAL **bufs, int len, int nch);
 
@@ -163,4 +167,69 @@ private:
 } WDL_FIXALIGN;
 
 
+// low latency version for long impulses: the start of the impulse (2*worker_blocksize+known_blocksize samples) is convolved by a
+// WDL_ConvolutionEngine_Div on the calling (audio) thread, the rest by another WDL_ConvolutionEngine_Div on a worker thread,
+// in blocks of worker_blocksize. Counting from the Add() which completes a block, the worker has worker_blocksize samples worth
+// of time to deliver it, less however much the host's blocks exceed known_blocksize (all of a host block if known_blocksize
+// is 0, so pass it, or keep worker_blocksize well above the host block size). If the worker is later than that, the tail is
+// left out of the samples concerned (see GetTailUnderruns()) rather than holding up Avail().
+// the audio thread never blocks or wakes the worker: the worker polls for input every millisecond, so worker_blocksize should be
+// well above the OS's sleep granularity in samples.
+// Add()/Avail()/Get()/Advance() must be called from a single thread, SetImpulse()/Reset() must not be called concurrently with them.
+// SetImpulse()/Reset() are not real-time safe: they stop and start the worker thread (and SetImpulse() allocates), so call them
+// from a non-audio thread, or only while the audio thread is not processing.
+class WDL_ConvolutionEngine_Thread
+{
+public:
+  WDL_ConvolutionEngine_Thread();
+  ~WDL_ConvolutionEngine_Thread();
+
+  // worker_blocksize is rounded up to a power of 2 (min 256). impulses no longer than the head (see above) don't start a worker thread.
+  int SetImpulse(WDL_ImpulseBuffer *impulse, int maxfft_size=0, int known_blocksize=0, int max_imp_size=0, int impulse_offset=0, int latency_allowed=0, int worker_blocksize=4096);
+
+  int GetLatency() { return m_head.GetLatency(); }
+  void Reset(); // not real-time safe, see above
+
+  void Add(WDL_FFT_REAL **bufs, int len, int nch);
+
+  int Avail(int wantSamples);
+  WDL_FFT_REAL **Get() { return m_head.Get(); } // returns length valid
+  void Advance(int len);
+
+  // number of samples output without the tail since SetImpulse()/Reset(), because the worker fell behind. safe to call from any thread.
+  int GetTailUnderruns() const { return m_tail_underruns.load(std::memory_order_relaxed); }
+
+private:
+  void StartWorker();
+  void StopWorker();
+  void WorkerProc();
+  void MixTail(WDL_FFT_REAL **bufs, int offs, int len, int nch);
+
+  WDL_ConvolutionEngine_Div m_head; // audio thread
+  WDL_ConvolutionEngine_Div m_tail; // worker thread
+
+  int m_worker_blocksize; // tail engine latency and the maximum input processed per pass
+  int m_head_len; // impulse samples convolved by m_head, the tail output is delayed by this much
+  bool m_has_tail;
+
+  // single producer/single consumer rings (power of 2 sizes), the positions only ever increase (and wrap)
+  WDL_TypedBuf<WDL_FFT_REAL> m_tailin[WDL_CONVO_MAX_PROC_NCH], m_tailout[WDL_CONVO_MAX_PROC_NCH];
+  unsigned int m_tailin_mask, m_tailout_mask;
+  std::atomic<unsigned int> m_tailin_wr, m_tailin_rd, m_tailout_wr, m_tailout_rd;
+  std::atomic<int> m_tail_nch;
+
+  // audio thread state
+  int m_head_mixed; // samples of m_head's output which have had the tail mixed in
+  int m_tailin_pending; // input samples which didn't fit in m_tailin, to be sent as silence to keep the tail aligned
+  int m_tailout_skip; // tail samples to discard, standing in for samples already output without them
+  std::atomic<int> m_tail_underruns;
+
+  // worker thread state
+  WDL_TypedBuf<WDL_FFT_REAL> m_worker_buf;
+  std::thread m_worker;
+  std::atomic<bool> m_worker_quit;
+
+} WDL_FIXALIGN;
+
+
 #endif
\ No newline at end of file
@@ -267,6 +267,23 @@ static WDL_FFT_COMPLEX d32768[4095];
   a1.im = t4; \
   }
 
+/* the passes of 32 point and larger FFTs (and the complex multiplies) can be vectorized, see fft_simd.h. these point
+   at the versions in use, WDL_fft_set_impl() changes them */
+
+#define FFT_BIGPASS_N 128 /* cpassbig()/upassbig() are used from n=128 (1024 point FFTs) up */
+
+static void cpass_scalar(WDL_FFT_COMPLEX *a, const WDL_FFT_COMPLEX *w, unsigned int n);
+static void upass_scalar(WDL_FFT_COMPLEX *a, const WDL_FFT_COMPLEX *w, unsigned int n);
+static void complexmul_scalar(WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n);
+static void complexmul2_scalar(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n);
+static void complexmul3_scalar(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n);
+
+static void (*fft_cpass)(WDL_FFT_COMPLEX *a, const WDL_FFT_COMPLEX *w, unsigned int n) = cpass_scalar;
+static void (*fft_upass)(WDL_FFT_COMPLEX *a, const WDL_FFT_COMPLEX *w, unsigned int n) = upass_scalar;
+static void (*fft_complexmul)(WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n) = complexmul_scalar;
+static void (*fft_complexmul2)(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n) = complexmul2_scalar;
+static void (*fft_complexmul3)(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n) = complexmul3_scalar;
+
 static void c2(register WDL_FFT_COMPLEX *a)
 {
   register WDL_FFT_REAL t1;
@@ -438,7 +455,7 @@ static void cpass(register WDL_FFT_COMPLEX *a,register const WDL_FFT_COMPLEX *w,
 
 static void c32(register WDL_FFT_COMPLEX *a)
 {
-  cpass(a,d32,4);
+  fft_cpass(a,d32,4);
   c8(a + 16);
   c8(a + 24);
   c16(a);
@@ -446,7 +463,7 @@ static void c32(register WDL_FFT_COMPLEX *a)
 
 static void c64(register WDL_FFT_COMPLEX *a)
 {
-  cpass(a,d64,8);
+  fft_cpass(a,d64,8);
   c16(a + 32);
   c16(a + 48);
   c32(a);
@@ -454,7 +471,7 @@ static void c64(register WDL_FFT_COMPLEX *a)
 
 static void c128(register WDL_FFT_COMPLEX *a)
 {
-  cpass(a,d128,16);
+  fft_cpass(a,d128,16);
   c32(a + 64);
   c32(a + 96);
   c64(a);
@@ -462,7 +479,7 @@ static void c128(register WDL_FFT_COMPLEX *a)
 
 static void c256(register WDL_FFT_COMPLEX *a)
 {
-  cpass(a,d256,32);
+  fft_cpass(a,d256,32);
   c64(a + 128);
   c64(a + 192);
   c128(a);
@@ -470,7 +487,7 @@ static void c256(register WDL_FFT_COMPLEX *a)
 
 static void c512(register WDL_FFT_COMPLEX *a)
 {
-  cpass(a,d512,64);
+  fft_cpass(a,d512,64);
   c128(a + 384);
   c128(a + 256);
   c256(a);
@@ -529,7 +546,7 @@ static void cpassbig(register WDL_FFT_COMPLEX *a,register const WDL_FFT_COMPLEX
 
 static void c1024(register WDL_FFT_COMPLEX *a)
 {
-  cpassbig(a,d1024,128);
+  fft_cpass(a,d1024,128);
   c256(a + 768);
   c256(a + 512);
   c512(a);
@@ -537,7 +554,7 @@ static void c1024(register WDL_FFT_COMPLEX *a)
 
 static void c2048(register WDL_FFT_COMPLEX *a)
 {
-  cpassbig(a,d2048,256);
+  fft_cpass(a,d2048,256);
   c512(a + 1536);
   c512(a + 1024);
   c1024(a);
@@ -545,7 +562,7 @@ static void c2048(register WDL_FFT_COMPLEX *a)
 
 static void c4096(register WDL_FFT_COMPLEX *a)
 {
-  cpassbig(a,d4096,512);
+  fft_cpass(a,d4096,512);
   c1024(a + 3072);
   c1024(a + 2048);
   c2048(a);
@@ -553,7 +570,7 @@ static void c4096(register WDL_FFT_COMPLEX *a)
 
 static void c8192(register WDL_FFT_COMPLEX *a)
 {
-  cpassbig(a,d8192,1024);
+  fft_cpass(a,d8192,1024);
   c2048(a + 6144);
   c2048(a + 4096);
   c4096(a);
@@ -561,7 +578,7 @@ static void c8192(register WDL_FFT_COMPLEX *a)
 
 static void c16384(register WDL_FFT_COMPLEX *a)
 {
-  cpassbig(a,d16384,2048);
+  fft_cpass(a,d16384,2048);
   c4096(a + 8192 + 4096);
   c4096(a + 8192);
   c8192(a);
@@ -569,7 +586,7 @@ static void c16384(register WDL_FFT_COMPLEX *a)
 
 static void c32768(register WDL_FFT_COMPLEX *a)
 {
-  cpassbig(a,d32768,4096);
+  fft_cpass(a,d32768,4096);
   c8192(a + 16384 + 8192);
   c8192(a + 16384);
   c16384(a);
@@ -577,10 +594,9 @@ static void c32768(register WDL_FFT_COMPLEX *a)
 
 
 /* n even, n > 0 */
-void WDL_fft_complexmul(WDL_FFT_COMPLEX *a,WDL_FFT_COMPLEX *b,int n)
+static void complexmul_scalar(WDL_FFT_COMPLEX *a,WDL_FFT_COMPLEX *b,int n)
 {
   register WDL_FFT_REAL t1, t2, t3, t4, t5, t6, t7, t8;
-  if (n<2 || (n&1)) return;
 
   do {
     t1 = a[0].re * b[0].re;
@@ -604,10 +620,9 @@ void WDL_fft_complexmul(WDL_FFT_COMPLEX *a,WDL_FFT_COMPLEX *b,int n)
   } while (n -= 2);
 }
 
-void WDL_fft_complexmul2(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n)
+static void complexmul2_scalar(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n)
 {
   register WDL_FFT_REAL t1, t2, t3, t4, t5, t6, t7, t8;
-  if (n<2 || (n&1)) return;
 
   do {
     t1 = a[0].re * b[0].re;
@@ -631,10 +646,9 @@ void WDL_fft_complexmul2(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX
     c += 2;
   } while (n -= 2);
 }
-void WDL_fft_complexmul3(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n)
+static void complexmul3_scalar(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n)
 {
   register WDL_FFT_REAL t1, t2, t3, t4, t5, t6, t7, t8;
-  if (n<2 || (n&1)) return;
 
   do {
     t1 = a[0].re * b[0].re;
@@ -825,7 +839,7 @@ static void u32(register WDL_FFT_COMPLEX *a)
   u16(a);
   u8(a + 16);
   u8(a + 24);
-  upass(a,d32,4);
+  fft_upass(a,d32,4);
 }
 
 static void u64(register WDL_FFT_COMPLEX *a)
@@ -833,7 +847,7 @@ static void u64(register WDL_FFT_COMPLEX *a)
   u32(a);
   u16(a + 32);
   u16(a + 48);
-  upass(a,d64,8);
+  fft_upass(a,d64,8);
 }
 
 static void u128(register WDL_FFT_COMPLEX *a)
@@ -841,7 +855,7 @@ static void u128(register WDL_FFT_COMPLEX *a)
   u64(a);
   u32(a + 64);
   u32(a + 96);
-  upass(a,d128,16);
+  fft_upass(a,d128,16);
 }
 
 static void u256(register WDL_FFT_COMPLEX *a)
@@ -849,7 +863,7 @@ static void u256(register WDL_FFT_COMPLEX *a)
   u128(a);
   u64(a + 128);
   u64(a + 192);
-  upass(a,d256,32);
+  fft_upass(a,d256,32);
 }
 
 static void u512(register WDL_FFT_COMPLEX *a)
@@ -857,7 +871,7 @@ static void u512(register WDL_FFT_COMPLEX *a)
   u256(a);
   u128(a + 256);
   u128(a + 384);
-  upass(a,d512,64);
+  fft_upass(a,d512,64);
 }
 
 
@@ -918,7 +932,7 @@ static void u1024(register WDL_FFT_COMPLEX *a)
   u512(a);
   u256(a + 512);
   u256(a + 768);
-  upassbig(a,d1024,128);
+  fft_upass(a,d1024,128);
 }
 
 static void u2048(register WDL_FFT_COMPLEX *a)
@@ -926,7 +940,7 @@ static void u2048(register WDL_FFT_COMPLEX *a)
   u1024(a);
   u512(a + 1024);
   u512(a + 1536);
-  upassbig(a,d2048,256);
+  fft_upass(a,d2048,256);
 }
 
 
@@ -935,7 +949,7 @@ static void u4096(register WDL_FFT_COMPLEX *a)
   u2048(a);
   u1024(a + 2048);
   u1024(a + 3072);
-  upassbig(a,d4096,512);
+  fft_upass(a,d4096,512);
 }
 
 static void u8192(register WDL_FFT_COMPLEX *a)
@@ -943,7 +957,7 @@ static void u8192(register WDL_FFT_COMPLEX *a)
   u4096(a);
   u2048(a + 4096);
   u2048(a + 6144);
-  upassbig(a,d8192,1024);
+  fft_upass(a,d8192,1024);
 }
 
 static void u16384(register WDL_FFT_COMPLEX *a)
@@ -951,7 +965,7 @@ static void u16384(register WDL_FFT_COMPLEX *a)
   u8192(a);
   u4096(a + 8192);
   u4096(a + 8192 + 4096);
-  upassbig(a,d16384,2048);
+  fft_upass(a,d16384,2048);
 }
 
 static void u32768(register WDL_FFT_COMPLEX *a)
@@ -959,7 +973,270 @@ static void u32768(register WDL_FFT_COMPLEX *a)
   u16384(a);
   u8192(a + 16384);
   u8192(a + 16384  + 8192 );
-  upassbig(a,d32768,4096);
+  fft_upass(a,d32768,4096);
+}
+
+
+static void cpass_scalar(WDL_FFT_COMPLEX *a, const WDL_FFT_COMPLEX *w, unsigned int n)
+{
+  if (n < FFT_BIGPASS_N) cpass(a,w,n);
+  else cpassbig(a,w,n);
+}
+
+static void upass_scalar(WDL_FFT_COMPLEX *a, const WDL_FFT_COMPLEX *w, unsigned int n)
+{
+  if (n < FFT_BIGPASS_N) upass(a,w,n);
+  else upassbig(a,w,n);
+}
+
+
+/* twiddles for the vectorized passes, a[k] of each quarter uses fft_passtw[k] (the [0] and, for big passes, [n] entries
+   are unused). one table per FFT size, 2n entries each, n = 4 (32 point) to 4096 (32768 point) */
+static WDL_FFT_COMPLEX fft_passtw[32768/2 - 8];
+#define FFT_PASSTW(n) (fft_passtw + (n)*2 - 8)
+
+static void fft_passtw_gen(const WDL_FFT_COMPLEX *w, unsigned int n)
+{
+  WDL_FFT_COMPLEX *tw = FFT_PASSTW(n);
+  const unsigned int n2 = n * 2;
+  unsigned int k;
+
+  tw[0].re = 1;
+  tw[0].im = 0;
+  if (n < FFT_BIGPASS_N)
+  {
+    for (k = 1; k < n2; k ++) tw[k] = w[k-1];
+  }
+  else
+  {
+    for (k = 1; k < n; k ++) tw[k] = w[k-1];
+    tw[n].re = tw[n].im = sqrthalf;
+    for (k = n+1; k < n2; k ++)
+    {
+      tw[k].re = w[n2-k-1].im;
+      tw[k].im = w[n2-k-1].re;
+    }
+  }
+}
+
+#ifndef WDL_FFT_NO_SIMD
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FFT_HAVE_SSE2
+#include <emmintrin.h>
+
+#define FFT_SIMD(x) x##_sse2
+#define FFT_SIMD_FUNC
+#if WDL_FFT_REALSIZE == 4
+#define fft_v __m128
+#define FFT_V_N 4
+#define FFT_V_LOAD2(p,re,im) { const __m128 lo_ = _mm_loadu_ps((const float *)(p)), hi_ = _mm_loadu_ps((const float *)(p) + 4); \
+  re = _mm_shuffle_ps(lo_,hi_,_MM_SHUFFLE(2,0,2,0)); im = _mm_shuffle_ps(lo_,hi_,_MM_SHUFFLE(3,1,3,1)); }
+#define FFT_V_STORE2(p,re,im) { const __m128 re_ = (re), im_ = (im); \
+  _mm_storeu_ps((float *)(p),_mm_unpacklo_ps(re_,im_)); _mm_storeu_ps((float *)(p) + 4,_mm_unpackhi_ps(re_,im_)); }
+#define FFT_V_ADD _mm_add_ps
+#define FFT_V_SUB _mm_sub_ps
+#define FFT_V_MUL _mm_mul_ps
+#else
+#define fft_v __m128d
+#define FFT_V_N 2
+#define FFT_V_LOAD2(p,re,im) { const __m128d lo_ = _mm_loadu_pd((const double *)(p)), hi_ = _mm_loadu_pd((const double *)(p) + 2); \
+  re = _mm_unpacklo_pd(lo_,hi_); im = _mm_unpackhi_pd(lo_,hi_); }
+#define FFT_V_STORE2(p,re,im) { const __m128d re_ = (re), im_ = (im); \
+  _mm_storeu_pd((double *)(p),_mm_unpacklo_pd(re_,im_)); _mm_storeu_pd((double *)(p) + 2,_mm_unpackhi_pd(re_,im_)); }
+#define FFT_V_ADD _mm_add_pd
+#define FFT_V_SUB _mm_sub_pd
+#define FFT_V_MUL _mm_mul_pd
+#endif
+#include "fft_simd.h"
+
+/* AVX is chosen at runtime, so is compiled for whatever the compiler is targeting */
+#if !defined(WDL_FFT_NO_AVX) && (defined(__GNUC__) || (defined(_MSC_VER) && _MSC_VER >= 1600))
+#define FFT_HAVE_AVX
+#include <immintrin.h>
+
+#define FFT_SIMD(x) x##_avx
+#ifdef __GNUC__
+#define FFT_SIMD_FUNC __attribute__((target("avx")))
+#else
+#define FFT_SIMD_FUNC
+#endif
+/* these deinterleave within each 128 bit half, which leaves the lanes out of order: the same for a[] and the twiddles */
+#if WDL_FFT_REALSIZE == 4
+#define fft_v __m256
+#define FFT_V_N 8
+#define FFT_V_LOAD2(p,re,im) { const __m256 lo_ = _mm256_loadu_ps((const float *)(p)), hi_ = _mm256_loadu_ps((const float *)(p) + 8); \
+  re = _mm256_shuffle_ps(lo_,hi_,_MM_SHUFFLE(2,0,2,0)); im = _mm256_shuffle_ps(lo_,hi_,_MM_SHUFFLE(3,1,3,1)); }
+#define FFT_V_STORE2(p,re,im) { const __m256 re_ = (re), im_ = (im); \
+  _mm256_storeu_ps((float *)(p),_mm256_unpacklo_ps(re_,im_)); _mm256_storeu_ps((float *)(p) + 8,_mm256_unpackhi_ps(re_,im_)); }
+#define FFT_V_ADD _mm256_add_ps
+#define FFT_V_SUB _mm256_sub_ps
+#define FFT_V_MUL _mm256_mul_ps
+#else
+#define fft_v __m256d
+#define FFT_V_N 4
+#define FFT_V_LOAD2(p,re,im) { const __m256d lo_ = _mm256_loadu_pd((const double *)(p)), hi_ = _mm256_loadu_pd((const double *)(p) + 4); \
+  re = _mm256_unpacklo_pd(lo_,hi_); im = _mm256_unpackhi_pd(lo_,hi_); }
+#define FFT_V_STORE2(p,re,im) { const __m256d re_ = (re), im_ = (im); \
+  _mm256_storeu_pd((double *)(p),_mm256_unpacklo_pd(re_,im_)); _mm256_storeu_pd((double *)(p) + 4,_mm256_unpackhi_pd(re_,im_)); }
+#define FFT_V_ADD _mm256_add_pd
+#define FFT_V_SUB _mm256_sub_pd
+#define FFT_V_MUL _mm256_mul_pd
+#endif
+#include "fft_simd.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static int fft_cpu_has_avx()
+{
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info,1);
+  /* AVX and OSXSAVE, and the OS saves the YMM registers */
+  return (info[2] & (1<<28)) && (info[2] & (1<<27)) && (_xgetbv(0) & 6) == 6;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx");
+#endif
+}
+
+#endif // AVX
+
+#endif // SSE2
+
+#if (defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)) && (WDL_FFT_REALSIZE == 4 || defined(__aarch64__) || defined(_M_ARM64))
+#define FFT_HAVE_NEON
+#include <arm_neon.h>
+
+#define FFT_SIMD(x) x##_neon
+#define FFT_SIMD_FUNC
+#if WDL_FFT_REALSIZE == 4
+#define fft_v float32x4_t
+#define FFT_V_N 4
+#define FFT_V_LOAD2(p,re,im) { const float32x4x2_t v_ = vld2q_f32((const float *)(p)); re = v_.val[0]; im = v_.val[1]; }
+#define FFT_V_STORE2(p,re,im) { float32x4x2_t v_; v_.val[0] = (re); v_.val[1] = (im); vst2q_f32((float *)(p),v_); }
+#define FFT_V_ADD vaddq_f32
+#define FFT_V_SUB vsubq_f32
+#define FFT_V_MUL vmulq_f32
+#else
+#define fft_v float64x2_t
+#define FFT_V_N 2
+#define FFT_V_LOAD2(p,re,im) { const float64x2x2_t v_ = vld2q_f64((const double *)(p)); re = v_.val[0]; im = v_.val[1]; }
+#define FFT_V_STORE2(p,re,im) { float64x2x2_t v_; v_.val[0] = (re); v_.val[1] = (im); vst2q_f64((double *)(p),v_); }
+#define FFT_V_ADD vaddq_f64
+#define FFT_V_SUB vsubq_f64
+#define FFT_V_MUL vmulq_f64
+#endif
+#include "fft_simd.h"
+
+#endif // NEON
+
+#endif // !WDL_FFT_NO_SIMD
+
+
+typedef struct
+{
+  const char *name;
+  void (*cpass)(WDL_FFT_COMPLEX *a, const WDL_FFT_COMPLEX *w, unsigned int n);
+  void (*upass)(WDL_FFT_COMPLEX *a, const WDL_FFT_COMPLEX *w, unsigned int n);
+  void (*complexmul)(WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n);
+  void (*complexmul2)(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n);
+  void (*complexmul3)(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n);
+} fft_impl;
+
+#define FFT_IMPL(name,x) { name, cpass_##x, upass_##x, complexmul_##x, complexmul2_##x, complexmul3_##x }
+
+/* in WDL_FFT_IMPL_* order, unsupported ones have no functions */
+static const fft_impl fft_impls[WDL_FFT_IMPL_COUNT] =
+{
+  FFT_IMPL("scalar",scalar),
+#ifdef FFT_HAVE_SSE2
+  FFT_IMPL("SSE2",sse2),
+#else
+  { "SSE2", 0, 0, 0, 0, 0 },
+#endif
+#ifdef FFT_HAVE_AVX
+  FFT_IMPL("AVX",avx),
+#else
+  { "AVX", 0, 0, 0, 0, 0 },
+#endif
+#ifdef FFT_HAVE_NEON
+  FFT_IMPL("NEON",neon),
+#else
+  { "NEON", 0, 0, 0, 0, 0 },
+#endif
+};
+
+#undef FFT_IMPL
+
+static int fft_impl_cur = WDL_FFT_IMPL_SCALAR;
+
+static int fft_impl_supported(int impl)
+{
+  if (impl < 0 || impl >= WDL_FFT_IMPL_COUNT || !fft_impls[impl].cpass) return 0;
+#ifdef FFT_HAVE_AVX
+  if (impl == WDL_FFT_IMPL_AVX) return fft_cpu_has_avx();
+#endif
+  return 1;
+}
+
+const char *WDL_fft_impl_name(int impl)
+{
+  return fft_impl_supported(impl) ? fft_impls[impl].name : 0;
+}
+
+int WDL_fft_get_impl()
+{
+  return fft_impl_cur;
+}
+
+int WDL_fft_set_impl(int impl)
+{
+  WDL_fft_init();
+
+  if (impl == WDL_FFT_IMPL_AUTO)
+  {
+    static const int pref[] = { WDL_FFT_IMPL_AVX, WDL_FFT_IMPL_SSE2, WDL_FFT_IMPL_NEON };
+    unsigned int x;
+    impl = WDL_FFT_IMPL_SCALAR;
+    for (x = 0; x < sizeof(pref)/sizeof(pref[0]); x ++)
+    {
+      if (fft_impl_supported(pref[x])) { impl = pref[x]; break; }
+    }
+  }
+
+  if (fft_impl_supported(impl))
+  {
+    const fft_impl *f = fft_impls + impl;
+    fft_cpass = f->cpass;
+    fft_upass = f->upass;
+    fft_complexmul = f->complexmul;
+    fft_complexmul2 = f->complexmul2;
+    fft_complexmul3 = f->complexmul3;
+    fft_impl_cur = impl;
+  }
+  return fft_impl_cur;
+}
+
+/* n even, n > 0 */
+void WDL_fft_complexmul(WDL_FFT_COMPLEX *a,WDL_FFT_COMPLEX *b,int n)
+{
+  if (n<2 || (n&1)) return;
+  fft_complexmul(a,b,n);
+}
+
+void WDL_fft_complexmul2(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n)
+{
+  if (n<2 || (n&1)) return;
+  fft_complexmul2(c,a,b,n);
+}
+
+void WDL_fft_complexmul3(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n)
+{
+  if (n<2 || (n&1)) return;
+  fft_complexmul3(c,a,b,n);
 }
 
 
@@ -1050,6 +1327,18 @@ void WDL_fft_init()
     fft_gen(d32768,d16384,0);
 #undef fft_gen
 
+    fft_passtw_gen(d32,4);
+    fft_passtw_gen(d64,8);
+    fft_passtw_gen(d128,16);
+    fft_passtw_gen(d256,32);
+    fft_passtw_gen(d512,64);
+    fft_passtw_gen(d1024,128);
+    fft_passtw_gen(d2048,256);
+    fft_passtw_gen(d4096,512);
+    fft_passtw_gen(d8192,1024);
+    fft_passtw_gen(d16384,2048);
+    fft_passtw_gen(d32768,4096);
+
 #ifndef WDL_FFT_NO_PERMUTE
 	  offs = 0;
 	  for (i = 2; i <= 32768; i *= 2) 
@@ -1059,6 +1348,7 @@ void WDL_fft_init()
 	  }
 #endif
 
+    WDL_fft_set_impl(WDL_FFT_IMPL_AUTO);
   }
 }
 
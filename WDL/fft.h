@@ -70,6 +70,29 @@ extern void WDL_real_fft(WDL_FFT_REAL *, int len, int isInverse);
 extern int WDL_fft_permute(int fftsize, int idx);
 extern int *WDL_fft_permute_tab(int fftsize);
 
+/* The FFT passes and complex multiplies have vectorized versions, which give
+results identical to the scalar code. WDL_fft_init() selects the fastest one
+that the CPU supports; WDL_fft_set_impl() can select another (for testing or
+benchmarking, say), and returns the one in use, which is unchanged if impl
+isn't supported. Don't change it while other threads are doing FFTs. Define
+WDL_FFT_NO_SIMD when compiling fft.c to leave out everything but the scalar
+code, or WDL_FFT_NO_AVX to leave out AVX. */
+enum
+{
+  WDL_FFT_IMPL_AUTO = -1,
+  WDL_FFT_IMPL_SCALAR = 0,
+  WDL_FFT_IMPL_SSE2,
+  WDL_FFT_IMPL_AVX,
+  WDL_FFT_IMPL_NEON,
+  WDL_FFT_IMPL_COUNT
+};
+
+extern int WDL_fft_set_impl(int impl);
+extern int WDL_fft_get_impl();
+
+/* Returns the name of impl, or NULL if it isn't supported. */
+extern const char *WDL_fft_impl_name(int impl);
+
 #ifdef __cplusplus
 };
 #endif
@@ -0,0 +1,241 @@
+/*
+  WDL - fft_simd.h
+  Copyright (C) 2006 and later Cockos Incorporated
+  Copyright 1999 D. J. Bernstein
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+
+
+  Vectorized versions of the FFT passes and complex multiplies, for fft.c only: it includes this file once
+  per instruction set, after defining:
+
+    FFT_SIMD(x)                   x with the instruction set's suffix added
+    FFT_SIMD_FUNC                 attributes for the functions (e.g. the target instruction set)
+    fft_v                         the vector type, holding FFT_V_N reals
+    FFT_V_LOAD2(p,re,im)          loads FFT_V_N complex values from p, split into real and imaginary vectors
+    FFT_V_STORE2(p,re,im)         the reverse of FFT_V_LOAD2
+    FFT_V_ADD/SUB/MUL(a,b)
+
+  The vector lanes don't need to be in order, as long as FFT_V_STORE2 puts them back where FFT_V_LOAD2 got them.
+
+  The passes do the same operations in the same order as the TRANSFORM/UNTRANSFORM macros, so the results are
+  identical to the scalar code (and so is the output order, see WDL_fft_permute()). The elements that the scalar
+  code handles with TRANSFORMZERO/TRANSFORMHALF, and any that don't fill a vector, use the scalar macros.
+
+*/
+
+/* a[k..end-1] of each quarter, tw[] from fft_passtw */
+FFT_SIMD_FUNC static void FFT_SIMD(cpass_range)(WDL_FFT_COMPLEX *a, const WDL_FFT_COMPLEX *tw, unsigned int n2, unsigned int k, unsigned int end)
+{
+  register WDL_FFT_REAL t1, t2, t3, t4, t5, t6, t7, t8;
+  WDL_FFT_COMPLEX *a1 = a + n2;
+  WDL_FFT_COMPLEX *a2 = a1 + n2;
+  WDL_FFT_COMPLEX *a3 = a2 + n2;
+
+  for (; k < end && (k & (FFT_V_N-1)); k ++)
+    TRANSFORM(a[k],a1[k],a2[k],a3[k],tw[k].re,tw[k].im);
+
+  for (; k + FFT_V_N <= end; k += FFT_V_N)
+  {
+    fft_v a0r, a0i, a1r, a1i, a2r, a2i, a3r, a3i, wre, wim;
+    fft_v v1, v2, v3, v4, v6, v7, v8;
+
+    FFT_V_LOAD2(a+k,a0r,a0i);
+    FFT_V_LOAD2(a1+k,a1r,a1i);
+    FFT_V_LOAD2(a2+k,a2r,a2i);
+    FFT_V_LOAD2(a3+k,a3r,a3i);
+    FFT_V_LOAD2(tw+k,wre,wim);
+
+    v1 = FFT_V_SUB(a0r,a2r);
+    a0r = FFT_V_ADD(a2r,a0r);
+    v4 = FFT_V_SUB(a1i,a3i);
+    v8 = FFT_V_SUB(v1,v4);
+    v1 = FFT_V_ADD(v1,v4);
+    a1i = FFT_V_ADD(a3i,a1i);
+    v7 = FFT_V_MUL(v8,wre);
+    v4 = FFT_V_MUL(v1,wre);
+    v8 = FFT_V_MUL(v8,wim);
+    v3 = FFT_V_SUB(a1r,a3r);
+    a1r = FFT_V_ADD(a3r,a1r);
+    v1 = FFT_V_MUL(v1,wim);
+    v2 = FFT_V_SUB(a0i,a2i);
+    a0i = FFT_V_ADD(a2i,a0i);
+    v6 = FFT_V_ADD(v2,v3);
+    v2 = FFT_V_SUB(v2,v3);
+    v3 = FFT_V_MUL(v6,wim);
+    a2r = FFT_V_SUB(v7,v3);
+    a2i = FFT_V_ADD(FFT_V_MUL(v6,wre),v8);
+    a3i = FFT_V_SUB(FFT_V_MUL(wre,v2),v1);
+    a3r = FFT_V_ADD(v4,FFT_V_MUL(v2,wim));
+
+    FFT_V_STORE2(a+k,a0r,a0i);
+    FFT_V_STORE2(a1+k,a1r,a1i);
+    FFT_V_STORE2(a2+k,a2r,a2i);
+    FFT_V_STORE2(a3+k,a3r,a3i);
+  }
+
+  for (; k < end; k ++)
+    TRANSFORM(a[k],a1[k],a2[k],a3[k],tw[k].re,tw[k].im);
+}
+
+FFT_SIMD_FUNC static void FFT_SIMD(upass_range)(WDL_FFT_COMPLEX *a, const WDL_FFT_COMPLEX *tw, unsigned int n2, unsigned int k, unsigned int end)
+{
+  register WDL_FFT_REAL t1, t2, t3, t4, t5, t6, t7, t8;
+  WDL_FFT_COMPLEX *a1 = a + n2;
+  WDL_FFT_COMPLEX *a2 = a1 + n2;
+  WDL_FFT_COMPLEX *a3 = a2 + n2;
+
+  for (; k < end && (k & (FFT_V_N-1)); k ++)
+    UNTRANSFORM(a[k],a1[k],a2[k],a3[k],tw[k].re,tw[k].im);
+
+  for (; k + FFT_V_N <= end; k += FFT_V_N)
+  {
+    fft_v a0r, a0i, a1r, a1i, a2r, a2i, a3r, a3i, wre, wim;
+    fft_v v1, v2, v3, v4, v5, v6;
+
+    FFT_V_LOAD2(a+k,a0r,a0i);
+    FFT_V_LOAD2(a1+k,a1r,a1i);
+    FFT_V_LOAD2(a2+k,a2r,a2i);
+    FFT_V_LOAD2(a3+k,a3r,a3i);
+    FFT_V_LOAD2(tw+k,wre,wim);
+
+    v1 = FFT_V_ADD(FFT_V_MUL(a2r,wre),FFT_V_MUL(a2i,wim));
+    v5 = FFT_V_SUB(FFT_V_MUL(a3r,wre),FFT_V_MUL(a3i,wim));
+    v3 = FFT_V_ADD(v5,v1);
+    v5 = FFT_V_SUB(v5,v1);
+    v2 = FFT_V_SUB(FFT_V_MUL(a2i,wre),FFT_V_MUL(a2r,wim));
+    v6 = FFT_V_ADD(FFT_V_MUL(wre,a3i),FFT_V_MUL(wim,a3r));
+
+    a2r = FFT_V_SUB(a0r,v3);
+    a0r = FFT_V_ADD(v3,a0r);
+    a3i = FFT_V_SUB(a1i,v5);
+    a1i = FFT_V_ADD(v5,a1i);
+    v4 = FFT_V_SUB(v2,v6);
+    v6 = FFT_V_ADD(v6,v2);
+    a3r = FFT_V_SUB(a1r,v4);
+    a1r = FFT_V_ADD(v4,a1r);
+    a2i = FFT_V_SUB(a0i,v6);
+    a0i = FFT_V_ADD(v6,a0i);
+
+    FFT_V_STORE2(a+k,a0r,a0i);
+    FFT_V_STORE2(a1+k,a1r,a1i);
+    FFT_V_STORE2(a2+k,a2r,a2i);
+    FFT_V_STORE2(a3+k,a3r,a3i);
+  }
+
+  for (; k < end; k ++)
+    UNTRANSFORM(a[k],a1[k],a2[k],a3[k],tw[k].re,tw[k].im);
+}
+
+/* same arguments as cpass()/cpassbig(), w is not used (the twiddles come from fft_passtw) */
+FFT_SIMD_FUNC static void FFT_SIMD(cpass)(WDL_FFT_COMPLEX *a, const WDL_FFT_COMPLEX *w, unsigned int n)
+{
+  register WDL_FFT_REAL t1, t2, t3, t4, t5, t6, t7, t8;
+  const unsigned int n2 = n * 2;
+  const WDL_FFT_COMPLEX *tw = FFT_PASSTW(n);
+  (void)w;
+
+  TRANSFORMZERO(a[0],a[n2],a[n2*2],a[n2*3]);
+  if (n < FFT_BIGPASS_N)
+  {
+    FFT_SIMD(cpass_range)(a,tw,n2,1,n2);
+  }
+  else
+  {
+    FFT_SIMD(cpass_range)(a,tw,n2,1,n);
+    TRANSFORMHALF(a[n],a[n2+n],a[n2*2+n],a[n2*3+n]);
+    FFT_SIMD(cpass_range)(a,tw,n2,n+1,n2);
+  }
+}
+
+FFT_SIMD_FUNC static void FFT_SIMD(upass)(WDL_FFT_COMPLEX *a, const WDL_FFT_COMPLEX *w, unsigned int n)
+{
+  register WDL_FFT_REAL t1, t2, t3, t4, t5, t6, t7, t8;
+  const unsigned int n2 = n * 2;
+  const WDL_FFT_COMPLEX *tw = FFT_PASSTW(n);
+  (void)w;
+
+  UNTRANSFORMZERO(a[0],a[n2],a[n2*2],a[n2*3]);
+  if (n < FFT_BIGPASS_N)
+  {
+    FFT_SIMD(upass_range)(a,tw,n2,1,n2);
+  }
+  else
+  {
+    FFT_SIMD(upass_range)(a,tw,n2,1,n);
+    UNTRANSFORMHALF(a[n],a[n2+n],a[n2*2+n],a[n2*3+n]);
+    FFT_SIMD(upass_range)(a,tw,n2,n+1,n2);
+  }
+}
+
+/* n even, n > 0: any left over after the vectors go to the scalar versions, which do pairs */
+FFT_SIMD_FUNC static void FFT_SIMD(complexmul)(WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n)
+{
+  int k = 0;
+  for (; k + FFT_V_N <= n; k += FFT_V_N)
+  {
+    fft_v ar, ai, br, bi;
+    FFT_V_LOAD2(a+k,ar,ai);
+    FFT_V_LOAD2(b+k,br,bi);
+    FFT_V_STORE2(a+k,
+      FFT_V_SUB(FFT_V_MUL(ar,br),FFT_V_MUL(ai,bi)),
+      FFT_V_ADD(FFT_V_MUL(ai,br),FFT_V_MUL(ar,bi)));
+  }
+  if (k < n) complexmul_scalar(a+k,b+k,n-k);
+}
+
+FFT_SIMD_FUNC static void FFT_SIMD(complexmul2)(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n)
+{
+  int k = 0;
+  for (; k + FFT_V_N <= n; k += FFT_V_N)
+  {
+    fft_v ar, ai, br, bi;
+    FFT_V_LOAD2(a+k,ar,ai);
+    FFT_V_LOAD2(b+k,br,bi);
+    FFT_V_STORE2(c+k,
+      FFT_V_SUB(FFT_V_MUL(ar,br),FFT_V_MUL(ai,bi)),
+      FFT_V_ADD(FFT_V_MUL(ai,br),FFT_V_MUL(ar,bi)));
+  }
+  if (k < n) complexmul2_scalar(c+k,a+k,b+k,n-k);
+}
+
+FFT_SIMD_FUNC static void FFT_SIMD(complexmul3)(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n)
+{
+  int k = 0;
+  for (; k + FFT_V_N <= n; k += FFT_V_N)
+  {
+    fft_v ar, ai, br, bi, cr, ci;
+    FFT_V_LOAD2(a+k,ar,ai);
+    FFT_V_LOAD2(b+k,br,bi);
+    FFT_V_LOAD2(c+k,cr,ci);
+    FFT_V_STORE2(c+k,
+      FFT_V_ADD(cr,FFT_V_SUB(FFT_V_MUL(ar,br),FFT_V_MUL(ai,bi))),
+      FFT_V_ADD(ci,FFT_V_ADD(FFT_V_MUL(ai,br),FFT_V_MUL(ar,bi))));
+  }
+  if (k < n) complexmul3_scalar(c+k,a+k,b+k,n-k);
+}
+
+#undef FFT_SIMD
+#undef FFT_SIMD_FUNC
+#undef fft_v
+#undef FFT_V_N
+#undef FFT_V_LOAD2
+#undef FFT_V_STORE2
+#undef FFT_V_ADD
+#undef FFT_V_SUB
+#undef FFT_V_MUL